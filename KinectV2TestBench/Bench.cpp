@@ -0,0 +1,2180 @@
+#include "../KinectV2TestCommon/AcquisitionThread.h"
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/BodyIndexCodec.h"
+#include "../KinectV2TestCommon/BodyStats.h"
+#include "../KinectV2TestCommon/BoneMatrices.h"
+#include "../KinectV2TestCommon/ColorConvert.h"
+#include "../KinectV2TestCommon/Colorize.h"
+#include "../KinectV2TestCommon/DepthCodec.h"
+#include "../KinectV2TestCommon/FrameCopy.h"
+#include "../KinectV2TestCommon/FramePipeline.h"
+#include "../KinectV2TestCommon/GestureMatcher.h"
+#include "../KinectV2TestCommon/PointCloud.h"
+#include "../KinectV2TestCommon/Recording.h"
+#include "../KinectV2TestCommon/Registration.h"
+#include "../KinectV2TestCommon/SkeletonFilter.h"
+#include "../KinectV2TestCommon/SkeletonHistory.h"
+#include "../KinectV2TestCommon/SkeletonRecording.h"
+#include "../KinectV2TestCommon/SpatialFilter.h"
+#include "../KinectV2TestCommon/SyntheticSource.h"
+#include "../KinectV2TestCommon/TaskGraph.h"
+#include "../KinectV2TestCommon/TemporalFilter.h"
+#include "../KinectV2TestCommon/Trace.h"
+#include "../KinectV2TestCommon/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	enum
+	{
+		DEPTH_WIDTH = 512,
+		DEPTH_HEIGHT = 424,
+		COLOR_WIDTH = 1920,
+		COLOR_HEIGHT = 1080,
+
+		//! Row pitch alignment of a mapped Direct3D texture.
+		TEXTURE_PITCH_ALIGNMENT = 256
+	};
+
+	double g_seconds = 1.0;
+	const char* g_filter = nullptr;
+	const char* g_depthRecording = nullptr;
+	const char* g_bodyIndexRecording = nullptr;
+	bool g_failed = false;
+	bool g_checkLimits = true;		// speed limits, off with "-nolimits"
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double elapsedSeconds( Clock::time_point start )
+	{
+		return std::chrono::duration< double >( Clock::now() - start ).count();
+	}
+
+	bool selected( const char* name )
+	{
+		return !g_filter || strstr( name, g_filter ) != nullptr;
+	}
+
+	std::size_t texturePitch( std::size_t rowSize )
+	{
+		return ( rowSize + TEXTURE_PITCH_ALIGNMENT - 1 ) / TEXTURE_PITCH_ALIGNMENT * TEXTURE_PITCH_ALIGNMENT;
+	}
+
+	//! Result of a frame kernel, saved with "-json" or "-csv".
+	struct Result
+	{
+		std::string name;
+		uint64_t frames;
+		double seconds;
+		std::size_t pixelsPerFrame;
+		std::size_t bytesPerFrame;
+	};
+
+	std::vector< Result > g_results;
+
+	//! Ticks per second of kinect::traceClock(), the time stamp counter on x86.
+	double g_cycleHz = 0;
+
+	double cyclesPerPixel( const Result& r )
+	{
+		return r.pixelsPerFrame ? r.seconds * g_cycleHz / ( static_cast< double >( r.frames ) * r.pixelsPerFrame ) : 0;
+	}
+
+	void record( const std::string& name, uint64_t frames, double seconds, std::size_t pixelsPerFrame, std::size_t bytesPerFrame )
+	{
+		Result r = { name, frames, seconds, pixelsPerFrame, bytesPerFrame };
+		g_results.push_back( r );
+	}
+
+	void report( const char* name, uint64_t frames, double seconds, std::size_t pixelsPerFrame, std::size_t bytesPerFrame )
+	{
+		const double fps = frames / seconds;
+		record( name, frames, seconds, pixelsPerFrame, bytesPerFrame );
+		printf( "%-24s %10.1f fps %8.2f GB/s", name, fps, fps * bytesPerFrame / 1e9 );
+		if( pixelsPerFrame ) printf( " %8.2f cycles/px", cyclesPerPixel( g_results.back() ) );
+		printf( "\n" );
+	}
+
+	//! Call step repeatedly for g_seconds. Return the number of calls.
+	template< class Step >
+	uint64_t measure( Step step, double& seconds )
+	{
+		uint64_t count = 0;
+		const auto start = Clock::now();
+		do {
+			step();
+			++count;
+		} while( ( seconds = elapsedSeconds( start ) ) < g_seconds );
+		return count;
+	}
+
+	void fail( const char* name, const char* what )
+	{
+		printf( "%-24s FAILED : %s\n", name, what );
+		g_failed = true;
+	}
+
+	//! Depth frames of the recording given on the command line, or of the stand-in sensor.
+	std::vector< std::vector< uint16_t > > loadDepthFrames( std::size_t maxFrames )
+	{
+		std::vector< std::vector< uint16_t > > frames;
+		std::unique_ptr< kinect::FrameSource > source;
+		if( g_depthRecording ) {
+			source.reset( new kinect::RecordingReader( g_depthRecording ) );
+		}
+		else {
+			source.reset( new kinect::SyntheticFrameSource( kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT ) );
+			maxFrames = kinect::SyntheticFrameSource::PATTERN_COUNT;
+		}
+
+		kinect::FrameView frame;
+		while( frames.size() < maxFrames && source->acquireLatestFrame( frame ) )
+		{
+			if( frame.format == kinect::PIXEL_FORMAT_DEPTH16 && frame.width == DEPTH_WIDTH && frame.height == DEPTH_HEIGHT )
+			{
+				const auto* data = reinterpret_cast< const uint16_t* >( frame.data );
+				frames.push_back( std::vector< uint16_t >( data, data + frame.width * frame.height ) );
+			}
+			source->releaseFrame();
+		}
+		return frames;
+	}
+
+	//! Compression ratio and speed of the depth codec, after checking every frame round-trips bit-exactly.
+	void benchDepthCodec( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const auto frames = loadDepthFrames( 300 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+
+		const std::size_t frameBytes = DEPTH_WIDTH * DEPTH_HEIGHT * sizeof( uint16_t );
+		const std::size_t capacity = kinect::depthCodecMaxEncodedSize( DEPTH_WIDTH, DEPTH_HEIGHT );
+		std::vector< std::vector< unsigned char > > encoded( frames.size() );
+		std::vector< uint16_t > decoded( DEPTH_WIDTH * DEPTH_HEIGHT );
+		uint64_t encodedBytes = 0;
+		for( std::size_t i = 0; i < frames.size(); ++i )
+		{
+			encoded[ i ].resize( capacity );
+			encoded[ i ].resize( kinect::encodeDepth(
+				frames[ i ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, encoded[ i ].data(), capacity, simd ) );
+			encodedBytes += encoded[ i ].size();
+
+			kinect::decodeDepth( encoded[ i ].data(), encoded[ i ].size(), decoded.data(), DEPTH_WIDTH, DEPTH_HEIGHT, simd );
+			if( decoded != frames[ i ] ) {
+				fail( name, "round trip mismatch" );
+				return;
+			}
+		}
+
+		std::vector< unsigned char > buffer( capacity );
+		std::size_t index = 0;
+		double encodeSeconds;
+		const uint64_t encodeCount = measure( [&]() {
+			kinect::encodeDepth( frames[ index ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, buffer.data(), capacity, simd );
+			index = ( index + 1 ) % frames.size();
+		}, encodeSeconds );
+
+		index = 0;
+		double decodeSeconds;
+		const uint64_t decodeCount = measure( [&]() {
+			kinect::decodeDepth( encoded[ index ].data(), encoded[ index ].size(), decoded.data(), DEPTH_WIDTH, DEPTH_HEIGHT, simd );
+			index = ( index + 1 ) % frames.size();
+		}, decodeSeconds );
+
+		record( std::string( name ) + ".encode", encodeCount, encodeSeconds, DEPTH_WIDTH * DEPTH_HEIGHT, frameBytes );
+		record( std::string( name ) + ".decode", decodeCount, decodeSeconds, DEPTH_WIDTH * DEPTH_HEIGHT, frameBytes );
+		const double ratio = static_cast< double >( frameBytes ) * frames.size() / encodedBytes;
+		printf( "%-24s ratio %5.2f  encode %8.1f MB/s  decode %8.1f MB/s\n", name, ratio,
+			encodeCount * frameBytes / encodeSeconds / 1e6, decodeCount * frameBytes / decodeSeconds / 1e6 );
+	}
+
+	//! Body index frames of the recording given on the command line, or of the stand-in sensor.
+	std::vector< std::vector< uint8_t > > loadBodyIndexFrames( std::size_t maxFrames )
+	{
+		std::vector< std::vector< uint8_t > > frames;
+		std::unique_ptr< kinect::FrameSource > source;
+		if( g_bodyIndexRecording ) {
+			source.reset( new kinect::RecordingReader( g_bodyIndexRecording ) );
+		}
+		else {
+			source.reset( new kinect::SyntheticFrameSource( kinect::PIXEL_FORMAT_BODY_INDEX8, DEPTH_WIDTH, DEPTH_HEIGHT ) );
+			maxFrames = kinect::SyntheticFrameSource::PATTERN_COUNT;
+		}
+
+		kinect::FrameView frame;
+		while( frames.size() < maxFrames && source->acquireLatestFrame( frame ) )
+		{
+			if( frame.format == kinect::PIXEL_FORMAT_BODY_INDEX8 && frame.width == DEPTH_WIDTH && frame.height == DEPTH_HEIGHT )
+			{
+				frames.push_back( std::vector< uint8_t >( frame.data, frame.data + frame.width * frame.height ) );
+			}
+			source->releaseFrame();
+		}
+		return frames;
+	}
+
+	//! Compression ratio and speed of the body index codec, after checking the round trip,
+	//! the rendered colors and the body boxes of every frame.
+	void benchBodyIndexCodec( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const auto frames = loadBodyIndexFrames( 300 );
+		if( frames.empty() ) {
+			fail( name, "no body index frames" );
+			return;
+		}
+
+		const std::size_t frameBytes = DEPTH_WIDTH * DEPTH_HEIGHT;
+		const std::size_t pitch = texturePitch( DEPTH_WIDTH * 4 );
+		const std::size_t capacity = kinect::bodyIndexCodecMaxEncodedSize( DEPTH_WIDTH, DEPTH_HEIGHT );
+		std::vector< std::vector< unsigned char > > encoded( frames.size() );
+		std::vector< uint8_t > decoded( frameBytes );
+		std::vector< unsigned char > image( pitch * DEPTH_HEIGHT );
+		uint64_t encodedBytes = 0;
+		for( std::size_t i = 0; i < frames.size(); ++i )
+		{
+			const std::vector< uint8_t >& frame = frames[ i ];
+			encoded[ i ].resize( capacity );
+			encoded[ i ].resize( kinect::encodeBodyIndex(
+				frame.data(), DEPTH_WIDTH, DEPTH_HEIGHT, encoded[ i ].data(), capacity, simd ) );
+			encodedBytes += encoded[ i ].size();
+
+			kinect::decodeBodyIndex( encoded[ i ].data(), encoded[ i ].size(), decoded.data(), DEPTH_WIDTH, DEPTH_HEIGHT );
+			if( decoded != frame ) {
+				fail( name, "round trip mismatch" );
+				return;
+			}
+
+			kinect::renderBodyIndex( encoded[ i ].data(), encoded[ i ].size(), image.data(), pitch, DEPTH_WIDTH, DEPTH_HEIGHT );
+			for( std::size_t p = 0; p < frameBytes; ++p )
+			{
+				uint32_t color;
+				memcpy( &color, &image[ p / DEPTH_WIDTH * pitch + p % DEPTH_WIDTH * 4 ], 4 );
+				if( color != kinect::bodyIndexColor( frame[ p ] ) ) {
+					fail( name, "rendered color mismatch" );
+					return;
+				}
+			}
+
+			// Boxes against a brute force scan.
+			kinect::BodyIndexBox expected[ kinect::MAX_BODY_COUNT ] = {};
+			for( unsigned int y = 0; y < DEPTH_HEIGHT; ++y )
+			{
+				for( unsigned int x = 0; x < DEPTH_WIDTH; ++x )
+				{
+					const uint8_t body = frame[ y * DEPTH_WIDTH + x ];
+					if( body >= kinect::MAX_BODY_COUNT ) continue;
+					kinect::BodyIndexBox& box = expected[ body ];
+					if( box.empty() ) {
+						box.x0 = static_cast< uint16_t >( x );
+						box.y0 = static_cast< uint16_t >( y );
+					}
+					box.x0 = std::min( box.x0, static_cast< uint16_t >( x ) );
+					box.x1 = std::max( box.x1, static_cast< uint16_t >( x + 1 ) );
+					box.y1 = static_cast< uint16_t >( y + 1 );
+				}
+			}
+			unsigned int width, height;
+			kinect::BodyIndexBox boxes[ kinect::MAX_BODY_COUNT ];
+			kinect::readBodyIndexCodecHeader( encoded[ i ].data(), encoded[ i ].size(), width, height, boxes );
+			if( memcmp( boxes, expected, sizeof boxes ) != 0 ) {
+				fail( name, "body box mismatch" );
+				return;
+			}
+		}
+
+		std::vector< unsigned char > buffer( capacity );
+		std::size_t index = 0;
+		double encodeSeconds;
+		const uint64_t encodeCount = measure( [&]() {
+			kinect::encodeBodyIndex( frames[ index ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, buffer.data(), capacity, simd );
+			index = ( index + 1 ) % frames.size();
+		}, encodeSeconds );
+
+		index = 0;
+		double decodeSeconds;
+		const uint64_t decodeCount = measure( [&]() {
+			kinect::decodeBodyIndex( encoded[ index ].data(), encoded[ index ].size(), decoded.data(), DEPTH_WIDTH, DEPTH_HEIGHT );
+			index = ( index + 1 ) % frames.size();
+		}, decodeSeconds );
+
+		index = 0;
+		double renderSeconds;
+		const uint64_t renderCount = measure( [&]() {
+			kinect::renderBodyIndex( encoded[ index ].data(), encoded[ index ].size(), image.data(), pitch, DEPTH_WIDTH, DEPTH_HEIGHT );
+			index = ( index + 1 ) % frames.size();
+		}, renderSeconds );
+
+		record( std::string( name ) + ".encode", encodeCount, encodeSeconds, DEPTH_WIDTH * DEPTH_HEIGHT, frameBytes );
+		record( std::string( name ) + ".decode", decodeCount, decodeSeconds, DEPTH_WIDTH * DEPTH_HEIGHT, frameBytes );
+		record( std::string( name ) + ".render", renderCount, renderSeconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * 4 );
+		const double ratio = static_cast< double >( frameBytes ) * frames.size() / encodedBytes;
+		printf( "%-24s ratio %5.1f  encode %8.1f MB/s  decode %8.1f MB/s  render %8.1f fps\n", name, ratio,
+			encodeCount * frameBytes / encodeSeconds / 1e6, decodeCount * frameBytes / decodeSeconds / 1e6,
+			renderCount / renderSeconds );
+	}
+
+	//! Speed of the per-body statistics on body index and depth frames, after checking that
+	//! the record matches the scalar one and the boxes match the body index codec.
+	void benchBodyStats( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		auto frames = loadBodyIndexFrames( 300 );
+		const auto depthFrames = loadDepthFrames( 300 );
+		if( frames.empty() || depthFrames.empty() ) {
+			fail( name, "no frames" );
+			return;
+		}
+
+		// The stand-in sensor tracks one body. Split each frame's bodies in vertical bands of
+		// labels 0-6, 6 being no body either.
+		const std::size_t recorded = frames.size();
+		for( std::size_t i = 0; i < recorded; ++i )
+		{
+			std::vector< uint8_t > split = frames[ i ];
+			for( std::size_t p = 0; p < split.size(); ++p )
+			{
+				if( split[ p ] != kinect::BODY_INDEX_NONE ) split[ p ] = static_cast< uint8_t >( p % DEPTH_WIDTH * 7 / DEPTH_WIDTH );
+			}
+			frames.push_back( split );
+		}
+
+		std::vector< unsigned char > encoded( kinect::bodyIndexCodecMaxEncodedSize( DEPTH_WIDTH, DEPTH_HEIGHT ) );
+		for( std::size_t i = 0; i < frames.size(); ++i )
+		{
+			const uint8_t* index = frames[ i ].data();
+			const uint16_t* depth = depthFrames[ i % depthFrames.size() ].data();
+
+			// An odd width leaves a scalar tail on every row.
+			const unsigned int widths[] = { DEPTH_WIDTH, DEPTH_WIDTH - 13 };
+			for( const unsigned int width : widths )
+			{
+				for( int withDepth = 0; withDepth < 2; ++withDepth )
+				{
+					kinect::BodyIndexStats expected, stats;
+					kinect::computeBodyIndexStats( index, withDepth ? depth : nullptr, width, DEPTH_HEIGHT, 0, expected, kinect::SIMD_SCALAR );
+					kinect::computeBodyIndexStats( index, withDepth ? depth : nullptr, width, DEPTH_HEIGHT, 0, stats, simd );
+					if( memcmp( &stats, &expected, sizeof stats ) != 0 ) {
+						fail( name, "record differs from scalar" );
+						return;
+					}
+				}
+			}
+
+			kinect::BodyIndexStats stats;
+			kinect::computeBodyIndexStats( index, depth, DEPTH_WIDTH, DEPTH_HEIGHT, 0, stats, simd );
+			const std::size_t size = kinect::encodeBodyIndex( index, DEPTH_WIDTH, DEPTH_HEIGHT, encoded.data(), encoded.size() );
+			unsigned int width, height;
+			kinect::BodyIndexBox boxes[ kinect::MAX_BODY_COUNT ];
+			kinect::readBodyIndexCodecHeader( encoded.data(), size, width, height, boxes );
+			for( int body = 0; body < kinect::MAX_BODY_COUNT; ++body )
+			{
+				if( memcmp( &boxes[ body ], &stats.bodies[ body ].box, sizeof boxes[ body ] ) != 0 ) {
+					fail( name, "box differs from codec" );
+					return;
+				}
+			}
+		}
+
+		std::size_t index = 0;
+		kinect::BodyIndexStats stats;
+		double seconds;
+		const uint64_t count = measure( [&]() {
+			kinect::computeBodyIndexStats( frames[ index ].data(), depthFrames[ index % depthFrames.size() ].data(),
+				DEPTH_WIDTH, DEPTH_HEIGHT, 0, stats, simd );
+			index = ( index + 1 ) % frames.size();
+		}, seconds );
+		report( name, count, seconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * 3 );
+	}
+
+	//! Same texture upload as Step() of the apps.
+	void copyToTexture( const kinect::FrameView& frame, unsigned char* dst, std::size_t pitch )
+	{
+		if( frame.format == kinect::PIXEL_FORMAT_YUY2 )
+		{
+			kinect::convertYuy2ToRgba( frame.data, frame.width, frame.height, dst, pitch );
+			return;
+		}
+
+		kinect::copyFrame( frame, dst, pitch );
+	}
+
+	//! Maximum frame rate of acquire -> copy -> release on the stand-in sensor.
+	void benchStep( const char* name, kinect::PixelFormat format, unsigned int width, unsigned int height )
+	{
+		if( !selected( name ) ) return;
+
+		kinect::SyntheticFrameSource source( format, width, height );
+		const unsigned int texelSize = format == kinect::PIXEL_FORMAT_YUY2 ? 4 : kinect::bytesPerPixel( format );
+		const std::size_t pitch = texturePitch( width * texelSize );
+		std::vector< unsigned char > texture( pitch * height );
+
+		uint64_t frames = 0;
+		const auto start = Clock::now();
+		double seconds;
+		do {
+			kinect::FrameView frame;
+			if( source.acquireLatestFrame( frame ) )
+			{
+				copyToTexture( frame, texture.data(), pitch );
+				source.releaseFrame();
+				++frames;
+			}
+		} while( ( seconds = elapsedSeconds( start ) ) < g_seconds );
+
+		report( name, frames, seconds, width * height, width * height * kinect::bytesPerPixel( format ) );
+	}
+
+	//! Maximum frame rate of replaying a recording into the texture.
+	void benchReplay( const char* name, kinect::PixelFormat format, unsigned int width, unsigned int height )
+	{
+		if( !selected( name ) ) return;
+
+		const char* path = "bench_replay.kv2rec";
+		{
+			kinect::SyntheticFrameSource source( format, width, height );
+			kinect::RecordingWriter writer( path, format, width, height );
+			for( int i = 0; i < 300; ++i )
+			{
+				kinect::FrameView frame;
+				source.acquireLatestFrame( frame );
+				writer.write( frame );
+				source.releaseFrame();
+			}
+		}
+
+		uint64_t frames = 0;
+		double seconds;
+		{
+			kinect::RecordingReader reader( path );
+			const std::size_t pitch = texturePitch( width * kinect::bytesPerPixel( format ) );
+			std::vector< unsigned char > texture( pitch * height );
+
+			const auto start = Clock::now();
+			do {
+				kinect::FrameView frame;
+				if( !reader.acquireLatestFrame( frame ) )
+				{
+					reader.seek( 0 );
+					continue;
+				}
+				copyToTexture( frame, texture.data(), pitch );
+				reader.releaseFrame();
+				++frames;
+			} while( ( seconds = elapsedSeconds( start ) ) < g_seconds );
+		}
+		std::remove( path );
+
+		report( name, frames, seconds, width * height, width * height * kinect::bytesPerPixel( format ) );
+	}
+
+	//! YUY2 to RGBA conversion of a color frame into a padded texture.
+	void benchYuy2ToRgba( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		kinect::SyntheticFrameSource source( kinect::PIXEL_FORMAT_YUY2, COLOR_WIDTH, COLOR_HEIGHT );
+		kinect::FrameView frame;
+		source.acquireLatestFrame( frame );
+
+		// Pitch wider than a row, as a mapped texture may have.
+		const std::size_t pitch = COLOR_WIDTH * 4 + TEXTURE_PITCH_ALIGNMENT;
+		std::vector< unsigned char > texture( pitch * COLOR_HEIGHT );
+		std::vector< unsigned char > reference( pitch * COLOR_HEIGHT );
+		kinect::convertYuy2ToRgba( frame.data, COLOR_WIDTH, COLOR_HEIGHT, reference.data(), pitch, kinect::SIMD_SCALAR );
+		kinect::convertYuy2ToRgba( frame.data, COLOR_WIDTH, COLOR_HEIGHT, texture.data(), pitch, simd );
+		if( texture != reference ) {
+			fail( name, "differs from scalar" );
+			return;
+		}
+
+		double seconds;
+		const uint64_t frames = measure( [&]() {
+			kinect::convertYuy2ToRgba( frame.data, COLOR_WIDTH, COLOR_HEIGHT, texture.data(), pitch, simd );
+		}, seconds );
+		report( name, frames, seconds, COLOR_WIDTH * COLOR_HEIGHT, COLOR_WIDTH * COLOR_HEIGHT * 4 );
+	}
+
+	//! Bandwidth of one frame copy into a texture. A packed texture has no padding after each row.
+	//! Mode -1 is the per-row std::copy the apps used before.
+	void benchCopy( const char* name, unsigned int pixelSize, unsigned int width, unsigned int height, bool packed, int mode )
+	{
+		if( !selected( name ) ) return;
+
+		const std::size_t rowSize = width * pixelSize;
+		const std::size_t pitch = packed ? rowSize : texturePitch( rowSize ) + TEXTURE_PITCH_ALIGNMENT;
+		std::vector< unsigned char > source( rowSize * height );
+		for( std::size_t i = 0; i < source.size(); ++i ) source[ i ] = static_cast< unsigned char >( i * 7 + ( i >> 9 ) );
+
+		kinect::FrameView frame;
+		frame.data = source.data();
+		frame.width = width;
+		frame.height = height;
+		frame.bytesPerPixel = pixelSize;
+		frame.format = pixelSize == 1 ? kinect::PIXEL_FORMAT_BODY_INDEX8 :
+			( pixelSize == 2 ? kinect::PIXEL_FORMAT_DEPTH16 : kinect::PIXEL_FORMAT_RGBA8 );
+		frame.relativeTime = 0;
+
+		std::vector< unsigned char > texture( pitch * height );
+		auto copy = [&]() {
+			if( mode < 0 ) {
+				for( unsigned int y = 0; y < height; ++y )
+				{
+					const auto* srcStart = source.data() + y * rowSize;
+					std::copy( srcStart, srcStart + rowSize, texture.data() + pitch * y );
+				}
+			}
+			else {
+				kinect::copyFrame( frame, texture.data(), pitch, static_cast< kinect::CopyMode >( mode ) );
+			}
+		};
+
+		copy();
+		for( unsigned int y = 0; y < height; ++y )
+		{
+			if( memcmp( texture.data() + pitch * y, source.data() + rowSize * y, rowSize ) != 0 ) {
+				fail( name, "copy mismatch" );
+				return;
+			}
+		}
+
+		double seconds;
+		const uint64_t frames = measure( copy, seconds );
+		report( name, frames, seconds, width * height, rowSize * height );
+	}
+
+	//! Acquisition thread feeding a consumer through the triple buffer, as in the apps.
+	//! Every frame the consumer takes must be newer than the last one and intact.
+	void benchHandoff( const char* name, kinect::PixelFormat format, unsigned int width, unsigned int height )
+	{
+		if( !selected( name ) ) return;
+
+		kinect::SyntheticFrameSource source( format, width, height );
+		const auto patterns = source.patterns_;
+		kinect::AcquisitionThread< kinect::FrameBuffer > acquisition;
+		acquisition.scheduler().setMode( kinect::FrameScheduler::SCHEDULE_FREE );
+		acquisition.start( [&]( kinect::FrameBuffer& buffer ) {
+			return kinect::copyLatestFrame( source, buffer );
+		} );
+
+		uint64_t consumed = 0;
+		int64_t lastTime = -1;
+		const char* error = nullptr;
+		const auto start = Clock::now();
+		double seconds;
+		do {
+			const kinect::FrameBuffer* frame = acquisition.latest();
+			if( !frame || error ) continue;
+
+			const int64_t index = frame->view_.relativeTime / kinect::FRAME_INTERVAL_TICKS;
+			if( frame->view_.relativeTime <= lastTime ) {
+				error = "frame out of order";
+			}
+			else if( frame->pixels_ != patterns[ index % kinect::SyntheticFrameSource::PATTERN_COUNT ] ) {
+				error = "torn frame";
+			}
+			lastTime = frame->view_.relativeTime;
+			++consumed;
+		} while( ( seconds = elapsedSeconds( start ) ) < g_seconds );
+		acquisition.stop();
+
+		if( error ) {
+			fail( name, error );
+			return;
+		}
+		const uint64_t produced = acquisition.producedCount();
+
+		// A producer that throws must still wake a consumer sleeping until notified,
+		// which then gets the error from latest().
+		std::atomic< bool > notified( false );
+		acquisition.start( []( kinect::FrameBuffer& ) -> bool {
+			throw std::runtime_error( "sensor lost" );
+		}, [&]() { notified = true; } );
+		const auto failStart = Clock::now();
+		while( !notified && elapsedSeconds( failStart ) < 1.0 ) {
+			std::this_thread::yield();
+		}
+		acquisition.stop();
+		bool rethrown = false;
+		try {
+			acquisition.latest();
+		}
+		catch( const std::runtime_error& ) {
+			rethrown = true;
+		}
+		if( !notified || !rethrown ) {
+			fail( name, notified ? "producer error not rethrown" : "producer error not notified" );
+			return;
+		}
+		printf( "%-24s %10.1f fps produced %10.1f fps consumed %5.1f %% dropped\n", name,
+			produced / seconds, consumed / seconds, produced ? 100.0 * ( produced - consumed ) / produced : 0.0 );
+	}
+
+	//! Color frame from the stand-in to the texture, in the two ways the work can be split
+	//! between the acquisition thread and Step() : RGBA converted on acquisition then copied
+	//! to the texture, or YUY2 copied on acquisition then converted into the texture, as the
+	//! color app does. Both give the same texels. Time is of one thread doing both sides.
+	void benchColorUpload( const char* name, bool convertOnAcquire )
+	{
+		if( !selected( name ) ) return;
+
+		kinect::SyntheticFrameSource source( kinect::PIXEL_FORMAT_YUY2, COLOR_WIDTH, COLOR_HEIGHT );
+		const std::size_t pitch = texturePitch( COLOR_WIDTH * 4 );
+		std::vector< unsigned char > texture( pitch * COLOR_HEIGHT ), expected( texture.size() );
+		kinect::FrameBuffer buffer;
+
+		double acquireSeconds = 0, stepSeconds = 0;
+		const auto upload = [&]() {
+			auto start = Clock::now();
+			const bool acquired = convertOnAcquire ?
+				kinect::convertLatestFrame( source, buffer ) : kinect::copyLatestFrame( source, buffer );
+			acquireSeconds += elapsedSeconds( start );
+			if( !acquired ) return false;
+
+			start = Clock::now();
+			if( convertOnAcquire ) {
+				kinect::copyFrame( buffer.view_, texture.data(), pitch );
+			}
+			else {
+				kinect::convertYuy2ToRgba( buffer.view_.data, buffer.view_.width, buffer.view_.height, texture.data(), pitch );
+			}
+			stepSeconds += elapsedSeconds( start );
+			return true;
+		};
+
+		if( !upload() ) {
+			fail( name, "no color frames" );
+			return;
+		}
+		const int64_t pattern = buffer.view_.relativeTime / kinect::FRAME_INTERVAL_TICKS % kinect::SyntheticFrameSource::PATTERN_COUNT;
+		kinect::convertYuy2ToRgba( source.patterns_[ pattern ].data(), COLOR_WIDTH, COLOR_HEIGHT, expected.data(), pitch, kinect::SIMD_SCALAR );
+		if( texture != expected ) {
+			fail( name, "texture differs from the frame" );
+			return;
+		}
+
+		acquireSeconds = stepSeconds = 0;
+		double seconds;
+		const uint64_t count = measure( [&]() { upload(); }, seconds );
+		record( name, count, seconds, COLOR_WIDTH * COLOR_HEIGHT, COLOR_WIDTH * COLOR_HEIGHT * 2 );
+		printf( "%-24s %10.1f fps  acquisition %6.3f ms  step %6.3f ms  handoff %4.1f MB\n", name, count / seconds,
+			acquireSeconds / count * 1e3, stepSeconds / count * 1e3, buffer.pixels_.size() / 1e6 );
+	}
+
+	//! Acquisition from a stand-in sensor delivering 30 [fps] in real time.
+	//! Wakes per frame show the CPU cost of the schedule, the age of each frame when it was
+	//! published (since it arrived) shows its latency cost.
+	void benchPacing( const char* name, kinect::FrameScheduler::Mode mode )
+	{
+		if( !selected( name ) ) return;
+
+		kinect::SyntheticFrameSource source( kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT, true );
+		kinect::LatencyHistogram age;
+		kinect::AcquisitionThread< kinect::FrameBuffer > acquisition;
+		acquisition.scheduler().setMode( mode );
+		acquisition.start( [&]( kinect::FrameBuffer& buffer ) {
+			if( !kinect::copyLatestFrame( source, buffer ) ) return false;
+			const auto arrival = source.clock_.arrivalTime( buffer.view_.relativeTime );
+			age.add( std::chrono::duration< double, std::micro >( kinect::SyntheticClock::Clock::now() - arrival ).count() );
+			return true;
+		} );
+
+		// At least a few dozen frames are needed.
+		const auto start = Clock::now();
+		double seconds;
+		do {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		} while( ( seconds = elapsedSeconds( start ) ) < std::max( g_seconds, 2.0 ) );
+		acquisition.stop();
+
+		const auto& scheduler = acquisition.scheduler();
+		const uint64_t frames = acquisition.producedCount();
+		printf( "%-24s %6.1f fps %7.2f wakes/frame  age p50 %6.0f p99 %6.0f us  wake to process p99 %5.0f us\n", name,
+			frames / seconds, frames ? static_cast< double >( scheduler.wakeCount() ) / frames : 0.0,
+			age.percentile( 0.5 ), age.percentile( 0.99 ), scheduler.latency().percentile( 0.99 ) );
+	}
+
+	//! Stand-ins of all four streams feeding one pipeline.
+	struct PipelineStandIns
+	{
+		PipelineStandIns( bool realTime, int64_t colorIntervalTicks )
+			: depth_( kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT, realTime ),
+			color_( kinect::PIXEL_FORMAT_YUY2, COLOR_WIDTH, COLOR_HEIGHT, realTime ),
+			bodyIndex_( kinect::PIXEL_FORMAT_BODY_INDEX8, DEPTH_WIDTH, DEPTH_HEIGHT, realTime ),
+			body_( realTime )
+		{
+			color_.clock_.intervalTicks_ = colorIntervalTicks;
+			sources_.depth_ = &depth_;
+			sources_.color_ = &color_;
+			sources_.bodyIndex_ = &bodyIndex_;
+			sources_.body_ = &body_;
+		}
+
+		kinect::SyntheticFrameSource depth_;
+		kinect::SyntheticFrameSource color_;
+		kinect::SyntheticFrameSource bodyIndex_;
+		kinect::SyntheticBodyFrameSource body_;
+		kinect::PipelineSources sources_;
+	};
+
+	//! Frames of a set must lie within the tolerance of the set's time.
+	bool checkFrameSet( const kinect::FrameSet& set, int64_t tolerance )
+	{
+		for( int type = 0; type < kinect::STREAM_IMAGE_COUNT; ++type )
+		{
+			const auto& image = set.images_[ type ];
+			if( set.has( static_cast< kinect::StreamType >( type ) ) != ( image != nullptr ) ) return false;
+			if( image && std::abs( image->view_.relativeTime - set.relativeTime_ ) > tolerance ) return false;
+		}
+		if( set.has( kinect::STREAM_BODY ) != ( set.body_ != nullptr ) ) return false;
+		if( set.body_ && std::abs( set.body_->relativeTime - set.relativeTime_ ) > tolerance ) return false;
+		return true;
+	}
+
+	//! Four streams in real time through the pipeline on an acquisition thread.
+	//! Color in low light runs at 15 [fps], so every other set lacks it.
+	void benchPipeline( const char* name, int64_t colorIntervalTicks )
+	{
+		if( !selected( name ) ) return;
+
+		PipelineStandIns standIns( true, colorIntervalTicks );
+		kinect::FramePipeline pipeline( standIns.sources_, kinect::STREAM_FLAG_ALL );
+		kinect::AcquisitionThread< kinect::FrameSet > acquisition;
+		acquisition.start( [&]( kinect::FrameSet& set ) { return pipeline.poll( set ); } );
+
+		uint64_t consumed = 0;
+		bool valid = true;
+		const auto start = Clock::now();
+		double seconds;
+		do {
+			const kinect::FrameSet* set = acquisition.latest();
+			if( set ) {
+				valid = valid && checkFrameSet( *set, kinect::FRAME_INTERVAL_TICKS / 2 );
+				++consumed;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		} while( ( seconds = elapsedSeconds( start ) ) < std::max( g_seconds, 2.0 ) );
+		acquisition.stop();
+
+		if( !valid ) {
+			fail( name, "frames of a set out of tolerance" );
+			return;
+		}
+		printf( "%-24s %6.1f sets/s consumed, complete %llu partial %llu dropped %llu\n", name, consumed / seconds,
+			static_cast< unsigned long long >( pipeline.completeCount() ),
+			static_cast< unsigned long long >( pipeline.partialCount() ),
+			static_cast< unsigned long long >( pipeline.droppedCount() ) );
+	}
+
+	//! Maximum rate of complete sets, including the color conversion.
+	void benchPipelineThroughput( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		PipelineStandIns standIns( false, kinect::FRAME_INTERVAL_TICKS );
+		kinect::FramePipeline pipeline( standIns.sources_, kinect::STREAM_FLAG_ALL );
+		kinect::FrameSet set;
+		double seconds;
+		measure( [&]() { pipeline.poll( set ); }, seconds );
+		if( pipeline.partialCount() != 0 || !checkFrameSet( set, 0 ) ) {
+			fail( name, "free running streams gave partial sets" );
+			return;
+		}
+		report( name, pipeline.completeCount(), seconds, 0,
+			DEPTH_WIDTH * DEPTH_HEIGHT * 3 + COLOR_WIDTH * COLOR_HEIGHT * 2 + sizeof( kinect::BodyFrame ) );
+	}
+
+	//! Depth to color mapping of a depth frame through the registration table.
+	//! Checks the result against the scalar kernel and the reference projection first.
+	void benchRegistration( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const auto buildStart = Clock::now();
+		const kinect::DepthRegistration registration(
+			kinect::kinectDepthIntrinsics(), DEPTH_WIDTH, DEPTH_HEIGHT,
+			kinect::kinectColorIntrinsics(), COLOR_WIDTH, COLOR_HEIGHT, kinect::kinectDepthToColor() );
+		const double buildSeconds = elapsedSeconds( buildStart );
+
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		const uint16_t* depth = frames[ 0 ].data();
+		const std::size_t count = DEPTH_WIDTH * DEPTH_HEIGHT;
+		std::vector< float > x( count ), y( count ), referenceX( count ), referenceY( count );
+		registration.mapToColor( depth, referenceX.data(), referenceY.data(), kinect::SIMD_SCALAR );
+		registration.mapToColor( depth, x.data(), y.data(), simd );
+		if( memcmp( x.data(), referenceX.data(), count * sizeof( float ) ) != 0 ||
+			memcmp( y.data(), referenceY.data(), count * sizeof( float ) ) != 0 ) {
+			fail( name, "differs from scalar" );
+			return;
+		}
+
+		double maxError = 0;
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			double rx, ry;
+			const bool valid = registration.projectReference( i % DEPTH_WIDTH, i / DEPTH_WIDTH, depth[ i ], rx, ry );
+			if( valid != std::isfinite( x[ i ] ) ) {
+				fail( name, "validity differs from reference" );
+				return;
+			}
+			if( valid ) maxError = std::max( maxError, std::max( std::abs( x[ i ] - rx ), std::abs( y[ i ] - ry ) ) );
+		}
+		if( maxError > 0.01 ) {
+			fail( name, "too far from reference projection" );
+			return;
+		}
+
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			registration.mapToColor( depth, x.data(), y.data(), simd );
+		}, seconds );
+		record( name, iterations, seconds, count, count * sizeof( uint16_t ) );
+		printf( "%-24s %10.1f fps %8.1f Mpx/s  table %.0f ms  max error %.5f px\n", name,
+			iterations / seconds, iterations * count / seconds / 1e6, buildSeconds * 1e3, maxError );
+	}
+
+	//! Registered RGB-D image : color sampled for each depth pixel.
+	void benchRegisterColor( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		const kinect::DepthRegistration registration(
+			kinect::kinectDepthIntrinsics(), DEPTH_WIDTH, DEPTH_HEIGHT,
+			kinect::kinectColorIntrinsics(), COLOR_WIDTH, COLOR_HEIGHT, kinect::kinectDepthToColor() );
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		kinect::SyntheticFrameSource source( kinect::PIXEL_FORMAT_RGBA8, COLOR_WIDTH, COLOR_HEIGHT );
+		kinect::FrameView color;
+		source.acquireLatestFrame( color );
+		std::vector< unsigned char > rgbd( DEPTH_WIDTH * DEPTH_HEIGHT * 4 );
+
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			registration.registerColor( frames[ 0 ].data(), color.data, color.rowSize(), rgbd.data(), DEPTH_WIDTH * 4 );
+		}, seconds );
+		report( name, iterations, seconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * 6 );
+	}
+
+	//! Point cloud of a depth frame on threadCount threads (0 : all hardware threads).
+	//! Checks the result against the scalar kernel on one thread first.
+	void benchPointCloud( const char* name, kinect::SimdLevel simd, unsigned int threadCount )
+	{
+		if( !selected( name ) ) return;
+		if( simd != kinect::SIMD_BEST && kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const kinect::PointCloudGenerator generator( kinect::kinectDepthIntrinsics(), DEPTH_WIDTH, DEPTH_HEIGHT );
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		const uint16_t* depth = frames[ 0 ].data();
+		kinect::ThreadPool pool( threadCount );
+		kinect::PointCloud reference, cloud;
+		generator.generate( depth, reference, kinect::SIMD_SCALAR );
+		generator.generate( depth, cloud, pool, simd );
+		const std::size_t count = reference.size();
+		if( memcmp( cloud.x_.data(), reference.x_.data(), count * sizeof( float ) ) != 0 ||
+			memcmp( cloud.y_.data(), reference.y_.data(), count * sizeof( float ) ) != 0 ||
+			memcmp( cloud.z_.data(), reference.z_.data(), count * sizeof( float ) ) != 0 ||
+			cloud.valid_ != reference.valid_ ) {
+			fail( name, "differs from scalar" );
+			return;
+		}
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			if( ( cloud.valid_[ i ] != 0 ) != ( depth[ i ] != 0 ) || std::abs( cloud.z_[ i ] - depth[ i ] * 0.001 ) > 1e-6 ) {
+				fail( name, "wrong point" );
+				return;
+			}
+		}
+
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			generator.generate( depth, cloud, pool, simd );
+		}, seconds );
+		// Threads beyond the hardware ones share cores.
+		const unsigned int cores = std::min( pool.threadCount(), std::max( std::thread::hardware_concurrency(), 1u ) );
+		const double pointsPerSecond = iterations * count / seconds;
+		record( name, iterations, seconds, count, count * sizeof( uint16_t ) );
+		printf( "%-24s %10.1f fps %8.1f Mpt/s  %u threads  %.1f Mpt/s per core  %.0f sensors at 30 fps\n", name,
+			iterations / seconds, pointsPerSecond / 1e6, pool.threadCount(), pointsPerSecond / cores / 1e6,
+			iterations / seconds / 30 );
+	}
+
+	//! Noisy copies of a static depth frame : noise growing with the square of the depth,
+	//! as the sensor's, and 10% of the pixels lost in each frame.
+	std::vector< std::vector< uint16_t > > makeNoisyDepthFrames( const std::vector< uint16_t >& truth, std::size_t frameCount )
+	{
+		uint32_t state = 2463534242u;
+		auto next = [&]() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		};
+
+		std::vector< std::vector< uint16_t > > frames( frameCount, truth );
+		for( auto& frame : frames )
+		{
+			for( auto& d : frame )
+			{
+				if( d == 0 ) continue;
+				if( next() % 10 == 0 ) {
+					d = 0;
+					continue;
+				}
+				// Sum of 4 uniforms in [-1, 1), sigma about 1.15.
+				double noise = 0;
+				for( int k = 0; k < 4; ++k ) noise += ( next() & 0xffff ) / 32768.0 - 1.0;
+				const double sigma = 2.0 + 1.5 * ( d / 1000.0 ) * ( d / 1000.0 );
+				d = static_cast< uint16_t >( std::max( 1.0, d + noise * sigma ) );
+			}
+		}
+		return frames;
+	}
+
+	//! Error variance [mm^2] and hole ratio of frame against truth, over pixels where truth is valid.
+	void depthError( const uint16_t* frame, const std::vector< uint16_t >& truth, double& variance, double& holes )
+	{
+		double sum = 0;
+		std::size_t valid = 0, total = 0;
+		for( std::size_t i = 0; i < truth.size(); ++i )
+		{
+			if( truth[ i ] == 0 ) continue;
+			++total;
+			if( frame[ i ] == 0 ) continue;
+			const double e = static_cast< double >( frame[ i ] ) - truth[ i ];
+			sum += e * e;
+			++valid;
+		}
+		variance = valid ? sum / valid : 0;
+		holes = total ? 1.0 - static_cast< double >( valid ) / total : 0;
+	}
+
+	//! Temporal median over noisy frames. Checks the result against the scalar kernel and
+	//! that the noise and the holes shrink.
+	void benchTemporalFilter( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		const auto& truth = frames[ 0 ];
+		const auto noisy = makeNoisyDepthFrames( truth, 32 );
+
+		kinect::TemporalDepthFilter filter( DEPTH_WIDTH, DEPTH_HEIGHT );
+		kinect::TemporalDepthFilter reference( DEPTH_WIDTH, DEPTH_HEIGHT );
+		std::vector< uint16_t > out( truth.size() ), referenceOut( truth.size() );
+		double rawVariance = 0, rawHoles = 0, variance = 0, holes = 0;
+		std::size_t measured = 0;
+		for( std::size_t f = 0; f < noisy.size(); ++f )
+		{
+			filter.apply( noisy[ f ].data(), out.data(), simd );
+			reference.apply( noisy[ f ].data(), referenceOut.data(), kinect::SIMD_SCALAR );
+			if( out != referenceOut ) {
+				fail( name, "differs from scalar" );
+				return;
+			}
+			if( f < filter.historySize() ) continue;
+
+			double v, h;
+			depthError( noisy[ f ].data(), truth, v, h );
+			rawVariance += v;
+			rawHoles += h;
+			depthError( out.data(), truth, v, h );
+			variance += v;
+			holes += h;
+			++measured;
+		}
+		rawVariance /= measured;
+		rawHoles /= measured;
+		variance /= measured;
+		holes /= measured;
+		if( variance * 2 > rawVariance || holes > rawHoles ) {
+			fail( name, "noise not reduced" );
+			return;
+		}
+
+		std::size_t f = 0;
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			filter.apply( noisy[ f++ % noisy.size() ].data(), out.data(), simd );
+		}, seconds );
+		record( name, iterations, seconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * sizeof( uint16_t ) );
+		printf( "%-24s %10.1f fps %8.3f ms  variance %.1f -> %.1f mm^2  holes %.1f%% -> %.2f%%\n", name,
+			iterations / seconds, seconds / iterations * 1e3, rawVariance, variance, rawHoles * 100, holes * 100 );
+	}
+
+	//! Bilateral filter of a noisy frame on threadCount threads (0 : all hardware threads).
+	//! Checks that the result is the same on 1 to 4 threads and that the noise shrinks.
+	void benchBilateralFilter( const char* name, unsigned int threadCount )
+	{
+		if( !selected( name ) ) return;
+
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		const auto& truth = frames[ 0 ];
+		const auto noisy = makeNoisyDepthFrames( truth, 1 );
+		const kinect::BilateralDepthFilter filter( DEPTH_WIDTH, DEPTH_HEIGHT );
+
+		std::vector< uint16_t > reference( truth.size() ), out( truth.size() );
+		filter.apply( noisy[ 0 ].data(), reference.data() );
+		for( unsigned int n = 1; n <= 4; ++n )
+		{
+			kinect::ThreadPool pool( n );
+			filter.apply( noisy[ 0 ].data(), out.data(), pool );
+			if( out != reference ) {
+				fail( name, "result depends on the thread count" );
+				return;
+			}
+		}
+
+		double rawVariance, rawHoles, variance, holes;
+		depthError( noisy[ 0 ].data(), truth, rawVariance, rawHoles );
+		depthError( reference.data(), truth, variance, holes );
+		if( variance * 2 > rawVariance ) {
+			fail( name, "noise not reduced" );
+			return;
+		}
+
+		kinect::ThreadPool pool( threadCount );
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			filter.apply( noisy[ 0 ].data(), out.data(), pool );
+		}, seconds );
+		record( name, iterations, seconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * sizeof( uint16_t ) );
+		printf( "%-24s %10.1f fps %8.3f ms  %u threads  variance %.1f -> %.1f mm^2\n", name,
+			iterations / seconds, seconds / iterations * 1e3, pool.threadCount(), rawVariance, variance );
+	}
+
+	//! RGBA image of a depth frame through the colormap table.
+	//! Checks the gray table against the shader for every depth value first.
+	void benchColorize( const char* name, kinect::Colormap colormap, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const kinect::DepthColorizer gray;
+		for( unsigned int d = 0; d < 65536; ++d )
+		{
+			const uint32_t color = gray.color( static_cast< uint16_t >( d ) );
+			const unsigned char* rgba = reinterpret_cast< const unsigned char* >( &color );
+			const uint8_t level = kinect::shaderGrayLevel( static_cast< uint16_t >( d ) );
+			if( rgba[ 0 ] != level || rgba[ 1 ] != level || rgba[ 2 ] != level || rgba[ 3 ] != 255 ) {
+				fail( name, "gray differs from def.ps.hlsl" );
+				return;
+			}
+		}
+
+		const auto frames = loadDepthFrames( 1 );
+		if( frames.empty() ) {
+			fail( name, "no depth frames" );
+			return;
+		}
+		const kinect::DepthColorizer colorizer( colormap );
+		const std::size_t pitch = texturePitch( DEPTH_WIDTH * 4 );
+		std::vector< unsigned char > image( pitch * DEPTH_HEIGHT ), reference( pitch * DEPTH_HEIGHT );
+		colorizer.colorize( frames[ 0 ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, reference.data(), pitch, kinect::SIMD_SCALAR );
+		colorizer.colorize( frames[ 0 ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, image.data(), pitch, simd );
+		if( image != reference ) {
+			fail( name, "differs from scalar" );
+			return;
+		}
+
+		double seconds;
+		const uint64_t iterations = measure( [&]() {
+			colorizer.colorize( frames[ 0 ].data(), DEPTH_WIDTH, DEPTH_HEIGHT, image.data(), pitch, simd );
+		}, seconds );
+		report( name, iterations, seconds, DEPTH_WIDTH * DEPTH_HEIGHT, DEPTH_WIDTH * DEPTH_HEIGHT * 6 );
+	}
+
+	void benchBodyStep( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		kinect::SyntheticBodyFrameSource source;
+		kinect::BodyFrame frame;
+		float sink = 0;
+
+		uint64_t frames = 0;
+		const auto start = Clock::now();
+		double seconds;
+		do {
+			if( source.acquireLatestFrame( frame ) )
+			{
+				sink += frame.bodies[ 0 ].joints[ 0 ].orientation[ 1 ];
+				++frames;
+			}
+		} while( ( seconds = elapsedSeconds( start ) ) < g_seconds );
+
+		report( name, frames, seconds, 0, sizeof frame );
+		if( sink == 12345.0f ) printf( "\n" );
+	}
+
+	//! Body frames of the stand-in sensor with all 6 bodies : bodies 1-5 are copies of body 0
+	//! moved aside, each lost for a second every 3 seconds.
+	std::vector< kinect::BodyFrame > makeBodyFrames( std::size_t count )
+	{
+		kinect::SyntheticBodyFrameSource source;
+		std::vector< kinect::BodyFrame > frames( count );
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			kinect::BodyFrame& frame = frames[ i ];
+			source.acquireLatestFrame( frame );
+			for( int b = 1; b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				kinect::BodyData& body = frame.bodies[ b ];
+				if( ( i / 30 + b ) % 3 == 0 ) continue;
+
+				body = frame.bodies[ 0 ];
+				body.trackingId += b;
+				for( auto& joint : body.joints )
+				{
+					joint.position[ 0 ] += 0.7f * ( b - 3 );
+					joint.position[ 2 ] += 0.4f * ( b % 2 );
+				}
+			}
+		}
+		return frames;
+	}
+
+	//! Speed of filling the skeleton history, and of a scan over it : the path length of every
+	//! joint over the whole history. Checks first that frames come back as they were pushed.
+	void benchSkeletonHistory( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		const auto frames = makeBodyFrames( 450 );
+		kinect::SkeletonHistory history;
+		for( const auto& frame : frames )
+		{
+			history.push( frame );
+		}
+		for( unsigned int age = 0; age < history.size(); ++age )
+		{
+			const kinect::BodyFrame& expected = frames[ frames.size() - 1 - age ];
+			kinect::BodyFrame frame;
+			history.frame( age, frame );
+			for( int b = 0; b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				const kinect::BodyData& x = frame.bodies[ b ];
+				const kinect::BodyData& y = expected.bodies[ b ];
+				if( x.isTracked != y.isTracked || x.trackingId != y.trackingId ||
+					( y.isTracked && memcmp( x.joints, y.joints, sizeof x.joints ) != 0 ) ) {
+					fail( name, "frame differs from the one pushed" );
+					return;
+				}
+			}
+		}
+
+		std::size_t index = 0;
+		double pushSeconds;
+		const uint64_t pushCount = measure( [&]() {
+			history.push( frames[ index ] );
+			index = ( index + 1 ) % frames.size();
+		}, pushSeconds );
+
+		// Joints of all bodies at once, row after row.
+		std::vector< float > length( kinect::SkeletonHistory::JOINT_STRIDE );
+		double scanSeconds;
+		const uint64_t scanCount = measure( [&]() {
+			std::fill( length.begin(), length.end(), 0.0f );
+			for( unsigned int age = 1; age < history.size(); ++age )
+			{
+				const float* x0 = history.component( kinect::JOINT_POSITION_X, age );
+				const float* y0 = history.component( kinect::JOINT_POSITION_Y, age );
+				const float* z0 = history.component( kinect::JOINT_POSITION_Z, age );
+				const float* x1 = history.component( kinect::JOINT_POSITION_X, age - 1 );
+				const float* y1 = history.component( kinect::JOINT_POSITION_Y, age - 1 );
+				const float* z1 = history.component( kinect::JOINT_POSITION_Z, age - 1 );
+				for( int i = 0; i < kinect::SkeletonHistory::JOINT_STRIDE; ++i )
+				{
+					const float dx = x1[ i ] - x0[ i ];
+					const float dy = y1[ i ] - y0[ i ];
+					const float dz = z1[ i ] - z0[ i ];
+					length[ i ] += std::sqrt( dx * dx + dy * dy + dz * dz );
+				}
+			}
+		}, scanSeconds );
+
+		printf( "%-24s push %8.2f Mframes/s  scan %8.1f Mjoint-frames/s over %u frames\n", name,
+			pushCount / pushSeconds / 1e6,
+			scanCount * ( history.size() - 1.0 ) * kinect::SkeletonHistory::JOINT_SLOTS / scanSeconds / 1e6, history.size() );
+		if( length[ 0 ] == 12345.0f ) printf( "\n" );
+	}
+
+	//! Jitter, lag and speed of the One Euro skeleton filter on the stand-in bodies with noise
+	//! added, after checking that the SIMD level gives the same positions as scalar code and
+	//! that bodies coming into view keep their raw positions on their first frame.
+	//! Jitter is the RMS of the second difference of the positions less that of the truth,
+	//! lag the shift along the velocity that fits the filtered positions to the truth best.
+	void benchSkeletonFilter( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		const auto truth = makeBodyFrames( 900 );
+		auto noisy = truth;
+		uint32_t random = 2463534242u;
+		for( auto& frame : noisy )
+		{
+			for( auto& body : frame.bodies )
+			{
+				for( auto& joint : body.joints )
+				{
+					for( float& p : joint.position )
+					{
+						// Sum of 4 uniforms, 8 [mm] sigma.
+						float noise = 0;
+						for( int k = 0; k < 4; ++k )
+						{
+							random ^= random << 13;
+							random ^= random >> 17;
+							random ^= random << 5;
+							noise += ( random >> 8 ) * ( 1.0f / 16777216.0f ) - 0.5f;
+						}
+						p += noise * 0.008f * 1.7320508f;
+					}
+				}
+			}
+		}
+
+		kinect::OneEuroSkeletonFilter filter, reference;
+		std::vector< kinect::BodyFrame > filtered = noisy;
+		for( std::size_t i = 0; i < filtered.size(); ++i )
+		{
+			kinect::BodyFrame expected = noisy[ i ];
+			reference.update( expected, kinect::SIMD_SCALAR );
+			filter.update( filtered[ i ], simd );
+			for( int b = 0; b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				if( memcmp( filtered[ i ].bodies[ b ].joints, expected.bodies[ b ].joints, sizeof expected.bodies[ b ].joints ) != 0 ) {
+					fail( name, "positions differ from scalar" );
+					return;
+				}
+				const kinect::BodyData& body = noisy[ i ].bodies[ b ];
+				const bool isNew = body.isTracked && ( i == 0 || !noisy[ i - 1 ].bodies[ b ].isTracked ||
+					noisy[ i - 1 ].bodies[ b ].trackingId != body.trackingId );
+				if( isNew && memcmp( filtered[ i ].bodies[ b ].joints, body.joints, sizeof body.joints ) != 0 ) {
+					fail( name, "new body does not start from its raw positions" );
+					return;
+				}
+			}
+		}
+
+		// Body 0 is always tracked.
+		double rawJitter = 0, jitter = 0, lagNumerator = 0, lagDenominator = 0;
+		uint64_t samples = 0;
+		for( std::size_t i = 30; i < truth.size(); ++i )
+		{
+			for( int j = 0; j < kinect::MAX_JOINT_COUNT; ++j )
+			{
+				for( int a = 0; a < 3; ++a )
+				{
+					const auto at = [&]( const std::vector< kinect::BodyFrame >& frames, std::size_t k ) {
+						return static_cast< double >( frames[ k ].bodies[ 0 ].joints[ j ].position[ a ] );
+					};
+					const double truthAcceleration = at( truth, i ) - 2 * at( truth, i - 1 ) + at( truth, i - 2 );
+					const double rawError = at( noisy, i ) - 2 * at( noisy, i - 1 ) + at( noisy, i - 2 ) - truthAcceleration;
+					const double error = at( filtered, i ) - 2 * at( filtered, i - 1 ) + at( filtered, i - 2 ) - truthAcceleration;
+					rawJitter += rawError * rawError;
+					jitter += error * error;
+
+					const double velocity = at( truth, i ) - at( truth, i - 1 );
+					lagNumerator += ( at( truth, i ) - at( filtered, i ) ) * velocity;
+					lagDenominator += velocity * velocity;
+					++samples;
+				}
+			}
+		}
+
+		kinect::SkeletonHistory history;
+		history.push( noisy.back() );
+		std::vector< float > x( kinect::SkeletonHistory::JOINT_STRIDE ), y( x ), z( x );
+		double seconds;
+		const uint64_t count = measure( [&]() {
+			filter.update( history, x.data(), y.data(), z.data(), simd );
+		}, seconds );
+
+		printf( "%-24s jitter %5.1f -> %4.1f mm  lag %5.1f ms  %8.1f Mjoints/s\n", name,
+			std::sqrt( rawJitter / samples ) * 1000, std::sqrt( jitter / samples ) * 1000,
+			lagNumerator / lagDenominator * 1000.0 / 30.0, count * kinect::SkeletonHistory::JOINT_SLOTS / seconds / 1e6 );
+	}
+
+	//! Speed of building the bone matrices of a frame. Checks first that all SIMD levels give the
+	//! scalar matrices, that a pose given as orientations comes back as the bone directions with
+	//! the apex of each bone on its joint, and that a joint with no orientation takes its parent's.
+	void benchBoneMatrices( const char* name, kinect::SimdLevel simd )
+	{
+		if( !selected( name ) ) return;
+		if( kinect::resolveSimdLevel( simd ) != simd ) return;
+
+		// Orientation of each joint of body 0 turns Y onto the direction from its parent, not normalized.
+		kinect::BodyFrame frame = makeBodyFrames( 31 ).back();
+		kinect::BodyData& body = frame.bodies[ 0 ];
+		float direction[ kinect::MAX_JOINT_COUNT ][ 3 ] = {};
+		for( int j = 0; j < kinect::MAX_JOINT_COUNT; ++j )
+		{
+			float* q = body.joints[ j ].orientation;
+			q[ 0 ] = q[ 1 ] = q[ 2 ] = 0;
+			q[ 3 ] = 1;
+			if( j == kinect::human::JOINT_ORDER[ 0 ] ) continue;
+
+			const float* p = body.joints[ j ].position;
+			const float* parent = body.joints[ kinect::human::JOINT_PARENT[ j ] ].position;
+			const float d[ 3 ] = { p[ 0 ] - parent[ 0 ], p[ 1 ] - parent[ 1 ], p[ 2 ] - parent[ 2 ] };
+			const float length = std::sqrt( d[ 0 ] * d[ 0 ] + d[ 1 ] * d[ 1 ] + d[ 2 ] * d[ 2 ] );
+			for( int a = 0; a < 3; ++a )
+			{
+				direction[ j ][ a ] = d[ a ] / length;
+			}
+			if( direction[ j ][ 1 ] < -0.999f )
+			{
+				// Half turn about Z for the legs hanging straight down.
+				direction[ j ][ 0 ] = direction[ j ][ 2 ] = 0;
+				direction[ j ][ 1 ] = -1;
+				q[ 2 ] = 1;
+				q[ 3 ] = 0;
+				continue;
+			}
+			q[ 0 ] = direction[ j ][ 2 ];
+			q[ 2 ] = -direction[ j ][ 0 ];
+			q[ 3 ] = 1 + direction[ j ][ 1 ];
+		}
+		const int orphan = kinect::JOINT_HAND_TIP_LEFT;
+		std::fill( body.joints[ orphan ].orientation, body.joints[ orphan ].orientation + 4, 0.0f );
+
+		kinect::SkeletonHistory history;
+		history.push( frame );
+		kinect::BoneMatrixBuilder builder, reference;
+		std::vector< kinect::BoneInstance > bones( kinect::BoneMatrixBuilder::MAX_BONES ), expected( bones );
+		const std::size_t count = builder.build( history, bones.data(), simd );
+		if( count != reference.build( history, expected.data(), kinect::SIMD_SCALAR ) ||
+			memcmp( bones.data(), expected.data(), count * sizeof( kinect::BoneInstance ) ) != 0 ) {
+			fail( name, "matrices differ from scalar" );
+			return;
+		}
+
+		int boneOf[ kinect::MAX_JOINT_COUNT ] = {};
+		for( int bone = 0; bone < kinect::BoneMatrixBuilder::BONES_PER_BODY; ++bone )
+		{
+			boneOf[ kinect::BoneMatrixBuilder::boneJoint( bone ) ] = bone;
+		}
+		for( int bone = 0; bone < kinect::BoneMatrixBuilder::BONES_PER_BODY; ++bone )
+		{
+			const int j = kinect::BoneMatrixBuilder::boneJoint( bone );
+			const int parent = kinect::human::JOINT_PARENT[ j ];
+			const float length = kinect::human::boneLength( j ) * 0.01f;
+			const float ( *m )[ 4 ] = bones[ bone ].m;
+			for( int a = 0; a < 3; ++a )
+			{
+				const float fk = builder.positions( a )[ j ] - builder.positions( a )[ parent ];
+				if( j != orphan && std::fabs( fk - length * direction[ j ][ a ] ) > 1e-5f ) {
+					fail( name, "bone direction differs from the pose" );
+					return;
+				}
+				if( m[ 1 ][ a ] + m[ 3 ][ a ] != builder.positions( a )[ j ] ) {
+					fail( name, "bone apex is not on its joint" );
+					return;
+				}
+				const float ( *p )[ 4 ] = bones[ boneOf[ parent ] ].m;
+				if( j == orphan && ( m[ 0 ][ a ] != p[ 0 ][ a ] || m[ 2 ][ a ] != p[ 2 ][ a ] ) ) {
+					fail( name, "joint with no orientation does not take its parent's" );
+					return;
+				}
+			}
+		}
+
+		double seconds;
+		const uint64_t builds = measure( [&]() {
+			builder.build( history, bones.data(), simd );
+		}, seconds );
+
+		printf( "%-24s %3u bones  %8.1f Mbones/s\n", name, static_cast< unsigned int >( count ), builds * count / seconds / 1e6 );
+	}
+
+
+	//! Body 0 of the stand-in doing gesture k with its right arm at phase u in [0, 1], scale
+	//! times the size of the model skeleton, SpineBase at x [m].
+	void poseGesture( kinect::BodyData& body, const kinect::BodyData& rest, unsigned int k, float u, float scale, float x )
+	{
+		uint32_t random = 2463534242u ^ ( k * 2654435761u );
+		float p[ 10 ];
+		for( float& v : p )
+		{
+			random ^= random << 13;
+			random ^= random >> 17;
+			random ^= random << 5;
+			v = ( random >> 8 ) * ( 1.0f / 16777216.0f );
+		}
+		const float w = 6.2831853f * ( 1 + k % 2 ) * u;
+		const float upper = 0.3f + 0.9f * p[ 0 ] + ( 0.2f + 0.6f * p[ 1 ] ) * std::sin( w + 6.28f * p[ 2 ] );
+		const float upperYaw = -0.5f + p[ 3 ] + ( 0.2f + 0.6f * p[ 4 ] ) * std::sin( w + 6.28f * p[ 5 ] );
+		const float lower = upper + 0.5f + 1.5f * p[ 6 ] + ( 0.2f + 0.8f * p[ 7 ] ) * std::sin( 2 * w + 6.28f * p[ 8 ] );
+		const float lowerYaw = upperYaw + 0.5f * p[ 9 ];
+		const float arm[ 3 ] = { std::sin( upper ) * std::cos( upperYaw ), -std::cos( upper ), -std::sin( upper ) * std::sin( upperYaw ) };
+		const float hand[ 3 ] = { std::sin( lower ) * std::cos( lowerYaw ), -std::cos( lower ), -std::sin( lower ) * std::sin( lowerYaw ) };
+
+		const float* root = rest.joints[ kinect::JOINT_SPINE_BASE ].position;
+		body = rest;
+		for( auto& joint : body.joints )
+		{
+			joint.position[ 0 ] = x + ( joint.position[ 0 ] - root[ 0 ] ) * scale;
+			joint.position[ 1 ] = 1.0f + ( joint.position[ 1 ] - root[ 1 ] ) * scale;
+			joint.position[ 2 ] = 2.5f + ( joint.position[ 2 ] - root[ 2 ] ) * scale;
+		}
+		const auto place = [&]( int joint, int from, const float* direction ) {
+			for( int a = 0; a < 3; ++a )
+			{
+				body.joints[ joint ].position[ a ] = body.joints[ from ].position[ a ] +
+					kinect::human::boneLength( joint ) * 0.01f * scale * direction[ a ];
+			}
+		};
+		place( kinect::JOINT_ELBOW_RIGHT, kinect::JOINT_SHOULDER_RIGHT, arm );
+		place( kinect::JOINT_WRIST_RIGHT, kinect::JOINT_ELBOW_RIGHT, hand );
+		place( kinect::JOINT_HAND_RIGHT, kinect::JOINT_WRIST_RIGHT, hand );
+		place( kinect::JOINT_HAND_TIP_RIGHT, kinect::JOINT_HAND_RIGHT, hand );
+		place( kinect::JOINT_THUMB_RIGHT, kinect::JOINT_WRIST_RIGHT, hand );
+	}
+
+	//! Speed of matching 6 bodies against 200 gesture templates per frame. The templates are
+	//! recorded at the model size; each body is another size, does its gesture a little
+	//! unevenly in time with 4 [mm] of noise, and must be recognized. The pool, the serial
+	//! loop and matching with no pruning must agree.
+	void benchGestureMatcher( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		const unsigned int templateCount = 200;
+		const kinect::BodyData rest = makeBodyFrames( 1 ).front().bodies[ 0 ];
+		kinect::GestureMatcher matcher;
+		kinect::SkeletonHistory history;
+		kinect::BodyFrame frame;
+		memset( &frame, 0, sizeof frame );
+		frame.bodies[ 0 ].isTracked = true;
+		frame.bodies[ 0 ].trackingId = 1;
+		for( unsigned int k = 0; k < templateCount; ++k )
+		{
+			const unsigned int frames = 40 + k % 21;
+			history.clear();
+			for( unsigned int i = 0; i < frames; ++i )
+			{
+				poseGesture( frame.bodies[ 0 ], rest, k, static_cast< float >( i ) / ( frames - 1 ), 1.0f, 0.0f );
+				history.push( frame );
+			}
+			matcher.addTemplate( "gesture " + std::to_string( k ), history, 0, frames, 0.08f );
+		}
+
+		// Every body ends its gesture on the last frame.
+		unsigned int expected[ kinect::MAX_BODY_COUNT ];
+		const unsigned int streamFrames = 120;
+		uint32_t random = 2463534242u;
+		history.clear();
+		for( unsigned int i = 0; i < streamFrames; ++i )
+		{
+			frame.relativeTime = i * kinect::FRAME_INTERVAL_TICKS;
+			for( int b = 0; b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				expected[ b ] = ( 37 * b + 11 ) % templateCount;
+				const unsigned int frames = matcher.templateFrames( expected[ b ] );
+				const unsigned int start = streamFrames - frames;
+				const float s = i < start ? 0.0f : static_cast< float >( i - start ) / ( frames - 1 );
+				const float u = s + 0.06f * std::sin( 6.2831853f * s );
+				poseGesture( frame.bodies[ b ], rest, expected[ b ], u, 0.85f + 0.07f * b, 0.7f * ( b - 2.5f ) );
+				frame.bodies[ b ].trackingId = 100 + b;
+				for( auto& joint : frame.bodies[ b ].joints )
+				{
+					for( float& v : joint.position )
+					{
+						random ^= random << 13;
+						random ^= random >> 17;
+						random ^= random << 5;
+						v += ( ( random >> 8 ) * ( 1.0f / 16777216.0f ) - 0.5f ) * 0.004f * 3.4641016f;
+					}
+				}
+			}
+			history.push( frame );
+		}
+
+		kinect::ThreadPool pool( 4 );
+		kinect::GestureMatcher reference( matcher ), serial( matcher );
+		reference.setPruning( false );
+		kinect::GestureMatch matches[ kinect::MAX_BODY_COUNT ], serialMatches[ kinect::MAX_BODY_COUNT ], referenceMatches[ kinect::MAX_BODY_COUNT ];
+		matcher.match( history, matches, &pool );
+		serial.match( history, serialMatches );
+		reference.match( history, referenceMatches );
+		for( int b = 0; b < kinect::MAX_BODY_COUNT; ++b )
+		{
+			if( matches[ b ].templateIndex != static_cast< int >( expected[ b ] ) ) {
+				fail( name, "gesture not recognized" );
+				return;
+			}
+			if( memcmp( &matches[ b ], &serialMatches[ b ], sizeof matches[ b ] ) != 0 ||
+				memcmp( &matches[ b ], &referenceMatches[ b ], sizeof matches[ b ] ) != 0 ) {
+				fail( name, "pool, serial and unpruned matches differ" );
+				return;
+			}
+		}
+
+		double seconds;
+		const kinect::GestureMatchStats before = matcher.stats();
+		const uint64_t count = measure( [&]() {
+			matcher.match( history, matches, &pool );
+		}, seconds );
+		const kinect::GestureMatchStats& after = matcher.stats();
+		const double pairs = static_cast< double >( after.candidates - before.candidates );
+		printf( "%-24s %u x %d  Kim %4.1f%%  Keogh %4.1f%%  abandoned %4.1f%%  %7.1f us/frame  %6.2f Mpairs/s\n", name,
+			templateCount, kinect::MAX_BODY_COUNT,
+			( after.prunedKim - before.prunedKim ) * 100.0 / pairs, ( after.prunedKeogh - before.prunedKeogh ) * 100.0 / pairs,
+			( after.abandoned - before.abandoned ) * 100.0 / pairs, seconds * 1e6 / count, pairs / seconds / 1e6 );
+	}
+
+
+	//! Size and speed of the skeleton recording format on 900 frames of 6 bodies with 2 [mm] of
+	//! jitter. Checks first that a recording written on the writer thread reads back within the
+	//! quantization steps with the tracking ids, and that seeking gives the same frames.
+	void benchSkeletonRecording( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		auto frames = makeBodyFrames( 900 );
+		uint32_t random = 2463534242u;
+		uint64_t bodyFrames = 0;
+		for( auto& frame : frames )
+		{
+			for( auto& body : frame.bodies )
+			{
+				if( !body.isTracked ) continue;
+				++bodyFrames;
+				for( auto& joint : body.joints )
+				{
+					for( float& p : joint.position )
+					{
+						random ^= random << 13;
+						random ^= random >> 17;
+						random ^= random << 5;
+						p += ( ( random >> 8 ) * ( 1.0f / 16777216.0f ) - 0.5f ) * 0.002f * 3.4641016f;
+					}
+				}
+			}
+		}
+
+		const char* path = "bench_skeleton.kv2skl";
+		uint64_t payloadSize;
+		{
+			kinect::SkeletonRecordingWriter writer( path, static_cast< unsigned int >( frames.size() ) );
+			for( const auto& frame : frames )
+			{
+				writer.write( frame );
+			}
+			writer.close();
+			payloadSize = writer.payloadSize();
+			if( writer.droppedCount() != 0 || writer.frameCount() != frames.size() ) {
+				fail( name, "frames dropped" );
+				return;
+			}
+		}
+
+		kinect::SkeletonRecordingReader reader( path );
+		const float positionTolerance = reader.header().positionStep * 0.5f + 1e-6f;
+		const float orientationTolerance = 0.5f / kinect::SKELETON_ORIENTATION_SCALE + 1e-6f;
+		std::vector< kinect::BodyFrame > decoded( frames.size() );
+		bool ok = reader.frameCount() == frames.size();
+		for( std::size_t i = 0; ok && i < frames.size(); ++i )
+		{
+			ok = reader.read( decoded[ i ] ) && decoded[ i ].relativeTime == frames[ i ].relativeTime;
+			for( int b = 0; ok && b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				const kinect::BodyData& x = decoded[ i ].bodies[ b ];
+				const kinect::BodyData& y = frames[ i ].bodies[ b ];
+				ok = x.isTracked == y.isTracked && x.trackingId == y.trackingId;
+				for( int j = 0; ok && y.isTracked && j < kinect::MAX_JOINT_COUNT; ++j )
+				{
+					ok = x.joints[ j ].trackingState == y.joints[ j ].trackingState;
+					for( int a = 0; a < 3; ++a )
+					{
+						ok = ok && std::fabs( x.joints[ j ].position[ a ] - y.joints[ j ].position[ a ] ) <= positionTolerance;
+					}
+					for( int a = 0; a < 4; ++a )
+					{
+						ok = ok && std::fabs( x.joints[ j ].orientation[ a ] - y.joints[ j ].orientation[ a ] ) <= orientationTolerance;
+					}
+				}
+			}
+		}
+		if( !ok ) {
+			fail( name, "frames differ from the ones written" );
+			return;
+		}
+		const std::size_t seeks[] = { 899, 0, 31, 30, 29, 450, 1, 600 };
+		for( const std::size_t i : seeks )
+		{
+			kinect::BodyFrame frame;
+			reader.seek( i );
+			ok = reader.read( frame ) && frame.relativeTime == decoded[ i ].relativeTime &&
+				reader.findFrame( frame.relativeTime ) == i;
+			for( int b = 0; ok && b < kinect::MAX_BODY_COUNT; ++b )
+			{
+				ok = memcmp( frame.bodies[ b ].joints, decoded[ i ].bodies[ b ].joints, sizeof frame.bodies[ b ].joints ) == 0;
+			}
+			if( !ok ) {
+				fail( name, "seek differs from reading in order" );
+				return;
+			}
+		}
+		std::remove( path );
+
+		// In memory, frame after frame with the keyframes of the recording.
+		kinect::SkeletonEncoder encoder;
+		std::vector< unsigned char > encoded( frames.size() * kinect::SKELETON_CODEC_MAX_FRAME_SIZE );
+		std::vector< std::size_t > offsets( frames.size() + 1, 0 );
+		for( std::size_t i = 0; i < frames.size(); ++i )
+		{
+			offsets[ i + 1 ] = offsets[ i ] + encoder.encode( frames[ i ], i % kinect::SKELETON_RECORDING_KEYFRAME_INTERVAL == 0, &encoded[ offsets[ i ] ] );
+		}
+
+		std::size_t next = 0;
+		double encodeSeconds;
+		const uint64_t encodeCount = measure( [&]() {
+			encoder.encode( frames[ next ], next % kinect::SKELETON_RECORDING_KEYFRAME_INTERVAL == 0, &encoded[ offsets[ next ] ] );
+			next = ( next + 1 ) % frames.size();
+		}, encodeSeconds );
+
+		kinect::SkeletonDecoder decoder;
+		kinect::BodyFrame frame;
+		next = 0;
+		double decodeSeconds;
+		const uint64_t decodeCount = measure( [&]() {
+			decoder.decode( &encoded[ offsets[ next ] ], offsets[ next + 1 ] - offsets[ next ], frame );
+			next = ( next + 1 ) % frames.size();
+		}, decodeSeconds );
+
+		const double bytesPerBody = static_cast< double >( payloadSize ) / bodyFrames;
+		const double bodiesPerFrame = static_cast< double >( bodyFrames ) / frames.size();
+		printf( "%-24s %5.1f B/body-frame (%4.1f%% of raw)  encode %6.1f  decode %6.1f Mbody-frames/s\n", name,
+			bytesPerBody, bytesPerBody * 100.0 / sizeof( kinect::BodyData::joints ),
+			encodeCount * bodiesPerFrame / encodeSeconds / 1e6, decodeCount * bodiesPerFrame / decodeSeconds / 1e6 );
+	}
+
+
+	//! Shader loading as the apps did it before AssetLoader : the path through a stringstream,
+	//! the file read a character at a time into a string.
+	std::string legacyFileGetContents( const std::string& directory, const char* path )
+	{
+		std::stringstream newPathSS;
+		newPathSS << directory << '/' << path;
+		std::ifstream ifs( newPathSS.str(), std::ios::binary );
+		std::string str(
+			(std::istreambuf_iterator< char >( ifs )),
+			std::istreambuf_iterator< char >()
+			);
+		if( str.size() == 0 ) throw std::runtime_error( "File not found" );
+		return str;
+	}
+
+	//! Startup time of loading a vertex and a pixel shader of the given sizes : the old way with
+	//! the extra copy of the vertex shader, mapped loose files, and the mapped archive. Checks
+	//! first that all give the file contents, and that a copy of a file shares its blob.
+	void benchAssets( const char* name, std::size_t vsSize, std::size_t psSize )
+	{
+		if( !selected( name ) ) return;
+
+		const char* names[] = { "bench_asset.vs.cso", "bench_asset.ps.cso", "bench_asset_copy.ps.cso" };
+		const std::size_t sizes[] = { vsSize, psSize, psSize };
+		std::vector< std::string > contents;
+		uint32_t random = 2463534242u;
+		for( int i = 0; i < 3; ++i )
+		{
+			std::string data( sizes[ i ], '\0' );
+			for( char& c : data )
+			{
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				c = static_cast< char >( random );
+			}
+			if( i == 2 ) data = contents[ 1 ];
+			FILE* fp = fopen( names[ i ], "wb" );
+			fwrite( data.data(), 1, data.size(), fp );
+			fclose( fp );
+			contents.push_back( data );
+		}
+		const char* archiveName = "bench_assets.kv2pak";
+		kinect::writeAssetArchive( archiveName, ".", std::vector< std::string >( names, names + 3 ) );
+
+		bool ok = true;
+		for( int mount = 0; mount < 2; ++mount )
+		{
+			kinect::AssetLoader loader( "." );
+			ok = ok && loader.mountArchive( mount ? archiveName : "bench_no_such.kv2pak" ) == ( mount != 0 );
+			kinect::AssetSpan spans[ 3 ];
+			for( int i = 0; i < 3; ++i )
+			{
+				spans[ i ] = loader.load( names[ i ] );
+				ok = ok && spans[ i ].size == contents[ i ].size() && memcmp( spans[ i ].data, contents[ i ].data(), spans[ i ].size ) == 0 &&
+					spans[ i ].hash == kinect::assetHash( contents[ i ].data(), contents[ i ].size() );
+			}
+			ok = ok && spans[ 2 ].data == spans[ 1 ].data && loader.mappedFileCount() == ( mount ? 0u : 2u );
+			try {
+				loader.load( "bench_no_such.cso" );
+				ok = false;
+			}
+			catch( std::runtime_error& ) {
+			}
+		}
+		if( !ok ) {
+			fail( name, "assets differ from the files" );
+			return;
+		}
+
+		std::size_t total = 0;
+		double legacySeconds, loaderSeconds, archiveSeconds;
+		const uint64_t legacyCount = measure( [&]() {
+			std::string binData;
+			std::string vsBinData;
+			binData = legacyFileGetContents( ".", names[ 0 ] );
+			vsBinData = binData;
+			binData = legacyFileGetContents( ".", names[ 1 ] );
+			total += binData.size() + vsBinData.size();
+		}, legacySeconds );
+		const uint64_t loaderCount = measure( [&]() {
+			kinect::AssetLoader loader( "." );
+			total += loader.load( names[ 0 ] ).size + loader.load( names[ 1 ] ).size;
+		}, loaderSeconds );
+		const uint64_t archiveCount = measure( [&]() {
+			kinect::AssetLoader loader( "." );
+			loader.mountArchive( archiveName );
+			total += loader.load( names[ 0 ] ).size + loader.load( names[ 1 ] ).size;
+		}, archiveSeconds );
+
+		for( const char* file : names )
+		{
+			std::remove( file );
+		}
+		std::remove( archiveName );
+		printf( "%-24s istreambuf %9.1f us  mapped %8.1f us  archive %8.1f us per startup\n", name,
+			legacySeconds * 1e6 / legacyCount, loaderSeconds * 1e6 / loaderCount, archiveSeconds * 1e6 / archiveCount );
+	}
+
+	//! Startup of an app with stand-in tasks that sleep as long as the real steps take,
+	//! after checking the order, the thread of the main thread tasks and the failure path.
+	void benchStartupGraph( const char* name )
+	{
+		if( !selected( name ) ) return;
+
+		struct StandIn
+		{
+			const char* name;
+			unsigned int ms;
+			kinect::TaskGraph::TaskThread thread;
+			int dependencies[ 3 ];
+		};
+		const StandIn standIns[] = {
+			{ "sensor", 60, kinect::TaskGraph::TASK_ANY_THREAD, { -1, -1, -1 } },
+			{ "recorder", 5, kinect::TaskGraph::TASK_ANY_THREAD, { -1, -1, -1 } },
+			{ "filters", 10, kinect::TaskGraph::TASK_ANY_THREAD, { -1, -1, -1 } },
+			{ "assets", 15, kinect::TaskGraph::TASK_ANY_THREAD, { -1, -1, -1 } },
+			{ "device", 40, kinect::TaskGraph::TASK_MAIN_THREAD, { -1, -1, -1 } },
+			{ "resources", 10, kinect::TaskGraph::TASK_ANY_THREAD, { 4, 3, -1 } },
+			{ "acquisition", 2, kinect::TaskGraph::TASK_ANY_THREAD, { 0, 1, 2 } }
+		};
+		const std::size_t count = sizeof standIns / sizeof standIns[ 0 ];
+
+		double elapsed[ 2 ];
+		double serial = 0;
+		for( int parallel = 0; parallel < 2; ++parallel )
+		{
+			kinect::TaskGraph graph;
+			std::thread::id mainThread = std::this_thread::get_id();
+			bool onMainThread = true;
+			for( const StandIn& task : standIns )
+			{
+				std::vector< kinect::TaskGraph::TaskId > dependencies;
+				for( const int dependency : task.dependencies )
+				{
+					if( dependency >= 0 ) dependencies.push_back( dependency );
+				}
+				graph.add( task.name, [&, task]() {
+					std::this_thread::sleep_for( std::chrono::milliseconds( task.ms ) );
+					if( task.thread == kinect::TaskGraph::TASK_MAIN_THREAD && std::this_thread::get_id() != mainThread ) onMainThread = false;
+				}, dependencies, task.thread );
+			}
+			graph.run( parallel ? 0 : 1 );
+
+			const std::vector< kinect::TaskGraph::TaskTiming > timeline = graph.timeline();
+			bool ok = onMainThread && timeline.size() == count;
+			for( std::size_t i = 0; ok && i < count; ++i )
+			{
+				ok = timeline[ i ].state == kinect::TaskGraph::TASK_DONE &&
+					( standIns[ i ].thread == kinect::TaskGraph::TASK_ANY_THREAD || timeline[ i ].thread == 0 );
+				for( const int dependency : standIns[ i ].dependencies )
+				{
+					ok = ok && ( dependency < 0 || timeline[ dependency ].end <= timeline[ i ].start );
+				}
+			}
+			if( !ok ) {
+				fail( name, "tasks ran out of order or on the wrong thread" );
+				return;
+			}
+			elapsed[ parallel ] = graph.elapsed();
+			serial = graph.serialTime();
+		}
+
+		// A failure skips the tasks not started yet and reaches the caller.
+		{
+			kinect::TaskGraph graph;
+			const kinect::TaskGraph::TaskId sensor = graph.add( "sensor", []() { throw std::runtime_error( "no sensor" ); } );
+			graph.add( "acquisition", []() {}, std::vector< kinect::TaskGraph::TaskId >( 1, sensor ) );
+			bool ok = false;
+			try {
+				graph.run( 2 );
+			}
+			catch( std::runtime_error& e ) {
+				ok = strcmp( e.what(), "no sensor" ) == 0;
+			}
+			const std::vector< kinect::TaskGraph::TaskTiming > timeline = graph.timeline();
+			ok = ok && timeline[ 0 ].state == kinect::TaskGraph::TASK_FAILED && timeline[ 1 ].state == kinect::TaskGraph::TASK_SKIPPED;
+			try {
+				graph.add( "late", []() {} );
+				ok = false;
+			}
+			catch( std::runtime_error& ) {
+			}
+			try {
+				kinect::TaskGraph cycle;
+				cycle.add( "self", []() {}, std::vector< kinect::TaskGraph::TaskId >( 1, 0 ) );
+				ok = false;
+			}
+			catch( std::invalid_argument& ) {
+			}
+			if( !ok ) {
+				fail( name, "failure not reported" );
+				return;
+			}
+		}
+
+		printf( "%-24s tasks %6.1f ms  one thread %6.1f ms  graph %6.1f ms to ready\n", name, serial, elapsed[ 0 ], elapsed[ 1 ] );
+	}
+
+	//! Cost of a trace scope, which fails over 50 ns or, where the clock reads alone take that,
+	//! over 10 ns more than them, after checking the stage statistics, the ring wrap and the
+	//! Chrome export.
+	void benchTrace( const char* name )
+	{
+		if( !selected( name ) ) return;
+#if !KINECT_TRACE
+		printf( "%-24s compiled out\n", name );
+		return;
+#endif
+
+		kinect::clearTrace();
+		bool ok = true;
+
+		// Stages of a known length on a few threads while the main thread reads the rings.
+		std::vector< std::thread > threads;
+		for( int t = 0; t < 3; ++t )
+		{
+			threads.push_back( std::thread( []() {
+				KINECT_TRACE_THREAD( "bench worker" );
+				for( int i = 0; i < 200; ++i )
+				{
+					KINECT_TRACE_SCOPE( "bench.spin" );
+					const auto start = Clock::now();
+					while( elapsedSeconds( start ) < 100e-6 ) {}
+				}
+			} ) );
+		}
+		for( int i = 0; i < 20; ++i )
+		{
+			kinect::traceStageStats( 1000 );
+		}
+		for( auto& thread : threads )
+		{
+			thread.join();
+		}
+		for( const kinect::TraceStageStats& stage : kinect::traceStageStats( 10000 ) )
+		{
+			if( stage.name == "bench.spin" )
+			{
+				ok = ok && stage.count == 600 && stage.p50 >= 95 && stage.p50 < 1000 && stage.p99 <= stage.max;
+			}
+		}
+
+		// A full ring keeps the newest events, all but the slot the thread may be writing.
+		for( int i = 0; i < kinect::TRACE_EVENT_CAPACITY + 100; ++i )
+		{
+			KINECT_TRACE_SCOPE( "bench.wrap" );
+		}
+		uint64_t wrapped = 0;
+		for( const kinect::TraceStageStats& stage : kinect::traceStageStats( 10000 ) )
+		{
+			if( stage.name == "bench.wrap" ) wrapped = stage.count;
+		}
+		ok = ok && wrapped == kinect::TRACE_EVENT_CAPACITY - 1;
+
+		const char* traceName = "bench_trace.json";
+		kinect::writeChromeTrace( traceName );
+		std::ifstream file( traceName );
+		const std::string json( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+		file.close();
+		std::remove( traceName );
+		std::size_t spins = 0;
+		for( std::size_t at = json.find( "\"bench.spin\"" ); at != std::string::npos; at = json.find( "\"bench.spin\"", at + 1 ) )
+		{
+			++spins;
+		}
+		ok = ok && spins == 600 && json.find( "\"bench worker\"" ) != std::string::npos &&
+			json.find( "{\"displayTimeUnit\"" ) == 0 && json.compare( json.size() - 4, 4, "\n]}\n" ) == 0;
+
+		kinect::clearTrace();
+		ok = ok && kinect::traceStageStats( 10000 ).empty();
+		if( !ok ) {
+			fail( name, "trace events lost or wrong" );
+			return;
+		}
+
+		// Best of a few rounds, as other work on the machine only adds time. A scope reads the
+		// clock twice, most of its cost : where two reads alone take about the 50 ns budget, as
+		// on VMs that trap the time stamp counter, only the recording on top of them is checked.
+		const double scopeLimitNs = 50;
+		const double recordLimitNs = 10;
+		double scopeNs = 0;
+		double clockNs = 0;
+		uint64_t sum = 0;
+		for( int round = 0; round < 5; ++round )
+		{
+			double seconds;
+			const uint64_t count = measure( [&]() {
+				for( int i = 0; i < 1000; ++i )
+				{
+					KINECT_TRACE_SCOPE( "bench.empty" );
+				}
+			}, seconds );
+			kinect::clearTrace();
+			const double ns = seconds * 1e9 / ( count * 1000 );
+			if( round == 0 || ns < scopeNs ) scopeNs = ns;
+
+			double clockSeconds;
+			const uint64_t clockCount = measure( [&]() {
+				for( int i = 0; i < 1000; ++i )
+				{
+					sum += kinect::traceClock();
+				}
+			}, clockSeconds );
+			const double readNs = clockSeconds * 1e9 / ( clockCount * 1000 );
+			if( round == 0 || readNs < clockNs ) clockNs = readNs;
+		}
+		const double limitNs = std::max( scopeLimitNs, 2 * clockNs + recordLimitNs );
+		printf( "%-24s %8.1f ns per scope, %.1f ns per clock read, limit %.1f ns%s\n", name, scopeNs, clockNs, limitNs, sum == 0 ? " " : "" );
+		if( g_checkLimits && scopeNs > limitNs ) {
+			fail( name, limitNs == scopeLimitNs ? "scope costs more than 50 ns" : "scope records in more than 10 ns over its clock reads" );
+		}
+	}
+
+
+	//! Ticks of kinect::traceClock() per second, against the steady clock over 50 ms.
+	//! On x86 these are reference cycles of the time stamp counter, at the nominal frequency
+	//! whatever the turbo, so cycles per pixel stay comparable across runs of a machine.
+	double calibrateCycleClock()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t ticks = kinect::traceClock();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+		const uint64_t endTicks = kinect::traceClock();
+		const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+		return ( endTicks - ticks ) / seconds;
+	}
+
+	//! Results as { "seconds", "simd", "cycleHz", "results" : [ one object per kernel ] }.
+	void writeJsonResults( const char* path )
+	{
+		std::ofstream os( path );
+		os << "{\n\t\"seconds\": " << g_seconds << ",\n\t\"simd\": \"" << kinect::simdLevelName( kinect::cpuSimdLevel() )
+			<< "\",\n\t\"cycleHz\": " << std::fixed << std::setprecision( 0 ) << g_cycleHz << ",\n\t\"results\": [";
+		os << std::setprecision( 6 );
+		for( std::size_t i = 0; i < g_results.size(); ++i )
+		{
+			const Result& r = g_results[ i ];
+			const double fps = r.frames / r.seconds;
+			os << ( i ? ",\n" : "\n" ) << "\t\t{ \"name\": \"" << r.name << "\", \"frames\": " << r.frames
+				<< ", \"seconds\": " << r.seconds << ", \"fps\": " << fps
+				<< ", \"pixelsPerFrame\": " << r.pixelsPerFrame << ", \"bytesPerFrame\": " << r.bytesPerFrame
+				<< ", \"mpixelsPerSecond\": " << fps * r.pixelsPerFrame / 1e6 << ", \"gbPerSecond\": " << fps * r.bytesPerFrame / 1e9
+				<< ", \"cyclesPerPixel\": " << cyclesPerPixel( r ) << " }";
+		}
+		os << "\n\t]\n}\n";
+		if( !os ) throw std::runtime_error( std::string( "Cannot write file : " ) + path );
+	}
+
+	//! Results as CSV, one row per kernel after a header row.
+	void writeCsvResults( const char* path )
+	{
+		std::ofstream os( path );
+		os << "name,frames,seconds,fps,pixelsPerFrame,bytesPerFrame,mpixelsPerSecond,gbPerSecond,cyclesPerPixel\n";
+		os << std::fixed << std::setprecision( 6 );
+		for( const Result& r : g_results )
+		{
+			const double fps = r.frames / r.seconds;
+			os << r.name << "," << r.frames << "," << r.seconds << "," << fps << "," << r.pixelsPerFrame << "," << r.bytesPerFrame
+				<< "," << fps * r.pixelsPerFrame / 1e6 << "," << fps * r.bytesPerFrame / 1e9 << "," << cyclesPerPixel( r ) << "\n";
+		}
+		if( !os ) throw std::runtime_error( std::string( "Cannot write file : " ) + path );
+	}
+}
+
+//! Headless benchmark of the frame paths with the stand-in sensor.
+//! Usage : KinectV2TestBench [seconds per benchmark] [name filter or "all"] [depth recording] [body index recording]
+//!         [-json results.json] [-csv results.csv] [-nolimits]
+//! The frame kernels report their frame rate, throughput and cycles per pixel of the time stamp
+//! counter, and are saved with -json or -csv to compare across commits.
+//! Returns 1 if a check failed. -nolimits keeps the correctness checks but not the speed limits,
+//! for the short run of ctest.
+//! Linux : cmake -S . -B build && cmake --build build && ctest --test-dir build from the top directory.
+int main( int argc, char* argv[] )
+{
+	const char* jsonPath = nullptr;
+	const char* csvPath = nullptr;
+	std::vector< const char* > args;
+	for( int i = 1; i < argc; ++i )
+	{
+		if( strcmp( argv[ i ], "-json" ) == 0 && i + 1 < argc ) {
+			jsonPath = argv[ ++i ];
+		}
+		else if( strcmp( argv[ i ], "-csv" ) == 0 && i + 1 < argc ) {
+			csvPath = argv[ ++i ];
+		}
+		else if( strcmp( argv[ i ], "-nolimits" ) == 0 ) {
+			g_checkLimits = false;
+		}
+		else {
+			args.push_back( argv[ i ] );
+		}
+	}
+	if( args.size() > 0 ) g_seconds = atof( args[ 0 ] );
+	if( args.size() > 1 && strcmp( args[ 1 ], "all" ) != 0 ) g_filter = args[ 1 ];
+	if( args.size() > 2 ) g_depthRecording = args[ 2 ];
+	if( args.size() > 3 ) g_bodyIndexRecording = args[ 3 ];
+	g_cycleHz = calibrateCycleClock();
+
+	benchStep( "step.depth", kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT );
+	benchStep( "step.bodyindex", kinect::PIXEL_FORMAT_BODY_INDEX8, DEPTH_WIDTH, DEPTH_HEIGHT );
+	benchStep( "step.color", kinect::PIXEL_FORMAT_YUY2, COLOR_WIDTH, COLOR_HEIGHT );
+	benchBodyStep( "step.body" );
+	benchSkeletonHistory( "skeleton.history" );
+	benchSkeletonFilter( "skeleton.filter.scalar", kinect::SIMD_SCALAR );
+	benchSkeletonFilter( "skeleton.filter.sse2", kinect::SIMD_SSE2 );
+	benchSkeletonFilter( "skeleton.filter.avx2", kinect::SIMD_AVX2 );
+	benchBoneMatrices( "skeleton.bones.scalar", kinect::SIMD_SCALAR );
+	benchBoneMatrices( "skeleton.bones.sse2", kinect::SIMD_SSE2 );
+	benchBoneMatrices( "skeleton.bones.avx2", kinect::SIMD_AVX2 );
+	benchGestureMatcher( "skeleton.gestures" );
+	benchSkeletonRecording( "skeleton.recording" );
+	benchHandoff( "handoff.depth", kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT );
+	benchHandoff( "handoff.color", kinect::PIXEL_FORMAT_YUY2, COLOR_WIDTH, COLOR_HEIGHT );
+	benchColorUpload( "upload.color.rgba", true );
+	benchColorUpload( "upload.color.yuy2", false );
+	benchPacing( "pacing.poll", kinect::FrameScheduler::SCHEDULE_FREE );
+	benchPacing( "pacing.paced", kinect::FrameScheduler::SCHEDULE_PACED );
+	benchPipeline( "pipeline.sync", kinect::FRAME_INTERVAL_TICKS );
+	benchPipeline( "pipeline.lowlight", kinect::FRAME_INTERVAL_TICKS * 2 );
+	benchPipelineThroughput( "pipeline.throughput" );
+	benchReplay( "replay.depth", kinect::PIXEL_FORMAT_DEPTH16, DEPTH_WIDTH, DEPTH_HEIGHT );
+	benchReplay( "replay.bodyindex", kinect::PIXEL_FORMAT_BODY_INDEX8, DEPTH_WIDTH, DEPTH_HEIGHT );
+	benchYuy2ToRgba( "convert.yuy2.scalar", kinect::SIMD_SCALAR );
+	benchYuy2ToRgba( "convert.yuy2.sse2", kinect::SIMD_SSE2 );
+	benchYuy2ToRgba( "convert.yuy2.avx2", kinect::SIMD_AVX2 );
+	benchCopy( "copy.1.stdcopy", 1, DEPTH_WIDTH, DEPTH_HEIGHT, false, -1 );
+	benchCopy( "copy.1.packed", 1, DEPTH_WIDTH, DEPTH_HEIGHT, true, kinect::COPY_ROWS );
+	benchCopy( "copy.1.rows", 1, DEPTH_WIDTH, DEPTH_HEIGHT, false, kinect::COPY_ROWS );
+	benchCopy( "copy.1.stream", 1, DEPTH_WIDTH, DEPTH_HEIGHT, false, kinect::COPY_STREAM );
+	benchCopy( "copy.2.stdcopy", 2, DEPTH_WIDTH, DEPTH_HEIGHT, false, -1 );
+	benchCopy( "copy.2.packed", 2, DEPTH_WIDTH, DEPTH_HEIGHT, true, kinect::COPY_ROWS );
+	benchCopy( "copy.2.rows", 2, DEPTH_WIDTH, DEPTH_HEIGHT, false, kinect::COPY_ROWS );
+	benchCopy( "copy.2.stream", 2, DEPTH_WIDTH, DEPTH_HEIGHT, false, kinect::COPY_STREAM );
+	benchCopy( "copy.4.stdcopy", 4, COLOR_WIDTH, COLOR_HEIGHT, false, -1 );
+	benchCopy( "copy.4.packed", 4, COLOR_WIDTH, COLOR_HEIGHT, true, kinect::COPY_ROWS );
+	benchCopy( "copy.4.rows", 4, COLOR_WIDTH, COLOR_HEIGHT, false, kinect::COPY_ROWS );
+	benchCopy( "copy.4.stream", 4, COLOR_WIDTH, COLOR_HEIGHT, false, kinect::COPY_STREAM );
+	benchRegistration( "registration.map.scalar", kinect::SIMD_SCALAR );
+	benchRegistration( "registration.map.sse2", kinect::SIMD_SSE2 );
+	benchRegistration( "registration.map.avx2", kinect::SIMD_AVX2 );
+	benchRegisterColor( "registration.rgbd" );
+	benchPointCloud( "pointcloud.scalar", kinect::SIMD_SCALAR, 1 );
+	benchPointCloud( "pointcloud.sse2", kinect::SIMD_SSE2, 1 );
+	benchPointCloud( "pointcloud.avx2", kinect::SIMD_AVX2, 1 );
+	benchPointCloud( "pointcloud.threads", kinect::SIMD_BEST, 0 );
+	benchPointCloud( "pointcloud.threads4", kinect::SIMD_BEST, 4 );
+	benchTemporalFilter( "filter.temporal.scalar", kinect::SIMD_SCALAR );
+	benchTemporalFilter( "filter.temporal.sse2", kinect::SIMD_SSE2 );
+	benchTemporalFilter( "filter.temporal.avx2", kinect::SIMD_AVX2 );
+	benchBilateralFilter( "filter.bilateral.1", 1 );
+	benchBilateralFilter( "filter.bilateral.threads", 0 );
+	benchBilateralFilter( "filter.bilateral.threads4", 4 );
+	benchColorize( "colorize.gray.scalar", kinect::COLORMAP_GRAY, kinect::SIMD_SCALAR );
+	benchColorize( "colorize.gray.avx2", kinect::COLORMAP_GRAY, kinect::SIMD_AVX2 );
+	benchColorize( "colorize.turbo.avx2", kinect::COLORMAP_TURBO, kinect::SIMD_AVX2 );
+	benchColorize( "colorize.viridis.avx2", kinect::COLORMAP_VIRIDIS, kinect::SIMD_AVX2 );
+	benchDepthCodec( "codec.depth.scalar", kinect::SIMD_SCALAR );
+	benchDepthCodec( "codec.depth.sse2", kinect::SIMD_SSE2 );
+	benchBodyIndexCodec( "codec.bodyindex.scalar", kinect::SIMD_SCALAR );
+	benchBodyIndexCodec( "codec.bodyindex.sse2", kinect::SIMD_SSE2 );
+	benchBodyIndexCodec( "codec.bodyindex.avx2", kinect::SIMD_AVX2 );
+	benchBodyStats( "stats.bodyindex.scalar", kinect::SIMD_SCALAR );
+	benchBodyStats( "stats.bodyindex.sse2", kinect::SIMD_SSE2 );
+	benchBodyStats( "stats.bodyindex.avx2", kinect::SIMD_AVX2 );
+	benchAssets( "assets.shaders", 2048, 1024 );
+	benchAssets( "assets.large", 8 << 20, 1 << 20 );
+	benchStartupGraph( "startup.graph" );
+	benchTrace( "trace.scope" );
+
+	try {
+		if( jsonPath ) writeJsonResults( jsonPath );
+		if( csvPath ) writeCsvResults( csvPath );
+	}
+	catch( const std::exception& e ) {
+		printf( "%s\n", e.what() );
+		return 1;
+	}
+	return g_failed ? 1 : 0;
+}
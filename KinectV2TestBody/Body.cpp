@@ -1,24 +1,32 @@
 ﻿#include <Windows.h>
 #include <tchar.h>
-#include <Kinect.h>
 #include <d3d11.h>
 #include <DirectXMath.h>
-#include <fstream>
-#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <array>
 #include <memory>
-#include <filesystem>
 #include <exception>
+#include <stdexcept>
+#include "../KinectV2TestCommon/AcquisitionThread.h"
+#include "../KinectV2TestCommon/AppShell.h"
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/Human.h"
+#include "../KinectV2TestCommon/KinectSensor.h"
+#include "../KinectV2TestCommon/SkeletonProcessor.h"
+#include "../KinectV2TestCommon/SkeletonRecording.h"
+#include "../KinectV2TestCommon/SyntheticSource.h"
+#include "../KinectV2TestCommon/TaskGraph.h"
+#include "../KinectV2TestCommon/Trace.h"
 
-#pragma comment( lib, "kinect20.lib" )
 #pragma comment( lib, "d3d11.lib" )
 
 namespace
 {
 	const TCHAR* g_appName = _T( "Kinect Body" );
+	const char* g_recordingPath = "body.kv2skl";
+	const char* g_tracePath = "body.trace.json";
 	const int g_windowWidth = 1280;
 	const int g_windowHeight = 720;
 }
@@ -41,147 +49,9 @@ void Assert( HRESULT hr )
 	}
 }
 
-//! Read all binary data from file.
-std::string fileGetContents( const char* path )
-{
-	// Get directory name of exe file.
-	namespace sys = std::tr2::sys;
-	auto exeDir = sys::path( __argv[ 0 ] ).parent_path();
-
-	std::stringstream newPathSS;
-	newPathSS << exeDir << sys::slash< sys::path >::value << path;
-	auto newPath = newPathSS.str();
-
-	// Read and copy all.
-	std::ifstream ifs( newPath, std::ios::binary );
-	std::string str(
-		(std::istreambuf_iterator< char >( ifs )),
-		std::istreambuf_iterator< char >()
-		);
-
-	// Error occurs if file not found or empty file.
-	if( str.size() == 0 )
-	{
-		std::stringstream ss;
-		ss << "File not found : " << path;
-		throw std::runtime_error( ss.str() );
-	}
-	return str;
-}
-
-
-namespace human
-{
-	// Boneの接続
-	const int JOINT_ORDER[ JointType_Count ] = {
-		JointType_SpineBase,		// 脊椎Base
-		JointType_SpineMid,			// 脊椎中間
-		JointType_SpineShoulder,	// 脊椎肩
-		JointType_Neck,				// 首
-		JointType_Head,				// 頭
-		JointType_ShoulderLeft,		// 左肩
-		JointType_ElbowLeft,		// 左肘
-		JointType_WristLeft,		// 左手首
-		JointType_HandLeft,			// 左手
-		JointType_ThumbLeft,		// 左親指
-		JointType_HandTipLeft,		// 左手先
-		JointType_ShoulderRight,	// （右も同様）
-		JointType_ElbowRight,
-		JointType_WristRight,
-		JointType_HandRight,
-		JointType_ThumbRight,
-		JointType_HandTipRight,
-		JointType_HipLeft,			// 左尻
-		JointType_KneeLeft,			// 左膝
-		JointType_AnkleLeft,		// 左足首
-		JointType_FootLeft,			// 左足元
-		JointType_HipRight,			// （右も同様）
-		JointType_KneeRight,
-		JointType_AnkleRight,
-		JointType_FootRight
-	};
-
-	// Boneの長さ[cm]
-	const float BONE_LENGTH[ 20 ] = {
-		0.0f,  // SpineBase
-		5.1f,  // 尻 -> 背
-		28.3f, // 背 -> 首
-		21.5f, // 首 -> 頭
-		19.8f, // 首 -> 左肩
-		24.3f, // 左肩 -> 左肘
-		26.5f, // 左肘 -> 左手首
-		8.2f,  // 左手首 -> 左手
-		19.8f, // （体は左右対称なので同じ値とする）
-		24.3f,
-		26.5f,
-		8.2f,
-		10.0f, // 尻 -> 左股
-		35.8f, // 左股 -> 左膝
-		35.2f, // 左膝 -> 左足首
-		11.5f, // 左足首 -> 左足
-		10.0f,
-		35.8f,
-		35.2f,
-		11.5f
-	};
-
-	// Boneのルートから地面までの距離[cm]
-	const float BONE_ROOT_DISTANCE = 108.4f;
-
-} // namespace human
-
-
-struct Kinect
-{
-	enum
-	{
-		MAX_BODY_INDEX_FRAME_WIDTH = 512,
-		MAX_BODY_INDEX_FRAME_HEIGHT = 424,
-		MAX_BODY_INDEX_FRAME_BYTE_PER_PIXEL = 1
-	};
-
-	void init()
-	{
-		HRESULT hr;
-
-		IKinectSensor* sensor;
-		hr = GetDefaultKinectSensor( &sensor );
-		Assert( hr );
-		sensor_.reset( sensor );
-
-		hr = sensor_->Open();
-		Assert( hr );
-
-		// Sensor -> Body Source
-		IBodyFrameSource* bodySource;
-		hr = sensor_->get_BodyFrameSource( &bodySource );
-		Assert( hr );
-		bodySource_.reset( bodySource );
-
-		// Body Source -> Body Reader
-		IBodyFrameReader* bodyReader;
-		hr = bodySource_->OpenReader( &bodyReader );
-		Assert( hr );
-		bodyReader_.reset( bodyReader );
+// Bone hierarchy and lengths, shared with the analytics in KinectV2TestCommon.
+namespace human = kinect::human;
 
-		// Coordinate mapper
-		ICoordinateMapper* mapper;
-		hr = sensor_->get_CoordinateMapper( &mapper );
-		Assert( hr );
-		coordMapper_.reset( mapper );
-	}
-
-	void release()
-	{
-		sensor_->Close();
-	}
-
-	std::unique_ptr< IKinectSensor, Deleter > sensor_;
-	std::unique_ptr< IBodyFrameSource, Deleter > bodySource_;
-	std::unique_ptr< IBodyFrameReader, Deleter > bodyReader_;
-
-	std::unique_ptr< ICoordinateMapper, Deleter > coordMapper_;
-};
 
 struct D3D
 {
@@ -193,7 +63,8 @@ struct D3D
 		unsigned int color;
 	};
 
-	void init( HWND hWnd )
+	//! Device and swap chain of the window.
+	void initDevice( HWND hWnd )
 	{
 		HRESULT hr;
 
@@ -237,6 +108,12 @@ struct D3D
 		Assert( hr );
 		backBufferRTV_.reset( backBufferRTV );
 		backBuffer->Release();
+	}
+
+	//! States, shaders and buffers, once the device is made and the shaders are loaded.
+	void initResources( kinect::AssetLoader& assets )
+	{
+		HRESULT hr;
 
 		// Common state
 
@@ -252,20 +129,15 @@ struct D3D
 
 		// Body
 
-		std::string binData;
-		std::string vsBinData;
 		ID3D11VertexShader* vs;
-		binData = fileGetContents( "def.vs.cso" );
-		hr = device_->CreateVertexShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &vs );
+		const kinect::AssetSpan vsBin = assets.load( "def.vs.cso" );
+		hr = device_->CreateVertexShader( vsBin.data, vsBin.size, nullptr, &vs );
 		Assert( hr );
 		modelVS_.reset( vs );
-		vsBinData = binData;
 
 		ID3D11PixelShader* ps;
-		binData = fileGetContents( "def.ps.cso" );
-		hr = device_->CreatePixelShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &ps );
+		const kinect::AssetSpan psBin = assets.load( "def.ps.cso" );
+		hr = device_->CreatePixelShader( psBin.data, psBin.size, nullptr, &ps );
 		Assert( hr );
 		modelPS_.reset( ps );
 
@@ -310,12 +182,23 @@ struct D3D
 		Assert( hr );
 		modelVB_.reset( buf );
 
+		// Bone matrices, rewritten every frame.
+		bufDesc = CD3D11_BUFFER_DESC( sizeof( kinect::BoneInstance ) * kinect::BoneMatrixBuilder::MAX_BONES,
+			D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
+		hr = device_->CreateBuffer( &bufDesc, nullptr, &buf );
+		Assert( hr );
+		boneVB_.reset( buf );
+
 		D3D11_INPUT_ELEMENT_DESC ieDesc[] = {
 				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "COLOR", 0, DXGI_FORMAT_B8G8R8A8_UNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+				{ "COLOR", 0, DXGI_FORMAT_B8G8R8A8_UNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
 		};
 		ID3D11InputLayout* il;
-		hr = device_->CreateInputLayout( ieDesc, ARRAYSIZE( ieDesc ), vsBinData.data(), vsBinData.size(), &il );
+		hr = device_->CreateInputLayout( ieDesc, ARRAYSIZE( ieDesc ), vsBin.data, vsBin.size, &il );
 		Assert( hr );
 		modelIL_.reset( il );
 	}
@@ -335,63 +218,112 @@ struct D3D
 	std::unique_ptr< ID3D11PixelShader, Deleter > modelPS_;
 	std::unique_ptr< ID3D11Buffer, Deleter > modelCB_;
 	std::unique_ptr< ID3D11Buffer, Deleter > modelVB_;
+	std::unique_ptr< ID3D11Buffer, Deleter > boneVB_;
 	std::unique_ptr< ID3D11InputLayout, Deleter > modelIL_;
-
-	std::array< float, 4 * JointType_Count > jointRot_;
 };
 
 namespace
 {
-	HWND g_hWnd = NULL;
-	Kinect g_kinect;
+	kinect::KinectSensor g_sensor;
 	D3D g_d3d;
+
+	//! Body source of the acquisition thread, the sensor or the stand-in.
+	kinect::BodyFrameSource* g_source = nullptr;
+	std::unique_ptr< kinect::SyntheticBodyFrameSource > g_synthetic;
+	std::unique_ptr< kinect::SkeletonRecordingReader > g_replay;
+	std::unique_ptr< kinect::SkeletonRecordingWriter > g_recorder;	// codes and writes on its own thread
+	kinect::AcquisitionThread< kinect::BodyFrame > g_acquisition;
+
+	//! Joints over the last frames, the bones of the newest one, one pyramid instance each,
+	//! and the gestures of the tracked bodies.
+	std::unique_ptr< kinect::SkeletonProcessor > g_skeletons;
+
+	//! G records the last 2 [s] of the first tracked body as a gesture template.
+	int g_gestureOf[ kinect::MAX_BODY_COUNT ] = { -1, -1, -1, -1, -1, -1 };	// last reported template
+	bool g_recordGesture = false;
+	const unsigned int g_gestureFrames = 60;
+	const float g_gestureThreshold = 0.08f;	// [m]
 }
 
-void Step()
+//! Add the last frames of the first tracked body as a gesture template.
+void RecordGesture()
 {
-	HRESULT hr;
-
-	IBodyFrame* frame;
-	hr = g_kinect.bodyReader_->AcquireLatestFrame( &frame );
-	if( hr == E_PENDING )
+	for( unsigned int bi = 0; bi < kinect::MAX_BODY_COUNT; ++bi )
 	{
+		if( !( g_skeletons->history().trackedMask( 0 ) & ( 1u << bi ) ) ) continue;
+
+		std::stringstream ss;
+		try {
+			kinect::GestureMatcher& gestures = g_skeletons->gestures();
+			const std::string name = "Gesture " + std::to_string( gestures.templateCount() + 1 );
+			gestures.addTemplate( name, g_skeletons->history(), bi, g_gestureFrames, g_gestureThreshold );
+			ss << "Recorded : " << name << "\n";
+		}
+		catch( std::invalid_argument& e ) {
+			ss << "Gesture not recorded : " << e.what() << "\n";
+		}
+		OutputDebugStringA( ss.str().c_str() );
 		return;
 	}
-	Assert( hr );
-	
-	IBody* bodies[ BODY_COUNT ] = {};
-	hr = frame->GetAndRefreshBodyData( ARRAYSIZE( bodies ), bodies );
-	Assert( hr );
-
-	// test
-	g_d3d.jointRot_[ 0 ] = 0;
-	g_d3d.jointRot_[ 1 ] = 0;
-	g_d3d.jointRot_[ 2 ] = 0;
-	for( int bi = 0; bi < ARRAYSIZE( bodies ); ++bi )
+}
+
+//! Runs on the acquisition thread.
+bool Acquire( kinect::BodyFrame& frame )
+{
+	if( !g_source->acquireLatestFrame( frame ) )
 	{
-		BOOLEAN isTracked;
-		hr = bodies[ bi ]->get_IsTracked( &isTracked );
-		Assert( hr );
-		if( isTracked )
+		return false;
+	}
+
+	// Every frame is recorded, also those the render loop skips.
+	if( g_recorder )
+	{
+		g_recorder->write( frame );
+	}
+	return true;
+}
+
+//! Return whether a new frame was taken.
+bool Step()
+{
+	KINECT_TRACE_SCOPE( "Step" );
+
+	const kinect::BodyFrame* latest = g_acquisition.latest();
+	if( !latest )
+	{
+		return false;
+	}
+
+	// The same frame stays latest until the next one arrives.
+	if( g_skeletons->update( *latest ) )
+	{
+		// A template recorded now is matched from the next frame on.
+		if( g_recordGesture )
 		{
-			JointOrientation jointOrients[ JointType_Count ];
-			hr = bodies[ bi ]->GetJointOrientations( ARRAYSIZE( jointOrients ), jointOrients );
-			Assert( hr );
-			g_d3d.jointRot_[ 0 ] = jointOrients[ JointType_SpineBase ].Orientation.x;
-			g_d3d.jointRot_[ 1 ] = jointOrients[ JointType_SpineBase ].Orientation.y;
-			g_d3d.jointRot_[ 2 ] = jointOrients[ JointType_SpineBase ].Orientation.z;
-			break;
+			g_recordGesture = false;
+			RecordGesture();
+		}
+		for( int bi = 0; bi < kinect::MAX_BODY_COUNT; ++bi )
+		{
+			const kinect::GestureMatch& match = g_skeletons->match( bi );
+			if( match.templateIndex == g_gestureOf[ bi ] ) continue;
+			g_gestureOf[ bi ] = match.templateIndex;
+			if( match.templateIndex >= 0 )
+			{
+				std::stringstream ss;
+				ss << "Body " << bi << " : " << g_skeletons->gestures().templateName( match.templateIndex )
+					<< " (" << match.distance * 100 << " cm)\n";
+				OutputDebugStringA( ss.str().c_str() );
+			}
 		}
 	}
-
-	//for( auto& body : bodies ) {
-	//	body->Release();
-	//}
-	frame->Release();
+	return true;
 }
 
 void Draw()
 {
+	KINECT_TRACE_SCOPE( "Draw" );
+
 	ID3D11DeviceContext* context = g_d3d.context_.get();
 	
 	// Clear
@@ -401,95 +333,133 @@ void Draw()
 	auto* rtv = g_d3d.backBufferRTV_.get();
 	context->OMSetRenderTargets( 1, &rtv, nullptr );
 	
-	// Draw body
+	// Draw body : every bone is an instance of the pyramid.
 
-	auto cbModelWVP = DirectX::XMMatrixIdentity();
-	auto matWorld = DirectX::XMMatrixIdentity();
-	matWorld = DirectX::XMMatrixRotationRollPitchYaw( g_d3d.jointRot_[ 0 ], g_d3d.jointRot_[ 1 ], g_d3d.jointRot_[ 2 ] );
-	auto matView =  DirectX::XMMatrixLookAtLH(
-		DirectX::XMVectorSet( 0, 0, -3, 0 ), DirectX::XMVectorSet( 0, 0, 5, 0 ), DirectX::XMVectorSet( 0, 1, 0, 0 )
+	// Seen from the sensor. Camera space is right-handed, the X mirror keeps the faces front.
+	auto matView = DirectX::XMMatrixScaling( -1, 1, 1 ) * DirectX::XMMatrixLookAtLH(
+		DirectX::XMVectorSet( 0, 0, 0, 0 ), DirectX::XMVectorSet( 0, 0, 1, 0 ), DirectX::XMVectorSet( 0, 1, 0, 0 )
 		);
 	auto matProj = DirectX::XMMatrixPerspectiveFovLH(
 		DirectX::XMConvertToRadians( 50 ), (float)g_windowWidth / (float)g_windowHeight, 0.01f, 1000.0f
 		);
-	cbModelWVP = matWorld * matView * matProj;
-	cbModelWVP = DirectX::XMMatrixTranspose( cbModelWVP );
-	g_d3d.context_->UpdateSubresource( g_d3d.modelCB_.get(), 0, nullptr, &cbModelWVP, 0, 0 );
+	auto cbModelVP = DirectX::XMMatrixTranspose( matView * matProj );
+	g_d3d.context_->UpdateSubresource( g_d3d.modelCB_.get(), 0, nullptr, &cbModelVP, 0, 0 );
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	{
+		KINECT_TRACE_SCOPE( "Map" );
+		Assert( context->Map( g_d3d.boneVB_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped ) );
+	}
+	auto* instances = static_cast< kinect::BoneInstance* >( mapped.pData );
+	UINT instanceCount = static_cast< UINT >( g_skeletons->boneCount() );
+	if( instanceCount != 0 )
+	{
+		memcpy( instances, g_skeletons->bones(), instanceCount * sizeof( kinect::BoneInstance ) );
+	}
+	else
+	{
+		// Nobody tracked : the test pyramid 3 [m] ahead, mirrored back to the left-handed mesh.
+		DirectX::XMStoreFloat4x4( reinterpret_cast< DirectX::XMFLOAT4X4* >( instances->m ),
+			DirectX::XMMatrixScaling( -0.3f, 0.3f, 0.3f ) * DirectX::XMMatrixTranslation( 0, 0, 3 ) );
+		instanceCount = 1;
+	}
+	{
+		KINECT_TRACE_SCOPE( "Unmap" );
+		context->Unmap( g_d3d.boneVB_.get(), 0 );
+	}
 
-	auto* vb = g_d3d.modelVB_.get();
-	unsigned int stride = sizeof( D3D::MeshFormat );
-	unsigned int offset = 0;
+	ID3D11Buffer* vbs[] = { g_d3d.modelVB_.get(), g_d3d.boneVB_.get() };
+	unsigned int strides[] = { sizeof( D3D::MeshFormat ), sizeof( kinect::BoneInstance ) };
+	unsigned int offsets[] = { 0, 0 };
 	auto* cb = g_d3d.modelCB_.get();
 	D3D11_VIEWPORT viewport = { 0, 0, g_windowWidth, g_windowHeight, 0, 1 };
 	context->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 	context->IASetInputLayout( g_d3d.modelIL_.get() );
-	context->IASetVertexBuffers( 0, 1, &vb, &stride, &offset );
+	context->IASetVertexBuffers( 0, 2, vbs, strides, offsets );
 	context->VSSetShader( g_d3d.modelVS_.get(), nullptr, 0 );
 	context->VSSetConstantBuffers( 0, 1, &cb );
 	context->RSSetState( g_d3d.rasterState_.get() );
 	context->PSSetShader( g_d3d.modelPS_.get(), nullptr, 0 );
 	context->RSSetViewports( 1, &viewport );
-	context->Draw( 18, 0 );
+	context->DrawInstanced( 18, instanceCount, 0, 0 );
 
-	g_d3d.swapChain_->Present( 1, 0 );
+	{
+		KINECT_TRACE_SCOPE( "Present" );
+		g_d3d.swapChain_->Present( 1, 0 );
+	}
 }
 
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
-	nCmdShow; lpCmdLine; hPrevInstance;
-
-	WNDCLASS wcls;
-	memset( &wcls, 0, sizeof wcls );
-	wcls.style = CS_HREDRAW | CS_VREDRAW;
-	wcls.lpfnWndProc = []( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam ) -> LRESULT {
-		switch( message ) {
-		case WM_KEYDOWN:
-			if( wParam == VK_ESCAPE ) {
-				PostMessage( hWnd, WM_DESTROY, 0, 0 );
-				return 0;
-			}
-			break;
-		case WM_DESTROY:
-			PostQuitMessage( 0 );
-			break;
-		}
-		return DefWindowProc( hWnd, message, wParam, lParam );
-	};
-	wcls.hInstance = hInstance;
-	wcls.lpszClassName = g_appName;
-	RegisterClass( &wcls );
-
-	RECT rect = { 0, 0, g_windowWidth, g_windowHeight };
-	AdjustWindowRect( &rect, WS_OVERLAPPEDWINDOW, FALSE );
-
-	const int windowWidth  = ( rect.right  - rect.left );
-	const int windowHeight = ( rect.bottom - rect.top );
-	g_hWnd = CreateWindow( g_appName, g_appName, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, windowWidth, windowHeight, NULL, NULL, hInstance, NULL );
+	nCmdShow; hPrevInstance;
+	kinect::AppShell shell( hInstance, g_appName, g_windowWidth, g_windowHeight, lpCmdLine );
 
-	ShowWindow( g_hWnd, SW_SHOW );
+	// "G" records the gesture of the next frame as a template.
+	shell.setKeyHandler( []( WPARAM key ) {
+		if( key != 'G' ) return false;
+		g_recordGesture = true;
+		return true;
+	} );
 
 	try {
-		g_kinect.init();
-		g_d3d.init( g_hWnd );
-
-		MSG msg;
-		memset( &msg, 0, sizeof msg );
-		while( msg.message != WM_QUIT ) {
-			BOOL r = PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE );
-			if( r == 0 ) {
-				Step();
-				Draw();
+		// Both read and write g_recordingPath : recording while replaying would truncate the file being read.
+		if( shell.hasOption( "-replay" ) && shell.hasOption( "-record" ) ) {
+			throw std::runtime_error( "-replay and -record can not be used together" );
+		}
+
+		kinect::TaskGraph& startup = shell.startup();
+		const kinect::TaskGraph::TaskId sensor = startup.add( "sensor", [&shell]() {
+			// "-synthetic" runs without the sensor.
+			if( shell.hasOption( "-synthetic" ) ) {
+				g_synthetic.reset( new kinect::SyntheticBodyFrameSource( true ) );
+				g_source = g_synthetic.get();
+			}
+			else if( shell.hasOption( "-replay" ) ) {
+				g_replay.reset( new kinect::SkeletonRecordingReader( g_recordingPath ) );
+				g_source = g_replay.get();
 			}
 			else {
-				DispatchMessage( &msg );
+				g_sensor.open( kinect::STREAM_FLAG_BODY );
+				g_source = g_sensor.sources().body_;
 			}
-		}
+		} );
 
+		// "-record" saves every frame to the recording.
+		const kinect::TaskGraph::TaskId recorder = startup.add( "recorder", [&shell]() {
+			if( shell.hasOption( "-record" ) ) {
+				g_recorder.reset( new kinect::SkeletonRecordingWriter( g_recordingPath ) );
+			}
+		} );
+
+		const kinect::TaskGraph::TaskId filters = startup.add( "filters", [&shell]() {
+			// "-smooth" filters the jitter of the joint positions.
+			g_skeletons.reset( new kinect::SkeletonProcessor( shell.hasOption( "-smooth" ) ) );
+		} );
+
+		shell.addDeviceSteps( { "def.vs.cso", "def.ps.cso" },
+			[]( HWND hWnd ) { g_d3d.initDevice( hWnd ); },
+			[]( kinect::AssetLoader& assets ) { g_d3d.initResources( assets ); } );
+
+		startup.add( "acquisition", [&shell]() {
+			shell.startAcquisition( g_acquisition, *g_source, Acquire );
+		}, { sensor, recorder, filters } );
+		shell.runStartup();
+
+		shell.run( Step, Draw, g_tracePath );
+		OutputDebugStringA( ( g_skeletons->summary() + "\n" ).c_str() );
+		if( g_recorder ) {
+			g_recorder->close();
+			std::stringstream ss;
+			ss << "Recording : " << g_recorder->frameCount() << " frames, " << g_recorder->droppedCount() << " dropped, "
+				<< g_recorder->payloadSize() << " bytes\n";
+			OutputDebugStringA( ss.str().c_str() );
+			g_recorder.reset();
+		}
 		g_d3d.release();
-		g_kinect.release();
+		g_sensor.close();
 	}
 	catch( std::exception &e ) {
-		MessageBoxA( g_hWnd, e.what(), nullptr, MB_ICONSTOP );
+		MessageBoxA( shell.window(), e.what(), nullptr, MB_ICONSTOP );
 	}
 
 	return 0;
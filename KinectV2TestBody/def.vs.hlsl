@@ -2,6 +2,10 @@ struct VS_IN
 {
 	float3 pos : POSITION;
 	float4 color : COLOR;
+	float4 world0 : WORLD0;	// bone matrix rows, per instance
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+	float4 world3 : WORLD3;
 };
 
 struct PS_IN
@@ -12,13 +16,14 @@ struct PS_IN
 
 cbuffer cbModel
 {
-	float4x4 cbModelWVP;
+	float4x4 cbModelVP;
 };
 
 PS_IN main( VS_IN vsIn )
 {
 	PS_IN psIn;
-	psIn.pos = mul( float4( vsIn.pos, 1 ), cbModelWVP );
+	float4x4 world = float4x4( vsIn.world0, vsIn.world1, vsIn.world2, vsIn.world3 );
+	psIn.pos = mul( mul( float4( vsIn.pos, 1 ), world ), cbModelVP );
 	psIn.color = vsIn.color;
 	return psIn;
 }
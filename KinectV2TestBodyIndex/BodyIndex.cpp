@@ -1,25 +1,39 @@
 #include <Windows.h>
 #include <tchar.h>
-#include <Kinect.h>
 #include <d3d11.h>
 #include <fstream>
-#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <array>
 #include <memory>
-#include <filesystem>
 #include <exception>
+#include "../KinectV2TestCommon/AcquisitionThread.h"
+#include "../KinectV2TestCommon/AppShell.h"
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/BodyStats.h"
+#include "../KinectV2TestCommon/FrameCopy.h"
+#include "../KinectV2TestCommon/FramePipeline.h"
+#include "../KinectV2TestCommon/KinectSensor.h"
+#include "../KinectV2TestCommon/Recording.h"
+#include "../KinectV2TestCommon/SyntheticSource.h"
+#include "../KinectV2TestCommon/TaskGraph.h"
+#include "../KinectV2TestCommon/Trace.h"
 
-#pragma comment( lib, "kinect20.lib" )
 #pragma comment( lib, "d3d11.lib" )
 
 namespace
 {
 	const TCHAR* g_appName = _T( "Kinect BodyIndex" );
+	const char* g_recordingPath = "bodyindex.kv2rec";
+	const char* g_statsPath = "bodyindex.stats.txt";
+	const char* g_tracePath = "bodyindex.trace.json";
 	const int g_windowWidth = 640;
 	const int g_windowHeight = 530;
+
+	// Size of the body index frames.
+	const unsigned int g_frameWidth = 512;
+	const unsigned int g_frameHeight = 424;
 }
 
 //! Custom deleter of std::unique_ptr for COM instance.
@@ -40,83 +54,10 @@ void Assert( HRESULT hr )
 	}
 }
 
-//! Read all binary data from file.
-std::string fileGetContents( const char* path )
-{
-	// Get directory name of exe file.
-	namespace sys = std::tr2::sys;
-	auto exeDir = sys::path( __argv[ 0 ] ).parent_path();
-
-	std::stringstream newPathSS;
-	newPathSS << exeDir << sys::slash< sys::path >::value << path;
-	auto newPath = newPathSS.str();
-
-	// Read and copy all.
-	std::ifstream ifs( newPath, std::ios::binary );
-	std::string str(
-		(std::istreambuf_iterator< char >( ifs )),
-		std::istreambuf_iterator< char >()
-		);
-
-	// Error occurs if file not found or empty file.
-	if( str.size() == 0 )
-	{
-		std::stringstream ss;
-		ss << "File not found : " << path;
-		throw std::runtime_error( ss.str() );
-	}
-	return str;
-}
-
-struct Kinect
-{
-	enum
-	{
-		MAX_BODY_INDEX_FRAME_WIDTH = 512,
-		MAX_BODY_INDEX_FRAME_HEIGHT = 424,
-		MAX_BODY_INDEX_FRAME_BYTE_PER_PIXEL = 1
-	};
-
-	void init()
-	{
-		HRESULT hr;
-
-		IKinectSensor* sensor;
-		hr = GetDefaultKinectSensor( &sensor );
-		Assert( hr );
-		sensor_.reset( sensor );
-
-		hr = sensor_->Open();
-		Assert( hr );
-
-		// Sensor -> BodyIndex Source
-		IBodyIndexFrameSource* bodyIndexSource;
-		hr = sensor_->get_BodyIndexFrameSource( &bodyIndexSource );
-		Assert( hr );
-		bodyIndexSource_.reset( bodyIndexSource );
-
-		// BodyIndex Source -> BodyIndex Reader
-		IBodyIndexFrameReader* bodyIndexReader;
-		hr = bodyIndexSource_->OpenReader( &bodyIndexReader );
-		Assert( hr );
-		bodyIndexReader_.reset( bodyIndexReader );
-	}
-
-	void release()
-	{
-		sensor_->Close();
-	}
-
-	std::unique_ptr< IKinectSensor, Deleter > sensor_;
-	std::unique_ptr< IBodyIndexFrameSource, Deleter > bodyIndexSource_;
-	std::unique_ptr< IBodyIndexFrameReader, Deleter > bodyIndexReader_;
-
-	//std::array< unsigned char, (MAX_DEPTH_FRAME_WIDTH * MAX_DEPTH_FRAME_HEIGHT * MAX_DEPTH_FRAME_BYTE_PER_PIXEL) > bodyIndexFrame_;
-};
-
 struct D3D
 {
-	void init( HWND hWnd )
+	//! Device and swap chain of the window.
+	void initDevice( HWND hWnd )
 	{
 		HRESULT hr;
 
@@ -160,6 +101,12 @@ struct D3D
 		Assert( hr );
 		backBufferRTV_.reset( backBufferRTV );
 		backBuffer->Release();
+	}
+
+	//! States, shaders and buffers, once the device is made and the shaders are loaded.
+	void initResources( kinect::AssetLoader& assets )
+	{
+		HRESULT hr;
 
 		// Common state
 
@@ -191,7 +138,7 @@ struct D3D
 		ID3D11Texture2D* tex;
 		D3D11_TEXTURE2D_DESC texDesc;
 		texDesc = CD3D11_TEXTURE2D_DESC(
-			DXGI_FORMAT_R8_UINT, Kinect::MAX_BODY_INDEX_FRAME_WIDTH, Kinect::MAX_BODY_INDEX_FRAME_HEIGHT, 1, 1,
+			DXGI_FORMAT_R8_UINT, g_frameWidth, g_frameHeight, 1, 1,
 			D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
 		hr = device_->CreateTexture2D( &texDesc, nullptr, &tex );
 		Assert( hr );
@@ -207,18 +154,15 @@ struct D3D
 		Assert( hr );
 		bodyIndexFrameSRV_.reset( srv );
 
-		std::string binData;
 		ID3D11VertexShader* vs;
-		binData = fileGetContents( "def.vs.cso" );
-		hr = device_->CreateVertexShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &vs );
+		const kinect::AssetSpan vsBin = assets.load( "def.vs.cso" );
+		hr = device_->CreateVertexShader( vsBin.data, vsBin.size, nullptr, &vs );
 		Assert( hr );
 		fullscreenVS_.reset( vs );
 
 		ID3D11PixelShader* ps;
-		binData = fileGetContents( "def.ps.cso" );
-		hr = device_->CreatePixelShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &ps );
+		const kinect::AssetSpan psBin = assets.load( "def.ps.cso" );
+		hr = device_->CreatePixelShader( psBin.data, psBin.size, nullptr, &ps );
 		Assert( hr );
 		texPS_.reset( ps );
 	}
@@ -243,50 +187,82 @@ struct D3D
 
 namespace
 {
-	HWND g_hWnd = NULL;
-	Kinect g_kinect;
+	kinect::KinectSensor g_sensor;
 	D3D g_d3d;
+
+	//! Body index source of the acquisition thread, the sensor or the stand-in.
+	kinect::FrameSource* g_source = nullptr;
+	std::unique_ptr< kinect::SyntheticFrameSource > g_synthetic;
+	std::unique_ptr< kinect::RecordingReader > g_replay;
+	std::unique_ptr< kinect::RecordingWriter > g_recorder;
+
+	//! Body index frames, with the depth frames of the same time for "-stats" on the sensor.
+	std::unique_ptr< kinect::FramePipeline > g_pipeline;
+	kinect::AcquisitionThread< kinect::FrameSet > g_acquisition;
+
+	//! Per-body statistics of every frame, one line each.
+	std::unique_ptr< std::ofstream > g_statsLog;
 }
 
-void Step()
+//! Runs on the acquisition thread.
+bool Acquire( kinect::FrameSet& set )
 {
-	HRESULT hr;
+	if( !g_pipeline->poll( set ) || !set.has( kinect::STREAM_BODY_INDEX ) )
+	{
+		return false;
+	}
+	const kinect::FrameView& frame = set.images_[ kinect::STREAM_BODY_INDEX ]->view_;
 
-	IBodyIndexFrame* frame;
-	hr = g_kinect.bodyIndexReader_->AcquireLatestFrame( &frame );
-	if( hr == E_PENDING )
+	if( g_recorder )
 	{
-		return;
+		g_recorder->write( frame );
 	}
-	Assert( hr );
 
-	UINT frameSize;
-	BYTE* framePtr;
-	hr = frame->AccessUnderlyingBuffer( &frameSize, &framePtr );
-	Assert( hr );
+	if( g_statsLog )
+	{
+		// Depth only comes with the sensor, and may be missing from a set.
+		const uint16_t* depth = set.has( kinect::STREAM_DEPTH ) ?
+			reinterpret_cast< const uint16_t* >( set.images_[ kinect::STREAM_DEPTH ]->view_.data ) : nullptr;
+		kinect::BodyIndexStats stats;
+		kinect::computeBodyIndexStats( frame.data, depth, frame.width, frame.height, frame.relativeTime, stats );
+		*g_statsLog << kinect::formatBodyIndexStats( stats ) << '\n';
+	}
+	return true;
+}
+
+//! Return whether a new frame was taken.
+bool Step()
+{
+	KINECT_TRACE_SCOPE( "Step" );
+
+	HRESULT hr;
+
+	const kinect::FrameSet* set = g_acquisition.latest();
+	if( !set )
+	{
+		return false;
+	}
+	const kinect::FrameView& frame = set->images_[ kinect::STREAM_BODY_INDEX ]->view_;
 
 	// Copy pixels to Direct3D texture.
 	D3D11_MAPPED_SUBRESOURCE map;
-	D3D11_TEXTURE2D_DESC texDesc;
-	hr = g_d3d.context_->Map( g_d3d.bodyIndexFrame_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	{
+		KINECT_TRACE_SCOPE( "Map" );
+		hr = g_d3d.context_->Map( g_d3d.bodyIndexFrame_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	}
 	Assert( hr );
-	g_d3d.bodyIndexFrame_->GetDesc( &texDesc );
-	for( unsigned int y = 0; y < texDesc.Height; ++y )
+	kinect::copyFrame( frame, reinterpret_cast< unsigned char* >( map.pData ), map.RowPitch );
 	{
-		const int copySize = Kinect::MAX_BODY_INDEX_FRAME_WIDTH * Kinect::MAX_BODY_INDEX_FRAME_BYTE_PER_PIXEL;
-		auto* destStart = reinterpret_cast< unsigned char* >( map.pData ) + map.RowPitch * y;
-		const auto* srcStart = reinterpret_cast< unsigned char* >( framePtr ) + y * copySize;
-		const auto* srcEnd = srcStart + copySize;
-		const auto dest = stdext::make_checked_array_iterator( destStart, copySize );
-		std::copy( srcStart, srcEnd, dest );
+		KINECT_TRACE_SCOPE( "Unmap" );
+		g_d3d.context_->Unmap( g_d3d.bodyIndexFrame_.get(), 0 );
 	}
-	g_d3d.context_->Unmap( g_d3d.bodyIndexFrame_.get(), 0 );
-
-	frame->Release();
+	return true;
 }
 
 void Draw()
 {
+	KINECT_TRACE_SCOPE( "Draw" );
+
 	ID3D11DeviceContext* context = g_d3d.context_.get();
 	
 	// Clear
@@ -309,65 +285,80 @@ void Draw()
 	context->RSSetViewports( 1, &viewport );
 	context->Draw( 4, 0 );
 
-	g_d3d.swapChain_->Present( 1, 0 );
+	{
+		KINECT_TRACE_SCOPE( "Present" );
+		g_d3d.swapChain_->Present( 1, 0 );
+	}
 }
 
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
-	nCmdShow; lpCmdLine; hPrevInstance;
-
-	WNDCLASS wcls;
-	memset( &wcls, 0, sizeof wcls );
-	wcls.style = CS_HREDRAW | CS_VREDRAW;
-	wcls.lpfnWndProc = []( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam ) -> LRESULT {
-		switch( message ) {
-		case WM_KEYDOWN:
-			if( wParam == VK_ESCAPE ) {
-				PostMessage( hWnd, WM_DESTROY, 0, 0 );
-				return 0;
-			}
-			break;
-		case WM_DESTROY:
-			PostQuitMessage( 0 );
-			break;
-		}
-		return DefWindowProc( hWnd, message, wParam, lParam );
-	};
-	wcls.hInstance = hInstance;
-	wcls.lpszClassName = g_appName;
-	RegisterClass( &wcls );
-
-	RECT rect = { 0, 0, g_windowWidth, g_windowHeight };
-	AdjustWindowRect( &rect, WS_OVERLAPPEDWINDOW, FALSE );
-
-	const int windowWidth  = ( rect.right  - rect.left );
-	const int windowHeight = ( rect.bottom - rect.top );
-	g_hWnd = CreateWindow( g_appName, g_appName, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, windowWidth, windowHeight, NULL, NULL, hInstance, NULL );
-
-	ShowWindow( g_hWnd, SW_SHOW );
+	nCmdShow; hPrevInstance;
+	kinect::AppShell shell( hInstance, g_appName, g_windowWidth, g_windowHeight, lpCmdLine );
 
 	try {
-		g_kinect.init();
-		g_d3d.init( g_hWnd );
-
-		MSG msg;
-		memset( &msg, 0, sizeof msg );
-		while( msg.message != WM_QUIT ) {
-			BOOL r = PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE );
-			if( r == 0 ) {
-				Step();
-				Draw();
+		// Both read and write g_recordingPath : recording while replaying would truncate the file being read.
+		if( shell.hasOption( "-replay" ) && shell.hasOption( "-record" ) ) {
+			throw std::runtime_error( "-replay and -record can not be used together" );
+		}
+
+		kinect::TaskGraph& startup = shell.startup();
+		const kinect::TaskGraph::TaskId sensor = startup.add( "sensor", [&shell]() {
+			// "-synthetic" runs without the sensor, "-replay" plays the recording back.
+			// Each stream of the sensor is acquired once, by the pipeline.
+			kinect::PipelineSources sources;
+			unsigned int streams = kinect::STREAM_FLAG_BODY_INDEX;
+			if( shell.hasOption( "-synthetic" ) ) {
+				g_synthetic.reset( new kinect::SyntheticFrameSource(
+					kinect::PIXEL_FORMAT_BODY_INDEX8, g_frameWidth, g_frameHeight, true ) );
+				g_source = g_synthetic.get();
+			}
+			else if( shell.hasOption( "-replay" ) ) {
+				g_replay.reset( new kinect::RecordingReader( g_recordingPath ) );
+				g_source = g_replay.get();
 			}
 			else {
-				DispatchMessage( &msg );
+				// "-stats" takes the depth of the bodies from the frames of the same time.
+				if( shell.hasOption( "-stats" ) ) streams |= kinect::STREAM_FLAG_DEPTH;
+				g_sensor.open( streams );
+				sources = g_sensor.sources();
+				g_source = sources.bodyIndex_;
 			}
-		}
+			sources.bodyIndex_ = g_source;
+			g_pipeline.reset( new kinect::FramePipeline( sources, streams ) );
+
+			// "-stats" logs the pixel count, box and centroids of each body.
+			if( shell.hasOption( "-stats" ) ) {
+				g_statsLog.reset( new std::ofstream( g_statsPath ) );
+			}
+		} );
+
+		// "-record" saves every frame to the recording.
+		const kinect::TaskGraph::TaskId recorder = startup.add( "recorder", [&shell]() {
+			if( shell.hasOption( "-record" ) ) {
+				g_recorder.reset( new kinect::RecordingWriter(
+					g_recordingPath, kinect::PIXEL_FORMAT_BODY_INDEX8, g_frameWidth, g_frameHeight ) );
+			}
+		} );
+
+		shell.addDeviceSteps( { "def.vs.cso", "def.ps.cso" },
+			[]( HWND hWnd ) { g_d3d.initDevice( hWnd ); },
+			[]( kinect::AssetLoader& assets ) { g_d3d.initResources( assets ); } );
+
+		startup.add( "acquisition", [&shell]() {
+			shell.startAcquisition( g_acquisition, *g_source, Acquire );
+		}, { sensor, recorder } );
+		shell.runStartup();
 
+		shell.run( Step, Draw, g_tracePath );
+		g_recorder.reset();
+		g_statsLog.reset();
 		g_d3d.release();
-		g_kinect.release();
+		g_pipeline.reset();
+		g_sensor.close();
 	}
 	catch( std::exception &e ) {
-		MessageBoxA( g_hWnd, e.what(), nullptr, MB_ICONSTOP );
+		MessageBoxA( shell.window(), e.what(), nullptr, MB_ICONSTOP );
 	}
 
 	return 0;
@@ -0,0 +1,366 @@
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/BodyIndexCodec.h"
+#include "../KinectV2TestCommon/BodyStats.h"
+#include "../KinectV2TestCommon/ColorConvert.h"
+#include "../KinectV2TestCommon/Colorize.h"
+#include "../KinectV2TestCommon/DepthCodec.h"
+#include "../KinectV2TestCommon/DepthProcessor.h"
+#include "../KinectV2TestCommon/Recording.h"
+#include "../KinectV2TestCommon/SkeletonProcessor.h"
+#include "../KinectV2TestCommon/SkeletonRecording.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double elapsedSeconds( Clock::time_point start )
+	{
+		return std::chrono::duration< double >( Clock::now() - start ).count();
+	}
+
+	struct Options
+	{
+		Options() : depthFlags( 0 ), smooth( false ), colorize( false ), colormap( kinect::COLORMAP_GRAY ),
+			encode( false ), threadCount( 0 ), outputPath( nullptr ), statsPath( nullptr ) {}
+
+		unsigned int depthFlags;		// DepthProcessingFlags
+		bool smooth;
+		bool colorize;
+		kinect::Colormap colormap;
+		bool encode;
+		unsigned int threadCount;
+		const char* outputPath;
+		const char* statsPath;
+		std::vector< const char* > inputs;
+	};
+
+	const char* formatName( kinect::PixelFormat format )
+	{
+		switch( format )
+		{
+		case kinect::PIXEL_FORMAT_DEPTH16: return "depth";
+		case kinect::PIXEL_FORMAT_BODY_INDEX8: return "body index";
+		case kinect::PIXEL_FORMAT_RGBA8: return "RGBA";
+		case kinect::PIXEL_FORMAT_YUY2: return "YUY2";
+		}
+		return "unknown";
+	}
+
+	kinect::Colormap parseColormap( const char* name )
+	{
+		if( strcmp( name, "gray" ) == 0 ) return kinect::COLORMAP_GRAY;
+		if( strcmp( name, "turbo" ) == 0 ) return kinect::COLORMAP_TURBO;
+		if( strcmp( name, "viridis" ) == 0 ) return kinect::COLORMAP_VIRIDIS;
+		throw std::invalid_argument( std::string( "Unknown colormap : " ) + name );
+	}
+
+	//! True if the file starts as a skeleton recording, "KV2SKL".
+	bool isSkeletonRecording( const char* path )
+	{
+		char magic[ 6 ] = {};
+		std::ifstream ifs( path, std::ios::binary );
+		ifs.read( magic, sizeof magic );
+		return memcmp( magic, "KV2SKL", sizeof magic ) == 0;
+	}
+
+	//! Writer of the processed frames with "-o", else null.
+	std::unique_ptr< kinect::RecordingWriter > createOutput( const Options& options, kinect::PixelFormat format,
+		unsigned int width, unsigned int height )
+	{
+		std::unique_ptr< kinect::RecordingWriter > writer;
+		if( options.outputPath )
+		{
+			writer.reset( new kinect::RecordingWriter( options.outputPath, format, width, height ) );
+		}
+		return writer;
+	}
+
+	kinect::FrameView rgbaView( const std::vector< unsigned char >& rgba, unsigned int width, unsigned int height, int64_t relativeTime )
+	{
+		const kinect::FrameView view = { rgba.data(), width, height, 4, kinect::PIXEL_FORMAT_RGBA8, relativeTime };
+		return view;
+	}
+
+	void printRate( const char* path, const kinect::RecordingHeader& header, std::size_t frames, double seconds )
+	{
+		printf( "%s : %u frames of %s %ux%u in %.3f s, %.1f fps\n", path, static_cast< unsigned int >( frames ),
+			formatName( static_cast< kinect::PixelFormat >( header.format ) ), header.width, header.height, seconds, frames / seconds );
+	}
+
+	//! Depth frames through the chain of KinectV2TestDepth, every frame as the render loop
+	//! would show it, then colorized or coded if asked.
+	void processDepth( const char* path, kinect::RecordingReader& reader, const Options& options )
+	{
+		const unsigned int width = reader.header().width;
+		const unsigned int height = reader.header().height;
+		kinect::DepthProcessor processor( width, height, options.depthFlags, options.threadCount );
+		const kinect::DepthColorizer colorizer( options.colormap );
+		std::unique_ptr< kinect::RecordingWriter > output = createOutput( options,
+			options.colorize ? kinect::PIXEL_FORMAT_RGBA8 : kinect::PIXEL_FORMAT_DEPTH16, width, height );
+
+		std::vector< uint16_t > depth( static_cast< std::size_t >( width ) * height );
+		std::vector< unsigned char > rgba( options.colorize ? depth.size() * 4 : 0 );
+		std::vector< unsigned char > encoded( options.encode ? kinect::depthCodecMaxEncodedSize( width, height ) : 0 );
+		uint64_t encodedBytes = 0;
+		double encodeSeconds = 0;
+
+		const auto start = Clock::now();
+		for( std::size_t i = 0; i < reader.frameCount(); ++i )
+		{
+			// The recording is mapped read-only, the temporal filter works in place.
+			kinect::FrameView frame = reader.frame( i );
+			memcpy( depth.data(), frame.data, frame.size() );
+			processor.denoise( depth.data() );
+			frame.data = reinterpret_cast< const unsigned char* >( depth.data() );
+			const kinect::FrameView view = processor.process( frame );
+
+			if( options.encode )
+			{
+				const auto encodeStart = Clock::now();
+				encodedBytes += kinect::encodeDepth( reinterpret_cast< const uint16_t* >( view.data ), width, height,
+					encoded.data(), encoded.size() );
+				encodeSeconds += elapsedSeconds( encodeStart );
+			}
+			if( options.colorize )
+			{
+				colorizer.colorize( reinterpret_cast< const uint16_t* >( view.data ), width, height, rgba.data(), width * 4 );
+				if( output ) output->write( rgbaView( rgba, width, height, view.relativeTime ) );
+			}
+			else if( output )
+			{
+				output->write( view );
+			}
+		}
+		printRate( path, reader.header(), reader.frameCount(), elapsedSeconds( start ) );
+
+		if( options.depthFlags != 0 )
+		{
+			printf( "%s\n", processor.summary().c_str() );
+		}
+		if( options.encode && encodedBytes > 0 )
+		{
+			const double rawBytes = static_cast< double >( reader.frameCount() ) * depth.size() * sizeof( uint16_t );
+			printf( "Depth codec : ratio %.2f, %.1f MB/s\n", rawBytes / encodedBytes, rawBytes / encodeSeconds / 1e6 );
+		}
+	}
+
+	//! Statistics of each body index frame, or the colors of KinectV2TestBodyIndex.
+	void processBodyIndex( const char* path, kinect::RecordingReader& reader, const Options& options )
+	{
+		const unsigned int width = reader.header().width;
+		const unsigned int height = reader.header().height;
+		std::unique_ptr< kinect::RecordingWriter > output = createOutput( options,
+			options.colorize ? kinect::PIXEL_FORMAT_RGBA8 : kinect::PIXEL_FORMAT_BODY_INDEX8, width, height );
+		std::unique_ptr< std::ofstream > statsLog;
+		if( options.statsPath )
+		{
+			statsLog.reset( new std::ofstream( options.statsPath ) );
+			if( !*statsLog ) throw std::runtime_error( std::string( "Cannot create file : " ) + options.statsPath );
+		}
+
+		const std::size_t pixelCount = static_cast< std::size_t >( width ) * height;
+		std::vector< unsigned char > encoded( options.encode || options.colorize ? kinect::bodyIndexCodecMaxEncodedSize( width, height ) : 0 );
+		std::vector< unsigned char > rgba( options.colorize ? pixelCount * 4 : 0 );
+		uint64_t encodedBytes = 0;
+
+		const auto start = Clock::now();
+		for( std::size_t i = 0; i < reader.frameCount(); ++i )
+		{
+			const kinect::FrameView frame = reader.frame( i );
+			if( statsLog )
+			{
+				kinect::BodyIndexStats stats;
+				kinect::computeBodyIndexStats( frame.data, nullptr, width, height, frame.relativeTime, stats );
+				*statsLog << kinect::formatBodyIndexStats( stats ) << '\n';
+			}
+			if( !encoded.empty() )
+			{
+				const std::size_t size = kinect::encodeBodyIndex( frame.data, width, height, encoded.data(), encoded.size() );
+				encodedBytes += size;
+
+				// Mostly runs of no body, so rendering the code is faster than a lookup per pixel.
+				if( options.colorize )
+				{
+					kinect::renderBodyIndex( encoded.data(), size, rgba.data(), width * 4, width, height );
+					if( output ) output->write( rgbaView( rgba, width, height, frame.relativeTime ) );
+				}
+			}
+			if( output && !options.colorize )
+			{
+				output->write( frame );
+			}
+		}
+		printRate( path, reader.header(), reader.frameCount(), elapsedSeconds( start ) );
+
+		if( options.encode && encodedBytes > 0 )
+		{
+			printf( "Body index codec : ratio %.1f\n", static_cast< double >( reader.frameCount() ) * pixelCount / encodedBytes );
+		}
+		if( statsLog )
+		{
+			statsLog->close();
+			if( !*statsLog ) throw std::runtime_error( std::string( "Cannot write file : " ) + options.statsPath );
+		}
+	}
+
+	//! YUY2 frames to RGBA, as the acquisition thread of KinectV2TestColor does.
+	void processColor( const char* path, kinect::RecordingReader& reader, const Options& options )
+	{
+		const unsigned int width = reader.header().width;
+		const unsigned int height = reader.header().height;
+		std::unique_ptr< kinect::RecordingWriter > output = createOutput( options, kinect::PIXEL_FORMAT_RGBA8, width, height );
+		std::vector< unsigned char > rgba( static_cast< std::size_t >( width ) * height * 4 );
+
+		const auto start = Clock::now();
+		for( std::size_t i = 0; i < reader.frameCount(); ++i )
+		{
+			const kinect::FrameView frame = reader.frame( i );
+			kinect::convertYuy2ToRgba( frame.data, width, height, rgba.data(), width * 4 );
+			if( output ) output->write( rgbaView( rgba, width, height, frame.relativeTime ) );
+		}
+		printRate( path, reader.header(), reader.frameCount(), elapsedSeconds( start ) );
+	}
+
+	//! Body frames through the skeleton processing of KinectV2TestBody.
+	void processSkeleton( const char* path, const Options& options )
+	{
+		if( options.outputPath )
+		{
+			throw std::invalid_argument( "-o is not supported for skeleton recordings" );
+		}
+
+		kinect::SkeletonRecordingReader reader( path );
+		kinect::SkeletonProcessor processor( options.smooth, options.threadCount );
+		kinect::BodyFrame frame;
+		std::size_t bones = 0;
+
+		const auto start = Clock::now();
+		while( reader.read( frame ) )
+		{
+			processor.update( frame );
+			bones += processor.boneCount();
+		}
+		const double seconds = elapsedSeconds( start );
+		printf( "%s : %u body frames in %.3f s, %.1f fps, %.1f bones per frame\n", path,
+			static_cast< unsigned int >( reader.frameCount() ), seconds, reader.frameCount() / seconds,
+			reader.frameCount() ? static_cast< double >( bones ) / reader.frameCount() : 0.0 );
+		printf( "%s\n", processor.summary().c_str() );
+	}
+
+	void processRecording( const char* path, const Options& options )
+	{
+		if( isSkeletonRecording( path ) )
+		{
+			processSkeleton( path, options );
+			return;
+		}
+
+		kinect::RecordingReader reader( path );
+		switch( reader.header().format )
+		{
+		case kinect::PIXEL_FORMAT_DEPTH16:
+			processDepth( path, reader, options );
+			break;
+		case kinect::PIXEL_FORMAT_BODY_INDEX8:
+			processBodyIndex( path, reader, options );
+			break;
+		case kinect::PIXEL_FORMAT_YUY2:
+			processColor( path, reader, options );
+			break;
+		default:
+			throw std::runtime_error( std::string( "Nothing to do for the frames of " ) + path );
+		}
+	}
+
+	const char* argument( int argc, char* argv[], int& i )
+	{
+		if( i + 1 >= argc )
+		{
+			throw std::invalid_argument( std::string( "Missing value of " ) + argv[ i ] );
+		}
+		return argv[ ++i ];
+	}
+
+	void printUsage()
+	{
+		printf(
+			"Usage : KinectV2TestCli [options] recording...\n"
+			"        KinectV2TestCli -pack archive directory name...\n"
+			"  -denoise           depth : median of the last frames\n"
+			"  -smooth            depth : edge-preserving smoothing, bodies : joint smoothing\n"
+			"  -pointcloud        depth : camera space points\n"
+			"  -colorize map      depth : RGBA through gray, turbo or viridis, body index : body colors\n"
+			"  -encode            depth, body index : compression ratio of the codec\n"
+			"  -stats log         body index : statistics of the bodies, one line per frame\n"
+			"  -threads n         threads of smoothing, points and gestures, 0 for all (default)\n"
+			"  -o recording       write the processed frames, with one input recording\n" );
+	}
+}
+
+//! Headless processing of recordings as fast as the machine goes, with the same code as the apps,
+//! for machines without the sensor or a GPU. Recordings are processed one after another, each
+//! frame in order. "-pack" writes the asset archive the apps mount.
+int main( int argc, char* argv[] )
+{
+	try {
+		if( argc >= 4 && strcmp( argv[ 1 ], "-pack" ) == 0 ) {
+			const std::vector< std::string > names( argv + 4, argv + argc );
+			kinect::writeAssetArchive( argv[ 2 ], argv[ 3 ], names );
+			printf( "%s : %u assets\n", argv[ 2 ], static_cast< unsigned int >( names.size() ) );
+			return 0;
+		}
+
+		Options options;
+		for( int i = 1; i < argc; ++i )
+		{
+			const char* arg = argv[ i ];
+			if( strcmp( arg, "-denoise" ) == 0 ) options.depthFlags |= kinect::DEPTH_DENOISE;
+			else if( strcmp( arg, "-smooth" ) == 0 ) {
+				options.depthFlags |= kinect::DEPTH_SMOOTH;
+				options.smooth = true;
+			}
+			else if( strcmp( arg, "-pointcloud" ) == 0 ) options.depthFlags |= kinect::DEPTH_POINT_CLOUD;
+			else if( strcmp( arg, "-colorize" ) == 0 ) {
+				options.colorize = true;
+				options.colormap = parseColormap( argument( argc, argv, i ) );
+			}
+			else if( strcmp( arg, "-encode" ) == 0 ) options.encode = true;
+			else if( strcmp( arg, "-stats" ) == 0 ) options.statsPath = argument( argc, argv, i );
+			else if( strcmp( arg, "-threads" ) == 0 ) options.threadCount = static_cast< unsigned int >( atoi( argument( argc, argv, i ) ) );
+			else if( strcmp( arg, "-o" ) == 0 ) options.outputPath = argument( argc, argv, i );
+			else if( arg[ 0 ] == '-' ) throw std::invalid_argument( std::string( "Unknown option : " ) + arg );
+			else options.inputs.push_back( arg );
+		}
+		if( options.inputs.empty() ) {
+			printUsage();
+			return 1;
+		}
+		if( options.outputPath && options.inputs.size() > 1 ) {
+			throw std::invalid_argument( "-o takes one input recording" );
+		}
+
+		for( const char* input : options.inputs )
+		{
+			processRecording( input, options );
+		}
+	}
+	catch( std::invalid_argument& e ) {
+		fprintf( stderr, "%s\n", e.what() );
+		printUsage();
+		return 1;
+	}
+	catch( std::exception& e ) {
+		fprintf( stderr, "%s\n", e.what() );
+		return 1;
+	}
+	return 0;
+}
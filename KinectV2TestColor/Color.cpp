@@ -1,25 +1,31 @@
 #include <Windows.h>
 #include <tchar.h>
-#include <Kinect.h>
 #include <d3d11.h>
-#include <fstream>
-#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <array>
 #include <memory>
-#include <filesystem>
 #include <exception>
+#include "../KinectV2TestCommon/AcquisitionThread.h"
+#include "../KinectV2TestCommon/AppShell.h"
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/ColorConvert.h"
+#include "../KinectV2TestCommon/KinectSensor.h"
+#include "../KinectV2TestCommon/SyntheticSource.h"
+#include "../KinectV2TestCommon/TaskGraph.h"
+#include "../KinectV2TestCommon/Trace.h"
 
-#pragma comment( lib, "kinect20.lib" )
 #pragma comment( lib, "d3d11.lib" )
 
 namespace
 {
 	const TCHAR* g_appName = _T( "Kinect Color" );
+	const char* g_tracePath = "color.trace.json";
 	const int g_windowWidth = 1280;
 	const int g_windowHeight = 720;
+	const unsigned int g_frameWidth = 1920;
+	const unsigned int g_frameHeight = 1080;
 }
 
 //! Custom deleter of std::unique_ptr for COM instance.
@@ -40,83 +46,10 @@ void Assert( HRESULT hr )
 	}
 }
 
-//! Read all binary data from file.
-std::string fileGetContents( const char* path )
-{
-	// Get directory name of exe file.
-	namespace sys = std::tr2::sys;
-	auto exeDir = sys::path( __argv[ 0 ] ).parent_path();
-
-	std::stringstream newPathSS;
-	newPathSS << exeDir << sys::slash< sys::path >::value << path;
-	auto newPath = newPathSS.str();
-
-	// Read and copy all.
-	std::ifstream ifs( newPath, std::ios::binary );
-	std::string str(
-		(std::istreambuf_iterator< char >( ifs )),
-		std::istreambuf_iterator< char >()
-		);
-
-	// Error occurs if file not found or empty file.
-	if( str.size() == 0 )
-	{
-		std::stringstream ss;
-		ss << "File not found : " << path;
-		throw std::runtime_error( ss.str() );
-	}
-	return str;
-}
-
-struct Kinect
-{
-	enum
-	{
-		MAX_COLOR_FRAME_WIDTH = 1920,
-		MAX_COLOR_FRAME_HEIGHT = 1080,
-		MAX_COLOR_FRAME_BYTE_PER_PIXEL = 4
-	};
-
-	void init()
-	{
-		HRESULT hr;
-
-		IKinectSensor* sensor;
-		hr = GetDefaultKinectSensor( &sensor );
-		Assert( hr );
-		sensor_.reset( sensor );
-
-		hr = sensor_->Open();
-		Assert( hr );
-
-		// Sensor -> Color Source
-		IColorFrameSource* colorSource;
-		hr = sensor_->get_ColorFrameSource( &colorSource );
-		Assert( hr );
-		colorSource_.reset( colorSource );
-
-		// Color Source -> Color Reader
-		IColorFrameReader* colorReader;
-		hr = colorSource_->OpenReader( &colorReader );
-		Assert( hr );
-		colorReader_.reset( colorReader );
-	}
-
-	void release()
-	{
-		sensor_->Close();
-	}
-
-	std::unique_ptr< IKinectSensor, Deleter > sensor_;
-	std::unique_ptr< IColorFrameSource, Deleter > colorSource_;
-	std::unique_ptr< IColorFrameReader, Deleter > colorReader_;
-
-	std::array< unsigned char, (MAX_COLOR_FRAME_WIDTH * MAX_COLOR_FRAME_HEIGHT * MAX_COLOR_FRAME_BYTE_PER_PIXEL) > colorFrameConverted_;
-};
-
 struct D3D
 {
-	void init( HWND hWnd )
+	//! Device and swap chain of the window.
+	void initDevice( HWND hWnd )
 	{
 		HRESULT hr;
 
@@ -160,6 +93,12 @@ struct D3D
 		Assert( hr );
 		backBufferRTV_.reset( backBufferRTV );
 		backBuffer->Release();
+	}
+
+	//! States, shaders and buffers, once the device is made and the shaders are loaded.
+	void initResources( kinect::AssetLoader& assets )
+	{
+		HRESULT hr;
 
 		// Common state
 
@@ -191,7 +130,7 @@ struct D3D
 		ID3D11Texture2D* tex;
 		D3D11_TEXTURE2D_DESC texDesc;
 		texDesc = CD3D11_TEXTURE2D_DESC(
-			DXGI_FORMAT_R8G8B8A8_UNORM, 1920, 1080, 1, 1,
+			DXGI_FORMAT_R8G8B8A8_UNORM, g_frameWidth, g_frameHeight, 1, 1,
 			D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
 		hr = device_->CreateTexture2D( &texDesc, nullptr, &tex );
 		Assert( hr );
@@ -207,18 +146,15 @@ struct D3D
 		Assert( hr );
 		colorFrameSRV_.reset( srv );
 
-		std::string binData;
 		ID3D11VertexShader* vs;
-		binData = fileGetContents( "def.vs.cso" );
-		hr = device_->CreateVertexShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &vs );
+		const kinect::AssetSpan vsBin = assets.load( "def.vs.cso" );
+		hr = device_->CreateVertexShader( vsBin.data, vsBin.size, nullptr, &vs );
 		Assert( hr );
 		fullscreenVS_.reset( vs );
 
 		ID3D11PixelShader* ps;
-		binData = fileGetContents( "def.ps.cso" );
-		hr = device_->CreatePixelShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &ps );
+		const kinect::AssetSpan psBin = assets.load( "def.ps.cso" );
+		hr = device_->CreatePixelShader( psBin.data, psBin.size, nullptr, &ps );
 		Assert( hr );
 		texPS_.reset( ps );
 	}
@@ -243,49 +179,59 @@ struct D3D
 
 namespace
 {
-	HWND g_hWnd = NULL;
-	Kinect g_kinect;
+	kinect::KinectSensor g_sensor;
 	D3D g_d3d;
+
+	//! Frame source of the acquisition thread, the sensor or the stand-in.
+	kinect::FrameSource* g_source = nullptr;
+	std::unique_ptr< kinect::SyntheticFrameSource > g_synthetic;
+	kinect::AcquisitionThread< kinect::FrameBuffer > g_acquisition;
+}
+
+//! Runs on the acquisition thread. The raw YUY2 frame is handed over as is, half the size
+//! of RGBA, and Step() converts it straight into the texture : one pass over the pixels
+//! instead of a conversion to a staging buffer and a copy of it.
+bool Acquire( kinect::FrameBuffer& buffer )
+{
+	return kinect::copyLatestFrame( *g_source, buffer );
 }
 
-void Step()
+//! Return whether a new frame was taken.
+bool Step()
 {
+	KINECT_TRACE_SCOPE( "Step" );
+
 	HRESULT hr;
 
-	IColorFrame* frame;
-	hr = g_kinect.colorReader_->AcquireLatestFrame( &frame );
-	if( hr == E_PENDING )
+	const kinect::FrameBuffer* frame = g_acquisition.latest();
+	if( !frame )
 	{
-		return;
+		return false;
 	}
-	Assert( hr );
 
-	hr = frame->CopyConvertedFrameDataToArray(
-		g_kinect.colorFrameConverted_.size(), g_kinect.colorFrameConverted_.data(), ColorImageFormat_Rgba );
-	Assert( hr );
-
-	// Copy pixels to Direct3D texture.
+	// Convert YUY2 pixels to RGBA, directly into Direct3D texture.
 	D3D11_MAPPED_SUBRESOURCE map;
-	D3D11_TEXTURE2D_DESC texDesc;
-	hr = g_d3d.context_->Map( g_d3d.colorFrameConverted_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	{
+		KINECT_TRACE_SCOPE( "Map" );
+		hr = g_d3d.context_->Map( g_d3d.colorFrameConverted_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	}
 	Assert( hr );
-	g_d3d.colorFrameConverted_->GetDesc( &texDesc );
-	for( unsigned int y = 0; y < texDesc.Height; ++y )
 	{
-		const int copySize = 1920 * 4;
-		auto* destStart = reinterpret_cast< unsigned char* >( map.pData ) + map.RowPitch * y;
-		const auto* srcStart = g_kinect.colorFrameConverted_.data() + y * copySize;
-		const auto* srcEnd = srcStart + copySize;
-		const auto dest = stdext::make_checked_array_iterator( destStart, copySize );
-		std::copy( srcStart, srcEnd, dest );
+		KINECT_TRACE_SCOPE( "ConvertYuy2" );
+		kinect::convertYuy2ToRgba( frame->view_.data, frame->view_.width, frame->view_.height,
+			reinterpret_cast< unsigned char* >( map.pData ), map.RowPitch );
 	}
-	g_d3d.context_->Unmap( g_d3d.colorFrameConverted_.get(), 0 );
-
-	frame->Release();
+	{
+		KINECT_TRACE_SCOPE( "Unmap" );
+		g_d3d.context_->Unmap( g_d3d.colorFrameConverted_.get(), 0 );
+	}
+	return true;
 }
 
 void Draw()
 {
+	KINECT_TRACE_SCOPE( "Draw" );
+
 	ID3D11DeviceContext* context = g_d3d.context_.get();
 	
 	// Clear
@@ -308,65 +254,47 @@ void Draw()
 	context->RSSetViewports( 1, &viewport );
 	context->Draw( 4, 0 );
 
-	g_d3d.swapChain_->Present( 1, 0 );
+	{
+		KINECT_TRACE_SCOPE( "Present" );
+		g_d3d.swapChain_->Present( 1, 0 );
+	}
 }
 
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
-	nCmdShow; lpCmdLine; hPrevInstance;
-
-	WNDCLASS wcls;
-	memset( &wcls, 0, sizeof wcls );
-	wcls.style = CS_HREDRAW | CS_VREDRAW;
-	wcls.lpfnWndProc = []( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam ) -> LRESULT {
-		switch( message ) {
-		case WM_KEYDOWN:
-			if( wParam == VK_ESCAPE ) {
-				PostMessage( hWnd, WM_DESTROY, 0, 0 );
-				return 0;
-			}
-			break;
-		case WM_DESTROY:
-			PostQuitMessage( 0 );
-			break;
-		}
-		return DefWindowProc( hWnd, message, wParam, lParam );
-	};
-	wcls.hInstance = hInstance;
-	wcls.lpszClassName = g_appName;
-	RegisterClass( &wcls );
-
-	RECT rect = { 0, 0, g_windowWidth, g_windowHeight };
-	AdjustWindowRect( &rect, WS_OVERLAPPEDWINDOW, FALSE );
-
-	const int windowWidth  = ( rect.right  - rect.left );
-	const int windowHeight = ( rect.bottom - rect.top );
-	g_hWnd = CreateWindow( g_appName, g_appName, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, windowWidth, windowHeight, NULL, NULL, hInstance, NULL );
-
-	ShowWindow( g_hWnd, SW_SHOW );
+	nCmdShow; hPrevInstance;
+	kinect::AppShell shell( hInstance, g_appName, g_windowWidth, g_windowHeight, lpCmdLine );
 
 	try {
-		g_kinect.init();
-		g_d3d.init( g_hWnd );
-
-		MSG msg;
-		memset( &msg, 0, sizeof msg );
-		while( msg.message != WM_QUIT ) {
-			BOOL r = PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE );
-			if( r == 0 ) {
-				Step();
-				Draw();
+		kinect::TaskGraph& startup = shell.startup();
+		const kinect::TaskGraph::TaskId sensor = startup.add( "sensor", [&shell]() {
+			// "-synthetic" runs without the sensor.
+			if( shell.hasOption( "-synthetic" ) ) {
+				g_synthetic.reset( new kinect::SyntheticFrameSource(
+					kinect::PIXEL_FORMAT_YUY2, g_frameWidth, g_frameHeight, true ) );
+				g_source = g_synthetic.get();
 			}
 			else {
-				DispatchMessage( &msg );
+				g_sensor.open( kinect::STREAM_FLAG_COLOR );
+				g_source = g_sensor.sources().color_;
 			}
-		}
+		} );
+
+		shell.addDeviceSteps( { "def.vs.cso", "def.ps.cso" },
+			[]( HWND hWnd ) { g_d3d.initDevice( hWnd ); },
+			[]( kinect::AssetLoader& assets ) { g_d3d.initResources( assets ); } );
+
+		startup.add( "acquisition", [&shell]() {
+			shell.startAcquisition( g_acquisition, *g_source, Acquire );
+		}, { sensor } );
+		shell.runStartup();
 
+		shell.run( Step, Draw, g_tracePath );
 		g_d3d.release();
-		g_kinect.release();
+		g_sensor.close();
 	}
 	catch( std::exception &e ) {
-		MessageBoxA( g_hWnd, e.what(), nullptr, MB_ICONSTOP );
+		MessageBoxA( shell.window(), e.what(), nullptr, MB_ICONSTOP );
 	}
 
 	return 0;
@@ -0,0 +1,58 @@
+#include "AcquisitionThread.h"
+#include "ColorConvert.h"
+#include <cstring>
+
+namespace kinect
+{
+	unsigned char* FrameBuffer::assign( PixelFormat format, unsigned int width, unsigned int height, int64_t relativeTime )
+	{
+		view_.width = width;
+		view_.height = height;
+		view_.bytesPerPixel = bytesPerPixel( format );
+		view_.format = format;
+		view_.relativeTime = relativeTime;
+		pixels_.resize( view_.size() );
+		view_.data = pixels_.data();
+		return pixels_.data();
+	}
+
+	bool copyLatestFrame( FrameSource& source, FrameBuffer& buffer )
+	{
+		FrameView frame;
+		if( !source.acquireLatestFrame( frame ) )
+		{
+			return false;
+		}
+		{
+			KINECT_TRACE_SCOPE( "CopyFrame" );
+			unsigned char* dst = buffer.assign( frame.format, frame.width, frame.height, frame.relativeTime );
+			memcpy( dst, frame.data, frame.size() );
+		}
+		source.releaseFrame();
+		return true;
+	}
+
+	bool convertLatestFrame( FrameSource& source, FrameBuffer& buffer )
+	{
+		FrameView frame;
+		if( !source.acquireLatestFrame( frame ) )
+		{
+			return false;
+		}
+		if( frame.format == PIXEL_FORMAT_YUY2 )
+		{
+			KINECT_TRACE_SCOPE( "ConvertYuy2" );
+			unsigned char* dst = buffer.assign( PIXEL_FORMAT_RGBA8, frame.width, frame.height, frame.relativeTime );
+			convertYuy2ToRgba( frame.data, frame.width, frame.height, dst, buffer.view_.rowSize() );
+		}
+		else
+		{
+			KINECT_TRACE_SCOPE( "CopyFrame" );
+			unsigned char* dst = buffer.assign( frame.format, frame.width, frame.height, frame.relativeTime );
+			memcpy( dst, frame.data, frame.size() );
+		}
+		source.releaseFrame();
+		return true;
+	}
+
+} // namespace kinect
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "FrameScheduler.h"
+#include "FrameSource.h"
+#include "Trace.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace kinect
+{
+	//! Copy of an image frame, owned by a slot of the acquisition thread.
+	struct FrameBuffer
+	{
+		FrameBuffer() { view_.data = nullptr; }
+
+		//! Resize pixels_ for the frame and point view_ at them. Return the pixel storage.
+		unsigned char* assign( PixelFormat format, unsigned int width, unsigned int height, int64_t relativeTime );
+
+		std::vector< unsigned char > pixels_;
+		FrameView view_;		// data points into pixels_
+	};
+
+	//! Copy the newest frame of source into buffer and release it.
+	//! Return false if no new frame has arrived yet.
+	bool copyLatestFrame( FrameSource& source, FrameBuffer& buffer );
+
+	//! Same as copyLatestFrame, but YUY2 frames are converted to RGBA for a texture.
+	bool convertLatestFrame( FrameSource& source, FrameBuffer& buffer );
+
+	//! Runs the acquisition of a stream on its own thread.
+	//! The producer function fills a slot and returns true when it got a new frame.
+	//! scheduler() decides when it is called. The render loop calls latest() and always
+	//! gets the newest complete frame, without blocking the producer.
+	template< class T >
+	class AcquisitionThread
+	{
+	public:
+		typedef std::function< bool( T& ) > Producer;
+		typedef std::function< void() > Notify;
+
+		AcquisitionThread() : running_( false ), failed_( false ), produced_( 0 ) {}
+		~AcquisitionThread() { stop(); }
+
+		//! notify is called on the acquisition thread after each frame is published, and once
+		//! more if the producer throws, so that a consumer waiting on it calls latest().
+		void start( Producer producer, Notify notify = Notify() )
+		{
+			stop();
+			producer_ = producer;
+			notify_ = notify;
+			failed_ = false;
+			running_ = true;
+			thread_ = std::thread( [this]() { run(); } );
+		}
+
+		//! Wait for the thread to finish. The producer is not called after this returns.
+		void stop()
+		{
+			running_ = false;
+			if( thread_.joinable() )
+			{
+				thread_.join();
+			}
+		}
+
+		//! Consumer : newest frame published since the last call, or nullptr if none.
+		//! Rethrow the exception the producer failed with, if any.
+		//! The frame stays valid until the next call.
+		const T* latest()
+		{
+			if( failed_.load( std::memory_order_acquire ) )
+			{
+				failed_ = false;
+				std::rethrow_exception( error_ );
+			}
+			return buffer_.update() ? &buffer_.readBuffer() : nullptr;
+		}
+
+		//! Number of frames published so far.
+		uint64_t producedCount() const { return produced_.load( std::memory_order_relaxed ); }
+
+		//! Set up before start(), read after stop().
+		FrameScheduler& scheduler() { return scheduler_; }
+
+	private:
+		AcquisitionThread( const AcquisitionThread& ) = delete;
+		AcquisitionThread& operator=( const AcquisitionThread& ) = delete;
+
+		void run()
+		{
+			KINECT_TRACE_THREAD( "acquisition" );
+			try {
+				while( running_.load( std::memory_order_relaxed ) )
+				{
+					scheduler_.wait();
+					const bool produced = producer_( buffer_.writeBuffer() );
+					if( produced )
+					{
+						buffer_.publish();
+						produced_.fetch_add( 1, std::memory_order_relaxed );
+						if( notify_ ) notify_();
+					}
+					scheduler_.polled( produced );
+				}
+			}
+			catch( ... ) {
+				error_ = std::current_exception();
+				failed_.store( true, std::memory_order_release );
+				if( notify_ ) notify_();
+			}
+		}
+
+		Producer producer_;
+		Notify notify_;
+		FrameScheduler scheduler_;
+		TripleBuffer< T > buffer_;
+		std::atomic< bool > running_;
+		std::atomic< bool > failed_;
+		std::atomic< uint64_t > produced_;
+		std::exception_ptr error_;
+		std::thread thread_;
+	};
+
+} // namespace kinect
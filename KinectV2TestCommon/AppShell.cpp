@@ -0,0 +1,147 @@
+#include "AppShell.h"
+#include "Trace.h"
+
+#ifdef _WIN32
+
+#include <cstring>
+#include <sstream>
+
+namespace kinect
+{
+	AppShell::AppShell( HINSTANCE instance, const TCHAR* name, int width, int height, const char* commandLine )
+		: startTime_( std::chrono::steady_clock::now() ), commandLine_( commandLine ), window_( NULL ),
+		frameEvent_( CreateEvent( nullptr, FALSE, FALSE, nullptr ) )
+	{
+		KINECT_TRACE_THREAD( "render" );
+
+		WNDCLASS wcls;
+		memset( &wcls, 0, sizeof wcls );
+		wcls.style = CS_HREDRAW | CS_VREDRAW;
+		wcls.lpfnWndProc = windowProc;
+		wcls.hInstance = instance;
+		wcls.lpszClassName = name;
+		RegisterClass( &wcls );
+
+		RECT rect = { 0, 0, width, height };
+		AdjustWindowRect( &rect, WS_OVERLAPPEDWINDOW, FALSE );
+
+		const int windowWidth  = ( rect.right  - rect.left );
+		const int windowHeight = ( rect.bottom - rect.top );
+		window_ = CreateWindow( name, name, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, windowWidth, windowHeight, NULL, NULL, instance, NULL );
+
+		SetWindowLongPtr( window_, GWLP_USERDATA, reinterpret_cast< LONG_PTR >( this ) );
+
+		ShowWindow( window_, SW_SHOW );
+	}
+
+	AppShell::~AppShell()
+	{
+		// The acquisition thread sets the frame event until it stops.
+		if( stopAcquisition_ ) {
+			stopAcquisition_();
+		}
+		CloseHandle( frameEvent_ );
+	}
+
+	LRESULT CALLBACK AppShell::windowProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
+	{
+		switch( message ) {
+		case WM_KEYDOWN:
+			if( wParam == VK_ESCAPE ) {
+				PostMessage( hWnd, WM_DESTROY, 0, 0 );
+				return 0;
+			}
+			{
+				const AppShell* shell = reinterpret_cast< const AppShell* >( GetWindowLongPtr( hWnd, GWLP_USERDATA ) );
+				if( shell && shell->keyHandler_ && shell->keyHandler_( wParam ) ) {
+					return 0;
+				}
+			}
+			break;
+		case WM_DESTROY:
+			PostQuitMessage( 0 );
+			break;
+		}
+		return DefWindowProc( hWnd, message, wParam, lParam );
+	}
+
+	bool AppShell::hasOption( const char* option ) const
+	{
+		return strstr( commandLine_.c_str(), option ) != nullptr;
+	}
+
+	TaskGraph::TaskId AppShell::addDeviceSteps( const std::vector< std::string >& shaders,
+		std::function< void( HWND ) > initDevice, std::function< void( AssetLoader& ) > initResources )
+	{
+		const TaskGraph::TaskId assets = startup_.add( "assets", [this, shaders]() {
+			assets_.mountArchive( "assets.kv2pak" );
+			for( const std::string& shader : shaders ) {
+				assets_.load( shader );
+			}
+		} );
+
+		// DXGI sends messages to the window, so the swap chain is made on the thread of the window.
+		HWND window = window_;
+		const TaskGraph::TaskId device = startup_.add( "device", [initDevice, window]() {
+			initDevice( window );
+		}, {}, TaskGraph::TASK_MAIN_THREAD );
+		return startup_.add( "resources", [this, initResources]() {
+			initResources( assets_ );
+		}, { device, assets } );
+	}
+
+	void AppShell::runStartup()
+	{
+		startup_.run();
+		OutputDebugStringA( ( "Startup :\n" + startup_.summary() + "\n" ).c_str() );
+	}
+
+	void AppShell::run( std::function< bool() > step, std::function< void() > draw, const char* tracePath )
+	{
+		// "-trace" logs the stage times every few seconds and saves them at exit.
+		const bool traceEnabled = hasOption( "-trace" );
+		auto traceReported = std::chrono::steady_clock::now();
+		bool firstFrameLogged = false;
+
+		MSG msg;
+		memset( &msg, 0, sizeof msg );
+		while( msg.message != WM_QUIT ) {
+			BOOL r = PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE );
+			if( r == 0 ) {
+				// Sleep until a frame is published or a message is posted.
+				MsgWaitForMultipleObjects( 1, &frameEvent_, FALSE, INFINITE, QS_ALLINPUT );
+				if( step() && !firstFrameLogged ) {
+					// Cold start, until the first frame reaches the render loop.
+					firstFrameLogged = true;
+					std::stringstream ss;
+					ss << "First frame : " << std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime_ ).count()
+						<< " [ms] after start\n";
+					OutputDebugStringA( ss.str().c_str() );
+				}
+				draw();
+
+				// Stage times of the last second, every 5 [s].
+				if( traceEnabled && std::chrono::steady_clock::now() - traceReported > std::chrono::seconds( 5 ) ) {
+					traceReported = std::chrono::steady_clock::now();
+					OutputDebugStringA( ( "Stages :\n" + traceSummary( 1000 ) ).c_str() );
+				}
+			}
+			else {
+				DispatchMessage( &msg );
+			}
+		}
+
+		if( stopAcquisition_ ) {
+			stopAcquisition_();
+		}
+		if( traceEnabled ) {
+			writeChromeTrace( tracePath );
+		}
+		if( acquisitionSummary_ ) {
+			OutputDebugStringA( ( "Acquisition : " + acquisitionSummary_() + "\n" ).c_str() );
+		}
+	}
+
+} // namespace kinect
+
+#endif
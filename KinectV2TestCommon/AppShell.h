@@ -0,0 +1,96 @@
+#pragma once
+
+// Win32 window and message loop, Windows only.
+#ifdef _WIN32
+
+#include "AcquisitionThread.h"
+#include "AssetLoader.h"
+#include "TaskGraph.h"
+#include <Windows.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	//! What the apps share around their Direct3D code : the window, the startup steps, the
+	//! acquisition thread start, the render loop woken by each frame and the "-trace" reports.
+	//!
+	//! Startup steps run as soon as the ones they need are done : the sensor opens while the
+	//! device is made and the shaders are read. Each app adds its own steps to startup().
+	class AppShell
+	{
+	public:
+		//! Show a window named name with a client area of width x height.
+		//! The time to the first frame counts from here. Stops the acquisition when destroyed.
+		AppShell( HINSTANCE instance, const TCHAR* name, int width, int height, const char* commandLine );
+		~AppShell();
+
+		HWND window() const { return window_; }
+
+		//! Whether the command line has option, like "-synthetic".
+		bool hasOption( const char* option ) const;
+
+		//! handler is called with the virtual key of each key pressed but Escape, which closes
+		//! the window, and returns whether it used the key.
+		void setKeyHandler( std::function< bool( WPARAM ) > handler ) { keyHandler_ = handler; }
+
+		//! Shaders, from assets.kv2pak next to the exe if there is one, else the loose files.
+		AssetLoader& assets() { return assets_; }
+
+		TaskGraph& startup() { return startup_; }
+
+		//! Add the steps "assets" reading shaders, "device" calling initDevice with the window,
+		//! and "resources" calling initResources with assets() once both are done.
+		//! Return "resources".
+		TaskGraph::TaskId addDeviceSteps( const std::vector< std::string >& shaders,
+			std::function< void( HWND ) > initDevice, std::function< void( AssetLoader& ) > initResources );
+
+		//! Start acquisition, waiting for the frames of source if it can, and wake the render
+		//! loop each time a frame is published. Call from a startup step, once source is open.
+		//! acquisition must outlive the shell, which stops it.
+		template< class T, class Source >
+		void startAcquisition( AcquisitionThread< T >& acquisition, Source& source, typename AcquisitionThread< T >::Producer producer )
+		{
+			if( source.canWaitFrameArrived() ) {
+				Source* waited = &source;
+				acquisition.scheduler().setArrivalWait( [waited]( unsigned int timeoutMs ) {
+					return waited->waitFrameArrived( timeoutMs );
+				} );
+			}
+			HANDLE frameEvent = frameEvent_;
+			acquisition.start( producer, [frameEvent]() { SetEvent( frameEvent ); } );
+			stopAcquisition_ = [&acquisition]() { acquisition.stop(); };
+			acquisitionSummary_ = [&acquisition]() { return acquisition.scheduler().summary(); };
+		}
+
+		//! Run the startup steps and log their timeline. Rethrow what a step threw.
+		void runStartup();
+
+		//! Call step and draw each time a frame is published or a message is handled, until
+		//! the window closes. step returns whether it took a new frame. Then stop the
+		//! acquisition and log its pacing. With "-trace", log the stage times every 5 [s] and
+		//! save them to tracePath at the end.
+		void run( std::function< bool() > step, std::function< void() > draw, const char* tracePath );
+
+	private:
+		AppShell( const AppShell& ) = delete;
+		AppShell& operator=( const AppShell& ) = delete;
+
+		static LRESULT CALLBACK windowProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam );
+
+		std::chrono::steady_clock::time_point startTime_;
+		std::string commandLine_;
+		HWND window_;
+		HANDLE frameEvent_;		// set when the acquisition thread publishes a frame
+		std::function< bool( WPARAM ) > keyHandler_;
+		AssetLoader assets_;
+		TaskGraph startup_;
+		std::function< void() > stopAcquisition_;
+		std::function< std::string() > acquisitionSummary_;
+	};
+
+} // namespace kinect
+
+#endif
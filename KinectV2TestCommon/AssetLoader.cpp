@@ -0,0 +1,294 @@
+#include "AssetLoader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		const char ASSET_ARCHIVE_MAGIC[ 8 ] = { 'K', 'V', '2', 'P', 'A', 'K', 0, 0 };
+		const uint64_t K1 = 0x9E3779B185EBCA87ull;
+		const uint64_t K2 = 0xC2B2AE3D27D4EB4Full;
+
+		static_assert( sizeof( AssetArchiveHeader ) == 32, "AssetArchiveHeader must be packed" );
+		static_assert( sizeof( AssetArchiveEntry ) == 40, "AssetArchiveEntry must be packed" );
+
+		void throwError( const char* what, const std::string& path )
+		{
+			std::stringstream ss;
+			ss << what << " : " << path;
+			throw std::runtime_error( ss.str() );
+		}
+
+		uint64_t rotate( uint64_t v, int bits )
+		{
+			return ( v << bits ) | ( v >> ( 64 - bits ) );
+		}
+
+		std::string join( const std::string& directory, const std::string& name )
+		{
+			return directory.empty() ? name : directory + "/" + name;
+		}
+
+		bool fileExists( const std::string& path )
+		{
+			FILE* fp = fopen( path.c_str(), "rb" );
+			if( fp ) fclose( fp );
+			return fp != nullptr;
+		}
+	}
+
+	uint64_t assetHash( const void* data, std::size_t size )
+	{
+		const unsigned char* p = static_cast< const unsigned char* >( data );
+		uint64_t h = K2 ^ ( size * K1 );
+		for( ; size >= 8; p += 8, size -= 8 )
+		{
+			uint64_t word;
+			memcpy( &word, p, 8 );
+			h = rotate( h ^ ( rotate( word * K2, 31 ) * K1 ), 27 ) * K1 + K2;
+		}
+		uint64_t tail = 0;
+		memcpy( &tail, p, size );
+		h ^= rotate( tail * K2, 31 ) * K1;
+
+		// Avalanche of MurmurHash3.
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	std::string executableDirectory()
+	{
+		std::string path;
+#ifdef _WIN32
+		char buffer[ MAX_PATH ];
+		const DWORD length = GetModuleFileNameA( nullptr, buffer, MAX_PATH );
+		path.assign( buffer, length < MAX_PATH ? length : 0 );
+#else
+		char buffer[ 4096 ];
+		const ssize_t length = readlink( "/proc/self/exe", buffer, sizeof buffer );
+		path.assign( buffer, length > 0 && length < static_cast< ssize_t >( sizeof buffer ) ? length : 0 );
+#endif
+		const std::size_t slash = path.find_last_of( "/\\" );
+		return slash == std::string::npos ? std::string() : path.substr( 0, slash );
+	}
+
+	void writeAssetArchive( const char* path, const std::string& directory, const std::vector< std::string >& names )
+	{
+		struct Asset
+		{
+			std::string name;
+			AssetArchiveEntry entry;
+			std::size_t blob;
+		};
+		std::vector< Asset > assets;
+		std::vector< std::vector< unsigned char > > blobs;
+		std::string nameData;
+		for( const auto& name : names )
+		{
+			FILE* fp = fopen( join( directory, name ).c_str(), "rb" );
+			if( !fp ) throwError( "File not found", name );
+			std::vector< unsigned char > data;
+			unsigned char buffer[ 65536 ];
+			std::size_t n;
+			while( ( n = fread( buffer, 1, sizeof buffer, fp ) ) > 0 )
+			{
+				data.insert( data.end(), buffer, buffer + n );
+			}
+			const bool failed = ferror( fp ) != 0;
+			fclose( fp );
+			if( failed ) throwError( "Cannot read file", name );
+
+			Asset asset;
+			asset.name = name;
+			memset( &asset.entry, 0, sizeof asset.entry );
+			asset.entry.nameHash = assetHash( name.data(), name.size() );
+			asset.entry.contentHash = assetHash( data.data(), data.size() );
+			asset.entry.size = data.size();
+			asset.entry.nameOffset = static_cast< uint32_t >( nameData.size() );
+			asset.entry.nameSize = static_cast< uint32_t >( name.size() );
+			nameData += name;
+
+			// Same contents, same blob.
+			asset.blob = blobs.size();
+			for( std::size_t b = 0; b < blobs.size(); ++b )
+			{
+				if( blobs[ b ] == data )
+				{
+					asset.blob = b;
+					break;
+				}
+			}
+			if( asset.blob == blobs.size() )
+			{
+				blobs.push_back( std::move( data ) );
+			}
+			assets.push_back( asset );
+		}
+
+		AssetArchiveHeader header;
+		memset( &header, 0, sizeof header );
+		memcpy( header.magic, ASSET_ARCHIVE_MAGIC, sizeof header.magic );
+		header.version = ASSET_ARCHIVE_VERSION;
+		header.entryCount = static_cast< uint32_t >( assets.size() );
+		header.namesOffset = sizeof header + assets.size() * sizeof( AssetArchiveEntry );
+		header.dataOffset = ( header.namesOffset + nameData.size() + ASSET_ARCHIVE_ALIGNMENT - 1 ) / ASSET_ARCHIVE_ALIGNMENT * ASSET_ARCHIVE_ALIGNMENT;
+
+		std::vector< uint64_t > blobOffsets;
+		uint64_t offset = header.dataOffset;
+		for( const auto& blob : blobs )
+		{
+			blobOffsets.push_back( offset );
+			offset += ( blob.size() + ASSET_ARCHIVE_ALIGNMENT - 1 ) / ASSET_ARCHIVE_ALIGNMENT * ASSET_ARCHIVE_ALIGNMENT;
+		}
+		for( auto& asset : assets )
+		{
+			asset.entry.offset = blobOffsets[ asset.blob ];
+		}
+		std::stable_sort( assets.begin(), assets.end(), []( const Asset& a, const Asset& b ) { return a.entry.nameHash < b.entry.nameHash; } );
+
+		std::vector< unsigned char > file( static_cast< std::size_t >( offset ), 0 );
+		memcpy( &file[ 0 ], &header, sizeof header );
+		for( std::size_t i = 0; i < assets.size(); ++i )
+		{
+			memcpy( &file[ sizeof header + i * sizeof( AssetArchiveEntry ) ], &assets[ i ].entry, sizeof( AssetArchiveEntry ) );
+		}
+		std::copy( nameData.begin(), nameData.end(), file.begin() + static_cast< std::ptrdiff_t >( header.namesOffset ) );
+		for( std::size_t b = 0; b < blobs.size(); ++b )
+		{
+			std::copy( blobs[ b ].begin(), blobs[ b ].end(), file.begin() + static_cast< std::ptrdiff_t >( blobOffsets[ b ] ) );
+		}
+
+		FILE* fp = fopen( path, "wb" );
+		if( !fp ) throwError( "Cannot create file", path );
+		const bool ok = fwrite( file.data(), 1, file.size(), fp ) == file.size();
+		const bool closed = fclose( fp ) == 0;
+		if( !ok || !closed ) throwError( "Cannot write archive", path );
+	}
+
+	AssetLoader::AssetLoader( const std::string& directory )
+		: directory_( directory ), archiveData_( nullptr ), archiveSize_( 0 ), entries_( nullptr ), entryCount_( 0 )
+	{
+	}
+
+	bool AssetLoader::mountArchive( const std::string& name )
+	{
+		const std::string path = join( directory_, name );
+		if( !fileExists( path ) )
+		{
+			return false;
+		}
+
+		archive_.open( path.c_str() );
+		archiveSize_ = static_cast< std::size_t >( archive_.fileSize() );
+		if( archiveSize_ < sizeof( AssetArchiveHeader ) ) throwError( "Not an asset archive", path );
+		archiveData_ = archive_.map( 0, archiveSize_ );
+
+		AssetArchiveHeader header;
+		memcpy( &header, archiveData_, sizeof header );
+		if( memcmp( header.magic, ASSET_ARCHIVE_MAGIC, sizeof header.magic ) != 0 || header.version != ASSET_ARCHIVE_VERSION ||
+			header.namesOffset != sizeof header + static_cast< uint64_t >( header.entryCount ) * sizeof( AssetArchiveEntry ) ||
+			header.dataOffset < header.namesOffset || header.dataOffset > archiveSize_ )
+		{
+			archive_.close();
+			archiveData_ = nullptr;
+			throwError( "Not an asset archive", path );
+		}
+
+		// Entries are read in place, checked once here.
+		entries_ = reinterpret_cast< const AssetArchiveEntry* >( archiveData_ + sizeof header );
+		entryCount_ = header.entryCount;
+		for( std::size_t i = 0; i < entryCount_; ++i )
+		{
+			const AssetArchiveEntry& entry = entries_[ i ];
+			if( header.namesOffset + entry.nameOffset + entry.nameSize > header.dataOffset ||
+				entry.offset < header.dataOffset || entry.offset + entry.size > archiveSize_ ||
+				( i > 0 && entry.nameHash < entries_[ i - 1 ].nameHash ) )
+			{
+				archive_.close();
+				archiveData_ = nullptr;
+				entries_ = nullptr;
+				entryCount_ = 0;
+				throwError( "Broken asset archive", path );
+			}
+		}
+		return true;
+	}
+
+	bool AssetLoader::findInArchive( const std::string& name, AssetSpan& span ) const
+	{
+		const uint64_t hash = assetHash( name.data(), name.size() );
+		const AssetArchiveEntry* end = entries_ + entryCount_;
+		const AssetArchiveEntry* it = std::lower_bound( entries_, end, hash,
+			[]( const AssetArchiveEntry& entry, uint64_t h ) { return entry.nameHash < h; } );
+		const unsigned char* names = reinterpret_cast< const unsigned char* >( entries_ + entryCount_ );
+		for( ; it != end && it->nameHash == hash; ++it )
+		{
+			if( it->nameSize == name.size() && memcmp( names + it->nameOffset, name.data(), name.size() ) == 0 )
+			{
+				span.data = archiveData_ + it->offset;
+				span.size = static_cast< std::size_t >( it->size );
+				span.hash = it->contentHash;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	AssetSpan AssetLoader::load( const std::string& name )
+	{
+		auto known = byName_.find( name );
+		if( known != byName_.end() )
+		{
+			return known->second;
+		}
+
+		AssetSpan span;
+		if( !findInArchive( name, span ) )
+		{
+			const std::string path = join( directory_, name );
+			std::unique_ptr< MappedFile > file( new MappedFile() );
+			file->open( path.c_str() );
+			if( file->fileSize() == 0 ) throwError( "File not found", name );
+			span.size = static_cast< std::size_t >( file->fileSize() );
+			span.data = file->map( 0, span.size );
+			span.hash = assetHash( span.data, span.size );
+
+			// Keep the mapping unless the same contents are loaded already.
+			bool shared = false;
+			for( auto range = byHash_.equal_range( span.hash ); range.first != range.second; ++range.first )
+			{
+				const AssetSpan& blob = range.first->second;
+				if( blob.size == span.size && memcmp( blob.data, span.data, span.size ) == 0 )
+				{
+					span = blob;
+					shared = true;
+					break;
+				}
+			}
+			if( !shared )
+			{
+				files_.push_back( std::move( file ) );
+				byHash_.insert( std::make_pair( span.hash, span ) );
+			}
+		}
+		byName_[ name ] = span;
+		return span;
+	}
+
+} // namespace kinect
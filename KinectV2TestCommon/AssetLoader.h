@@ -0,0 +1,102 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	//! Asset archive layout, all assets of an app in one file.
+	//!
+	//!   [header] [entries] [names] [data]
+	//!
+	//! Entries are sorted by the hash of the name. Each blob starts at a multiple of
+	//! ASSET_ARCHIVE_ALIGNMENT, and assets with the same contents share one blob.
+	enum
+	{
+		ASSET_ARCHIVE_VERSION = 1,
+		ASSET_ARCHIVE_ALIGNMENT = 16
+	};
+
+	struct AssetArchiveHeader
+	{
+		char magic[ 8 ];			// "KV2PAK\0\0"
+		uint32_t version;
+		uint32_t entryCount;
+		uint64_t namesOffset;
+		uint64_t dataOffset;
+	};
+
+	struct AssetArchiveEntry
+	{
+		uint64_t nameHash;
+		uint64_t contentHash;
+		uint64_t offset;			// file offset of the blob
+		uint64_t size;
+		uint32_t nameOffset;		// from namesOffset
+		uint32_t nameSize;
+	};
+
+	//! View of an asset, valid as long as the loader that returned it.
+	struct AssetSpan
+	{
+		const unsigned char* data;
+		std::size_t size;
+		uint64_t hash;				// assetHash() of the contents
+	};
+
+	//! 64 bit hash of a blob, 8 bytes at a time.
+	uint64_t assetHash( const void* data, std::size_t size );
+
+	//! Directory of the running executable, without the trailing separator.
+	std::string executableDirectory();
+
+	//! Pack files of a directory into an archive.
+	//! Throw std::runtime_error if a file cannot be read or the archive cannot be written.
+	void writeAssetArchive( const char* path, const std::string& directory, const std::vector< std::string >& names );
+
+	//! Loads assets by name, from a mounted archive or from files of a directory.
+	//!
+	//! Files are memory mapped whole and handed out as spans, nothing is copied. A name is
+	//! looked up once; a file whose contents hash the same as a blob already loaded gets
+	//! that blob, and its own mapping is dropped.
+	class AssetLoader
+	{
+	public:
+		//! Files are looked up in directory, the executable's by default.
+		explicit AssetLoader( const std::string& directory = executableDirectory() );
+
+		//! Look assets up in the archive of that name in the directory first.
+		//! Return false if there is no such file. Throw std::runtime_error if it is not an archive.
+		bool mountArchive( const std::string& name );
+
+		//! Asset of that name. Throw std::runtime_error if it is not found or empty.
+		AssetSpan load( const std::string& name );
+
+		//! Files mapped, the archive excluded.
+		std::size_t mappedFileCount() const { return files_.size(); }
+
+		const std::string& directory() const { return directory_; }
+
+	private:
+		AssetLoader( const AssetLoader& ) = delete;
+		AssetLoader& operator=( const AssetLoader& ) = delete;
+
+		bool findInArchive( const std::string& name, AssetSpan& span ) const;
+
+		std::string directory_;
+		MappedFile archive_;
+		const unsigned char* archiveData_;
+		std::size_t archiveSize_;
+		const AssetArchiveEntry* entries_;
+		std::size_t entryCount_;
+		std::vector< std::unique_ptr< MappedFile > > files_;
+		std::map< std::string, AssetSpan > byName_;
+		std::multimap< uint64_t, AssetSpan > byHash_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,319 @@
+#include "BodyIndexCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		const char BODY_INDEX_CODEC_MAGIC[ 4 ] = { 'K', 'V', '2', 'B' };
+		const unsigned char LONG_RUN_FLAG = 0x80;
+
+		//! Index of the lowest set bit. v must not be 0.
+		inline unsigned int lowestBit( uint32_t v )
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward( &index, v );
+			return index;
+#else
+			return __builtin_ctz( v );
+#endif
+		}
+
+		//! End of the run that starts at x.
+		typedef unsigned int ( *RunEnd )( const uint8_t* row, unsigned int x, unsigned int width );
+
+		unsigned int runEndScalar( const uint8_t* row, unsigned int x, unsigned int width )
+		{
+			const uint8_t value = row[ x ];
+			while( ++x < width && row[ x ] == value ) {}
+			return x;
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		unsigned int runEndSse2( const uint8_t* row, unsigned int x, unsigned int width )
+		{
+			const uint8_t value = row[ x ];
+			const __m128i v = _mm_set1_epi8( static_cast< char >( value ) );
+			for( ++x; x + 16 <= width; x += 16 )
+			{
+				const uint32_t same = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row + x ) ), v ) );
+				if( same != 0xFFFF ) return x + lowestBit( ~same );
+			}
+			for( ; x < width && row[ x ] == value; ++x ) {}
+			return x;
+		}
+
+		KINECT_TARGET_AVX2
+		unsigned int runEndAvx2( const uint8_t* row, unsigned int x, unsigned int width )
+		{
+			const uint8_t value = row[ x ];
+			const __m256i v = _mm256_set1_epi8( static_cast< char >( value ) );
+			for( ++x; x + 32 <= width; x += 32 )
+			{
+				const uint32_t same = static_cast< uint32_t >( _mm256_movemask_epi8(
+					_mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row + x ) ), v ) ) );
+				if( same != 0xFFFFFFFF ) return x + lowestBit( ~same );
+			}
+			for( ; x < width && row[ x ] == value; ++x ) {}
+			return x;
+		}
+#endif
+
+		inline unsigned char* writeRun( unsigned char* out, uint8_t value, unsigned int length )
+		{
+			const unsigned int n = length - 1;
+			*out++ = value;
+			if( n < LONG_RUN_FLAG )
+			{
+				*out++ = static_cast< unsigned char >( n );
+			}
+			else
+			{
+				*out++ = static_cast< unsigned char >( LONG_RUN_FLAG | ( n >> 8 ) );
+				*out++ = static_cast< unsigned char >( n );
+			}
+			return out;
+		}
+
+		void writeU16( unsigned char* dst, unsigned int v )
+		{
+			dst[ 0 ] = static_cast< unsigned char >( v );
+			dst[ 1 ] = static_cast< unsigned char >( v >> 8 );
+		}
+
+		uint32_t readU16( const unsigned char* src )
+		{
+			return src[ 0 ] | ( src[ 1 ] << 8 );
+		}
+
+		//! Call fill( y, x, length, value ) for every run of the frame, the rows outside
+		//! the coded ones included.
+		template< class Fill >
+		void decodeRuns( const unsigned char* src, std::size_t srcSize, unsigned int width, unsigned int height, Fill fill )
+		{
+			unsigned int encodedWidth, encodedHeight;
+			BodyIndexBox boxes[ MAX_BODY_COUNT ];
+			if( !readBodyIndexCodecHeader( src, srcSize, encodedWidth, encodedHeight, boxes ) )
+			{
+				throw std::runtime_error( "Not encoded body index data" );
+			}
+			if( encodedWidth != width || encodedHeight != height )
+			{
+				throw std::runtime_error( "Encoded body index size does not match" );
+			}
+			const unsigned int top = readU16( src + 8 );
+			const unsigned int bottom = readU16( src + 10 );
+			const uint32_t payloadSize = readU16( src + 12 ) | ( readU16( src + 14 ) << 16 );
+			if( top > bottom || bottom > height )
+			{
+				throw std::runtime_error( "Body index data is broken" );
+			}
+			if( payloadSize > srcSize - BODY_INDEX_CODEC_HEADER_SIZE )
+			{
+				throw std::runtime_error( "Body index data is truncated" );
+			}
+
+			const unsigned char* in = src + BODY_INDEX_CODEC_HEADER_SIZE;
+			const unsigned char* end = in + payloadSize;
+			for( unsigned int y = 0; y < top; ++y )
+			{
+				fill( y, 0, width, static_cast< uint8_t >( BODY_INDEX_NONE ) );
+			}
+			for( unsigned int y = top; y < bottom; ++y )
+			{
+				for( unsigned int x = 0; x < width; )
+				{
+					if( end - in < 2 ) throw std::runtime_error( "Body index data is truncated" );
+					const uint8_t value = *in++;
+					unsigned int n = *in++;
+					if( n & LONG_RUN_FLAG )
+					{
+						if( in == end ) throw std::runtime_error( "Body index data is truncated" );
+						n = ( ( n & ~LONG_RUN_FLAG ) << 8 ) | *in++;
+					}
+					const unsigned int length = n + 1;
+					if( length > width - x ) throw std::runtime_error( "Body index data is broken" );
+					fill( y, x, length, value );
+					x += length;
+				}
+			}
+			for( unsigned int y = bottom; y < height; ++y )
+			{
+				fill( y, 0, width, static_cast< uint8_t >( BODY_INDEX_NONE ) );
+			}
+		}
+	}
+
+	std::size_t bodyIndexCodecMaxEncodedSize( unsigned int width, unsigned int height )
+	{
+		// A run of 1 pixel per pixel at worst.
+		return BODY_INDEX_CODEC_HEADER_SIZE + static_cast< std::size_t >( width ) * height * 2;
+	}
+
+	std::size_t encodeBodyIndex( const uint8_t* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstCapacity, SimdLevel simd )
+	{
+		if( width == 0 || width > BODY_INDEX_CODEC_MAX_WIDTH || height > 0xFFFF )
+		{
+			throw std::invalid_argument( "Body index frame size is not supported" );
+		}
+		if( dstCapacity < bodyIndexCodecMaxEncodedSize( width, height ) )
+		{
+			throw std::invalid_argument( "Body index codec output buffer is too small" );
+		}
+
+		RunEnd runEnd = runEndScalar;
+#if KINECT_X86
+		switch( resolveSimdLevel( simd ) )
+		{
+		case SIMD_AVX2: runEnd = runEndAvx2; break;
+		case SIMD_SSE2: runEnd = runEndSse2; break;
+		default: break;
+		}
+#else
+		static_cast< void >( simd );
+#endif
+
+		unsigned int x0[ MAX_BODY_COUNT ], y0[ MAX_BODY_COUNT ], x1[ MAX_BODY_COUNT ], y1[ MAX_BODY_COUNT ];
+		for( int i = 0; i < MAX_BODY_COUNT; ++i )
+		{
+			x0[ i ] = y0[ i ] = 0xFFFF;
+			x1[ i ] = y1[ i ] = 0;
+		}
+
+		// Rows are written as they are scanned. Empty rows before the first body pixel are
+		// overwritten by the next row, those after the last one are cut off at the end.
+		unsigned char* const rowsBegin = dst + BODY_INDEX_CODEC_HEADER_SIZE;
+		unsigned char* out = rowsBegin;
+		unsigned char* rowsEnd = rowsBegin;
+		unsigned int top = height;
+		unsigned int bottom = 0;
+		for( unsigned int y = 0; y < height; ++y )
+		{
+			const uint8_t* row = src + static_cast< std::size_t >( y ) * width;
+			unsigned char* const rowBegin = out;
+			bool any = false;
+			for( unsigned int x = 0; x < width; )
+			{
+				const uint8_t value = row[ x ];
+				const unsigned int end = runEnd( row, x, width );
+				out = writeRun( out, value, end - x );
+				if( value != BODY_INDEX_NONE )
+				{
+					any = true;
+					if( value < MAX_BODY_COUNT )
+					{
+						x0[ value ] = std::min( x0[ value ], x );
+						x1[ value ] = std::max( x1[ value ], end );
+						y0[ value ] = std::min( y0[ value ], y );
+						y1[ value ] = y + 1;
+					}
+				}
+				x = end;
+			}
+
+			if( any )
+			{
+				if( top == height ) top = y;
+				bottom = y + 1;
+				rowsEnd = out;
+			}
+			else if( top == height )
+			{
+				out = rowBegin;
+			}
+		}
+		if( top == height )
+		{
+			top = 0;
+		}
+
+		const std::size_t size = rowsEnd - dst;
+		const uint32_t payloadSize = static_cast< uint32_t >( rowsEnd - rowsBegin );
+		memcpy( dst, BODY_INDEX_CODEC_MAGIC, sizeof BODY_INDEX_CODEC_MAGIC );
+		writeU16( dst + 4, width );
+		writeU16( dst + 6, height );
+		writeU16( dst + 8, top );
+		writeU16( dst + 10, bottom );
+		writeU16( dst + 12, payloadSize & 0xFFFF );
+		writeU16( dst + 14, payloadSize >> 16 );
+		for( int i = 0; i < MAX_BODY_COUNT; ++i )
+		{
+			const bool present = x1[ i ] != 0;
+			unsigned char* box = dst + 16 + i * 8;
+			writeU16( box, present ? x0[ i ] : 0 );
+			writeU16( box + 2, present ? y0[ i ] : 0 );
+			writeU16( box + 4, x1[ i ] );
+			writeU16( box + 6, y1[ i ] );
+		}
+		return size;
+	}
+
+	bool readBodyIndexCodecHeader( const unsigned char* src, std::size_t srcSize,
+		unsigned int& width, unsigned int& height, BodyIndexBox boxes[ MAX_BODY_COUNT ] )
+	{
+		if( srcSize < BODY_INDEX_CODEC_HEADER_SIZE || memcmp( src, BODY_INDEX_CODEC_MAGIC, sizeof BODY_INDEX_CODEC_MAGIC ) != 0 )
+		{
+			return false;
+		}
+		width = readU16( src + 4 );
+		height = readU16( src + 6 );
+		for( int i = 0; i < MAX_BODY_COUNT; ++i )
+		{
+			const unsigned char* box = src + 16 + i * 8;
+			boxes[ i ].x0 = static_cast< uint16_t >( readU16( box ) );
+			boxes[ i ].y0 = static_cast< uint16_t >( readU16( box + 2 ) );
+			boxes[ i ].x1 = static_cast< uint16_t >( readU16( box + 4 ) );
+			boxes[ i ].y1 = static_cast< uint16_t >( readU16( box + 6 ) );
+		}
+		return true;
+	}
+
+	void decodeBodyIndex( const unsigned char* src, std::size_t srcSize, uint8_t* dst, unsigned int width, unsigned int height )
+	{
+		decodeRuns( src, srcSize, width, height, [=]( unsigned int y, unsigned int x, unsigned int length, uint8_t value ) {
+			memset( dst + static_cast< std::size_t >( y ) * width + x, value, length );
+		} );
+	}
+
+	void renderBodyIndex( const unsigned char* src, std::size_t srcSize,
+		unsigned char* dst, std::size_t dstPitch, unsigned int width, unsigned int height )
+	{
+		decodeRuns( src, srcSize, width, height, [=]( unsigned int y, unsigned int x, unsigned int length, uint8_t value ) {
+			uint32_t* out = reinterpret_cast< uint32_t* >( dst + y * dstPitch ) + x;
+			std::fill( out, out + length, bodyIndexColor( value ) );
+		} );
+	}
+
+	uint32_t bodyIndexColor( uint8_t index )
+	{
+		uint8_t rgba[ 4 ] = { 0, 0, 0, 255 };
+		switch( index )
+		{
+		case 255: break;
+		case 0: rgba[ 0 ] = 255; break;
+		case 1: rgba[ 1 ] = 255; break;
+		case 2: rgba[ 2 ] = 255; break;
+		case 3: rgba[ 0 ] = rgba[ 1 ] = 255; break;
+		case 4: rgba[ 1 ] = rgba[ 2 ] = 255; break;
+		case 5: rgba[ 0 ] = rgba[ 2 ] = 255; break;
+		case 6: rgba[ 0 ] = rgba[ 1 ] = rgba[ 2 ] = 255; break;
+		default: rgba[ 0 ] = rgba[ 1 ] = rgba[ 2 ] = 128; break;	// 0.5
+		}
+		uint32_t color;
+		memcpy( &color, rgba, 4 );
+		return color;
+	}
+
+} // namespace kinect
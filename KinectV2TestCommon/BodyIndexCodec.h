@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Cpu.h"
+#include "FrameSource.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace kinect
+{
+	//! Run-length codec for body index frames, which are mostly 255 (no body).
+	//!
+	//! Only the rows from the first to the last one with a body pixel are coded, as runs of
+	//! equal values; the other rows are 255. The box of each body comes first, so a reader
+	//! can crop or skip a body without decoding.
+	//!
+	//!   header : "KV2B", width (uint16), height (uint16), first row, end row (uint16),
+	//!            payload size (uint32)
+	//!   boxes  : x0, y0, x1, y1 (uint16, end exclusive) of bodies 0-5, all 0 if absent
+	//!   run    : value (uint8), length - 1 (1 byte if < 0x80, else 0x80 | high 7 bits, low 8 bits)
+	//!            Runs do not cross rows.
+	enum
+	{
+		BODY_INDEX_CODEC_HEADER_SIZE = 16 + 8 * MAX_BODY_COUNT,
+		BODY_INDEX_CODEC_MAX_WIDTH = 0x8000,
+		BODY_INDEX_NONE = 255
+	};
+
+	//! Bounding box of a body in pixels, end exclusive. Empty if the body is absent.
+	struct BodyIndexBox
+	{
+		uint16_t x0;
+		uint16_t y0;
+		uint16_t x1;
+		uint16_t y1;
+
+		bool empty() const { return x1 <= x0; }
+	};
+
+	//! Upper bound of the encoded size.
+	std::size_t bodyIndexCodecMaxEncodedSize( unsigned int width, unsigned int height );
+
+	//! Encode a frame in one scan, comparing 16 (SSE2) or 32 (AVX2) pixels at a time to find
+	//! where a run ends. Return the encoded size. Throw std::invalid_argument if width is larger
+	//! than BODY_INDEX_CODEC_MAX_WIDTH or dst is smaller than bodyIndexCodecMaxEncodedSize().
+	std::size_t encodeBodyIndex( const uint8_t* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstCapacity, SimdLevel simd = SIMD_BEST );
+
+	//! Read the frame size and the body boxes from an encoded frame. Return false if it is not one.
+	bool readBodyIndexCodecHeader( const unsigned char* src, std::size_t srcSize,
+		unsigned int& width, unsigned int& height, BodyIndexBox boxes[ MAX_BODY_COUNT ] );
+
+	//! Decode a frame of the given size.
+	//! Throw std::runtime_error if the data is broken or the size does not match.
+	void decodeBodyIndex( const unsigned char* src, std::size_t srcSize, uint8_t* dst, unsigned int width, unsigned int height );
+
+	//! Decode a frame straight to RGBA with the colors of bodyIndexColor().
+	void renderBodyIndex( const unsigned char* src, std::size_t srcSize,
+		unsigned char* dst, std::size_t dstPitch, unsigned int width, unsigned int height );
+
+	//! Color getColor() of KinectV2TestBodyIndex/def.ps.hlsl draws for a body index,
+	//! the R, G, B, A bytes in memory order.
+	uint32_t bodyIndexColor( uint8_t index );
+
+} // namespace kinect
@@ -0,0 +1,429 @@
+#include "BodyStats.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace kinect
+{
+	static_assert( sizeof( BodyIndexStats ) == 232, "BodyIndexStats is logged as is" );
+
+	namespace
+	{
+		enum
+		{
+			//! Pixels summed in 32 bit lanes before moving to the 64 bit sums. Offsets in a
+			//! segment fit in a byte, and 64 offset times depth products fit in a lane.
+			SEGMENT_WIDTH = 256
+		};
+
+		//! Integer sums of a body over a frame.
+		struct BodySums
+		{
+			uint64_t count;
+			uint64_t depthCount;
+			uint64_t sumX;
+			uint64_t sumY;
+			uint64_t sumDepth;
+			uint64_t sumXDepth;
+			uint64_t sumYDepth;
+			unsigned int x0, y0, x1, y1;
+		};
+
+		//! Sums of a body over one segment of a row, x relative to the segment.
+		struct SegmentSums
+		{
+			unsigned int count;
+			unsigned int depthCount;
+			unsigned int minX;
+			unsigned int maxX;
+			uint64_t sumX;
+			uint64_t sumDepth;
+			uint64_t sumXDepth;
+		};
+
+		inline unsigned int popCount( uint32_t v )
+		{
+			v = v - ( ( v >> 1 ) & 0x55555555 );
+			v = ( v & 0x33333333 ) + ( ( v >> 2 ) & 0x33333333 );
+			return ( ( ( v + ( v >> 4 ) ) & 0x0F0F0F0F ) * 0x01010101 ) >> 24;
+		}
+
+		//! Index of the lowest and highest set bits. v must not be 0.
+		inline unsigned int lowestBit( uint32_t v )
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward( &index, v );
+			return index;
+#else
+			return __builtin_ctz( v );
+#endif
+		}
+
+		inline unsigned int highestBit( uint32_t v )
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse( &index, v );
+			return index;
+#else
+			return 31 - __builtin_clz( v );
+#endif
+		}
+
+		void addSegment( BodySums& sums, const SegmentSums& segment, unsigned int segmentX, unsigned int y )
+		{
+			sums.count += segment.count;
+			sums.depthCount += segment.depthCount;
+			sums.sumX += static_cast< uint64_t >( segmentX ) * segment.count + segment.sumX;
+			sums.sumY += static_cast< uint64_t >( y ) * segment.count;
+			sums.sumDepth += segment.sumDepth;
+			sums.sumXDepth += segmentX * segment.sumDepth + segment.sumXDepth;
+			sums.sumYDepth += y * segment.sumDepth;
+			sums.x0 = std::min( sums.x0, segmentX + segment.minX );
+			sums.x1 = std::max( sums.x1, segmentX + segment.maxX + 1 );
+			sums.y0 = std::min( sums.y0, y );
+			sums.y1 = y + 1;
+		}
+
+		//! Pixels [begin, end) of row y.
+		void sumsScalar( const uint8_t* index, const uint16_t* depth, unsigned int begin, unsigned int end,
+			unsigned int y, BodySums* sums )
+		{
+			for( unsigned int x = begin; x < end; ++x )
+			{
+				const uint8_t body = index[ x ];
+				if( body >= MAX_BODY_COUNT ) continue;
+
+				BodySums& s = sums[ body ];
+				const unsigned int d = depth ? depth[ x ] : 0;
+				++s.count;
+				s.depthCount += d != 0;
+				s.sumX += x;
+				s.sumY += y;
+				s.sumDepth += d;
+				s.sumXDepth += static_cast< uint64_t >( x ) * d;
+				s.sumYDepth += static_cast< uint64_t >( y ) * d;
+				s.x0 = std::min( s.x0, x );
+				s.x1 = std::max( s.x1, x + 1 );
+				s.y0 = std::min( s.y0, y );
+				s.y1 = y + 1;
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		uint64_t sumU32( __m128i v )
+		{
+			uint32_t lanes[ 4 ];
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( lanes ), v );
+			return static_cast< uint64_t >( lanes[ 0 ] ) + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+		}
+
+		KINECT_TARGET_SSE2
+		uint64_t sumU64( __m128i v )
+		{
+			uint64_t lanes[ 2 ];
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( lanes ), v );
+			return lanes[ 0 ] + lanes[ 1 ];
+		}
+
+		KINECT_TARGET_AVX2
+		uint64_t sumU32( __m256i v )
+		{
+			uint32_t lanes[ 8 ];
+			_mm256_storeu_si256( reinterpret_cast< __m256i* >( lanes ), v );
+			uint64_t sum = 0;
+			for( int i = 0; i < 8; ++i ) sum += lanes[ i ];
+			return sum;
+		}
+
+		KINECT_TARGET_AVX2
+		uint64_t sumU64( __m256i v )
+		{
+			uint64_t lanes[ 4 ];
+			_mm256_storeu_si256( reinterpret_cast< __m256i* >( lanes ), v );
+			return lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+		}
+
+		//! Row y, 16 pixels at a time.
+		template< bool HAS_DEPTH >
+		KINECT_TARGET_SSE2
+		void rowSse2( const uint8_t* index, const uint16_t* depth, unsigned int width, unsigned int y, BodySums* sums )
+		{
+			const __m128i none = _mm_set1_epi8( static_cast< char >( BODY_INDEX_NONE ) );
+			const __m128i zero = _mm_setzero_si128();
+			const unsigned int vectorWidth = width & ~15u;
+
+			for( unsigned int segmentX = 0; segmentX < vectorWidth; segmentX += SEGMENT_WIDTH )
+			{
+				const unsigned int segmentEnd = std::min( segmentX + SEGMENT_WIDTH, vectorWidth );
+				__m128i offsets = _mm_setr_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 );
+				__m128i offsets0 = _mm_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7 );
+				__m128i offsets1 = _mm_setr_epi16( 8, 9, 10, 11, 12, 13, 14, 15 );
+				__m128i sumX[ MAX_BODY_COUNT ], sumDepth[ MAX_BODY_COUNT ], sumXDepth[ MAX_BODY_COUNT ];
+				for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+				{
+					sumX[ body ] = sumDepth[ body ] = sumXDepth[ body ] = zero;
+				}
+				SegmentSums segment[ MAX_BODY_COUNT ];
+				unsigned int present = 0;
+
+				for( unsigned int x = segmentX; x < segmentEnd; x += 16,
+					offsets = _mm_add_epi8( offsets, _mm_set1_epi8( 16 ) ),
+					offsets0 = _mm_add_epi16( offsets0, _mm_set1_epi16( 16 ) ),
+					offsets1 = _mm_add_epi16( offsets1, _mm_set1_epi16( 16 ) ) )
+				{
+					const __m128i labels = _mm_loadu_si128( reinterpret_cast< const __m128i* >( index + x ) );
+					if( _mm_movemask_epi8( _mm_cmpeq_epi8( labels, none ) ) == 0xFFFF ) continue;
+
+					__m128i d0 = zero, d1 = zero;
+					uint32_t valid = 0;
+					if( HAS_DEPTH )
+					{
+						d0 = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + x ) );
+						d1 = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + x + 8 ) );
+						valid = ~_mm_movemask_epi8( _mm_packs_epi16( _mm_cmpeq_epi16( d0, zero ), _mm_cmpeq_epi16( d1, zero ) ) ) & 0xFFFF;
+					}
+
+					for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+					{
+						const __m128i match = _mm_cmpeq_epi8( labels, _mm_set1_epi8( static_cast< char >( body ) ) );
+						const uint32_t bits = _mm_movemask_epi8( match );
+						if( bits == 0 ) continue;
+
+						const unsigned int offset = x - segmentX;
+						SegmentSums& s = segment[ body ];
+						if( !( present & ( 1u << body ) ) )
+						{
+							present |= 1u << body;
+							s.count = s.depthCount = 0;
+							s.minX = offset + lowestBit( bits );
+						}
+						s.count += popCount( bits );
+						s.depthCount += popCount( bits & valid );
+						s.maxX = offset + highestBit( bits );
+						sumX[ body ] = _mm_add_epi64( sumX[ body ], _mm_sad_epu8( _mm_and_si128( match, offsets ), zero ) );
+
+						if( HAS_DEPTH )
+						{
+							const __m128i m0 = _mm_and_si128( d0, _mm_unpacklo_epi8( match, match ) );
+							const __m128i m1 = _mm_and_si128( d1, _mm_unpackhi_epi8( match, match ) );
+							sumDepth[ body ] = _mm_add_epi32( sumDepth[ body ], _mm_add_epi32(
+								_mm_add_epi32( _mm_unpacklo_epi16( m0, zero ), _mm_unpackhi_epi16( m0, zero ) ),
+								_mm_add_epi32( _mm_unpacklo_epi16( m1, zero ), _mm_unpackhi_epi16( m1, zero ) ) ) );
+
+							// 32 bit products from their low and high halves.
+							const __m128i lo0 = _mm_mullo_epi16( m0, offsets0 );
+							const __m128i hi0 = _mm_mulhi_epu16( m0, offsets0 );
+							const __m128i lo1 = _mm_mullo_epi16( m1, offsets1 );
+							const __m128i hi1 = _mm_mulhi_epu16( m1, offsets1 );
+							sumXDepth[ body ] = _mm_add_epi32( sumXDepth[ body ], _mm_add_epi32(
+								_mm_add_epi32( _mm_unpacklo_epi16( lo0, hi0 ), _mm_unpackhi_epi16( lo0, hi0 ) ),
+								_mm_add_epi32( _mm_unpacklo_epi16( lo1, hi1 ), _mm_unpackhi_epi16( lo1, hi1 ) ) ) );
+						}
+					}
+				}
+
+				for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+				{
+					if( !( present & ( 1u << body ) ) ) continue;
+					SegmentSums& s = segment[ body ];
+					s.sumX = sumU64( sumX[ body ] );
+					s.sumDepth = sumU32( sumDepth[ body ] );
+					s.sumXDepth = sumU32( sumXDepth[ body ] );
+					addSegment( sums[ body ], s, segmentX, y );
+				}
+			}
+			sumsScalar( index, depth, vectorWidth, width, y, sums );
+		}
+
+		//! Row y, 32 pixels at a time.
+		template< bool HAS_DEPTH >
+		KINECT_TARGET_AVX2
+		void rowAvx2( const uint8_t* index, const uint16_t* depth, unsigned int width, unsigned int y, BodySums* sums )
+		{
+			const __m256i none = _mm256_set1_epi8( static_cast< char >( BODY_INDEX_NONE ) );
+			const __m256i zero = _mm256_setzero_si256();
+			const unsigned int vectorWidth = width & ~31u;
+
+			for( unsigned int segmentX = 0; segmentX < vectorWidth; segmentX += SEGMENT_WIDTH )
+			{
+				const unsigned int segmentEnd = std::min( segmentX + SEGMENT_WIDTH, vectorWidth );
+				__m256i offsets = _mm256_setr_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+					16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 );
+				__m256i offsets0 = _mm256_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 );
+				__m256i offsets1 = _mm256_setr_epi16( 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 );
+				__m256i sumX[ MAX_BODY_COUNT ], sumDepth[ MAX_BODY_COUNT ], sumXDepth[ MAX_BODY_COUNT ];
+				for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+				{
+					sumX[ body ] = sumDepth[ body ] = sumXDepth[ body ] = zero;
+				}
+				SegmentSums segment[ MAX_BODY_COUNT ];
+				unsigned int present = 0;
+
+				for( unsigned int x = segmentX; x < segmentEnd; x += 32,
+					offsets = _mm256_add_epi8( offsets, _mm256_set1_epi8( 32 ) ),
+					offsets0 = _mm256_add_epi16( offsets0, _mm256_set1_epi16( 32 ) ),
+					offsets1 = _mm256_add_epi16( offsets1, _mm256_set1_epi16( 32 ) ) )
+				{
+					const __m256i labels = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( index + x ) );
+					if( static_cast< uint32_t >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( labels, none ) ) ) == 0xFFFFFFFF ) continue;
+
+					__m256i d0 = zero, d1 = zero;
+					uint32_t valid = 0;
+					if( HAS_DEPTH )
+					{
+						d0 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( depth + x ) );
+						d1 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( depth + x + 16 ) );
+						// packs interleaves the 128 bit lanes, the permute puts the pixels back in order.
+						const __m256i invalid = _mm256_permute4x64_epi64(
+							_mm256_packs_epi16( _mm256_cmpeq_epi16( d0, zero ), _mm256_cmpeq_epi16( d1, zero ) ), 0xD8 );
+						valid = ~static_cast< uint32_t >( _mm256_movemask_epi8( invalid ) );
+					}
+
+					for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+					{
+						const __m256i match = _mm256_cmpeq_epi8( labels, _mm256_set1_epi8( static_cast< char >( body ) ) );
+						const uint32_t bits = static_cast< uint32_t >( _mm256_movemask_epi8( match ) );
+						if( bits == 0 ) continue;
+
+						const unsigned int offset = x - segmentX;
+						SegmentSums& s = segment[ body ];
+						if( !( present & ( 1u << body ) ) )
+						{
+							present |= 1u << body;
+							s.count = s.depthCount = 0;
+							s.minX = offset + lowestBit( bits );
+						}
+						s.count += popCount( bits );
+						s.depthCount += popCount( bits & valid );
+						s.maxX = offset + highestBit( bits );
+						sumX[ body ] = _mm256_add_epi64( sumX[ body ], _mm256_sad_epu8( _mm256_and_si256( match, offsets ), zero ) );
+
+						if( HAS_DEPTH )
+						{
+							const __m256i m0 = _mm256_and_si256( d0, _mm256_cvtepi8_epi16( _mm256_castsi256_si128( match ) ) );
+							const __m256i m1 = _mm256_and_si256( d1, _mm256_cvtepi8_epi16( _mm256_extracti128_si256( match, 1 ) ) );
+							sumDepth[ body ] = _mm256_add_epi32( sumDepth[ body ], _mm256_add_epi32(
+								_mm256_add_epi32( _mm256_unpacklo_epi16( m0, zero ), _mm256_unpackhi_epi16( m0, zero ) ),
+								_mm256_add_epi32( _mm256_unpacklo_epi16( m1, zero ), _mm256_unpackhi_epi16( m1, zero ) ) ) );
+
+							const __m256i lo0 = _mm256_mullo_epi16( m0, offsets0 );
+							const __m256i hi0 = _mm256_mulhi_epu16( m0, offsets0 );
+							const __m256i lo1 = _mm256_mullo_epi16( m1, offsets1 );
+							const __m256i hi1 = _mm256_mulhi_epu16( m1, offsets1 );
+							sumXDepth[ body ] = _mm256_add_epi32( sumXDepth[ body ], _mm256_add_epi32(
+								_mm256_add_epi32( _mm256_unpacklo_epi16( lo0, hi0 ), _mm256_unpackhi_epi16( lo0, hi0 ) ),
+								_mm256_add_epi32( _mm256_unpacklo_epi16( lo1, hi1 ), _mm256_unpackhi_epi16( lo1, hi1 ) ) ) );
+						}
+					}
+				}
+
+				for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+				{
+					if( !( present & ( 1u << body ) ) ) continue;
+					SegmentSums& s = segment[ body ];
+					s.sumX = sumU64( sumX[ body ] );
+					s.sumDepth = sumU32( sumDepth[ body ] );
+					s.sumXDepth = sumU32( sumXDepth[ body ] );
+				}
+
+				// GCC does not clear the upper halves before calling code built for SSE.
+				_mm256_zeroupper();
+				for( unsigned int body = 0; body < MAX_BODY_COUNT; ++body )
+				{
+					if( present & ( 1u << body ) ) addSegment( sums[ body ], segment[ body ], segmentX, y );
+				}
+			}
+			sumsScalar( index, depth, vectorWidth, width, y, sums );
+		}
+#endif
+	}
+
+	void computeBodyIndexStats( const uint8_t* bodyIndex, const uint16_t* depth,
+		unsigned int width, unsigned int height, int64_t relativeTime, BodyIndexStats& stats, SimdLevel simd )
+	{
+		BodySums sums[ MAX_BODY_COUNT ];
+		memset( sums, 0, sizeof sums );
+		for( int body = 0; body < MAX_BODY_COUNT; ++body )
+		{
+			sums[ body ].x0 = sums[ body ].y0 = ~0u;
+		}
+
+		simd = resolveSimdLevel( simd );
+		for( unsigned int y = 0; y < height; ++y )
+		{
+			const uint8_t* indexRow = bodyIndex + static_cast< std::size_t >( y ) * width;
+			const uint16_t* depthRow = depth ? depth + static_cast< std::size_t >( y ) * width : nullptr;
+			switch( simd )
+			{
+#if KINECT_X86
+			case SIMD_AVX2:
+				if( depthRow ) rowAvx2< true >( indexRow, depthRow, width, y, sums );
+				else rowAvx2< false >( indexRow, depthRow, width, y, sums );
+				break;
+			case SIMD_SSE2:
+				if( depthRow ) rowSse2< true >( indexRow, depthRow, width, y, sums );
+				else rowSse2< false >( indexRow, depthRow, width, y, sums );
+				break;
+#endif
+			default:
+				sumsScalar( indexRow, depthRow, 0, width, y, sums );
+				break;
+			}
+		}
+
+		memset( &stats, 0, sizeof stats );
+		stats.relativeTime = relativeTime;
+		for( int body = 0; body < MAX_BODY_COUNT; ++body )
+		{
+			const BodySums& s = sums[ body ];
+			if( s.count == 0 ) continue;
+
+			BodyStats& b = stats.bodies[ body ];
+			stats.bodyMask |= 1u << body;
+			stats.pixelCount += static_cast< uint32_t >( s.count );
+			b.pixelCount = static_cast< uint32_t >( s.count );
+			b.depthPixelCount = static_cast< uint32_t >( s.depthCount );
+			b.box.x0 = static_cast< uint16_t >( s.x0 );
+			b.box.y0 = static_cast< uint16_t >( s.y0 );
+			b.box.x1 = static_cast< uint16_t >( s.x1 );
+			b.box.y1 = static_cast< uint16_t >( s.y1 );
+			b.centroidX = static_cast< float >( static_cast< double >( s.sumX ) / s.count );
+			b.centroidY = static_cast< float >( static_cast< double >( s.sumY ) / s.count );
+			if( s.sumDepth != 0 )
+			{
+				b.depthCentroidX = static_cast< float >( static_cast< double >( s.sumXDepth ) / s.sumDepth );
+				b.depthCentroidY = static_cast< float >( static_cast< double >( s.sumYDepth ) / s.sumDepth );
+				b.meanDepth = static_cast< float >( static_cast< double >( s.sumDepth ) / s.depthCount );
+			}
+		}
+	}
+
+	std::string formatBodyIndexStats( const BodyIndexStats& stats )
+	{
+		std::stringstream ss;
+		ss << stats.relativeTime << std::fixed;
+		for( int body = 0; body < MAX_BODY_COUNT; ++body )
+		{
+			if( !( stats.bodyMask & ( 1u << body ) ) ) continue;
+
+			const BodyStats& b = stats.bodies[ body ];
+			ss << ' ' << body << ':' << b.pixelCount << ' '
+				<< b.box.x0 << ',' << b.box.y0 << ',' << b.box.x1 << ',' << b.box.y1 << std::setprecision( 1 ) << ' '
+				<< b.centroidX << ',' << b.centroidY << ' ' << b.depthCentroidX << ',' << b.depthCentroidY
+				<< std::setprecision( 0 ) << ' ' << b.meanDepth;
+		}
+		return ss.str();
+	}
+
+} // namespace kinect
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "BodyIndexCodec.h"
+#include "Cpu.h"
+#include "FrameSource.h"
+#include <cstdint>
+#include <string>
+
+namespace kinect
+{
+	//! Statistics of one body in a body index frame, all 0 if the body is absent.
+	struct BodyStats
+	{
+		uint32_t pixelCount;
+		uint32_t depthPixelCount;	// pixels with a valid depth
+		BodyIndexBox box;
+		float centroidX;			// [pixels]
+		float centroidY;
+		float depthCentroidX;		// [pixels], each pixel weighted by its depth
+		float depthCentroidY;
+		float meanDepth;			// [mm] of the pixels with a valid depth
+	};
+
+	//! Statistics of all bodies in a frame. Fixed size with no pointers, so that it can be
+	//! logged or sent as is : 232 bytes a frame.
+	struct BodyIndexStats
+	{
+		int64_t relativeTime;		// TIMESPAN ticks
+		uint32_t bodyMask;			// bit i set if body i has pixels
+		uint32_t pixelCount;		// pixels of all bodies
+		BodyStats bodies[ MAX_BODY_COUNT ];
+	};
+
+	//! Statistics of a body index frame and the depth frame of the same size, read together
+	//! row by row in one pass. Each run of 16 (SSE2) or 32 (AVX2) pixels with a body is
+	//! compared with the 6 labels at once and the matching pixels summed per label; runs
+	//! with no body cost a compare. depth may be null, the depth fields are 0 then.
+	//! All sums are integer, so every SIMD level gives the same record.
+	void computeBodyIndexStats( const uint8_t* bodyIndex, const uint16_t* depth,
+		unsigned int width, unsigned int height, int64_t relativeTime, BodyIndexStats& stats,
+		SimdLevel simd = SIMD_BEST );
+
+	//! One line of text : the time, then "body:count x0,y0,x1,y1 cx,cy dx,dy depth" for each body.
+	std::string formatBodyIndexStats( const BodyIndexStats& stats );
+
+} // namespace kinect
@@ -0,0 +1,198 @@
+#include "BoneMatrices.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		enum
+		{
+			STRIDE = SkeletonHistory::JOINT_STRIDE
+		};
+
+		//! Rotation matrices of slots [begin, end) : the X, Y and Z axes of q, each component a row.
+		//! q need not be normalized, 0 gives the identity.
+		void rotationsScalar( const float* const* q, float* const* r, std::size_t begin, std::size_t end )
+		{
+			for( std::size_t i = begin; i < end; ++i )
+			{
+				const float x = q[ 0 ][ i ], y = q[ 1 ][ i ], z = q[ 2 ][ i ], w = q[ 3 ][ i ];
+				const float n = x * x + y * y + z * z + w * w;
+				const float s = n > 0.0f ? 2.0f / n : 0.0f;
+				const float xx = s * x * x, yy = s * y * y, zz = s * z * z;
+				const float xy = s * x * y, xz = s * x * z, yz = s * y * z;
+				const float wx = s * w * x, wy = s * w * y, wz = s * w * z;
+				r[ 0 ][ i ] = 1.0f - ( yy + zz );
+				r[ 1 ][ i ] = xy + wz;
+				r[ 2 ][ i ] = xz - wy;
+				r[ 3 ][ i ] = xy - wz;
+				r[ 4 ][ i ] = 1.0f - ( xx + zz );
+				r[ 5 ][ i ] = yz + wx;
+				r[ 6 ][ i ] = xz + wy;
+				r[ 7 ][ i ] = yz - wx;
+				r[ 8 ][ i ] = 1.0f - ( xx + yy );
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void rotationsSse2( const float* const* q, float* const* r )
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps( 1.0f );
+			const __m128 two = _mm_set1_ps( 2.0f );
+			for( std::size_t i = 0; i < STRIDE; i += 4 )
+			{
+				const __m128 x = _mm_loadu_ps( q[ 0 ] + i ), y = _mm_loadu_ps( q[ 1 ] + i );
+				const __m128 z = _mm_loadu_ps( q[ 2 ] + i ), w = _mm_loadu_ps( q[ 3 ] + i );
+				const __m128 n = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) ), _mm_mul_ps( w, w ) );
+				const __m128 s = _mm_and_ps( _mm_cmpgt_ps( n, zero ), _mm_div_ps( two, n ) );
+				const __m128 sx = _mm_mul_ps( s, x ), sy = _mm_mul_ps( s, y ), sz = _mm_mul_ps( s, z ), sw = _mm_mul_ps( s, w );
+				const __m128 xx = _mm_mul_ps( sx, x ), yy = _mm_mul_ps( sy, y ), zz = _mm_mul_ps( sz, z );
+				const __m128 xy = _mm_mul_ps( sx, y ), xz = _mm_mul_ps( sx, z ), yz = _mm_mul_ps( sy, z );
+				const __m128 wx = _mm_mul_ps( sw, x ), wy = _mm_mul_ps( sw, y ), wz = _mm_mul_ps( sw, z );
+				_mm_storeu_ps( r[ 0 ] + i, _mm_sub_ps( one, _mm_add_ps( yy, zz ) ) );
+				_mm_storeu_ps( r[ 1 ] + i, _mm_add_ps( xy, wz ) );
+				_mm_storeu_ps( r[ 2 ] + i, _mm_sub_ps( xz, wy ) );
+				_mm_storeu_ps( r[ 3 ] + i, _mm_sub_ps( xy, wz ) );
+				_mm_storeu_ps( r[ 4 ] + i, _mm_sub_ps( one, _mm_add_ps( xx, zz ) ) );
+				_mm_storeu_ps( r[ 5 ] + i, _mm_add_ps( yz, wx ) );
+				_mm_storeu_ps( r[ 6 ] + i, _mm_add_ps( xz, wy ) );
+				_mm_storeu_ps( r[ 7 ] + i, _mm_sub_ps( yz, wx ) );
+				_mm_storeu_ps( r[ 8 ] + i, _mm_sub_ps( one, _mm_add_ps( xx, yy ) ) );
+			}
+		}
+
+		KINECT_TARGET_AVX2
+		void rotationsAvx2( const float* const* q, float* const* r )
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps( 1.0f );
+			const __m256 two = _mm256_set1_ps( 2.0f );
+			for( std::size_t i = 0; i < STRIDE; i += 8 )
+			{
+				const __m256 x = _mm256_loadu_ps( q[ 0 ] + i ), y = _mm256_loadu_ps( q[ 1 ] + i );
+				const __m256 z = _mm256_loadu_ps( q[ 2 ] + i ), w = _mm256_loadu_ps( q[ 3 ] + i );
+				const __m256 n = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) ), _mm256_mul_ps( z, z ) ), _mm256_mul_ps( w, w ) );
+				const __m256 s = _mm256_and_ps( _mm256_cmp_ps( n, zero, _CMP_GT_OQ ), _mm256_div_ps( two, n ) );
+				const __m256 sx = _mm256_mul_ps( s, x ), sy = _mm256_mul_ps( s, y ), sz = _mm256_mul_ps( s, z ), sw = _mm256_mul_ps( s, w );
+				const __m256 xx = _mm256_mul_ps( sx, x ), yy = _mm256_mul_ps( sy, y ), zz = _mm256_mul_ps( sz, z );
+				const __m256 xy = _mm256_mul_ps( sx, y ), xz = _mm256_mul_ps( sx, z ), yz = _mm256_mul_ps( sy, z );
+				const __m256 wx = _mm256_mul_ps( sw, x ), wy = _mm256_mul_ps( sw, y ), wz = _mm256_mul_ps( sw, z );
+				_mm256_storeu_ps( r[ 0 ] + i, _mm256_sub_ps( one, _mm256_add_ps( yy, zz ) ) );
+				_mm256_storeu_ps( r[ 1 ] + i, _mm256_add_ps( xy, wz ) );
+				_mm256_storeu_ps( r[ 2 ] + i, _mm256_sub_ps( xz, wy ) );
+				_mm256_storeu_ps( r[ 3 ] + i, _mm256_sub_ps( xy, wz ) );
+				_mm256_storeu_ps( r[ 4 ] + i, _mm256_sub_ps( one, _mm256_add_ps( xx, zz ) ) );
+				_mm256_storeu_ps( r[ 5 ] + i, _mm256_add_ps( yz, wx ) );
+				_mm256_storeu_ps( r[ 6 ] + i, _mm256_add_ps( xz, wy ) );
+				_mm256_storeu_ps( r[ 7 ] + i, _mm256_sub_ps( yz, wx ) );
+				_mm256_storeu_ps( r[ 8 ] + i, _mm256_sub_ps( one, _mm256_add_ps( xx, yy ) ) );
+			}
+			_mm256_zeroupper();
+		}
+#endif
+	}
+
+	BoneMatrixBuilder::BoneMatrixBuilder( float boneWidth )
+		: boneWidth_( boneWidth ), quaternions_( 4 * STRIDE ), rotations_( 9 * STRIDE ), positions_( 3 * STRIDE )
+	{
+		if( !( boneWidth > 0 ) )
+		{
+			throw std::invalid_argument( "Bone width must be positive" );
+		}
+	}
+
+	std::size_t BoneMatrixBuilder::build( const SkeletonHistory& history, BoneInstance* dst, SimdLevel simd )
+	{
+		std::fill( positions_.begin(), positions_.end(), 0.0f );
+		if( history.size() == 0 )
+		{
+			return 0;
+		}
+
+		// Chain ends have a 0 quaternion, parents come first in JOINT_ORDER.
+		const float* src[ 4 ] = {
+			history.component( JOINT_ORIENTATION_X, 0 ), history.component( JOINT_ORIENTATION_Y, 0 ),
+			history.component( JOINT_ORIENTATION_Z, 0 ), history.component( JOINT_ORIENTATION_W, 0 )
+		};
+		float* q[ 4 ];
+		for( int c = 0; c < 4; ++c )
+		{
+			q[ c ] = &quaternions_[ c * STRIDE ];
+			std::copy( src[ c ], src[ c ] + STRIDE, q[ c ] );
+		}
+		const uint32_t tracked = history.trackedMask( 0 );
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			if( !( tracked & ( 1u << b ) ) ) continue;
+			const int base = b * MAX_JOINT_COUNT;
+			for( int k = 1; k < MAX_JOINT_COUNT; ++k )
+			{
+				const int i = base + human::JOINT_ORDER[ k ];
+				if( q[ 0 ][ i ] != 0.0f || q[ 1 ][ i ] != 0.0f || q[ 2 ][ i ] != 0.0f || q[ 3 ][ i ] != 0.0f ) continue;
+				const int parent = base + human::JOINT_PARENT[ human::JOINT_ORDER[ k ] ];
+				for( int c = 0; c < 4; ++c )
+				{
+					q[ c ][ i ] = q[ c ][ parent ];
+				}
+			}
+		}
+
+		float* r[ 9 ];
+		for( int c = 0; c < 9; ++c )
+		{
+			r[ c ] = &rotations_[ c * STRIDE ];
+		}
+		switch( resolveSimdLevel( simd ) )
+		{
+#if KINECT_X86
+		case SIMD_AVX2: rotationsAvx2( q, r ); break;
+		case SIMD_SSE2: rotationsSse2( q, r ); break;
+#endif
+		default: rotationsScalar( q, r, 0, STRIDE ); break;
+		}
+
+		float* p[ 3 ] = { &positions_[ 0 ], &positions_[ STRIDE ], &positions_[ 2 * STRIDE ] };
+		std::size_t count = 0;
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			if( !( tracked & ( 1u << b ) ) ) continue;
+
+			const int base = b * MAX_JOINT_COUNT;
+			const int root = base + human::JOINT_ORDER[ 0 ];
+			p[ 0 ][ root ] = history.component( JOINT_POSITION_X, 0 )[ root ];
+			p[ 1 ][ root ] = history.component( JOINT_POSITION_Y, 0 )[ root ];
+			p[ 2 ][ root ] = history.component( JOINT_POSITION_Z, 0 )[ root ];
+			for( int k = 1; k < MAX_JOINT_COUNT; ++k )
+			{
+				const int joint = human::JOINT_ORDER[ k ];
+				const int i = base + joint;
+				const int parent = base + human::JOINT_PARENT[ joint ];
+				const float length = human::boneLength( joint ) * 0.01f;
+				for( int a = 0; a < 3; ++a )
+				{
+					p[ a ][ i ] = p[ a ][ parent ] + length * r[ 3 + a ][ i ];
+				}
+
+				float ( *m )[ 4 ] = dst[ count++ ].m;
+				for( int a = 0; a < 3; ++a )
+				{
+					m[ 0 ][ a ] = boneWidth_ * r[ a ][ i ];
+					m[ 1 ][ a ] = length * r[ 3 + a ][ i ];
+					m[ 2 ][ a ] = boneWidth_ * r[ 6 + a ][ i ];
+					m[ 3 ][ a ] = p[ a ][ parent ];
+				}
+				m[ 0 ][ 3 ] = m[ 1 ][ 3 ] = m[ 2 ][ 3 ] = 0.0f;
+				m[ 3 ][ 3 ] = 1.0f;
+			}
+		}
+		return count;
+	}
+
+} // namespace kinect
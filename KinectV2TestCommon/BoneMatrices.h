@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Cpu.h"
+#include "FrameSource.h"
+#include "Human.h"
+#include "SkeletonHistory.h"
+#include <cstddef>
+#include <vector>
+
+namespace kinect
+{
+	//! World matrix of a bone, row-major for row vectors as in DirectXMath : the X, Y and Z
+	//! axes of the bone, scaled, then its base. It maps the pyramid of KinectV2TestBody
+	//! (base in [-1, 1] on XZ, apex at Y = 1) from the parent joint to the joint.
+	struct BoneInstance
+	{
+		float m[ 4 ][ 4 ];
+	};
+
+	//! Bone matrices of all tracked bodies by forward kinematics, ready for one instance buffer.
+	//!
+	//! From the measured SpineBase, each joint in human::JOINT_ORDER is placed at its parent
+	//! plus human::boneLength() along the Y axis of its orientation, which is how Kinect SDK
+	//! orients a bone. Joints with no orientation, the ends of the chains, take their
+	//! parent's. The quaternions of all 150 joint slots of a frame become rotation matrices
+	//! in one SIMD pass; walking the chains is then a few additions per joint.
+	class BoneMatrixBuilder
+	{
+	public:
+		enum
+		{
+			BONES_PER_BODY = MAX_JOINT_COUNT - 1,
+			MAX_BONES = MAX_BODY_COUNT * BONES_PER_BODY
+		};
+
+		//! boneWidth [m] is the half width of the base of a bone.
+		explicit BoneMatrixBuilder( float boneWidth = 0.02f );
+
+		//! Bones of the newest frame of history into dst, MAX_BONES at most, body after body
+		//! in JOINT_ORDER. Return the number of bones. All SIMD levels give the same matrices.
+		std::size_t build( const SkeletonHistory& history, BoneInstance* dst, SimdLevel simd = SIMD_BEST );
+
+		//! Joint positions [m] of the last build, a row of SkeletonHistory::JOINT_STRIDE per axis.
+		const float* positions( int axis ) const { return &positions_[ axis * SkeletonHistory::JOINT_STRIDE ]; }
+
+		//! Joint of each bone in dst, in build order.
+		static int boneJoint( std::size_t bone ) { return human::JOINT_ORDER[ 1 + bone % BONES_PER_BODY ]; }
+
+	private:
+		float boneWidth_;
+		std::vector< float > quaternions_;	// 4 rows, with the orientations of the chain ends filled in
+		std::vector< float > rotations_;	// 9 rows, the X, Y and Z axes of each joint
+		std::vector< float > positions_;	// 3 rows
+	};
+
+} // namespace kinect
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kinect
+{
+	//! Buffers shared by std::shared_ptr that go back to the pool when the last reference is
+	//! dropped, on whichever thread drops it, instead of being freed.
+	//!
+	//! Returning a buffer and taking one both lock the pool, so all the last owner did with a
+	//! buffer happens before acquire() hands it out again. The pool may be destroyed while
+	//! buffers are out : they are freed when they come back.
+	template< class T >
+	class BufferPool
+	{
+	public:
+		BufferPool() : free_( std::make_shared< FreeList >() ) {}
+
+		//! A free buffer, keeping its contents from its last use, or a new one.
+		std::shared_ptr< T > acquire()
+		{
+			std::unique_ptr< T > buffer;
+			{
+				std::lock_guard< std::mutex > lock( free_->mutex_ );
+				if( !free_->buffers_.empty() )
+				{
+					buffer = std::move( free_->buffers_.back() );
+					free_->buffers_.pop_back();
+				}
+			}
+			if( !buffer )
+			{
+				buffer.reset( new T() );
+			}
+			return std::shared_ptr< T >( buffer.release(), Recycler( free_ ) );
+		}
+
+	private:
+		BufferPool( const BufferPool& ) = delete;
+		BufferPool& operator=( const BufferPool& ) = delete;
+
+		struct FreeList
+		{
+			std::mutex mutex_;
+			std::vector< std::unique_ptr< T > > buffers_;
+		};
+
+		//! Deleter of the buffers handed out.
+		struct Recycler
+		{
+			explicit Recycler( const std::shared_ptr< FreeList >& list ) : list_( list ) {}
+
+			void operator()( T* buffer ) const
+			{
+				std::unique_ptr< T > holder( buffer );
+				std::lock_guard< std::mutex > lock( list_->mutex_ );
+				list_->buffers_.push_back( std::move( holder ) );
+			}
+
+			std::shared_ptr< FreeList > list_;
+		};
+
+		std::shared_ptr< FreeList > free_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,59 @@
+#include "CameraModel.h"
+
+namespace kinect
+{
+	CameraIntrinsics kinectDepthIntrinsics()
+	{
+		const CameraIntrinsics intrinsics = { 365.456f, 365.456f, 254.878f, 205.395f, 0.0905474f, -0.26819f, 0.0950862f };
+		return intrinsics;
+	}
+
+	CameraIntrinsics kinectColorIntrinsics()
+	{
+		const CameraIntrinsics intrinsics = { 1081.37f, 1081.37f, 959.5f, 539.5f, 0.0f, 0.0f, 0.0f };
+		return intrinsics;
+	}
+
+	CameraExtrinsics kinectDepthToColor()
+	{
+		// The cameras are about 52 [mm] apart along x.
+		const CameraExtrinsics extrinsics = {
+			{ 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			{ 0.052f, 0.0f, 0.0f }
+		};
+		return extrinsics;
+	}
+
+	std::vector< double > computeRays( const CameraIntrinsics& intrinsics, unsigned int width, unsigned int height )
+	{
+		std::vector< double > rays( static_cast< std::size_t >( width ) * height * 2 );
+		const double k1 = intrinsics.radialDistortion2;
+		const double k2 = intrinsics.radialDistortion4;
+		const double k3 = intrinsics.radialDistortion6;
+		for( unsigned int y = 0; y < height; ++y )
+		{
+			for( unsigned int x = 0; x < width; ++x )
+			{
+				const double xd = ( x - intrinsics.principalPointX ) / intrinsics.focalLengthX;
+				const double yd = ( y - intrinsics.principalPointY ) / intrinsics.focalLengthY;
+
+				// Invert xd = xu ( 1 + k1 r^2 + k2 r^4 + k3 r^6 ) by fixed point iteration.
+				double xu = xd;
+				double yu = yd;
+				for( int i = 0; i < 20; ++i )
+				{
+					const double r2 = xu * xu + yu * yu;
+					const double scale = 1.0 + r2 * ( k1 + r2 * ( k2 + r2 * k3 ) );
+					xu = xd / scale;
+					yu = yd / scale;
+				}
+
+				double* ray = &rays[ ( static_cast< std::size_t >( y ) * width + x ) * 2 ];
+				ray[ 0 ] = xu;
+				ray[ 1 ] = yu;
+			}
+		}
+		return rays;
+	}
+
+} // namespace kinect
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+namespace kinect
+{
+	//! Pinhole camera with radial distortion, same as CameraIntrinsics of Kinect SDK.
+	struct CameraIntrinsics
+	{
+		float focalLengthX;
+		float focalLengthY;
+		float principalPointX;
+		float principalPointY;
+		float radialDistortion2;	// k1 r^2 + k2 r^4 + k3 r^6
+		float radialDistortion4;
+		float radialDistortion6;
+	};
+
+	//! Pose of the color camera relative to the depth camera.
+	//! P_color = rotation * P_depth + translation [m], rotation in row major order.
+	struct CameraExtrinsics
+	{
+		float rotation[ 9 ];
+		float translation[ 3 ];
+	};
+
+	//! Typical values of a Kinect v2. Each sensor differs a little; prefer the depth
+	//! intrinsics from ICoordinateMapper::GetDepthCameraIntrinsics of the actual sensor.
+	CameraIntrinsics kinectDepthIntrinsics();
+	CameraIntrinsics kinectColorIntrinsics();
+	CameraExtrinsics kinectDepthToColor();
+
+	//! Undistorted ray of each pixel, x and y at z = 1 in turn, in the image axes
+	//! (x grows with the column, y with the row).
+	std::vector< double > computeRays( const CameraIntrinsics& intrinsics, unsigned int width, unsigned int height );
+
+} // namespace kinect
@@ -0,0 +1,175 @@
+#include "ColorConvert.h"
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		// R = 1.164 (Y - 16) + 1.596 (V - 128)
+		// G = 1.164 (Y - 16) - 0.813 (V - 128) - 0.391 (U - 128)
+		// B = 1.164 (Y - 16) + 2.018 (U - 128)
+		// in 1/64 units. COEF_Y is rounded up so that Y = 235 gives 255.
+		// Every intermediate fits in int16 except B, which saturates only when
+		// the result is clamped to 255 anyway.
+		const int COEF_Y = 75;
+		const int COEF_RV = 102;
+		const int COEF_GV = 52;
+		const int COEF_GU = 25;
+		const int COEF_BU = 129;
+		const int ROUND = 32;
+		const int SHIFT = 6;
+
+		inline unsigned char clampByte( int v )
+		{
+			return static_cast< unsigned char >( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+		}
+
+		inline void convertPixel( int y, int u, int v, unsigned char* dst )
+		{
+			const int luma = ( y - 16 ) * COEF_Y + ROUND;
+			dst[ 0 ] = clampByte( ( luma + COEF_RV * v ) >> SHIFT );
+			dst[ 1 ] = clampByte( ( luma - COEF_GV * v - COEF_GU * u ) >> SHIFT );
+			dst[ 2 ] = clampByte( ( luma + COEF_BU * u ) >> SHIFT );
+			dst[ 3 ] = 255;
+		}
+
+		//! Convert pixels [x, width) of a row.
+		inline void convertRowScalar( const unsigned char* src, unsigned int x, unsigned int width, unsigned char* dst )
+		{
+			for( ; x < width; x += 2 )
+			{
+				const unsigned char* p = src + x * 2;
+				const int u = p[ 1 ] - 128;
+				const int v = p[ 3 ] - 128;
+				convertPixel( p[ 0 ], u, v, dst + x * 4 );
+				convertPixel( p[ 2 ], u, v, dst + x * 4 + 4 );
+			}
+		}
+
+		void convertScalar( const unsigned char* src, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				convertRowScalar( src + y * width * 2, 0, width, dst + y * dstPitch );
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void convertSse2( const unsigned char* src, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch )
+		{
+			const __m128i lowByte = _mm_set1_epi16( 0x00FF );
+			const __m128i c16 = _mm_set1_epi16( 16 );
+			const __m128i c128 = _mm_set1_epi16( 128 );
+			const __m128i coefY = _mm_set1_epi16( COEF_Y );
+			const __m128i coefRV = _mm_set1_epi16( COEF_RV );
+			const __m128i coefGV = _mm_set1_epi16( COEF_GV );
+			const __m128i coefGU = _mm_set1_epi16( COEF_GU );
+			const __m128i coefBU = _mm_set1_epi16( COEF_BU );
+			const __m128i round = _mm_set1_epi16( ROUND );
+			const __m128i alpha = _mm_set1_epi8( -1 );
+			const unsigned int vectorWidth = width & ~7u;
+
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				const unsigned char* srcRow = src + y * width * 2;
+				unsigned char* dstRow = dst + y * dstPitch;
+				for( unsigned int x = 0; x < vectorWidth; x += 8 )
+				{
+					// 8 pixels : Y0 U0 Y1 V0 ... Y6 U3 Y7 V3
+					const __m128i yuyv = _mm_loadu_si128( reinterpret_cast< const __m128i* >( srcRow + x * 2 ) );
+					const __m128i luma = _mm_sub_epi16( _mm_and_si128( yuyv, lowByte ), c16 );
+					const __m128i chroma = _mm_sub_epi16( _mm_srli_epi16( yuyv, 8 ), c128 );
+
+					// Share chroma between the 2 pixels of each pair.
+					__m128i u = _mm_shufflelo_epi16( chroma, _MM_SHUFFLE( 2, 2, 0, 0 ) );
+					u = _mm_shufflehi_epi16( u, _MM_SHUFFLE( 2, 2, 0, 0 ) );
+					__m128i v = _mm_shufflelo_epi16( chroma, _MM_SHUFFLE( 3, 3, 1, 1 ) );
+					v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 3, 3, 1, 1 ) );
+
+					const __m128i l = _mm_add_epi16( _mm_mullo_epi16( luma, coefY ), round );
+					const __m128i r = _mm_srai_epi16( _mm_adds_epi16( l, _mm_mullo_epi16( v, coefRV ) ), SHIFT );
+					const __m128i g = _mm_srai_epi16( _mm_subs_epi16(
+						_mm_subs_epi16( l, _mm_mullo_epi16( v, coefGV ) ), _mm_mullo_epi16( u, coefGU ) ), SHIFT );
+					const __m128i b = _mm_srai_epi16( _mm_adds_epi16( l, _mm_mullo_epi16( u, coefBU ) ), SHIFT );
+
+					// Saturate to bytes and interleave to RGBA.
+					const __m128i rg = _mm_unpacklo_epi8( _mm_packus_epi16( r, r ), _mm_packus_epi16( g, g ) );
+					const __m128i ba = _mm_unpacklo_epi8( _mm_packus_epi16( b, b ), alpha );
+					_mm_storeu_si128( reinterpret_cast< __m128i* >( dstRow + x * 4 ), _mm_unpacklo_epi16( rg, ba ) );
+					_mm_storeu_si128( reinterpret_cast< __m128i* >( dstRow + x * 4 + 16 ), _mm_unpackhi_epi16( rg, ba ) );
+				}
+				convertRowScalar( srcRow, vectorWidth, width, dstRow );
+			}
+		}
+
+		KINECT_TARGET_AVX2
+		void convertAvx2( const unsigned char* src, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch )
+		{
+			const __m256i lowByte = _mm256_set1_epi16( 0x00FF );
+			const __m256i c16 = _mm256_set1_epi16( 16 );
+			const __m256i c128 = _mm256_set1_epi16( 128 );
+			const __m256i coefY = _mm256_set1_epi16( COEF_Y );
+			const __m256i coefRV = _mm256_set1_epi16( COEF_RV );
+			const __m256i coefGV = _mm256_set1_epi16( COEF_GV );
+			const __m256i coefGU = _mm256_set1_epi16( COEF_GU );
+			const __m256i coefBU = _mm256_set1_epi16( COEF_BU );
+			const __m256i round = _mm256_set1_epi16( ROUND );
+			const __m256i alpha = _mm256_set1_epi8( -1 );
+			const unsigned int vectorWidth = width & ~15u;
+
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				const unsigned char* srcRow = src + y * width * 2;
+				unsigned char* dstRow = dst + y * dstPitch;
+				for( unsigned int x = 0; x < vectorWidth; x += 16 )
+				{
+					// Same as SSE2 in each 128 bit lane, pixels 0-7 and 8-15.
+					const __m256i yuyv = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( srcRow + x * 2 ) );
+					const __m256i luma = _mm256_sub_epi16( _mm256_and_si256( yuyv, lowByte ), c16 );
+					const __m256i chroma = _mm256_sub_epi16( _mm256_srli_epi16( yuyv, 8 ), c128 );
+
+					__m256i u = _mm256_shufflelo_epi16( chroma, _MM_SHUFFLE( 2, 2, 0, 0 ) );
+					u = _mm256_shufflehi_epi16( u, _MM_SHUFFLE( 2, 2, 0, 0 ) );
+					__m256i v = _mm256_shufflelo_epi16( chroma, _MM_SHUFFLE( 3, 3, 1, 1 ) );
+					v = _mm256_shufflehi_epi16( v, _MM_SHUFFLE( 3, 3, 1, 1 ) );
+
+					const __m256i l = _mm256_add_epi16( _mm256_mullo_epi16( luma, coefY ), round );
+					const __m256i r = _mm256_srai_epi16( _mm256_adds_epi16( l, _mm256_mullo_epi16( v, coefRV ) ), SHIFT );
+					const __m256i g = _mm256_srai_epi16( _mm256_subs_epi16(
+						_mm256_subs_epi16( l, _mm256_mullo_epi16( v, coefGV ) ), _mm256_mullo_epi16( u, coefGU ) ), SHIFT );
+					const __m256i b = _mm256_srai_epi16( _mm256_adds_epi16( l, _mm256_mullo_epi16( u, coefBU ) ), SHIFT );
+
+					const __m256i rg = _mm256_unpacklo_epi8( _mm256_packus_epi16( r, r ), _mm256_packus_epi16( g, g ) );
+					const __m256i ba = _mm256_unpacklo_epi8( _mm256_packus_epi16( b, b ), alpha );
+					const __m256i lo = _mm256_unpacklo_epi16( rg, ba );	// pixels 0-3, 8-11
+					const __m256i hi = _mm256_unpackhi_epi16( rg, ba );	// pixels 4-7, 12-15
+					_mm256_storeu_si256( reinterpret_cast< __m256i* >( dstRow + x * 4 ), _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+					_mm256_storeu_si256( reinterpret_cast< __m256i* >( dstRow + x * 4 + 32 ), _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+				}
+				convertRowScalar( srcRow, vectorWidth, width, dstRow );
+			}
+		}
+#endif
+	}
+
+	void convertYuy2ToRgba( const unsigned char* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstPitch, SimdLevel simd )
+	{
+		switch( resolveSimdLevel( simd ) )
+		{
+#if KINECT_X86
+		case SIMD_AVX2: convertAvx2( src, width, height, dst, dstPitch ); break;
+		case SIMD_SSE2: convertSse2( src, width, height, dst, dstPitch ); break;
+#endif
+		default: convertScalar( src, width, height, dst, dstPitch ); break;
+		}
+	}
+
+} // namespace kinect
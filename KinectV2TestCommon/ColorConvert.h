@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Cpu.h"
+#include <cstddef>
+
+namespace kinect
+{
+	//! Convert a YUY2 frame (raw format of the color camera) to RGBA.
+	//! BT.601 video range, 6 bit fixed point. All SIMD levels give the same bytes as SIMD_SCALAR.
+	//! Source rows are packed (width * 2 bytes), destination rows are dstPitch bytes apart,
+	//! so a mapped texture can be written directly. Width must be even.
+	void convertYuy2ToRgba( const unsigned char* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstPitch, SimdLevel simd = SIMD_BEST );
+
+} // namespace kinect
@@ -0,0 +1,144 @@
+#include "Colorize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		enum
+		{
+			TABLE_SIZE = 65536
+		};
+
+		uint8_t toByte( double v )
+		{
+			return static_cast< uint8_t >( std::floor( std::min( std::max( v, 0.0 ), 1.0 ) * 255.0 + 0.5 ) );
+		}
+
+		//! Polynomial fit of Turbo (Google, 2019) in [0, 1].
+		void turbo( double t, double rgb[ 3 ] )
+		{
+			static const double coefs[ 3 ][ 6 ] = {
+				{ 0.13572138, 4.61539260, -42.66032258, 132.13108234, -152.94239396, 59.28637943 },
+				{ 0.09140261, 2.19418839, 4.84296658, -14.18503333, 4.27729857, 2.82956604 },
+				{ 0.10667330, 12.64194608, -60.58204836, 110.36276771, -89.90310912, 27.34824973 }
+			};
+			for( int c = 0; c < 3; ++c )
+			{
+				double v = 0;
+				for( int k = 5; k >= 0; --k ) v = v * t + coefs[ c ][ k ];
+				rgb[ c ] = v;
+			}
+		}
+
+		//! Polynomial fit of viridis (matplotlib) in [0, 1].
+		void viridis( double t, double rgb[ 3 ] )
+		{
+			static const double coefs[ 3 ][ 7 ] = {
+				{ 0.2777273272234177, 0.1050930431085774, -0.3308618287255563, -4.634230498983486, 6.228269936347081, 4.776384997670288, -5.435455855934631 },
+				{ 0.005407344544966578, 1.404613529898575, 0.214847559468213, -5.799100973351585, 14.17993336680509, -13.74514537774601, 4.645852612178535 },
+				{ 0.3340998053353061, 1.384590162594685, 0.09509516302823659, -19.33244095627987, 56.69055662738553, -65.35303263337234, 26.3124352495832 }
+			};
+			for( int c = 0; c < 3; ++c )
+			{
+				double v = 0;
+				for( int k = 6; k >= 0; --k ) v = v * t + coefs[ c ][ k ];
+				rgb[ c ] = v;
+			}
+		}
+
+		void colorizeScalar( const uint32_t* table, const uint16_t* depth, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				const uint16_t* src = depth + y * width;
+				uint32_t* out = reinterpret_cast< uint32_t* >( dst + y * dstPitch );
+				for( unsigned int x = 0; x < width; ++x )
+				{
+					out[ x ] = table[ src[ x ] ];
+				}
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_AVX2
+		void colorizeAvx2( const uint32_t* table, const uint16_t* depth, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch )
+		{
+			const unsigned int vectorWidth = width & ~7u;
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				const uint16_t* src = depth + y * width;
+				uint32_t* out = reinterpret_cast< uint32_t* >( dst + y * dstPitch );
+				for( unsigned int x = 0; x < vectorWidth; x += 8 )
+				{
+					const __m256i index = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + x ) ) );
+					const __m256i color = _mm256_i32gather_epi32( reinterpret_cast< const int* >( table ), index, 4 );
+					_mm256_storeu_si256( reinterpret_cast< __m256i* >( out + x ), color );
+				}
+				for( unsigned int x = vectorWidth; x < width; ++x )
+				{
+					out[ x ] = table[ src[ x ] ];
+				}
+			}
+		}
+#endif
+	}
+
+	DepthColorizer::DepthColorizer( Colormap colormap, uint16_t maxDepth, uint16_t minDepth )
+		: table_( TABLE_SIZE )
+	{
+		if( maxDepth <= minDepth )
+		{
+			throw std::invalid_argument( "maxDepth must be greater than minDepth" );
+		}
+
+		for( unsigned int d = 0; d < TABLE_SIZE; ++d )
+		{
+			uint8_t rgba[ 4 ] = { 0, 0, 0, 255 };
+			if( d != 0 )
+			{
+				const double t = std::min( std::max( ( static_cast< double >( d ) - minDepth ) / ( maxDepth - minDepth ), 0.0 ), 1.0 );
+				double rgb[ 3 ] = { t, t, t };
+				if( colormap == COLORMAP_TURBO ) turbo( t, rgb );
+				else if( colormap == COLORMAP_VIRIDIS ) viridis( t, rgb );
+				rgba[ 0 ] = toByte( rgb[ 0 ] );
+				rgba[ 1 ] = toByte( rgb[ 1 ] );
+				rgba[ 2 ] = toByte( rgb[ 2 ] );
+			}
+			memcpy( &table_[ d ], rgba, 4 );
+		}
+	}
+
+	void DepthColorizer::colorize( const uint16_t* depth, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstPitch, SimdLevel simd ) const
+	{
+		switch( resolveSimdLevel( simd ) )
+		{
+#if KINECT_X86
+		case SIMD_AVX2:
+			colorizeAvx2( table_.data(), depth, width, height, dst, dstPitch );
+			break;
+#endif
+		default:
+			colorizeScalar( table_.data(), depth, width, height, dst, dstPitch );
+			break;
+		}
+	}
+
+	uint8_t shaderGrayLevel( uint16_t depth )
+	{
+		const float texel = depth / 65535.0f;
+		const float color = std::min( std::max( texel * ( 65535.0f / 4500.0f ), 0.0f ), 1.0f );
+		return static_cast< uint8_t >( std::floor( color * 255.0f + 0.5f ) );
+	}
+
+} // namespace kinect
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	enum Colormap
+	{
+		COLORMAP_GRAY,		// same as KinectV2TestDepth/def.ps.hlsl
+		COLORMAP_TURBO,
+		COLORMAP_VIRIDIS
+	};
+
+	//! Depth frames to RGBA images on the CPU, for thumbnails and video without a GPU.
+	//! Every depth value has its color in a table of 65536 entries, so a frame costs
+	//! one lookup per pixel whatever the colormap.
+	class DepthColorizer
+	{
+	public:
+		enum
+		{
+			//! def.ps.hlsl scales by 65535 / 4500, white at 4.5 [m].
+			DEFAULT_MAX_DEPTH = 4500
+		};
+
+		//! Depth in [minDepth, maxDepth] [mm] spans the colormap. Invalid 0 is black.
+		explicit DepthColorizer( Colormap colormap = COLORMAP_GRAY,
+			uint16_t maxDepth = DEFAULT_MAX_DEPTH, uint16_t minDepth = 0 );
+
+		//! RGBA image of a depth frame into dst with dstPitch bytes per row.
+		//! All SIMD levels give the same image.
+		void colorize( const uint16_t* depth, unsigned int width, unsigned int height,
+			unsigned char* dst, std::size_t dstPitch, SimdLevel simd = SIMD_BEST ) const;
+
+		//! Color of a depth value, the R, G, B, A bytes in memory order.
+		uint32_t color( uint16_t depth ) const { return table_[ depth ]; }
+
+	private:
+		std::vector< uint32_t > table_;
+	};
+
+	//! Gray level def.ps.hlsl draws for a depth value : the R16_UNORM texel times
+	//! 65535 / 4500, saturated and stored to the R8G8B8A8_UNORM back buffer, in float.
+	uint8_t shaderGrayLevel( uint16_t depth );
+
+} // namespace kinect
@@ -0,0 +1,67 @@
+#include "Cpu.h"
+
+#if KINECT_X86 && defined( _MSC_VER )
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		SimdLevel detectSimdLevel()
+		{
+#if KINECT_X86 && defined( _MSC_VER )
+			int info[ 4 ];
+			__cpuid( info, 0 );
+			const int maxLeaf = info[ 0 ];
+
+			__cpuid( info, 1 );
+			const bool sse2 = ( info[ 3 ] & ( 1 << 26 ) ) != 0;
+			const bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+			const bool avx = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+			if( !sse2 ) return SIMD_SCALAR;
+
+			// AVX2 needs the OS to save YMM registers too.
+			if( maxLeaf >= 7 && osxsave && avx && ( _xgetbv( 0 ) & 6 ) == 6 )
+			{
+				__cpuidex( info, 7, 0 );
+				if( info[ 1 ] & ( 1 << 5 ) ) return SIMD_AVX2;
+			}
+			return SIMD_SSE2;
+#elif KINECT_X86 && defined( __GNUC__ )
+			__builtin_cpu_init();
+			if( __builtin_cpu_supports( "avx2" ) ) return SIMD_AVX2;
+			if( __builtin_cpu_supports( "sse2" ) ) return SIMD_SSE2;
+			return SIMD_SCALAR;
+#else
+			return SIMD_SCALAR;
+#endif
+		}
+	}
+
+	SimdLevel cpuSimdLevel()
+	{
+		static const SimdLevel level = detectSimdLevel();
+		return level;
+	}
+
+	SimdLevel resolveSimdLevel( SimdLevel requested )
+	{
+		const SimdLevel supported = cpuSimdLevel();
+		return ( requested == SIMD_BEST || requested > supported ) ? supported : requested;
+	}
+
+	const char* simdLevelName( SimdLevel level )
+	{
+		switch( level )
+		{
+		case SIMD_SCALAR: return "scalar";
+		case SIMD_SSE2: return "sse2";
+		case SIMD_AVX2: return "avx2";
+		case SIMD_BEST: return "best";
+		}
+		return "unknown";
+	}
+
+} // namespace kinect
@@ -0,0 +1,38 @@
+#pragma once
+
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#define KINECT_X86 1
+#else
+#define KINECT_X86 0
+#endif
+
+// GCC and Clang compile a function for an instruction set only if asked to.
+// Such functions must be called only after checking cpuSimdLevel().
+#if KINECT_X86 && defined( __GNUC__ )
+#define KINECT_TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#define KINECT_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#else
+#define KINECT_TARGET_SSE2
+#define KINECT_TARGET_AVX2
+#endif
+
+namespace kinect
+{
+	//! Instruction set used by a kernel.
+	enum SimdLevel
+	{
+		SIMD_SCALAR,
+		SIMD_SSE2,
+		SIMD_AVX2,
+		SIMD_BEST		// best level the CPU supports
+	};
+
+	//! Best level supported by this CPU.
+	SimdLevel cpuSimdLevel();
+
+	//! Replace SIMD_BEST and levels the CPU lacks with the best supported level.
+	SimdLevel resolveSimdLevel( SimdLevel requested );
+
+	const char* simdLevelName( SimdLevel level );
+
+} // namespace kinect
@@ -0,0 +1,401 @@
+#include "DepthCodec.h"
+#include <cstring>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		const char DEPTH_CODEC_MAGIC[ 4 ] = { 'K', 'V', '2', 'D' };
+		const unsigned char ZERO_RUN_FLAG = 0x80;
+
+		//! Number of bits to hold v.
+		inline unsigned int bitWidth( unsigned int v )
+		{
+			if( v == 0 ) return 0;
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse( &index, v );
+			return index + 1;
+#else
+			return 32 - __builtin_clz( v );
+#endif
+		}
+
+		inline uint16_t zigzag( uint16_t value, uint16_t prediction )
+		{
+			const unsigned int d = static_cast< uint16_t >( value - prediction );
+			return static_cast< uint16_t >( ( d << 1 ) ^ ( 0 - ( d >> 15 ) ) );
+		}
+
+		inline uint16_t unzigzag( uint16_t z, uint16_t prediction )
+		{
+			const uint16_t d = static_cast< uint16_t >( ( z >> 1 ) ^ ( 0 - ( z & 1 ) ) );
+			return static_cast< uint16_t >( prediction + d );
+		}
+
+		//! Prediction of the first pixel of a block at (x, y).
+		inline uint16_t blockPrediction( const uint16_t* p, unsigned int x, unsigned int y, unsigned int width )
+		{
+			if( x > 0 && p[ -1 ] != 0 ) return p[ -1 ];
+			return y > 0 ? p[ -static_cast< std::ptrdiff_t >( width ) ] : 0;
+		}
+
+		//! Store 8 values of bits width to bits bytes. Little endian.
+		inline void pack( const uint16_t* z, unsigned int bits, unsigned char* dst )
+		{
+			if( bits == 0 ) return;
+			if( bits == 16 )
+			{
+				memcpy( dst, z, 16 );
+				return;
+			}
+			uint64_t lo = 0;
+			uint64_t hi = 0;
+			for( unsigned int i = 0; i < 4; ++i )
+			{
+				lo |= static_cast< uint64_t >( z[ i ] ) << ( i * bits );
+				hi |= static_cast< uint64_t >( z[ i + 4 ] ) << ( i * bits );
+			}
+			const unsigned int half = bits * 4;
+			const uint64_t w0 = lo | ( hi << half );
+			const uint64_t w1 = hi >> ( 64 - half );
+			if( bits <= 8 )
+			{
+				memcpy( dst, &w0, bits );
+			}
+			else
+			{
+				memcpy( dst, &w0, 8 );
+				memcpy( dst + 8, &w1, bits - 8 );
+			}
+		}
+
+		inline void unpack( const unsigned char* src, unsigned int bits, uint16_t* z )
+		{
+			if( bits == 0 )
+			{
+				memset( z, 0, 16 );
+				return;
+			}
+			if( bits == 16 )
+			{
+				memcpy( z, src, 16 );
+				return;
+			}
+			uint64_t w0 = 0;
+			uint64_t w1 = 0;
+			if( bits <= 8 )
+			{
+				memcpy( &w0, src, bits );
+			}
+			else
+			{
+				memcpy( &w0, src, 8 );
+				memcpy( &w1, src + 8, bits - 8 );
+			}
+			const unsigned int half = bits * 4;
+			const uint64_t lo = w0;
+			const uint64_t hi = ( w0 >> half ) | ( w1 << ( 64 - half ) );
+			const uint64_t mask = ( 1u << bits ) - 1;
+			for( unsigned int i = 0; i < 4; ++i )
+			{
+				z[ i ] = static_cast< uint16_t >( ( lo >> ( i * bits ) ) & mask );
+				z[ i + 4 ] = static_cast< uint16_t >( ( hi >> ( i * bits ) ) & mask );
+			}
+		}
+
+		//! Output of encoder, merging zero blocks into runs.
+		struct BlockWriter
+		{
+			explicit BlockWriter( unsigned char* dst ) : out_( dst ), zeroRun_( 0 ) {}
+
+			void zeroBlock()
+			{
+				if( ++zeroRun_ == DEPTH_CODEC_MAX_ZERO_RUN ) flush();
+			}
+
+			void block( const uint16_t* z, unsigned int bits )
+			{
+				flush();
+				*out_++ = static_cast< unsigned char >( bits );
+				pack( z, bits, out_ );
+				out_ += bits;
+			}
+
+			void flush()
+			{
+				if( zeroRun_ == 0 ) return;
+				*out_++ = static_cast< unsigned char >( ZERO_RUN_FLAG | zeroRun_ );
+				zeroRun_ = 0;
+			}
+
+			unsigned char* out_;
+			unsigned int zeroRun_;
+		};
+
+		//! Input of decoder with bounds check.
+		struct BlockReader
+		{
+			BlockReader( const unsigned char* src, const unsigned char* end ) : in_( src ), end_( end ) {}
+
+			unsigned char header()
+			{
+				if( in_ >= end_ ) throw std::runtime_error( "Depth data is truncated" );
+				return *in_++;
+			}
+
+			const unsigned char* payload( unsigned int bits )
+			{
+				if( bits > 16 ) throw std::runtime_error( "Depth data is broken" );
+				if( static_cast< std::size_t >( end_ - in_ ) < bits ) throw std::runtime_error( "Depth data is truncated" );
+				const unsigned char* p = in_;
+				in_ += bits;
+				return p;
+			}
+
+			const unsigned char* in_;
+			const unsigned char* end_;
+		};
+
+		void encodeScalar( const uint16_t* src, unsigned int width, unsigned int height, BlockWriter& writer )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; x += DEPTH_CODEC_BLOCK )
+				{
+					const uint16_t* p = src + y * width + x;
+					uint16_t z[ DEPTH_CODEC_BLOCK ];
+					unsigned int any = 0;
+					unsigned int bits = 0;
+					uint16_t prediction = blockPrediction( p, x, y, width );
+					for( unsigned int i = 0; i < DEPTH_CODEC_BLOCK; ++i )
+					{
+						any |= p[ i ];
+						z[ i ] = zigzag( p[ i ], prediction );
+						bits |= z[ i ];
+						prediction = p[ i ];
+					}
+					if( any == 0 ) writer.zeroBlock();
+					else writer.block( z, bitWidth( bits ) );
+				}
+			}
+			writer.flush();
+		}
+
+		void decodeScalar( BlockReader& reader, uint16_t* dst, unsigned int width, unsigned int height )
+		{
+			const std::size_t blockCount = static_cast< std::size_t >( width / DEPTH_CODEC_BLOCK ) * height;
+			const unsigned int blocksPerRow = width / DEPTH_CODEC_BLOCK;
+			for( std::size_t block = 0; block < blockCount; )
+			{
+				const unsigned char header = reader.header();
+				if( header & ZERO_RUN_FLAG )
+				{
+					const std::size_t run = header & ~ZERO_RUN_FLAG;
+					if( run == 0 || block + run > blockCount ) throw std::runtime_error( "Depth data is broken" );
+					memset( dst + block * DEPTH_CODEC_BLOCK, 0, run * DEPTH_CODEC_BLOCK * sizeof( uint16_t ) );
+					block += run;
+					continue;
+				}
+
+				uint16_t z[ DEPTH_CODEC_BLOCK ];
+				unpack( reader.payload( header ), header, z );
+
+				const unsigned int x = static_cast< unsigned int >( block % blocksPerRow ) * DEPTH_CODEC_BLOCK;
+				const unsigned int y = static_cast< unsigned int >( block / blocksPerRow );
+				uint16_t* p = dst + block * DEPTH_CODEC_BLOCK;
+				uint16_t prediction = blockPrediction( p, x, y, width );
+				for( unsigned int i = 0; i < DEPTH_CODEC_BLOCK; ++i )
+				{
+					p[ i ] = unzigzag( z[ i ], prediction );
+					prediction = p[ i ];
+				}
+				++block;
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void encodeSse2( const uint16_t* src, unsigned int width, unsigned int height, BlockWriter& writer )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; x += DEPTH_CODEC_BLOCK )
+				{
+					const uint16_t* p = src + y * width + x;
+					const __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) );
+					if( _mm_movemask_epi8( _mm_cmpeq_epi16( v, zero ) ) == 0xFFFF )
+					{
+						writer.zeroBlock();
+						continue;
+					}
+
+					// Residual to the left pixel, lane 0 to the block prediction.
+					const __m128i left = _mm_or_si128(
+						_mm_slli_si128( v, 2 ), _mm_cvtsi32_si128( blockPrediction( p, x, y, width ) ) );
+					const __m128i d = _mm_sub_epi16( v, left );
+					const __m128i z = _mm_xor_si128( _mm_slli_epi16( d, 1 ), _mm_srai_epi16( d, 15 ) );
+
+					// OR of all lanes has the same bit width as the maximum.
+					__m128i o = _mm_or_si128( z, _mm_srli_si128( z, 8 ) );
+					o = _mm_or_si128( o, _mm_srli_si128( o, 4 ) );
+					o = _mm_or_si128( o, _mm_srli_si128( o, 2 ) );
+					const unsigned int bits = bitWidth( _mm_cvtsi128_si32( o ) & 0xFFFF );
+
+					uint16_t lanes[ DEPTH_CODEC_BLOCK ];
+					_mm_storeu_si128( reinterpret_cast< __m128i* >( lanes ), z );
+					writer.block( lanes, bits );
+				}
+			}
+			writer.flush();
+		}
+
+		KINECT_TARGET_SSE2
+		void decodeSse2( BlockReader& reader, uint16_t* dst, unsigned int width, unsigned int height )
+		{
+			const std::size_t blockCount = static_cast< std::size_t >( width / DEPTH_CODEC_BLOCK ) * height;
+			const unsigned int blocksPerRow = width / DEPTH_CODEC_BLOCK;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i one = _mm_set1_epi16( 1 );
+			for( std::size_t block = 0; block < blockCount; )
+			{
+				const unsigned char header = reader.header();
+				if( header & ZERO_RUN_FLAG )
+				{
+					const std::size_t run = header & ~ZERO_RUN_FLAG;
+					if( run == 0 || block + run > blockCount ) throw std::runtime_error( "Depth data is broken" );
+					for( std::size_t i = 0; i < run; ++i )
+					{
+						_mm_storeu_si128( reinterpret_cast< __m128i* >( dst + ( block + i ) * DEPTH_CODEC_BLOCK ), zero );
+					}
+					block += run;
+					continue;
+				}
+
+				uint16_t lanes[ DEPTH_CODEC_BLOCK ];
+				unpack( reader.payload( header ), header, lanes );
+				const __m128i z = _mm_loadu_si128( reinterpret_cast< const __m128i* >( lanes ) );
+
+				// Undo zigzag, then prefix sum of residuals on the prediction.
+				__m128i d = _mm_xor_si128( _mm_srli_epi16( z, 1 ), _mm_sub_epi16( zero, _mm_and_si128( z, one ) ) );
+				d = _mm_add_epi16( d, _mm_slli_si128( d, 2 ) );
+				d = _mm_add_epi16( d, _mm_slli_si128( d, 4 ) );
+				d = _mm_add_epi16( d, _mm_slli_si128( d, 8 ) );
+
+				const unsigned int x = static_cast< unsigned int >( block % blocksPerRow ) * DEPTH_CODEC_BLOCK;
+				const unsigned int y = static_cast< unsigned int >( block / blocksPerRow );
+				uint16_t* p = dst + block * DEPTH_CODEC_BLOCK;
+				const __m128i prediction = _mm_set1_epi16( static_cast< short >( blockPrediction( p, x, y, width ) ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( p ), _mm_add_epi16( d, prediction ) );
+				++block;
+			}
+		}
+#endif
+
+		void writeU16( unsigned char* dst, unsigned int v )
+		{
+			dst[ 0 ] = static_cast< unsigned char >( v );
+			dst[ 1 ] = static_cast< unsigned char >( v >> 8 );
+		}
+
+		void writeU32( unsigned char* dst, uint32_t v )
+		{
+			writeU16( dst, v & 0xFFFF );
+			writeU16( dst + 2, v >> 16 );
+		}
+
+		uint32_t readU16( const unsigned char* src )
+		{
+			return src[ 0 ] | ( src[ 1 ] << 8 );
+		}
+
+		uint32_t readU32( const unsigned char* src )
+		{
+			return readU16( src ) | ( readU16( src + 2 ) << 16 );
+		}
+	}
+
+	std::size_t depthCodecMaxEncodedSize( unsigned int width, unsigned int height )
+	{
+		const std::size_t blockCount = static_cast< std::size_t >( width / DEPTH_CODEC_BLOCK ) * height;
+		return DEPTH_CODEC_HEADER_SIZE + blockCount * ( 1 + DEPTH_CODEC_BLOCK * sizeof( uint16_t ) );
+	}
+
+	std::size_t encodeDepth( const uint16_t* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstCapacity, SimdLevel simd )
+	{
+		if( width % DEPTH_CODEC_BLOCK != 0 || width > 0xFFFF || height > 0xFFFF )
+		{
+			throw std::invalid_argument( "Depth frame size is not supported" );
+		}
+		if( dstCapacity < depthCodecMaxEncodedSize( width, height ) )
+		{
+			throw std::invalid_argument( "Depth codec output buffer is too small" );
+		}
+
+		BlockWriter writer( dst + DEPTH_CODEC_HEADER_SIZE );
+#if KINECT_X86
+		if( resolveSimdLevel( simd ) >= SIMD_SSE2 ) encodeSse2( src, width, height, writer );
+		else encodeScalar( src, width, height, writer );
+#else
+		static_cast< void >( simd );
+		encodeScalar( src, width, height, writer );
+#endif
+
+		const std::size_t size = writer.out_ - dst;
+		memcpy( dst, DEPTH_CODEC_MAGIC, sizeof DEPTH_CODEC_MAGIC );
+		writeU16( dst + 4, width );
+		writeU16( dst + 6, height );
+		writeU32( dst + 8, static_cast< uint32_t >( size - DEPTH_CODEC_HEADER_SIZE ) );
+		return size;
+	}
+
+	bool readDepthCodecHeader( const unsigned char* src, std::size_t srcSize, unsigned int& width, unsigned int& height )
+	{
+		if( srcSize < DEPTH_CODEC_HEADER_SIZE || memcmp( src, DEPTH_CODEC_MAGIC, sizeof DEPTH_CODEC_MAGIC ) != 0 )
+		{
+			return false;
+		}
+		width = readU16( src + 4 );
+		height = readU16( src + 6 );
+		return true;
+	}
+
+	void decodeDepth( const unsigned char* src, std::size_t srcSize,
+		uint16_t* dst, unsigned int width, unsigned int height, SimdLevel simd )
+	{
+		unsigned int encodedWidth, encodedHeight;
+		if( !readDepthCodecHeader( src, srcSize, encodedWidth, encodedHeight ) )
+		{
+			throw std::runtime_error( "Not encoded depth data" );
+		}
+		if( encodedWidth != width || encodedHeight != height || width % DEPTH_CODEC_BLOCK != 0 )
+		{
+			throw std::runtime_error( "Encoded depth size does not match" );
+		}
+		const uint32_t payloadSize = readU32( src + 8 );
+		if( payloadSize > srcSize - DEPTH_CODEC_HEADER_SIZE )
+		{
+			throw std::runtime_error( "Depth data is truncated" );
+		}
+
+		BlockReader reader( src + DEPTH_CODEC_HEADER_SIZE, src + DEPTH_CODEC_HEADER_SIZE + payloadSize );
+#if KINECT_X86
+		if( resolveSimdLevel( simd ) >= SIMD_SSE2 ) decodeSse2( reader, dst, width, height );
+		else decodeScalar( reader, dst, width, height );
+#else
+		static_cast< void >( simd );
+		decodeScalar( reader, dst, width, height );
+#endif
+	}
+
+} // namespace kinect
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Cpu.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace kinect
+{
+	//! Lossless codec for UINT16 depth frames.
+	//!
+	//! Pixels are coded in blocks of 8 along a row. Each pixel is predicted from its left
+	//! neighbour; the first pixel of a block uses the left pixel, or the pixel above if the
+	//! left one is invalid (0). Zigzag coded residuals of a block are bit packed with the
+	//! width of the largest one, so a block takes 1 + width bytes.
+	//! Blocks of only invalid pixels are run-length coded, up to 127 blocks per byte.
+	//!
+	//!   header : "KV2D", width (uint16), height (uint16), payload size (uint32)
+	//!   block  : 0-16 = bit width, followed by (bit width) bytes
+	//!            0x80 | n = n blocks of 0
+	enum
+	{
+		DEPTH_CODEC_BLOCK = 8,
+		DEPTH_CODEC_HEADER_SIZE = 12,
+		DEPTH_CODEC_MAX_ZERO_RUN = 127
+	};
+
+	//! Upper bound of the encoded size. Width must be a multiple of DEPTH_CODEC_BLOCK.
+	std::size_t depthCodecMaxEncodedSize( unsigned int width, unsigned int height );
+
+	//! Encode a frame. Return the encoded size.
+	//! Throw std::invalid_argument if width is not a multiple of DEPTH_CODEC_BLOCK
+	//! or dst is smaller than depthCodecMaxEncodedSize().
+	std::size_t encodeDepth( const uint16_t* src, unsigned int width, unsigned int height,
+		unsigned char* dst, std::size_t dstCapacity, SimdLevel simd = SIMD_BEST );
+
+	//! Read the frame size from an encoded frame. Return false if it is not one.
+	bool readDepthCodecHeader( const unsigned char* src, std::size_t srcSize, unsigned int& width, unsigned int& height );
+
+	//! Decode a frame of the given size.
+	//! Throw std::runtime_error if the data is broken or the size does not match.
+	void decodeDepth( const unsigned char* src, std::size_t srcSize,
+		uint16_t* dst, unsigned int width, unsigned int height, SimdLevel simd = SIMD_BEST );
+
+} // namespace kinect
@@ -0,0 +1,119 @@
+#include "DepthProcessor.h"
+#include "CameraModel.h"
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+namespace kinect
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		double elapsedSeconds( Clock::time_point start )
+		{
+			return std::chrono::duration< double >( Clock::now() - start ).count();
+		}
+	}
+
+	DepthProcessor::DepthProcessor( unsigned int width, unsigned int height, unsigned int flags, unsigned int threadCount )
+		: width_( width ), height_( height ), flags_( flags )
+	{
+		if( width == 0 || height == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+		if( flags & DEPTH_DENOISE )
+		{
+			temporalFilter_.reset( new TemporalDepthFilter( width, height ) );
+		}
+		if( flags & DEPTH_SMOOTH )
+		{
+			spatialFilter_.reset( new BilateralDepthFilter( width, height ) );
+			smoothed_.resize( static_cast< std::size_t >( width ) * height );
+		}
+		if( flags & DEPTH_POINT_CLOUD )
+		{
+			pointCloudGenerator_.reset( new PointCloudGenerator( kinectDepthIntrinsics(), width, height ) );
+		}
+		if( flags & ( DEPTH_SMOOTH | DEPTH_POINT_CLOUD ) )
+		{
+			pool_.reset( new ThreadPool( threadCount ) );
+		}
+		denoiseTime_.frames = smoothTime_.frames = pointCloudTime_.frames = 0;
+		denoiseTime_.seconds = smoothTime_.seconds = pointCloudTime_.seconds = 0;
+	}
+
+	void DepthProcessor::setCameraSpaceTable( const float* table )
+	{
+		if( flags_ & DEPTH_POINT_CLOUD )
+		{
+			pointCloudGenerator_.reset( new PointCloudGenerator( table, width_, height_ ) );
+		}
+	}
+
+	void DepthProcessor::denoise( uint16_t* depth )
+	{
+		if( !temporalFilter_ )
+		{
+			return;
+		}
+		const auto start = Clock::now();
+		temporalFilter_->apply( depth, depth );
+		denoiseTime_.seconds += elapsedSeconds( start );
+		++denoiseTime_.frames;
+	}
+
+	FrameView DepthProcessor::process( const FrameView& frame )
+	{
+		if( frame.format != PIXEL_FORMAT_DEPTH16 || frame.width != width_ || frame.height != height_ )
+		{
+			throw std::invalid_argument( "Not a depth frame of the processor size" );
+		}
+
+		FrameView view = frame;
+		if( spatialFilter_ )
+		{
+			const auto start = Clock::now();
+			spatialFilter_->apply( reinterpret_cast< const uint16_t* >( frame.data ), smoothed_.data(), *pool_ );
+			view.data = reinterpret_cast< const unsigned char* >( smoothed_.data() );
+			smoothTime_.seconds += elapsedSeconds( start );
+			++smoothTime_.frames;
+		}
+		if( pointCloudGenerator_ )
+		{
+			const auto start = Clock::now();
+			pointCloudGenerator_->generate( reinterpret_cast< const uint16_t* >( view.data ), pointCloud_, *pool_ );
+			pointCloudTime_.seconds += elapsedSeconds( start );
+			++pointCloudTime_.frames;
+		}
+		return view;
+	}
+
+	std::string DepthProcessor::summary() const
+	{
+		std::stringstream ss;
+		const char* separator = "";
+		const auto stage = [&]( const char* name, const StageTime& time ) {
+			ss << separator << name << " : " << time.frames << " frames, " << time.seconds / time.frames * 1e3 << " [ms] per frame";
+			separator = "\n";
+		};
+		if( denoiseTime_.frames > 0 )
+		{
+			stage( "Denoise", denoiseTime_ );
+		}
+		if( smoothTime_.frames > 0 )
+		{
+			stage( "Smooth", smoothTime_ );
+			ss << " on " << pool_->threadCount() << " threads";
+		}
+		if( pointCloudTime_.frames > 0 )
+		{
+			stage( "Point cloud", pointCloudTime_ );
+			ss << ", " << pointCloudTime_.frames * pointCloud_.size() / pointCloudTime_.seconds / 1e6 << " Mpoints/s on "
+				<< pool_->threadCount() << " threads";
+		}
+		return ss.str();
+	}
+
+} // namespace kinect
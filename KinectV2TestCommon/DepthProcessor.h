@@ -0,0 +1,83 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "PointCloud.h"
+#include "SpatialFilter.h"
+#include "TemporalFilter.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	//! Stages of DepthProcessor.
+	enum DepthProcessingFlags
+	{
+		DEPTH_DENOISE = 1 << 0,			// median of the last frames, TemporalDepthFilter
+		DEPTH_SMOOTH = 1 << 1,			// edge-preserving smoothing, BilateralDepthFilter
+		DEPTH_POINT_CLOUD = 1 << 2		// camera space points, PointCloudGenerator
+	};
+
+	//! Processing of a depth stream, the same in KinectV2TestDepth and in KinectV2TestCli.
+	//!
+	//! denoise() must see every frame in order, as the temporal filter keeps a history;
+	//! the app calls it on the acquisition thread. process() smooths a frame and makes its
+	//! points, for the frames the app shows on the render thread or for all frames of a
+	//! batch. denoise() and process() may run at the same time on two threads.
+	class DepthProcessor
+	{
+	public:
+		//! flags are DepthProcessingFlags. Smoothing and the points run on a pool of
+		//! threadCount threads, 0 for one per hardware thread.
+		DepthProcessor( unsigned int width, unsigned int height, unsigned int flags, unsigned int threadCount = 0 );
+
+		unsigned int flags() const { return flags_; }
+
+		//! Make the points through the rays of ICoordinateMapper::GetDepthFrameToCameraSpaceTable,
+		//! x and y at z = 1 [m] per pixel, instead of those of kinectDepthIntrinsics().
+		//! Not while process() runs.
+		void setCameraSpaceTable( const float* table );
+
+		//! Filter a frame [mm] in place with DEPTH_DENOISE, else do nothing.
+		void denoise( uint16_t* depth );
+
+		//! Smooth a depth frame with DEPTH_SMOOTH and make its points with DEPTH_POINT_CLOUD.
+		//! Return the smoothed frame, valid until the next call, or frame without DEPTH_SMOOTH.
+		FrameView process( const FrameView& frame );
+
+		//! Points of the last frame processed with DEPTH_POINT_CLOUD.
+		const PointCloud& pointCloud() const { return pointCloud_; }
+
+		//! Threads of smoothing and the points, null without DEPTH_SMOOTH and DEPTH_POINT_CLOUD.
+		ThreadPool* pool() const { return pool_.get(); }
+
+		//! Frames and time per frame of each stage so far, one line each.
+		std::string summary() const;
+
+	private:
+		DepthProcessor( const DepthProcessor& ) = delete;
+		DepthProcessor& operator=( const DepthProcessor& ) = delete;
+
+		struct StageTime
+		{
+			uint64_t frames;
+			double seconds;
+		};
+
+		unsigned int width_;
+		unsigned int height_;
+		unsigned int flags_;
+		std::unique_ptr< ThreadPool > pool_;
+		std::unique_ptr< TemporalDepthFilter > temporalFilter_;
+		std::unique_ptr< BilateralDepthFilter > spatialFilter_;
+		std::unique_ptr< PointCloudGenerator > pointCloudGenerator_;
+		std::vector< uint16_t > smoothed_;
+		PointCloud pointCloud_;
+		StageTime denoiseTime_;			// of the thread of denoise()
+		StageTime smoothTime_;			// of the thread of process()
+		StageTime pointCloudTime_;
+	};
+
+} // namespace kinect
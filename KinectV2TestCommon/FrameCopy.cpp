@@ -0,0 +1,112 @@
+#include "FrameCopy.h"
+#include "Cpu.h"
+#include "Trace.h"
+#include <cstring>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <emmintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+#if KINECT_X86
+		//! Copy with non-temporal stores. The caller issues the store fence.
+		KINECT_TARGET_SSE2
+		void streamCopy( const unsigned char* src, unsigned char* dst, std::size_t size )
+		{
+			// Streaming stores need 16 byte aligned destination.
+			std::size_t head = ( 16 - ( reinterpret_cast< std::size_t >( dst ) & 15 ) ) & 15;
+			if( head > size ) head = size;
+			memcpy( dst, src, head );
+			src += head;
+			dst += head;
+			size -= head;
+
+			for( ; size >= 64; size -= 64, src += 64, dst += 64 )
+			{
+				const __m128i a = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src ) );
+				const __m128i b = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 16 ) );
+				const __m128i c = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 32 ) );
+				const __m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 48 ) );
+				_mm_stream_si128( reinterpret_cast< __m128i* >( dst ), a );
+				_mm_stream_si128( reinterpret_cast< __m128i* >( dst + 16 ), b );
+				_mm_stream_si128( reinterpret_cast< __m128i* >( dst + 32 ), c );
+				_mm_stream_si128( reinterpret_cast< __m128i* >( dst + 48 ), d );
+			}
+			for( ; size >= 16; size -= 16, src += 16, dst += 16 )
+			{
+				_mm_stream_si128( reinterpret_cast< __m128i* >( dst ), _mm_loadu_si128( reinterpret_cast< const __m128i* >( src ) ) );
+			}
+			memcpy( dst, src, size );
+		}
+
+		KINECT_TARGET_SSE2
+		void streamCopyRows( const unsigned char* src, std::size_t srcPitch, unsigned char* dst, std::size_t dstPitch,
+			std::size_t rowSize, unsigned int height )
+		{
+			if( srcPitch == rowSize && dstPitch == rowSize )
+			{
+				streamCopy( src, dst, rowSize * height );
+			}
+			else
+			{
+				for( unsigned int y = 0; y < height; ++y )
+				{
+					streamCopy( src + y * srcPitch, dst + y * dstPitch, rowSize );
+				}
+			}
+			_mm_sfence();
+		}
+#endif
+	}
+
+	template< unsigned int PixelSize >
+	void copyPitched( const unsigned char* src, std::size_t srcPitch, unsigned char* dst, std::size_t dstPitch,
+		unsigned int width, unsigned int height, CopyMode mode )
+	{
+		const std::size_t rowSize = static_cast< std::size_t >( width ) * PixelSize;
+		if( mode == COPY_AUTO )
+		{
+			mode = ( rowSize * height >= COPY_STREAM_THRESHOLD ) ? COPY_STREAM : COPY_ROWS;
+		}
+
+#if KINECT_X86
+		if( mode == COPY_STREAM && cpuSimdLevel() >= SIMD_SSE2 )
+		{
+			streamCopyRows( src, srcPitch, dst, dstPitch, rowSize, height );
+			return;
+		}
+#endif
+
+		if( srcPitch == rowSize && dstPitch == rowSize )
+		{
+			memcpy( dst, src, rowSize * height );
+			return;
+		}
+		for( unsigned int y = 0; y < height; ++y )
+		{
+			memcpy( dst + y * dstPitch, src + y * srcPitch, rowSize );
+		}
+	}
+
+	template void copyPitched< 1 >( const unsigned char*, std::size_t, unsigned char*, std::size_t, unsigned int, unsigned int, CopyMode );
+	template void copyPitched< 2 >( const unsigned char*, std::size_t, unsigned char*, std::size_t, unsigned int, unsigned int, CopyMode );
+	template void copyPitched< 4 >( const unsigned char*, std::size_t, unsigned char*, std::size_t, unsigned int, unsigned int, CopyMode );
+
+	void copyFrame( const FrameView& frame, unsigned char* dst, std::size_t dstPitch, CopyMode mode )
+	{
+		KINECT_TRACE_SCOPE( "CopyRows" );
+		const std::size_t srcPitch = frame.rowSize();
+		switch( frame.bytesPerPixel )
+		{
+		case 1: copyPitched< 1 >( frame.data, srcPitch, dst, dstPitch, frame.width, frame.height, mode ); break;
+		case 2: copyPitched< 2 >( frame.data, srcPitch, dst, dstPitch, frame.width, frame.height, mode ); break;
+		case 4: copyPitched< 4 >( frame.data, srcPitch, dst, dstPitch, frame.width, frame.height, mode ); break;
+		default: throw std::invalid_argument( "Unsupported pixel size" );
+		}
+	}
+
+} // namespace kinect
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "FrameSource.h"
+#include <cstddef>
+
+namespace kinect
+{
+	enum CopyMode
+	{
+		COPY_AUTO,		// streaming stores for frames of COPY_STREAM_THRESHOLD bytes or more
+		COPY_ROWS,		// memcpy per row
+		COPY_STREAM		// non-temporal stores, bypassing the cache
+	};
+
+	enum
+	{
+		//! Frames this large would evict most of the cache, e.g. 1920x1080 RGBA.
+		COPY_STREAM_THRESHOLD = 2 * 1024 * 1024
+	};
+
+	//! Copy height rows of width pixels between buffers of different row pitch.
+	//! Rows are copied as one block when both pitches equal the row size.
+	//! Instantiated for PixelSize 1 (body index), 2 (depth) and 4 (RGBA). PixelSize only sets
+	//! the row size : rows are copied as bytes, by memcpy or 16 byte streaming stores, so all
+	//! sizes run the same loops. A copy per pixel type is no faster, see copy.*.stdcopy in the bench.
+	template< unsigned int PixelSize >
+	void copyPitched( const unsigned char* src, std::size_t srcPitch, unsigned char* dst, std::size_t dstPitch,
+		unsigned int width, unsigned int height, CopyMode mode = COPY_AUTO );
+
+	//! Copy a packed frame into a texture with dstPitch bytes per row.
+	void copyFrame( const FrameView& frame, unsigned char* dst, std::size_t dstPitch, CopyMode mode = COPY_AUTO );
+
+} // namespace kinect
@@ -0,0 +1,115 @@
+#include "FramePipeline.h"
+#include <stdexcept>
+
+namespace kinect
+{
+	void FrameSet::clear()
+	{
+		streams_ = 0;
+		relativeTime_ = 0;
+		for( auto& image : images_ ) image.reset();
+		body_.reset();
+	}
+
+	FramePipeline::FramePipeline( const PipelineSources& sources, unsigned int streams, int64_t toleranceTicks )
+		: bodySource_( sources.body_ ), streams_( streams & STREAM_FLAG_ALL ), tolerance_( toleranceTicks ),
+		hasReady_( false ), completeCount_( 0 ), partialCount_( 0 ), droppedCount_( 0 )
+	{
+		imageSources_[ STREAM_DEPTH ] = sources.depth_;
+		imageSources_[ STREAM_COLOR ] = sources.color_;
+		imageSources_[ STREAM_BODY_INDEX ] = sources.bodyIndex_;
+
+		for( int type = 0; type < STREAM_IMAGE_COUNT; ++type )
+		{
+			if( ( streams_ & ( 1u << type ) ) && !imageSources_[ type ] )
+			{
+				throw std::invalid_argument( "Enabled stream has no source" );
+			}
+		}
+		if( ( streams_ & STREAM_FLAG_BODY ) && !bodySource_ )
+		{
+			throw std::invalid_argument( "Enabled stream has no source" );
+		}
+		if( streams_ == 0 )
+		{
+			throw std::invalid_argument( "No stream enabled" );
+		}
+	}
+
+	bool FramePipeline::poll( FrameSet& set )
+	{
+		for( int i = 0; i < STREAM_IMAGE_COUNT; ++i )
+		{
+			const StreamType type = static_cast< StreamType >( i );
+			if( !( streams_ & ( 1u << type ) ) )
+			{
+				continue;
+			}
+			auto buffer = imagePool_[ type ].acquire();
+			if( convertLatestFrame( *imageSources_[ type ], *buffer ) && accept( type, buffer->view_.relativeTime ) )
+			{
+				building_.images_[ type ] = buffer;
+				if( building_.streams_ == streams_ ) finish();
+			}
+		}
+
+		if( streams_ & STREAM_FLAG_BODY )
+		{
+			auto frame = bodyPool_.acquire();
+			if( bodySource_->acquireLatestFrame( *frame ) && accept( STREAM_BODY, frame->relativeTime ) )
+			{
+				building_.body_ = frame;
+				if( building_.streams_ == streams_ ) finish();
+			}
+		}
+
+		if( !hasReady_ )
+		{
+			return false;
+		}
+		set = ready_;
+		ready_.clear();
+		hasReady_ = false;
+		return true;
+	}
+
+	bool FramePipeline::accept( StreamType type, int64_t time )
+	{
+		if( building_.streams_ != 0 )
+		{
+			const int64_t delta = time - building_.relativeTime_;
+			if( delta < -tolerance_ )
+			{
+				++droppedCount_;
+				return false;
+			}
+			if( delta > tolerance_ || building_.has( type ) )
+			{
+				finish();
+			}
+		}
+
+		if( building_.streams_ == 0 )
+		{
+			building_.relativeTime_ = time;
+		}
+		building_.streams_ |= 1u << type;
+		return true;
+	}
+
+	void FramePipeline::finish()
+	{
+		if( building_.streams_ == streams_ )
+		{
+			++completeCount_;
+		}
+		else
+		{
+			++partialCount_;
+		}
+		ready_ = building_;
+		hasReady_ = true;
+		building_.clear();
+	}
+
+} // namespace kinect
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "AcquisitionThread.h"
+#include "BufferPool.h"
+#include "FrameSource.h"
+#include <memory>
+
+namespace kinect
+{
+	enum StreamType
+	{
+		STREAM_DEPTH,
+		STREAM_COLOR,
+		STREAM_BODY_INDEX,
+		STREAM_BODY,
+		STREAM_COUNT,
+		STREAM_IMAGE_COUNT = STREAM_BODY		// streams of image frames
+	};
+
+	enum StreamFlags
+	{
+		STREAM_FLAG_DEPTH = 1 << STREAM_DEPTH,
+		STREAM_FLAG_COLOR = 1 << STREAM_COLOR,
+		STREAM_FLAG_BODY_INDEX = 1 << STREAM_BODY_INDEX,
+		STREAM_FLAG_BODY = 1 << STREAM_BODY,
+		STREAM_FLAG_ALL = ( 1 << STREAM_COUNT ) - 1
+	};
+
+	//! Frames of the streams taken at about the same time.
+	//! Frames are shared, not copied : every copy of a set refers to the same buffers,
+	//! which stay alive while any set refers to them. Color is converted to RGBA.
+	struct FrameSet
+	{
+		FrameSet() : streams_( 0 ), relativeTime_( 0 ) {}
+
+		bool has( StreamType type ) const { return ( streams_ & ( 1u << type ) ) != 0; }
+		void clear();
+
+		unsigned int streams_;		// StreamFlags of the frames present
+		int64_t relativeTime_;		// of the first frame put in the set
+		std::shared_ptr< const FrameBuffer > images_[ STREAM_IMAGE_COUNT ];
+		std::shared_ptr< const BodyFrame > body_;
+	};
+
+	//! Sources of the streams. Streams that are not enabled may be null.
+	struct PipelineSources
+	{
+		PipelineSources() : depth_( nullptr ), color_( nullptr ), bodyIndex_( nullptr ), body_( nullptr ) {}
+
+		FrameSource* depth_;
+		FrameSource* color_;
+		FrameSource* bodyIndex_;
+		BodyFrameSource* body_;
+	};
+
+	//! Acquires each enabled stream once and groups the frames into sets by RelativeTime.
+	//!
+	//! A frame joins the set being built if it is within the tolerance of the set's time and
+	//! its stream has no frame in the set yet. Otherwise the set is finished first, partial if
+	//! it lacks an enabled stream, and the frame starts the next set. A set holding every
+	//! enabled stream is finished at once. Frames older than the set being built are dropped.
+	//!
+	//! poll() fits the producer of an AcquisitionThread< FrameSet >.
+	class FramePipeline
+	{
+	public:
+		FramePipeline( const PipelineSources& sources, unsigned int streams,
+			int64_t toleranceTicks = FRAME_INTERVAL_TICKS / 2 );
+
+		//! Acquire from each enabled stream. Return true and the newest finished set, if any.
+		bool poll( FrameSet& set );
+
+		unsigned int streams() const { return streams_; }
+		uint64_t completeCount() const { return completeCount_; }
+		uint64_t partialCount() const { return partialCount_; }
+		uint64_t droppedCount() const { return droppedCount_; }
+
+	private:
+		FramePipeline( const FramePipeline& ) = delete;
+		FramePipeline& operator=( const FramePipeline& ) = delete;
+
+		//! Make room for a frame of the stream at time. Return false if the frame is dropped.
+		bool accept( StreamType type, int64_t time );
+		void finish();
+
+		FrameSource* imageSources_[ STREAM_IMAGE_COUNT ];
+		BodyFrameSource* bodySource_;
+		unsigned int streams_;
+		int64_t tolerance_;
+
+		FrameSet building_;
+		FrameSet ready_;
+		bool hasReady_;
+
+		// Buffers come back once no set refers to them any more, from any thread.
+		BufferPool< FrameBuffer > imagePool_[ STREAM_IMAGE_COUNT ];
+		BufferPool< BodyFrame > bodyPool_;
+
+		uint64_t completeCount_;
+		uint64_t partialCount_;
+		uint64_t droppedCount_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,101 @@
+#include "FrameScheduler.h"
+#include <sstream>
+#include <thread>
+
+namespace kinect
+{
+	void LatencyHistogram::reset()
+	{
+		count_ = 0;
+		max_ = 0;
+		for( auto& bucket : buckets_ ) bucket = 0;
+	}
+
+	void LatencyHistogram::add( double microseconds )
+	{
+		int bucket = static_cast< int >( microseconds / BUCKET_US );
+		if( bucket < 0 ) bucket = 0;
+		if( bucket >= BUCKET_COUNT ) bucket = BUCKET_COUNT - 1;
+		++buckets_[ bucket ];
+		++count_;
+		if( microseconds > max_ ) max_ = microseconds;
+	}
+
+	double LatencyHistogram::percentile( double p ) const
+	{
+		if( count_ == 0 )
+		{
+			return 0;
+		}
+		const double target = p * count_;
+		uint64_t sum = 0;
+		for( int i = 0; i < BUCKET_COUNT - 1; ++i )
+		{
+			sum += buckets_[ i ];
+			if( sum >= target )
+			{
+				return static_cast< double >( ( i + 1 ) * BUCKET_US );
+			}
+		}
+		return max_;
+	}
+
+	FrameScheduler::FrameScheduler( int64_t intervalTicks )
+		: mode_( SCHEDULE_PACED ),
+		interval_( std::chrono::duration_cast< Clock::duration >( std::chrono::microseconds( intervalTicks / 10 ) ) ),
+		predicted_( false ), lastPollFound_( true ), wakeCount_( 0 ), idleWakeCount_( 0 )
+	{
+	}
+
+	void FrameScheduler::wait()
+	{
+		const std::chrono::milliseconds pollStep( POLL_MS );
+		if( mode_ == SCHEDULE_FREE )
+		{
+			if( !lastPollFound_ ) std::this_thread::sleep_for( pollStep );
+		}
+		else if( arrivalWait_ )
+		{
+			// Give up after 2 intervals, so the loop can still stop when frames cease.
+			const auto timeout = std::chrono::duration_cast< std::chrono::milliseconds >( interval_ * 2 );
+			arrivalWait_( static_cast< unsigned int >( timeout.count() ) );
+		}
+		else if( predicted_ && Clock::now() < nextFrame_ )
+		{
+			std::this_thread::sleep_until( nextFrame_ );
+		}
+		else if( !lastPollFound_ )
+		{
+			std::this_thread::sleep_for( pollStep );
+		}
+
+		wake_ = Clock::now();
+		++wakeCount_;
+	}
+
+	void FrameScheduler::polled( bool gotFrame )
+	{
+		lastPollFound_ = gotFrame;
+		if( !gotFrame )
+		{
+			++idleWakeCount_;
+			return;
+		}
+
+		latency_.add( std::chrono::duration< double, std::micro >( Clock::now() - wake_ ).count() );
+
+		// The frame arrived at most one poll step before this wake. Wake a little
+		// before the next one is due, to find it within a poll step again.
+		nextFrame_ = wake_ + interval_ - std::chrono::milliseconds( EARLY_MS );
+		predicted_ = true;
+	}
+
+	std::string FrameScheduler::summary() const
+	{
+		std::stringstream ss;
+		ss << "wakes " << wakeCount_ << " (idle " << idleWakeCount_ << "), wake to process [us] p50 "
+			<< latency_.percentile( 0.5 ) << " p99 " << latency_.percentile( 0.99 ) << " max " << latency_.max_;
+		return ss.str();
+	}
+
+} // namespace kinect
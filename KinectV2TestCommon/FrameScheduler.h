@@ -0,0 +1,93 @@
+#pragma once
+
+#include "FrameSource.h"
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace kinect
+{
+	//! Histogram of latencies in BUCKET_US wide buckets. The last bucket holds everything longer.
+	struct LatencyHistogram
+	{
+		enum
+		{
+			BUCKET_US = 50,
+			BUCKET_COUNT = 400		// up to 20 [ms]
+		};
+
+		LatencyHistogram() { reset(); }
+
+		void reset();
+		void add( double microseconds );
+
+		//! Upper edge of the bucket the p-th fraction (0-1) of the samples falls in [us].
+		double percentile( double p ) const;
+
+		uint64_t count_;
+		double max_;
+		uint64_t buckets_[ BUCKET_COUNT ];
+	};
+
+	//! Decides when the acquisition loop polls its source.
+	//!
+	//! SCHEDULE_PACED waits on the arrival notification of the source if it has one.
+	//! Otherwise it sleeps until the next frame is predicted, one interval after the last
+	//! one was found less EARLY_MS, then polls every POLL_MS until the frame is there.
+	//! SCHEDULE_FREE polls again at once after a frame and every POLL_MS while there is none.
+	class FrameScheduler
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		//! Block until a frame arrives or timeoutMs passes. Return true if one arrived.
+		typedef std::function< bool( unsigned int timeoutMs ) > ArrivalWait;
+
+		enum Mode
+		{
+			SCHEDULE_PACED,
+			SCHEDULE_FREE
+		};
+
+		enum
+		{
+			POLL_MS = 1,
+			EARLY_MS = 2
+		};
+
+		explicit FrameScheduler( int64_t intervalTicks = FRAME_INTERVAL_TICKS );
+
+		void setMode( Mode mode ) { mode_ = mode; }
+
+		//! Use the arrival notification of the source. An empty function falls back to prediction.
+		void setArrivalWait( ArrivalWait wait ) { arrivalWait_ = wait; }
+
+		//! Sleep until it is time to poll.
+		void wait();
+
+		//! Tell the result of the poll after wait(), once the frame has been processed.
+		void polled( bool gotFrame );
+
+		//! Time from each wake that found a frame until the frame was processed.
+		const LatencyHistogram& latency() const { return latency_; }
+
+		uint64_t wakeCount() const { return wakeCount_; }
+		uint64_t idleWakeCount() const { return idleWakeCount_; }
+
+		//! One line report of the counters and the latency percentiles.
+		std::string summary() const;
+
+	private:
+		Mode mode_;
+		ArrivalWait arrivalWait_;
+		Clock::duration interval_;
+		bool predicted_;			// nextFrame_ is valid
+		bool lastPollFound_;
+		Clock::time_point nextFrame_;
+		Clock::time_point wake_;
+		uint64_t wakeCount_;
+		uint64_t idleWakeCount_;
+		LatencyHistogram latency_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kinect
+{
+	enum
+	{
+		MAX_BODY_COUNT = 6,
+		MAX_JOINT_COUNT = 25,
+
+		//! Frame interval of every Kinect v2 stream in TIMESPAN (100 [ns]) ticks.
+		FRAME_INTERVAL_TICKS = 333333
+	};
+
+	//! Pixel layout of an image frame.
+	enum PixelFormat
+	{
+		PIXEL_FORMAT_DEPTH16,		// UINT16 depth [mm], 0 = invalid
+		PIXEL_FORMAT_BODY_INDEX8,	// BYTE body index 0-5, 255 = no body
+		PIXEL_FORMAT_RGBA8,			// 4 bytes per pixel
+		PIXEL_FORMAT_YUY2			// 2 bytes per pixel, Y0 U Y1 V
+	};
+
+	//! Bytes per pixel of the format.
+	inline unsigned int bytesPerPixel( PixelFormat format )
+	{
+		switch( format )
+		{
+		case PIXEL_FORMAT_DEPTH16: return 2;
+		case PIXEL_FORMAT_BODY_INDEX8: return 1;
+		case PIXEL_FORMAT_RGBA8: return 4;
+		case PIXEL_FORMAT_YUY2: return 2;
+		}
+		return 0;
+	}
+
+	//! Non-owning view of an acquired image frame.
+	struct FrameView
+	{
+		const unsigned char* data;
+		unsigned int width;
+		unsigned int height;
+		unsigned int bytesPerPixel;
+		PixelFormat format;
+		int64_t relativeTime;	// TIMESPAN ticks
+
+		std::size_t rowSize() const { return static_cast< std::size_t >( width ) * bytesPerPixel; }
+		std::size_t size() const { return rowSize() * height; }
+	};
+
+	//! Source of image frames, the sensor or a stand-in.
+	struct FrameSource
+	{
+		virtual ~FrameSource() {}
+
+		//! Acquire the newest frame. Return false if no new frame has arrived yet.
+		//! The view stays valid until releaseFrame() is called.
+		virtual bool acquireLatestFrame( FrameView& frame ) = 0;
+
+		//! Release the frame acquired last.
+		virtual void releaseFrame() = 0;
+
+		//! Block until a frame arrives or timeoutMs passes. Return true if one arrived.
+		//! Only called if canWaitFrameArrived() returns true.
+		virtual bool waitFrameArrived( unsigned int timeoutMs ) { static_cast< void >( timeoutMs ); return false; }
+		virtual bool canWaitFrameArrived() const { return false; }
+	};
+
+	//! Joint of a body. Same layout as Joint and JointOrientation of Kinect SDK.
+	struct JointData
+	{
+		float position[ 3 ];	// camera space [m]
+		float orientation[ 4 ];	// quaternion x, y, z, w
+		int trackingState;		// 0 = not tracked, 1 = inferred, 2 = tracked
+	};
+
+	struct BodyData
+	{
+		bool isTracked;
+		uint64_t trackingId;
+		JointData joints[ MAX_JOINT_COUNT ];
+	};
+
+	struct BodyFrame
+	{
+		int64_t relativeTime;	// TIMESPAN ticks
+		BodyData bodies[ MAX_BODY_COUNT ];
+	};
+
+	//! Source of body frames, the sensor or a stand-in.
+	struct BodyFrameSource
+	{
+		virtual ~BodyFrameSource() {}
+
+		//! Copy the newest body frame. Return false if no new frame has arrived yet.
+		virtual bool acquireLatestFrame( BodyFrame& frame ) = 0;
+
+		//! Same as FrameSource.
+		virtual bool waitFrameArrived( unsigned int timeoutMs ) { static_cast< void >( timeoutMs ); return false; }
+		virtual bool canWaitFrameArrived() const { return false; }
+	};
+
+} // namespace kinect
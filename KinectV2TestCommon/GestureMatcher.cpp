@@ -0,0 +1,366 @@
+#include "GestureMatcher.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace kinect
+{
+	namespace
+	{
+		const float INF = std::numeric_limits< float >::infinity();
+	}
+
+	GestureMatcher::GestureMatcher( uint32_t jointMask, float band )
+		: jointMask_( jointMask & ( ( 1u << MAX_JOINT_COUNT ) - 1 ) ), jointCount_( 0 ), band_( band ), pruning_( true ),
+		framesTaken_( 0 )
+	{
+		for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+		{
+			jointCount_ += ( jointMask_ >> j ) & 1;
+		}
+		if( jointCount_ == 0 )
+		{
+			throw std::invalid_argument( "No joint to match" );
+		}
+		if( !( band >= 0 ) || band > 1 )
+		{
+			throw std::invalid_argument( "Band out of range" );
+		}
+		featureCount_ = 3 * jointCount_;
+		for( auto& stream : streams_ )
+		{
+			stream.features.resize( 2 * MAX_TEMPLATE_FRAMES * featureCount_ );
+		}
+		reset();
+		memset( &stats_, 0, sizeof stats_ );
+	}
+
+	void GestureMatcher::normalize( const SkeletonHistory& history, unsigned int age, unsigned int body, float* dst ) const
+	{
+		const float* px = history.component( JOINT_POSITION_X, age ) + body * MAX_JOINT_COUNT;
+		const float* py = history.component( JOINT_POSITION_Y, age ) + body * MAX_JOINT_COUNT;
+		const float* pz = history.component( JOINT_POSITION_Z, age ) + body * MAX_JOINT_COUNT;
+
+		// Measured bone directions with the model lengths, from SpineBase at 0.
+		float model[ MAX_JOINT_COUNT ][ 3 ];
+		model[ human::JOINT_ORDER[ 0 ] ][ 0 ] = model[ human::JOINT_ORDER[ 0 ] ][ 1 ] = model[ human::JOINT_ORDER[ 0 ] ][ 2 ] = 0;
+		for( int k = 1; k < MAX_JOINT_COUNT; ++k )
+		{
+			const int joint = human::JOINT_ORDER[ k ];
+			const int parent = human::JOINT_PARENT[ joint ];
+			const float d[ 3 ] = { px[ joint ] - px[ parent ], py[ joint ] - py[ parent ], pz[ joint ] - pz[ parent ] };
+			const float length = std::sqrt( d[ 0 ] * d[ 0 ] + d[ 1 ] * d[ 1 ] + d[ 2 ] * d[ 2 ] );
+			const float scale = length > 0 ? human::boneLength( joint ) * 0.01f / length : 0.0f;
+			for( int a = 0; a < 3; ++a )
+			{
+				model[ joint ][ a ] = model[ parent ][ a ] + d[ a ] * scale;
+			}
+		}
+
+		// Turn about Y so that the shoulders lie along X.
+		const float sx = px[ JOINT_SHOULDER_RIGHT ] - px[ JOINT_SHOULDER_LEFT ];
+		const float sz = pz[ JOINT_SHOULDER_RIGHT ] - pz[ JOINT_SHOULDER_LEFT ];
+		const float shoulders = std::sqrt( sx * sx + sz * sz );
+		const float c = shoulders > 0 ? sx / shoulders : 1.0f;
+		const float s = shoulders > 0 ? sz / shoulders : 0.0f;
+		for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+		{
+			if( !( jointMask_ & ( 1u << j ) ) ) continue;
+			*dst++ = model[ j ][ 0 ] * c + model[ j ][ 2 ] * s;
+			*dst++ = model[ j ][ 1 ];
+			*dst++ = model[ j ][ 2 ] * c - model[ j ][ 0 ] * s;
+		}
+	}
+
+	int GestureMatcher::addTemplate( const std::string& name, const SkeletonHistory& history, unsigned int body,
+		unsigned int frames, float threshold )
+	{
+		if( frames < MIN_TEMPLATE_FRAMES || frames > MAX_TEMPLATE_FRAMES || frames > history.size() )
+		{
+			throw std::invalid_argument( "Template frames out of range" );
+		}
+		if( body >= MAX_BODY_COUNT || !( threshold > 0 ) )
+		{
+			throw std::invalid_argument( "Invalid template" );
+		}
+		for( unsigned int age = 0; age < frames; ++age )
+		{
+			if( !( history.trackedMask( age ) & ( 1u << body ) ) || history.trackingId( age, body ) != history.trackingId( 0, body ) )
+			{
+				throw std::invalid_argument( "Body is not tracked over the template" );
+			}
+		}
+
+		Template t;
+		t.name = name;
+		t.frames = frames;
+		t.band = std::max( 1u, static_cast< unsigned int >( frames * band_ + 0.5f ) );
+		t.threshold = threshold;
+		t.features.resize( frames * featureCount_ );
+		for( unsigned int i = 0; i < frames; ++i )
+		{
+			normalize( history, frames - 1 - i, body, &t.features[ i * featureCount_ ] );
+		}
+
+		t.upper.resize( t.features.size() );
+		t.lower.resize( t.features.size() );
+		for( unsigned int i = 0; i < frames; ++i )
+		{
+			const unsigned int j0 = i > t.band ? i - t.band : 0;
+			const unsigned int j1 = std::min( i + t.band, frames - 1 );
+			for( unsigned int f = 0; f < featureCount_; ++f )
+			{
+				float hi = -INF, lo = INF;
+				for( unsigned int j = j0; j <= j1; ++j )
+				{
+					hi = std::max( hi, t.features[ j * featureCount_ + f ] );
+					lo = std::min( lo, t.features[ j * featureCount_ + f ] );
+				}
+				t.upper[ i * featureCount_ + f ] = hi;
+				t.lower[ i * featureCount_ + f ] = lo;
+			}
+		}
+
+		templates_.push_back( std::move( t ) );
+		return static_cast< int >( templates_.size() - 1 );
+	}
+
+	void GestureMatcher::reset()
+	{
+		for( auto& stream : streams_ )
+		{
+			stream.trackingId = 0;
+			stream.valid = 0;
+			stream.end = 0;
+		}
+		framesTaken_ = 0;
+	}
+
+	void GestureMatcher::match( const SkeletonHistory& history, GestureMatch matches[ MAX_BODY_COUNT ], ThreadPool* pool )
+	{
+		// Frames pushed since the last call, oldest first. Only the last MAX_TEMPLATE_FRAMES can count.
+		if( history.frameCount() < framesTaken_ )
+		{
+			reset();
+		}
+		const uint64_t pushed = history.frameCount() - framesTaken_;
+		unsigned int fresh = static_cast< unsigned int >( std::min< uint64_t >( pushed, history.size() ) );
+		fresh = std::min( fresh, static_cast< unsigned int >( MAX_TEMPLATE_FRAMES ) );
+		framesTaken_ = history.frameCount();
+		if( pushed > fresh )
+		{
+			// Frames were missed, the bodies start over.
+			for( auto& stream : streams_ )
+			{
+				stream.trackingId = 0;
+				stream.valid = 0;
+			}
+		}
+		for( unsigned int age = fresh; age-- > 0; )
+		{
+			for( unsigned int b = 0; b < MAX_BODY_COUNT; ++b )
+			{
+				Stream& stream = streams_[ b ];
+				if( !( history.trackedMask( age ) & ( 1u << b ) ) )
+				{
+					stream.trackingId = 0;
+					stream.valid = 0;
+					continue;
+				}
+				if( history.trackingId( age, b ) != stream.trackingId )
+				{
+					stream.trackingId = history.trackingId( age, b );
+					stream.valid = 0;
+				}
+				if( stream.end == 2 * MAX_TEMPLATE_FRAMES )
+				{
+					const std::size_t keep = ( MAX_TEMPLATE_FRAMES - 1 ) * featureCount_;
+					std::copy( stream.features.end() - keep, stream.features.end(), stream.features.begin() );
+					stream.end = MAX_TEMPLATE_FRAMES - 1;
+				}
+				normalize( history, age, b, &stream.features[ stream.end * featureCount_ ] );
+				++stream.end;
+				stream.valid = std::min( stream.valid + 1, static_cast< unsigned int >( MAX_TEMPLATE_FRAMES ) );
+			}
+		}
+
+		uint32_t bodies = 0;
+		for( unsigned int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			matches[ b ].templateIndex = -1;
+			matches[ b ].distance = INF;
+			if( streams_[ b ].valid >= MIN_TEMPLATE_FRAMES ) bodies |= 1u << b;
+		}
+		if( bodies == 0 || templates_.empty() )
+		{
+			return;
+		}
+
+		const std::size_t chunks = ( templates_.size() + TEMPLATE_CHUNK - 1 ) / TEMPLATE_CHUNK;
+		if( workspaces_.size() < chunks )
+		{
+			workspaces_.resize( chunks );
+		}
+		if( pool && chunks > 1 )
+		{
+			pool->parallelFor( templates_.size(), TEMPLATE_CHUNK, [&]( std::size_t begin, std::size_t end ) {
+				matchChunk( begin, end, bodies, workspaces_[ begin / TEMPLATE_CHUNK ] );
+			} );
+		}
+		else
+		{
+			for( std::size_t chunk = 0; chunk < chunks; ++chunk )
+			{
+				const std::size_t begin = chunk * TEMPLATE_CHUNK;
+				matchChunk( begin, std::min( begin + TEMPLATE_CHUNK, templates_.size() ), bodies, workspaces_[ chunk ] );
+			}
+		}
+
+		// Chunks in template order, the first of equal distances wins.
+		for( std::size_t chunk = 0; chunk < chunks; ++chunk )
+		{
+			const Workspace& workspace = workspaces_[ chunk ];
+			for( unsigned int b = 0; b < MAX_BODY_COUNT; ++b )
+			{
+				if( workspace.best[ b ].distance < matches[ b ].distance )
+				{
+					matches[ b ] = workspace.best[ b ];
+				}
+			}
+			stats_.candidates += workspace.stats.candidates;
+			stats_.prunedKim += workspace.stats.prunedKim;
+			stats_.prunedKeogh += workspace.stats.prunedKeogh;
+			stats_.abandoned += workspace.stats.abandoned;
+			stats_.completed += workspace.stats.completed;
+		}
+	}
+
+	void GestureMatcher::matchChunk( std::size_t begin, std::size_t end, uint32_t bodies, Workspace& workspace ) const
+	{
+		memset( &workspace.stats, 0, sizeof workspace.stats );
+		for( unsigned int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			workspace.best[ b ].templateIndex = -1;
+			workspace.best[ b ].distance = INF;
+
+			const Stream& stream = streams_[ b ];
+			if( !( bodies & ( 1u << b ) ) ) continue;
+
+			// Mean square joint distance per frame of the best template so far.
+			float bestScore = INF;
+			for( std::size_t i = begin; i < end; ++i )
+			{
+				const Template& t = templates_[ i ];
+				if( stream.valid < t.frames ) continue;
+
+				const float scale = static_cast< float >( t.frames * jointCount_ );
+				const float limit = std::min( t.threshold * t.threshold, bestScore ) * scale;
+				const float* query = &stream.features[ ( stream.end - t.frames ) * featureCount_ ];
+				const float sum = warp( t, query, limit, workspace, workspace.stats );
+				if( sum <= limit )
+				{
+					const float score = sum / scale;
+					if( score < bestScore )
+					{
+						bestScore = score;
+						workspace.best[ b ].templateIndex = static_cast< int >( i );
+						workspace.best[ b ].distance = std::sqrt( score );
+					}
+				}
+			}
+		}
+	}
+
+	float GestureMatcher::cost( const float* a, const float* b ) const
+	{
+		float sum = 0;
+		for( unsigned int f = 0; f < featureCount_; ++f )
+		{
+			const float d = a[ f ] - b[ f ];
+			sum += d * d;
+		}
+		return sum;
+	}
+
+	float GestureMatcher::warp( const Template& t, const float* query, float limit, Workspace& workspace, GestureMatchStats& stats ) const
+	{
+		const unsigned int m = t.frames;
+		const unsigned int n = featureCount_;
+		const float* c = t.features.data();
+		++stats.candidates;
+		if( !pruning_ )
+		{
+			limit = INF;
+		}
+
+		// The first and the last pair of frames are on every path.
+		if( cost( query, c ) + cost( query + ( m - 1 ) * n, c + ( m - 1 ) * n ) > limit )
+		{
+			++stats.prunedKim;
+			return INF;
+		}
+
+		// Each query frame meets some template frame within the band, so it costs at least its
+		// distance to the envelope. bound[ i ] is that of frames i and later.
+		workspace.bound.resize( m + 1 );
+		float* bound = workspace.bound.data();
+		bound[ m ] = 0;
+		for( unsigned int i = m; i-- > 0; )
+		{
+			const float* q = query + i * n;
+			const float* upper = &t.upper[ i * n ];
+			const float* lower = &t.lower[ i * n ];
+			float sum = 0;
+			for( unsigned int f = 0; f < n; ++f )
+			{
+				const float above = q[ f ] - upper[ f ];
+				const float below = lower[ f ] - q[ f ];
+				const float d = above > 0 ? above : below > 0 ? below : 0.0f;
+				sum += d * d;
+			}
+			bound[ i ] = bound[ i + 1 ] + sum;
+			if( bound[ i ] > limit )
+			{
+				++stats.prunedKeogh;
+				return INF;
+			}
+		}
+
+		// Banded warping over 2 rows, column j at j + 1 after an infinite column -1.
+		workspace.rows.resize( 2 * ( m + 1 ) );
+		float* previous = workspace.rows.data();
+		float* current = previous + m + 1;
+		std::fill( previous, previous + m + 1, INF );
+		previous[ 0 ] = 0;
+		for( unsigned int i = 0; i < m; ++i )
+		{
+			const unsigned int j0 = i > t.band ? i - t.band : 0;
+			const unsigned int j1 = std::min( i + t.band, m - 1 );
+			const float* q = query + i * n;
+			current[ j0 ] = INF;
+			float rowMin = INF;
+			for( unsigned int j = j0; j <= j1; ++j )
+			{
+				const float d = cost( q, c + j * n ) + std::min( std::min( previous[ j + 1 ], previous[ j ] ), current[ j ] );
+				current[ j + 1 ] = d;
+				rowMin = std::min( rowMin, d );
+			}
+			if( j1 + 2 <= m )
+			{
+				current[ j1 + 2 ] = INF;
+			}
+			if( rowMin + bound[ i + 1 ] > limit )
+			{
+				++stats.abandoned;
+				return INF;
+			}
+			std::swap( previous, current );
+		}
+		++stats.completed;
+		return previous[ m ];
+	}
+
+} // namespace kinect
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "Human.h"
+#include "SkeletonHistory.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	class ThreadPool;
+
+	//! Best template for a body.
+	struct GestureMatch
+	{
+		int templateIndex;	// -1 if no template is within its threshold
+		float distance;		// RMS distance [m] of the joints along the warping path
+	};
+
+	//! How far the template and body pairs went, over all calls of GestureMatcher::match().
+	struct GestureMatchStats
+	{
+		uint64_t candidates;	// pairs tried
+		uint64_t prunedKim;		// rejected by the first and last frames
+		uint64_t prunedKeogh;	// rejected by the envelope of the template
+		uint64_t abandoned;		// warping stopped early
+		uint64_t completed;		// warping ran to the end
+	};
+
+	//! Template matching of gestures by dynamic time warping of joint trajectories.
+	//!
+	//! A frame of a body becomes features : the joints of the mask, placed on the model
+	//! skeleton of human::boneLength() along the measured bone directions, relative to
+	//! SpineBase and turned so that the shoulders face the sensor. The size and place of
+	//! the body drop out, so a template recorded by one person matches another.
+	//!
+	//! match() compares the last frames of every tracked body with each template of the same
+	//! length, within a Sakoe-Chiba band. Most pairs never warp : the first and last frames
+	//! (LB_Kim), then the envelope of the template over the band (LB_Keogh) bound the
+	//! distance from below, and the warping itself stops once its rows plus the rest of the
+	//! envelope bound exceed the threshold of the template or the best template so far.
+	//! Templates are spread over the threads of a pool in chunks; the best of each chunk
+	//! is merged in template order, so the result is the same for any number of threads.
+	class GestureMatcher
+	{
+	public:
+		enum
+		{
+			MIN_TEMPLATE_FRAMES = 2,
+			MAX_TEMPLATE_FRAMES = 150,		// 5 [s]
+			TEMPLATE_CHUNK = 16,			// templates per task of the pool
+			DEFAULT_JOINT_MASK = ( 1 << JOINT_ELBOW_LEFT ) | ( 1 << JOINT_WRIST_LEFT ) | ( 1 << JOINT_HAND_LEFT ) |
+				( 1 << JOINT_ELBOW_RIGHT ) | ( 1 << JOINT_WRIST_RIGHT ) | ( 1 << JOINT_HAND_RIGHT )
+		};
+
+		//! Bit j of jointMask selects joint j. band is the warping window as a fraction of
+		//! the template length, at least 1 frame.
+		explicit GestureMatcher( uint32_t jointMask = DEFAULT_JOINT_MASK, float band = 0.1f );
+
+		//! Add the last frames of a body of history as a template, matched within threshold [m]
+		//! of RMS joint distance. Return its index. Throw std::invalid_argument if the body
+		//! is not tracked with the same id over those frames or frames is out of range.
+		int addTemplate( const std::string& name, const SkeletonHistory& history, unsigned int body,
+			unsigned int frames, float threshold );
+
+		std::size_t templateCount() const { return templates_.size(); }
+		const std::string& templateName( std::size_t index ) const { return templates_[ index ].name; }
+		unsigned int templateFrames( std::size_t index ) const { return templates_[ index ].frames; }
+
+		//! Take the frames pushed to history since the last call and match every tracked body.
+		//! A body is matched against the templates it has been tracked long enough for.
+		void match( const SkeletonHistory& history, GestureMatch matches[ MAX_BODY_COUNT ], ThreadPool* pool = nullptr );
+
+		//! Forget the frames taken so far.
+		void reset();
+
+		//! With pruning off every pair is warped in full, for reference.
+		void setPruning( bool pruning ) { pruning_ = pruning; }
+
+		const GestureMatchStats& stats() const { return stats_; }
+
+		//! Floats per frame, 3 per joint of the mask.
+		unsigned int featureCount() const { return featureCount_; }
+
+		//! Features of a body of a frame of history into featureCount() floats.
+		void normalize( const SkeletonHistory& history, unsigned int age, unsigned int body, float* dst ) const;
+
+	private:
+		struct Template
+		{
+			std::string name;
+			unsigned int frames;
+			unsigned int band;
+			float threshold;
+			std::vector< float > features;	// frames rows of featureCount_
+			std::vector< float > upper;		// envelope over the band
+			std::vector< float > lower;
+		};
+
+		//! Recent features of a body, the newest last. Rows slide back to the front when full.
+		struct Stream
+		{
+			uint64_t trackingId;
+			unsigned int valid;				// frames since the body was found, at most MAX_TEMPLATE_FRAMES
+			unsigned int end;				// rows used
+			std::vector< float > features;	// 2 * MAX_TEMPLATE_FRAMES rows
+		};
+
+		//! Scratch and results of one chunk of templates.
+		struct Workspace
+		{
+			std::vector< float > rows;		// 2 rows of the warping matrix
+			std::vector< float > bound;		// envelope bound of the frames after each
+			GestureMatch best[ MAX_BODY_COUNT ];
+			GestureMatchStats stats;
+		};
+
+		void matchChunk( std::size_t begin, std::size_t end, uint32_t bodies, Workspace& workspace ) const;
+
+		//! Warped distance of query to a template as a sum of squares, or a value above limit
+		//! if it is larger than limit.
+		float warp( const Template& t, const float* query, float limit, Workspace& workspace, GestureMatchStats& stats ) const;
+
+		float cost( const float* a, const float* b ) const;
+
+		uint32_t jointMask_;
+		unsigned int jointCount_;
+		unsigned int featureCount_;
+		float band_;
+		bool pruning_;
+		std::vector< Template > templates_;
+		Stream streams_[ MAX_BODY_COUNT ];
+		uint64_t framesTaken_;
+		std::vector< Workspace > workspaces_;
+		GestureMatchStats stats_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,173 @@
+﻿#pragma once
+
+#include "FrameSource.h"
+
+namespace kinect
+{
+	//! Joints in the JointType order of Kinect SDK, for code built without it.
+	enum JointIndex
+	{
+		JOINT_SPINE_BASE,
+		JOINT_SPINE_MID,
+		JOINT_NECK,
+		JOINT_HEAD,
+		JOINT_SHOULDER_LEFT,
+		JOINT_ELBOW_LEFT,
+		JOINT_WRIST_LEFT,
+		JOINT_HAND_LEFT,
+		JOINT_SHOULDER_RIGHT,
+		JOINT_ELBOW_RIGHT,
+		JOINT_WRIST_RIGHT,
+		JOINT_HAND_RIGHT,
+		JOINT_HIP_LEFT,
+		JOINT_KNEE_LEFT,
+		JOINT_ANKLE_LEFT,
+		JOINT_FOOT_LEFT,
+		JOINT_HIP_RIGHT,
+		JOINT_KNEE_RIGHT,
+		JOINT_ANKLE_RIGHT,
+		JOINT_FOOT_RIGHT,
+		JOINT_SPINE_SHOULDER,
+		JOINT_HAND_TIP_LEFT,
+		JOINT_THUMB_LEFT,
+		JOINT_HAND_TIP_RIGHT,
+		JOINT_THUMB_RIGHT
+	};
+
+	//! Joints that move alike, from the hierarchy : the spine and the joints hanging from it,
+	//! the middle of the limbs, and the ends of the chains.
+	enum JointGroup
+	{
+		JOINT_GROUP_TORSO,
+		JOINT_GROUP_LIMB,
+		JOINT_GROUP_EXTREMITY,
+		JOINT_GROUP_COUNT
+	};
+
+	namespace human
+	{
+		// Boneの接続
+		const int JOINT_ORDER[ MAX_JOINT_COUNT ] = {
+			JOINT_SPINE_BASE,		// 脊椎Base
+			JOINT_SPINE_MID,		// 脊椎中間
+			JOINT_SPINE_SHOULDER,	// 脊椎肩
+			JOINT_NECK,				// 首
+			JOINT_HEAD,				// 頭
+			JOINT_SHOULDER_LEFT,	// 左肩
+			JOINT_ELBOW_LEFT,		// 左肘
+			JOINT_WRIST_LEFT,		// 左手首
+			JOINT_HAND_LEFT,		// 左手
+			JOINT_THUMB_LEFT,		// 左親指
+			JOINT_HAND_TIP_LEFT,	// 左手先
+			JOINT_SHOULDER_RIGHT,	// （右も同様）
+			JOINT_ELBOW_RIGHT,
+			JOINT_WRIST_RIGHT,
+			JOINT_HAND_RIGHT,
+			JOINT_THUMB_RIGHT,
+			JOINT_HAND_TIP_RIGHT,
+			JOINT_HIP_LEFT,			// 左尻
+			JOINT_KNEE_LEFT,		// 左膝
+			JOINT_ANKLE_LEFT,		// 左足首
+			JOINT_FOOT_LEFT,		// 左足元
+			JOINT_HIP_RIGHT,		// （右も同様）
+			JOINT_KNEE_RIGHT,
+			JOINT_ANKLE_RIGHT,
+			JOINT_FOOT_RIGHT
+		};
+
+		//! Parent of each joint in JointType order, -1 for the root. Every joint comes after its
+		//! parent in JOINT_ORDER.
+		const int JOINT_PARENT[ MAX_JOINT_COUNT ] = {
+			-1,						// SpineBase
+			JOINT_SPINE_BASE,		// SpineMid
+			JOINT_SPINE_SHOULDER,	// Neck
+			JOINT_NECK,				// Head
+			JOINT_SPINE_SHOULDER,	// ShoulderLeft
+			JOINT_SHOULDER_LEFT,	// ElbowLeft
+			JOINT_ELBOW_LEFT,		// WristLeft
+			JOINT_WRIST_LEFT,		// HandLeft
+			JOINT_SPINE_SHOULDER,	// ShoulderRight
+			JOINT_SHOULDER_RIGHT,	// ElbowRight
+			JOINT_ELBOW_RIGHT,		// WristRight
+			JOINT_WRIST_RIGHT,		// HandRight
+			JOINT_SPINE_BASE,		// HipLeft
+			JOINT_HIP_LEFT,			// KneeLeft
+			JOINT_KNEE_LEFT,		// AnkleLeft
+			JOINT_ANKLE_LEFT,		// FootLeft
+			JOINT_SPINE_BASE,		// HipRight
+			JOINT_HIP_RIGHT,		// KneeRight
+			JOINT_KNEE_RIGHT,		// AnkleRight
+			JOINT_ANKLE_RIGHT,		// FootRight
+			JOINT_SPINE_MID,		// SpineShoulder
+			JOINT_HAND_LEFT,		// HandTipLeft
+			JOINT_WRIST_LEFT,		// ThumbLeft
+			JOINT_HAND_RIGHT,		// HandTipRight
+			JOINT_WRIST_RIGHT		// ThumbRight
+		};
+
+		// Boneの長さ[cm]
+		const float BONE_LENGTH[ 20 ] = {
+			0.0f,  // SpineBase
+			5.1f,  // 尻 -> 背
+			28.3f, // 背 -> 首
+			21.5f, // 首 -> 頭
+			19.8f, // 首 -> 左肩
+			24.3f, // 左肩 -> 左肘
+			26.5f, // 左肘 -> 左手首
+			8.2f,  // 左手首 -> 左手
+			19.8f, // （体は左右対称なので同じ値とする）
+			24.3f,
+			26.5f,
+			8.2f,
+			10.0f, // 尻 -> 左股
+			35.8f, // 左股 -> 左膝
+			35.2f, // 左膝 -> 左足首
+			11.5f, // 左足首 -> 左足
+			10.0f,
+			35.8f,
+			35.2f,
+			11.5f
+		};
+
+		// Boneのルートから地面までの距離[cm]
+		const float BONE_ROOT_DISTANCE = 108.4f;
+
+		//! Length [cm] of the bone from JOINT_PARENT to a joint, for all 25 joints. BONE_LENGTH
+		//! has the 20 joints of the older skeleton, whose spine goes straight to the neck; the
+		//! spine shoulder splits that bone, the hand tips and thumbs are added.
+		inline float boneLength( int joint )
+		{
+			const float SPINE_SHOULDER_TO_NECK = 3.4f;
+			switch( joint )
+			{
+			case JOINT_NECK: return SPINE_SHOULDER_TO_NECK;
+			case JOINT_SPINE_SHOULDER: return BONE_LENGTH[ JOINT_NECK ] - SPINE_SHOULDER_TO_NECK;
+			case JOINT_HAND_TIP_LEFT: case JOINT_HAND_TIP_RIGHT: return 7.2f;
+			case JOINT_THUMB_LEFT: case JOINT_THUMB_RIGHT: return 10.0f;
+			default: return BONE_LENGTH[ joint ];
+			}
+		}
+
+		//! Group of a joint : the spine chain up to the neck and the joints hanging from it are
+		//! the torso, joints with no child are extremities, the others are limbs.
+		inline JointGroup jointGroup( int joint )
+		{
+			bool hasChild = false;
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				hasChild = hasChild || JOINT_PARENT[ j ] == joint;
+			}
+			if( !hasChild )
+			{
+				return JOINT_GROUP_EXTREMITY;
+			}
+
+			const int parent = JOINT_PARENT[ joint ];
+			const bool spine = joint == JOINT_SPINE_BASE || joint == JOINT_SPINE_MID || joint == JOINT_SPINE_SHOULDER;
+			const bool onSpine = parent == JOINT_SPINE_BASE || parent == JOINT_SPINE_MID || parent == JOINT_SPINE_SHOULDER;
+			return spine || onSpine ? JOINT_GROUP_TORSO : JOINT_GROUP_LIMB;
+		}
+
+	} // namespace human
+
+} // namespace kinect
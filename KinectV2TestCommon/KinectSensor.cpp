@@ -0,0 +1,390 @@
+#include "KinectSensor.h"
+#include "Human.h"
+#include "Trace.h"
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#include <Windows.h>
+#include <Kinect.h>
+#include <sstream>
+#include <stdexcept>
+
+#pragma comment( lib, "kinect20.lib" )
+
+namespace kinect
+{
+	namespace
+	{
+		// Depth frames of the sensor are always 512 x 424.
+		const UINT32 DEPTH_PIXEL_COUNT = 512 * 424;
+
+		struct ComDeleter
+		{
+			void operator()( IUnknown* com ) {
+				if( com ) com->Release();
+			}
+		};
+
+		void check( HRESULT hr, const char* what )
+		{
+			if( FAILED( hr ) ) {
+				std::stringstream ss;
+				ss << "Error : " << what << " " << std::hex << hr;
+				throw std::runtime_error( ss.str() );
+			}
+		}
+
+		HRESULT getSource( IKinectSensor* sensor, IDepthFrameSource** source ) { return sensor->get_DepthFrameSource( source ); }
+		HRESULT getSource( IKinectSensor* sensor, IColorFrameSource** source ) { return sensor->get_ColorFrameSource( source ); }
+		HRESULT getSource( IKinectSensor* sensor, IBodyIndexFrameSource** source ) { return sensor->get_BodyIndexFrameSource( source ); }
+		HRESULT getSource( IKinectSensor* sensor, IBodyFrameSource** source ) { return sensor->get_BodyFrameSource( source ); }
+
+		void accessBuffer( IDepthFrame* frame, FrameView& view )
+		{
+			UINT size;
+			UINT16* buffer;
+			KINECT_TRACE_SCOPE( "AccessUnderlyingBuffer" );
+			check( frame->AccessUnderlyingBuffer( &size, &buffer ), "AccessUnderlyingBuffer" );
+			view.data = reinterpret_cast< const unsigned char* >( buffer );
+			view.format = PIXEL_FORMAT_DEPTH16;
+		}
+
+		void accessBuffer( IBodyIndexFrame* frame, FrameView& view )
+		{
+			UINT size;
+			BYTE* buffer;
+			KINECT_TRACE_SCOPE( "AccessUnderlyingBuffer" );
+			check( frame->AccessUnderlyingBuffer( &size, &buffer ), "AccessUnderlyingBuffer" );
+			view.data = buffer;
+			view.format = PIXEL_FORMAT_BODY_INDEX8;
+		}
+
+		void accessBuffer( IColorFrame* frame, FrameView& view )
+		{
+			ColorImageFormat rawFormat;
+			check( frame->get_RawColorImageFormat( &rawFormat ), "get_RawColorImageFormat" );
+			if( rawFormat != ColorImageFormat_Yuy2 )
+			{
+				throw std::runtime_error( "Raw color format is not YUY2" );
+			}
+			UINT size;
+			BYTE* buffer;
+			KINECT_TRACE_SCOPE( "AccessRawUnderlyingBuffer" );
+			check( frame->AccessRawUnderlyingBuffer( &size, &buffer ), "AccessRawUnderlyingBuffer" );
+			view.data = buffer;
+			view.format = PIXEL_FORMAT_YUY2;
+		}
+
+		//! Reader of a stream and its frame arrived event.
+		template< class Source, class Reader, class Args >
+		struct ReaderHolder
+		{
+			ReaderHolder() : frameArrived_( 0 ) {}
+			~ReaderHolder() { close(); }
+
+			void open( IKinectSensor* sensor )
+			{
+				Source* source;
+				check( getSource( sensor, &source ), "get_FrameSource" );
+				source_.reset( source );
+
+				Reader* reader;
+				check( source_->OpenReader( &reader ), "OpenReader" );
+				reader_.reset( reader );
+
+				check( reader_->SubscribeFrameArrived( &frameArrived_ ), "SubscribeFrameArrived" );
+			}
+
+			void close()
+			{
+				if( frameArrived_ )
+				{
+					reader_->UnsubscribeFrameArrived( frameArrived_ );
+					frameArrived_ = 0;
+				}
+				reader_.reset();
+				source_.reset();
+			}
+
+			bool wait( unsigned int timeoutMs )
+			{
+				if( WaitForSingleObject( reinterpret_cast< HANDLE >( frameArrived_ ), timeoutMs ) != WAIT_OBJECT_0 )
+				{
+					return false;
+				}
+
+				// Taking the event data resets the event.
+				Args* args;
+				check( reader_->GetFrameArrivedEventData( frameArrived_, &args ), "GetFrameArrivedEventData" );
+				args->Release();
+				return true;
+			}
+
+			std::unique_ptr< Source, ComDeleter > source_;
+			std::unique_ptr< Reader, ComDeleter > reader_;
+			WAITABLE_HANDLE frameArrived_;
+		};
+
+		//! Depth, color or body index stream.
+		template< class Source, class Reader, class Frame, class Args >
+		struct ImageStream : public FrameSource
+		{
+			ImageStream() : width_( 0 ), height_( 0 ) {}
+
+			void open( IKinectSensor* sensor )
+			{
+				holder_.open( sensor );
+
+				IFrameDescription* description;
+				check( holder_.source_->get_FrameDescription( &description ), "get_FrameDescription" );
+				std::unique_ptr< IFrameDescription, ComDeleter > descriptionHolder( description );
+				int width, height;
+				check( description->get_Width( &width ), "get_Width" );
+				check( description->get_Height( &height ), "get_Height" );
+				width_ = width;
+				height_ = height;
+			}
+
+			void close()
+			{
+				frame_.reset();
+				holder_.close();
+			}
+
+			virtual bool acquireLatestFrame( FrameView& view ) override
+			{
+				Frame* frame;
+				HRESULT hr;
+				{
+					KINECT_TRACE_SCOPE( "AcquireLatestFrame" );
+					hr = holder_.reader_->AcquireLatestFrame( &frame );
+				}
+				if( hr == E_PENDING )
+				{
+					return false;
+				}
+				check( hr, "AcquireLatestFrame" );
+				frame_.reset( frame );
+
+				TIMESPAN relativeTime;
+				check( frame->get_RelativeTime( &relativeTime ), "get_RelativeTime" );
+
+				accessBuffer( frame, view );
+				view.width = width_;
+				view.height = height_;
+				view.bytesPerPixel = bytesPerPixel( view.format );
+				view.relativeTime = relativeTime;
+				return true;
+			}
+
+			virtual void releaseFrame() override
+			{
+				frame_.reset();
+			}
+
+			virtual bool waitFrameArrived( unsigned int timeoutMs ) override
+			{
+				return holder_.wait( timeoutMs );
+			}
+
+			virtual bool canWaitFrameArrived() const override
+			{
+				return holder_.frameArrived_ != 0;
+			}
+
+			ReaderHolder< Source, Reader, Args > holder_;
+			std::unique_ptr< Frame, ComDeleter > frame_;
+			unsigned int width_;
+			unsigned int height_;
+		};
+
+		struct BodyStream : public BodyFrameSource
+		{
+			BodyStream()
+			{
+				for( auto& body : bodies_ ) {
+					body = nullptr;
+				}
+			}
+
+			void open( IKinectSensor* sensor )
+			{
+				holder_.open( sensor );
+			}
+
+			void close()
+			{
+				for( auto& body : bodies_ ) {
+					if( body ) body->Release();
+					body = nullptr;
+				}
+				holder_.close();
+			}
+
+			virtual bool acquireLatestFrame( BodyFrame& bodyFrame ) override
+			{
+				IBodyFrame* frame;
+				HRESULT hr;
+				{
+					KINECT_TRACE_SCOPE( "AcquireLatestFrame" );
+					hr = holder_.reader_->AcquireLatestFrame( &frame );
+				}
+				if( hr == E_PENDING )
+				{
+					return false;
+				}
+				check( hr, "AcquireLatestFrame" );
+				std::unique_ptr< IBodyFrame, ComDeleter > frameHolder( frame );
+
+				TIMESPAN relativeTime;
+				check( frame->get_RelativeTime( &relativeTime ), "get_RelativeTime" );
+				bodyFrame.relativeTime = relativeTime;
+
+				// Bodies are created at the first call and refreshed after that.
+				{
+					KINECT_TRACE_SCOPE( "GetAndRefreshBodyData" );
+					check( frame->GetAndRefreshBodyData( ARRAYSIZE( bodies_ ), bodies_ ), "GetAndRefreshBodyData" );
+				}
+
+				static_assert( static_cast< int >( BODY_COUNT ) == MAX_BODY_COUNT, "body count mismatch" );
+				static_assert( static_cast< int >( JointType_Count ) == MAX_JOINT_COUNT, "joint count mismatch" );
+				static_assert( static_cast< int >( JointType_FootRight ) == JOINT_FOOT_RIGHT &&
+					static_cast< int >( JointType_ThumbRight ) == JOINT_THUMB_RIGHT, "joint order mismatch" );
+				for( int bi = 0; bi < BODY_COUNT; ++bi )
+				{
+					auto& dst = bodyFrame.bodies[ bi ];
+
+					BOOLEAN isTracked;
+					check( bodies_[ bi ]->get_IsTracked( &isTracked ), "get_IsTracked" );
+					dst.isTracked = isTracked != FALSE;
+					dst.trackingId = 0;
+					if( !dst.isTracked )
+					{
+						continue;
+					}
+
+					UINT64 trackingId;
+					check( bodies_[ bi ]->get_TrackingId( &trackingId ), "get_TrackingId" );
+					dst.trackingId = trackingId;
+
+					Joint joints[ JointType_Count ];
+					check( bodies_[ bi ]->GetJoints( ARRAYSIZE( joints ), joints ), "GetJoints" );
+					JointOrientation jointOrients[ JointType_Count ];
+					check( bodies_[ bi ]->GetJointOrientations( ARRAYSIZE( jointOrients ), jointOrients ), "GetJointOrientations" );
+					for( int j = 0; j < JointType_Count; ++j )
+					{
+						auto& joint = dst.joints[ j ];
+						joint.position[ 0 ] = joints[ j ].Position.X;
+						joint.position[ 1 ] = joints[ j ].Position.Y;
+						joint.position[ 2 ] = joints[ j ].Position.Z;
+						joint.orientation[ 0 ] = jointOrients[ j ].Orientation.x;
+						joint.orientation[ 1 ] = jointOrients[ j ].Orientation.y;
+						joint.orientation[ 2 ] = jointOrients[ j ].Orientation.z;
+						joint.orientation[ 3 ] = jointOrients[ j ].Orientation.w;
+						joint.trackingState = joints[ j ].TrackingState;
+					}
+				}
+				return true;
+			}
+
+			virtual bool waitFrameArrived( unsigned int timeoutMs ) override
+			{
+				return holder_.wait( timeoutMs );
+			}
+
+			virtual bool canWaitFrameArrived() const override
+			{
+				return holder_.frameArrived_ != 0;
+			}
+
+			ReaderHolder< IBodyFrameSource, IBodyFrameReader, IBodyFrameArrivedEventArgs > holder_;
+			IBody* bodies_[ BODY_COUNT ];
+		};
+	}
+
+	struct KinectSensor::Impl
+	{
+		std::unique_ptr< IKinectSensor, ComDeleter > sensor_;
+		ImageStream< IDepthFrameSource, IDepthFrameReader, IDepthFrame, IDepthFrameArrivedEventArgs > depth_;
+		ImageStream< IColorFrameSource, IColorFrameReader, IColorFrame, IColorFrameArrivedEventArgs > color_;
+		ImageStream< IBodyIndexFrameSource, IBodyIndexFrameReader, IBodyIndexFrame, IBodyIndexFrameArrivedEventArgs > bodyIndex_;
+		BodyStream body_;
+	};
+
+	KinectSensor::KinectSensor()
+		: impl_( new Impl() )
+	{
+	}
+
+	KinectSensor::~KinectSensor()
+	{
+		close();
+	}
+
+	void KinectSensor::open( unsigned int streams )
+	{
+		close();
+
+		IKinectSensor* sensor;
+		check( GetDefaultKinectSensor( &sensor ), "GetDefaultKinectSensor" );
+		impl_->sensor_.reset( sensor );
+		check( impl_->sensor_->Open(), "Open" );
+
+		IKinectSensor* s = impl_->sensor_.get();
+		if( streams & STREAM_FLAG_DEPTH ) {
+			impl_->depth_.open( s );
+			sources_.depth_ = &impl_->depth_;
+		}
+		if( streams & STREAM_FLAG_COLOR ) {
+			impl_->color_.open( s );
+			sources_.color_ = &impl_->color_;
+		}
+		if( streams & STREAM_FLAG_BODY_INDEX ) {
+			impl_->bodyIndex_.open( s );
+			sources_.bodyIndex_ = &impl_->bodyIndex_;
+		}
+		if( streams & STREAM_FLAG_BODY ) {
+			impl_->body_.open( s );
+			sources_.body_ = &impl_->body_;
+		}
+	}
+
+	void KinectSensor::close()
+	{
+		impl_->depth_.close();
+		impl_->color_.close();
+		impl_->bodyIndex_.close();
+		impl_->body_.close();
+		if( impl_->sensor_ ) {
+			impl_->sensor_->Close();
+			impl_->sensor_.reset();
+		}
+		sources_ = PipelineSources();
+	}
+
+	std::vector< float > KinectSensor::depthToCameraSpaceTable() const
+	{
+		std::vector< float > rays;
+		if( !impl_->sensor_ ) {
+			return rays;
+		}
+
+		ICoordinateMapper* mapper;
+		check( impl_->sensor_->get_CoordinateMapper( &mapper ), "get_CoordinateMapper" );
+		std::unique_ptr< ICoordinateMapper, ComDeleter > mapperHolder( mapper );
+
+		UINT32 count = 0;
+		PointF* table = nullptr;
+		const HRESULT hr = mapper->GetDepthFrameToCameraSpaceTable( &count, &table );
+		if( SUCCEEDED( hr ) && count == DEPTH_PIXEL_COUNT && table[ 0 ].X != 0 )
+		{
+			rays.assign( &table[ 0 ].X, &table[ 0 ].X + count * 2 );
+		}
+		CoTaskMemFree( table );
+		return rays;
+	}
+
+} // namespace kinect
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+// Needs Kinect for Windows SDK 2.0, Windows only.
+#ifdef _WIN32
+
+#include "FramePipeline.h"
+#include "FrameSource.h"
+#include <memory>
+#include <vector>
+
+namespace kinect
+{
+	//! The default Kinect sensor, opened once, with a reader for each enabled stream.
+	//! Each stream is a FrameSource (BodyFrameSource for bodies) that waits on the
+	//! frame arrived event of its reader. Color frames are raw YUY2.
+	class KinectSensor
+	{
+	public:
+		KinectSensor();
+		~KinectSensor();
+
+		//! Open the sensor and the readers of streams (StreamFlags). Throw std::runtime_error if failed.
+		void open( unsigned int streams );
+
+		//! Release the readers and close the sensor.
+		void close();
+
+		//! Sources of the opened streams, null for the others.
+		const PipelineSources& sources() const { return sources_; }
+
+		//! Camera space ray of each depth pixel, x and y at z = 1 [m].
+		//! Empty while the sensor has not sent its calibration yet, before the first frames.
+		std::vector< float > depthToCameraSpaceTable() const;
+
+	private:
+		KinectSensor( const KinectSensor& ) = delete;
+		KinectSensor& operator=( const KinectSensor& ) = delete;
+
+		struct Impl;
+		std::unique_ptr< Impl > impl_;
+		PipelineSources sources_;
+	};
+
+} // namespace kinect
+
+#endif
@@ -0,0 +1,153 @@
+#include "MappedFile.h"
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		void throwError( const char* what, const char* path )
+		{
+			std::stringstream ss;
+			ss << what << " : " << ( path ? path : "" );
+			throw std::runtime_error( ss.str() );
+		}
+
+		uint64_t allocationGranularity()
+		{
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo( &info );
+			return info.dwAllocationGranularity;
+#else
+			return static_cast< uint64_t >( sysconf( _SC_PAGESIZE ) );
+#endif
+		}
+	}
+
+#ifdef _WIN32
+	MappedFile::MappedFile()
+		: fileSize_( 0 ), offset_( 0 ), size_( 0 ), view_( nullptr ), data_( nullptr ),
+		file_( INVALID_HANDLE_VALUE ), mapping_( nullptr )
+	{
+	}
+#else
+	MappedFile::MappedFile()
+		: fileSize_( 0 ), offset_( 0 ), size_( 0 ), view_( nullptr ), data_( nullptr ),
+		fd_( -1 ), viewSize_( 0 )
+	{
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	void MappedFile::open( const char* path )
+	{
+		close();
+#ifdef _WIN32
+		file_ = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( file_ == INVALID_HANDLE_VALUE ) throwError( "File not found", path );
+
+		LARGE_INTEGER size;
+		if( !GetFileSizeEx( file_, &size ) ) throwError( "Cannot get file size", path );
+		fileSize_ = static_cast< uint64_t >( size.QuadPart );
+
+		// Empty file cannot be mapped.
+		if( fileSize_ > 0 )
+		{
+			mapping_ = CreateFileMappingA( file_, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if( !mapping_ ) throwError( "Cannot map file", path );
+		}
+#else
+		fd_ = ::open( path, O_RDONLY );
+		if( fd_ < 0 ) throwError( "File not found", path );
+
+		struct stat st;
+		if( fstat( fd_, &st ) != 0 ) throwError( "Cannot get file size", path );
+		fileSize_ = static_cast< uint64_t >( st.st_size );
+#endif
+	}
+
+	void MappedFile::close()
+	{
+		unmap();
+#ifdef _WIN32
+		if( mapping_ ) CloseHandle( mapping_ );
+		if( file_ != INVALID_HANDLE_VALUE ) CloseHandle( file_ );
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if( fd_ >= 0 ) ::close( fd_ );
+		fd_ = -1;
+#endif
+		fileSize_ = 0;
+	}
+
+	bool MappedFile::isOpen() const
+	{
+#ifdef _WIN32
+		return file_ != INVALID_HANDLE_VALUE;
+#else
+		return fd_ >= 0;
+#endif
+	}
+
+	const unsigned char* MappedFile::map( uint64_t offset, std::size_t size )
+	{
+		unmap();
+		if( size == 0 ) return nullptr;
+		if( offset + size > fileSize_ ) throw std::runtime_error( "Map range out of file" );
+
+		// Mapping must start at the allocation granularity.
+		const uint64_t granularity = allocationGranularity();
+		const uint64_t viewOffset = offset / granularity * granularity;
+		const std::size_t viewSize = static_cast< std::size_t >( offset - viewOffset ) + size;
+#ifdef _WIN32
+		view_ = MapViewOfFile( mapping_, FILE_MAP_READ,
+			static_cast< DWORD >( viewOffset >> 32 ), static_cast< DWORD >( viewOffset ), viewSize );
+		if( !view_ ) throw std::runtime_error( "MapViewOfFile failed" );
+#else
+		void* view = mmap( nullptr, viewSize, PROT_READ, MAP_SHARED, fd_, static_cast< off_t >( viewOffset ) );
+		if( view == MAP_FAILED ) throw std::runtime_error( "mmap failed" );
+		view_ = view;
+		viewSize_ = viewSize;
+#endif
+		offset_ = offset;
+		size_ = size;
+		data_ = static_cast< const unsigned char* >( view_ ) + ( offset - viewOffset );
+		return data_;
+	}
+
+	void MappedFile::unmap()
+	{
+		if( view_ )
+		{
+#ifdef _WIN32
+			UnmapViewOfFile( view_ );
+#else
+			munmap( view_, viewSize_ );
+			viewSize_ = 0;
+#endif
+		}
+		view_ = nullptr;
+		data_ = nullptr;
+		offset_ = 0;
+		size_ = 0;
+	}
+
+} // namespace kinect
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kinect
+{
+	//! Read-only memory mapped file.
+	//! One range of the file is mapped at a time, so files larger than the address space can be read.
+	struct MappedFile
+	{
+		MappedFile();
+		~MappedFile();
+
+		//! Open file. Throw std::runtime_error if failed.
+		void open( const char* path );
+		void close();
+		bool isOpen() const;
+
+		uint64_t fileSize() const { return fileSize_; }
+
+		//! Map [offset, offset + size) and return the pointer to offset.
+		//! Any range mapped before is unmapped.
+		const unsigned char* map( uint64_t offset, std::size_t size );
+		void unmap();
+
+		//! Mapped range.
+		uint64_t mappedOffset() const { return offset_; }
+		std::size_t mappedSize() const { return size_; }
+
+	private:
+		MappedFile( const MappedFile& ) = delete;
+		MappedFile& operator=( const MappedFile& ) = delete;
+
+		uint64_t fileSize_;
+		uint64_t offset_;
+		std::size_t size_;
+		void* view_;		// start of mapping, aligned to the allocation granularity
+		const unsigned char* data_;
+#ifdef _WIN32
+		void* file_;
+		void* mapping_;
+#else
+		int fd_;
+		std::size_t viewSize_;
+#endif
+	};
+
+} // namespace kinect
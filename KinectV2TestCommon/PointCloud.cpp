@@ -0,0 +1,180 @@
+#include "PointCloud.h"
+#include "ThreadPool.h"
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		const float MM_TO_M = 0.001f;
+
+		void generateScalar( const uint16_t* depth, const float* rayX, const float* rayY, std::size_t count,
+			float* x, float* y, float* z, uint8_t* valid )
+		{
+			for( std::size_t i = 0; i < count; ++i )
+			{
+				const float d = static_cast< float >( depth[ i ] );
+				x[ i ] = d * rayX[ i ];
+				y[ i ] = d * rayY[ i ];
+				z[ i ] = d * MM_TO_M;
+				valid[ i ] = depth[ i ] != 0 ? 255 : 0;
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void generateSse2( const uint16_t* depth, const float* rayX, const float* rayY, std::size_t count,
+			float* x, float* y, float* z, uint8_t* valid )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps( MM_TO_M );
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 7 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 8 )
+			{
+				const __m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + i ) );
+				const __m128 d0 = _mm_cvtepi32_ps( _mm_unpacklo_epi16( d, zero ) );
+				const __m128 d1 = _mm_cvtepi32_ps( _mm_unpackhi_epi16( d, zero ) );
+				_mm_storeu_ps( x + i, _mm_mul_ps( d0, _mm_loadu_ps( rayX + i ) ) );
+				_mm_storeu_ps( x + i + 4, _mm_mul_ps( d1, _mm_loadu_ps( rayX + i + 4 ) ) );
+				_mm_storeu_ps( y + i, _mm_mul_ps( d0, _mm_loadu_ps( rayY + i ) ) );
+				_mm_storeu_ps( y + i + 4, _mm_mul_ps( d1, _mm_loadu_ps( rayY + i + 4 ) ) );
+				_mm_storeu_ps( z + i, _mm_mul_ps( d0, scale ) );
+				_mm_storeu_ps( z + i + 4, _mm_mul_ps( d1, scale ) );
+
+				// 0xffff where empty, packed to 0xff and inverted.
+				const __m128i empty = _mm_packs_epi16( _mm_cmpeq_epi16( d, zero ), zero );
+				_mm_storel_epi64( reinterpret_cast< __m128i* >( valid + i ), _mm_andnot_si128( empty, _mm_set1_epi8( -1 ) ) );
+			}
+			generateScalar( depth + vectorCount, rayX + vectorCount, rayY + vectorCount, count - vectorCount,
+				x + vectorCount, y + vectorCount, z + vectorCount, valid + vectorCount );
+		}
+
+		KINECT_TARGET_AVX2
+		void generateAvx2( const uint16_t* depth, const float* rayX, const float* rayY, std::size_t count,
+			float* x, float* y, float* z, uint8_t* valid )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m256 scale = _mm256_set1_ps( MM_TO_M );
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 15 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 16 )
+			{
+				const __m128i dl = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + i ) );
+				const __m128i dh = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + i + 8 ) );
+				const __m256 d0 = _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( dl ) );
+				const __m256 d1 = _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( dh ) );
+				_mm256_storeu_ps( x + i, _mm256_mul_ps( d0, _mm256_loadu_ps( rayX + i ) ) );
+				_mm256_storeu_ps( x + i + 8, _mm256_mul_ps( d1, _mm256_loadu_ps( rayX + i + 8 ) ) );
+				_mm256_storeu_ps( y + i, _mm256_mul_ps( d0, _mm256_loadu_ps( rayY + i ) ) );
+				_mm256_storeu_ps( y + i + 8, _mm256_mul_ps( d1, _mm256_loadu_ps( rayY + i + 8 ) ) );
+				_mm256_storeu_ps( z + i, _mm256_mul_ps( d0, scale ) );
+				_mm256_storeu_ps( z + i + 8, _mm256_mul_ps( d1, scale ) );
+
+				const __m128i empty = _mm_packs_epi16( _mm_cmpeq_epi16( dl, zero ), _mm_cmpeq_epi16( dh, zero ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( valid + i ), _mm_andnot_si128( empty, _mm_set1_epi8( -1 ) ) );
+			}
+			generateScalar( depth + vectorCount, rayX + vectorCount, rayY + vectorCount, count - vectorCount,
+				x + vectorCount, y + vectorCount, z + vectorCount, valid + vectorCount );
+		}
+#endif
+	}
+
+	void PointCloud::resize( unsigned int width, unsigned int height )
+	{
+		const std::size_t count = static_cast< std::size_t >( width ) * height;
+		width_ = width;
+		height_ = height;
+		x_.resize( count );
+		y_.resize( count );
+		z_.resize( count );
+		valid_.resize( count );
+	}
+
+	PointCloudGenerator::PointCloudGenerator( const CameraIntrinsics& depth, unsigned int width, unsigned int height )
+		: width_( width ), height_( height )
+	{
+		if( width == 0 || height == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+
+		// Rays are in the image axes, camera space y is up.
+		const std::vector< double > rays = computeRays( depth, width, height );
+		const std::size_t count = static_cast< std::size_t >( width ) * height;
+		rayX_.resize( count );
+		rayY_.resize( count );
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			rayX_[ i ] = static_cast< float >( rays[ i * 2 ] * 0.001 );
+			rayY_[ i ] = static_cast< float >( -rays[ i * 2 + 1 ] * 0.001 );
+		}
+	}
+
+	PointCloudGenerator::PointCloudGenerator( const float* cameraSpaceTable, unsigned int width, unsigned int height )
+		: width_( width ), height_( height )
+	{
+		if( width == 0 || height == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+
+		const std::size_t count = static_cast< std::size_t >( width ) * height;
+		rayX_.resize( count );
+		rayY_.resize( count );
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			rayX_[ i ] = static_cast< float >( cameraSpaceTable[ i * 2 ] * 0.001 );
+			rayY_[ i ] = static_cast< float >( cameraSpaceTable[ i * 2 + 1 ] * 0.001 );
+		}
+	}
+
+	void PointCloudGenerator::generate( const uint16_t* depth, PointCloud& cloud, SimdLevel simd ) const
+	{
+		cloud.resize( width_, height_ );
+		generateRows( depth, cloud, 0, height_, resolveSimdLevel( simd ) );
+	}
+
+	void PointCloudGenerator::generate( const uint16_t* depth, PointCloud& cloud, ThreadPool& pool, SimdLevel simd ) const
+	{
+		cloud.resize( width_, height_ );
+		simd = resolveSimdLevel( simd );
+		pool.parallelFor( height_, BAND_ROWS, [&]( std::size_t begin, std::size_t end ) {
+			generateRows( depth, cloud, static_cast< unsigned int >( begin ), static_cast< unsigned int >( end ), simd );
+		} );
+	}
+
+	void PointCloudGenerator::generateRows( const uint16_t* depth, PointCloud& cloud,
+		unsigned int beginRow, unsigned int endRow, SimdLevel simd ) const
+	{
+		const std::size_t begin = static_cast< std::size_t >( beginRow ) * width_;
+		const std::size_t count = static_cast< std::size_t >( endRow - beginRow ) * width_;
+		const uint16_t* d = depth + begin;
+		const float* rx = &rayX_[ begin ];
+		const float* ry = &rayY_[ begin ];
+		float* x = &cloud.x_[ begin ];
+		float* y = &cloud.y_[ begin ];
+		float* z = &cloud.z_[ begin ];
+		uint8_t* valid = &cloud.valid_[ begin ];
+
+		switch( simd )
+		{
+#if KINECT_X86
+		case SIMD_AVX2:
+			generateAvx2( d, rx, ry, count, x, y, z, valid );
+			break;
+		case SIMD_SSE2:
+			generateSse2( d, rx, ry, count, x, y, z, valid );
+			break;
+#endif
+		default:
+			generateScalar( d, rx, ry, count, x, y, z, valid );
+			break;
+		}
+	}
+
+} // namespace kinect
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CameraModel.h"
+#include "Cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	class ThreadPool;
+
+	//! Camera space points of a depth frame, one per pixel in row order, as separate arrays.
+	//! Axes as the camera space of Kinect SDK : x to the image right, y up, z away from the sensor [m].
+	struct PointCloud
+	{
+		PointCloud() : width_( 0 ), height_( 0 ) {}
+
+		void resize( unsigned int width, unsigned int height );
+		std::size_t size() const { return z_.size(); }
+
+		unsigned int width_;
+		unsigned int height_;
+		std::vector< float > x_;
+		std::vector< float > y_;
+		std::vector< float > z_;
+		std::vector< uint8_t > valid_;	// 255 where depth is measured, 0 where the point is 0
+	};
+
+	//! Turns depth frames into point clouds through the ray of each pixel, built once.
+	//! A point is the ray scaled by the depth : 3 multiplies per pixel.
+	class PointCloudGenerator
+	{
+	public:
+		enum
+		{
+			//! Rows per chunk of the thread pool, 27 chunks of a 512x424 frame.
+			BAND_ROWS = 16
+		};
+
+		//! Build the rays from the depth camera intrinsics.
+		PointCloudGenerator( const CameraIntrinsics& depth, unsigned int width, unsigned int height );
+
+		//! Use the rays of ICoordinateMapper::GetDepthFrameToCameraSpaceTable, x and y at z = 1 [m]
+		//! in camera space per pixel.
+		PointCloudGenerator( const float* cameraSpaceTable, unsigned int width, unsigned int height );
+
+		//! Points of a depth frame [mm] on the calling thread.
+		//! All SIMD levels give the same floats as SIMD_SCALAR.
+		void generate( const uint16_t* depth, PointCloud& cloud, SimdLevel simd = SIMD_BEST ) const;
+
+		//! Same as above, with the row bands spread over the threads of pool.
+		void generate( const uint16_t* depth, PointCloud& cloud, ThreadPool& pool, SimdLevel simd = SIMD_BEST ) const;
+
+		unsigned int width() const { return width_; }
+		unsigned int height() const { return height_; }
+
+	private:
+		void generateRows( const uint16_t* depth, PointCloud& cloud, unsigned int beginRow, unsigned int endRow, SimdLevel simd ) const;
+
+		unsigned int width_;
+		unsigned int height_;
+		std::vector< float > rayX_;		// ray / 1000, so that depth [mm] gives [m]
+		std::vector< float > rayY_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,181 @@
+#include "Recording.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace kinect
+{
+	namespace
+	{
+		const char RECORDING_MAGIC[ 8 ] = { 'K', 'V', '2', 'R', 'E', 'C', 0, 0 };
+		const std::size_t NO_CHUNK = static_cast< std::size_t >( -1 );
+
+		static_assert( sizeof( RecordingHeader ) == 64, "RecordingHeader must be packed" );
+		static_assert( sizeof( RecordingIndexEntry ) == 16, "RecordingIndexEntry must be packed" );
+
+		void throwError( const char* what, const char* path )
+		{
+			std::stringstream ss;
+			ss << what << " : " << path;
+			throw std::runtime_error( ss.str() );
+		}
+	}
+
+	RecordingWriter::RecordingWriter( const char* path, PixelFormat format, unsigned int width, unsigned int height )
+		: fp_( nullptr ), position_( 0 )
+	{
+		memset( &header_, 0, sizeof header_ );
+		memcpy( header_.magic, RECORDING_MAGIC, sizeof header_.magic );
+		header_.version = RECORDING_VERSION;
+		header_.format = format;
+		header_.width = width;
+		header_.height = height;
+		header_.bytesPerPixel = bytesPerPixel( format );
+		header_.chunkFrames = RECORDING_CHUNK_FRAMES;
+		header_.frameSize = static_cast< uint64_t >( width ) * height * header_.bytesPerPixel;
+		header_.frameStride = ( header_.frameSize + RECORDING_PAGE_SIZE - 1 ) / RECORDING_PAGE_SIZE * RECORDING_PAGE_SIZE;
+
+		fp_ = fopen( path, "wb" );
+		if( !fp_ ) throwError( "Cannot create file", path );
+
+		// Header is written again with the frame count on close.
+		writeBytes( &header_, sizeof header_ );
+		writePadding( RECORDING_HEADER_SIZE - sizeof header_ );
+	}
+
+	RecordingWriter::~RecordingWriter()
+	{
+		try {
+			close();
+		}
+		catch( ... ) {
+		}
+	}
+
+	void RecordingWriter::write( const FrameView& frame )
+	{
+		if( frame.size() != header_.frameSize || frame.format != static_cast< PixelFormat >( header_.format ) )
+		{
+			throw std::runtime_error( "Frame does not match the recording" );
+		}
+
+		RecordingIndexEntry entry;
+		entry.relativeTime = frame.relativeTime;
+		entry.offset = position_;
+		index_.push_back( entry );
+
+		writeBytes( frame.data, frame.size() );
+		writePadding( static_cast< std::size_t >( header_.frameStride - header_.frameSize ) );
+		++header_.frameCount;
+	}
+
+	void RecordingWriter::close()
+	{
+		if( !fp_ ) return;
+
+		header_.indexOffset = position_;
+		if( !index_.empty() )
+		{
+			writeBytes( index_.data(), index_.size() * sizeof( RecordingIndexEntry ) );
+		}
+
+		fseek( fp_, 0, SEEK_SET );
+		const bool ok = fwrite( &header_, sizeof header_, 1, fp_ ) == 1;
+		const bool closed = fclose( fp_ ) == 0;
+		fp_ = nullptr;
+		if( !ok || !closed ) throw std::runtime_error( "Cannot finish recording" );
+	}
+
+	void RecordingWriter::writeBytes( const void* data, std::size_t size )
+	{
+		if( fwrite( data, 1, size, fp_ ) != size ) throw std::runtime_error( "Cannot write recording" );
+		position_ += size;
+	}
+
+	void RecordingWriter::writePadding( std::size_t size )
+	{
+		static const unsigned char zeros[ RECORDING_PAGE_SIZE ] = {};
+		while( size > 0 )
+		{
+			const std::size_t n = std::min< std::size_t >( size, sizeof zeros );
+			writeBytes( zeros, n );
+			size -= n;
+		}
+	}
+
+	RecordingReader::RecordingReader( const char* path )
+		: chunk_( NO_CHUNK ), chunkData_( nullptr ), cursor_( 0 )
+	{
+		file_.open( path );
+		if( file_.fileSize() < RECORDING_HEADER_SIZE ) throwError( "Not a recording", path );
+
+		memcpy( &header_, file_.map( 0, sizeof header_ ), sizeof header_ );
+		file_.unmap();
+
+		if( memcmp( header_.magic, RECORDING_MAGIC, sizeof header_.magic ) != 0 ||
+			header_.version != RECORDING_VERSION ||
+			header_.bytesPerPixel != bytesPerPixel( static_cast< PixelFormat >( header_.format ) ) ||
+			header_.frameSize != static_cast< uint64_t >( header_.width ) * header_.height * header_.bytesPerPixel ||
+			header_.frameStride < header_.frameSize || header_.frameStride % RECORDING_PAGE_SIZE != 0 ||
+			header_.chunkFrames == 0 )
+		{
+			throwError( "Not a recording", path );
+		}
+		if( header_.indexOffset == 0 ||
+			header_.indexOffset + header_.frameCount * sizeof( RecordingIndexEntry ) > file_.fileSize() )
+		{
+			throwError( "Recording was not closed", path );
+		}
+
+		index_.resize( static_cast< std::size_t >( header_.frameCount ) );
+		if( !index_.empty() )
+		{
+			const std::size_t indexSize = index_.size() * sizeof( RecordingIndexEntry );
+			memcpy( index_.data(), file_.map( header_.indexOffset, indexSize ), indexSize );
+			file_.unmap();
+		}
+	}
+
+	FrameView RecordingReader::frame( std::size_t index )
+	{
+		if( index >= index_.size() ) throw std::out_of_range( "Frame index out of range" );
+
+		const std::size_t chunk = index / header_.chunkFrames;
+		const std::size_t first = chunk * header_.chunkFrames;
+		if( chunk != chunk_ )
+		{
+			const std::size_t count = std::min< std::size_t >( header_.chunkFrames, index_.size() - first );
+			chunkData_ = file_.map( index_[ first ].offset, static_cast< std::size_t >( count * header_.frameStride ) );
+			chunk_ = chunk;
+		}
+
+		FrameView view;
+		view.data = chunkData_ + ( index - first ) * header_.frameStride;
+		view.width = header_.width;
+		view.height = header_.height;
+		view.bytesPerPixel = header_.bytesPerPixel;
+		view.format = static_cast< PixelFormat >( header_.format );
+		view.relativeTime = index_[ index ].relativeTime;
+		return view;
+	}
+
+	std::size_t RecordingReader::findFrame( int64_t relativeTime ) const
+	{
+		auto it = std::lower_bound( index_.begin(), index_.end(), relativeTime,
+			[]( const RecordingIndexEntry& entry, int64_t time ) { return entry.relativeTime < time; } );
+		return static_cast< std::size_t >( it - index_.begin() );
+	}
+
+	bool RecordingReader::acquireLatestFrame( FrameView& view )
+	{
+		if( cursor_ >= index_.size() ) return false;
+		view = frame( cursor_++ );
+		return true;
+	}
+
+	void RecordingReader::releaseFrame()
+	{
+	}
+
+} // namespace kinect
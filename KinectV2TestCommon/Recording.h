@@ -0,0 +1,108 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <vector>
+
+namespace kinect
+{
+	//! Recording file layout.
+	//!
+	//!   [header page] [frame 0] [frame 1] ... [frame N-1] [frame index]
+	//!
+	//! Each frame record has the same size, padded to PAGE_SIZE, so frame i is found at
+	//! HEADER_SIZE + i * frameStride without reading anything. Frames are mapped CHUNK_FRAMES
+	//! at a time. The frame index at the end holds RelativeTime of each frame.
+	enum
+	{
+		RECORDING_VERSION = 1,
+		RECORDING_PAGE_SIZE = 4096,
+		RECORDING_HEADER_SIZE = RECORDING_PAGE_SIZE,
+		RECORDING_CHUNK_FRAMES = 64
+	};
+
+	struct RecordingHeader
+	{
+		char magic[ 8 ];			// "KV2REC\0\0"
+		uint32_t version;
+		uint32_t format;			// PixelFormat
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytesPerPixel;
+		uint32_t chunkFrames;
+		uint64_t frameSize;			// payload bytes of a frame
+		uint64_t frameStride;		// frameSize rounded up to the page size
+		uint64_t frameCount;
+		uint64_t indexOffset;		// 0 until the recording is closed
+	};
+
+	struct RecordingIndexEntry
+	{
+		int64_t relativeTime;		// TIMESPAN ticks
+		uint64_t offset;			// file offset of the frame payload
+	};
+
+	//! Append frames to a recording file.
+	struct RecordingWriter
+	{
+		//! Create file. Throw std::runtime_error if failed.
+		RecordingWriter( const char* path, PixelFormat format, unsigned int width, unsigned int height );
+		~RecordingWriter();
+
+		//! Append a frame. Its size must match the recording.
+		void write( const FrameView& frame );
+
+		//! Write the frame index and the final header. Called by the destructor too.
+		void close();
+
+		uint64_t frameCount() const { return header_.frameCount; }
+
+	private:
+		RecordingWriter( const RecordingWriter& ) = delete;
+		RecordingWriter& operator=( const RecordingWriter& ) = delete;
+
+		void writeBytes( const void* data, std::size_t size );
+		void writePadding( std::size_t size );
+
+		FILE* fp_;
+		RecordingHeader header_;
+		uint64_t position_;
+		std::vector< RecordingIndexEntry > index_;
+	};
+
+	//! Zero-copy reader of a recording file.
+	//! As a FrameSource, it hands out frames in order as fast as they are acquired.
+	struct RecordingReader : public FrameSource
+	{
+		//! Open file. Throw std::runtime_error if failed or not a closed recording.
+		explicit RecordingReader( const char* path );
+
+		const RecordingHeader& header() const { return header_; }
+		std::size_t frameCount() const { return index_.size(); }
+		int64_t relativeTime( std::size_t index ) const { return index_[ index ].relativeTime; }
+
+		//! View of frame without copy.
+		//! Valid until a frame of another chunk is requested from this reader.
+		FrameView frame( std::size_t index );
+
+		//! Index of the first frame at or after the time. frameCount() if none.
+		std::size_t findFrame( int64_t relativeTime ) const;
+
+		//! Set the frame returned by the next acquireLatestFrame().
+		void seek( std::size_t index ) { cursor_ = index; }
+		std::size_t tell() const { return cursor_; }
+
+		virtual bool acquireLatestFrame( FrameView& frame ) override;
+		virtual void releaseFrame() override;
+
+	private:
+		MappedFile file_;
+		RecordingHeader header_;
+		std::vector< RecordingIndexEntry > index_;
+		std::size_t chunk_;			// mapped chunk, SIZE_MAX if none
+		const unsigned char* chunkData_;
+		std::size_t cursor_;
+	};
+
+} // namespace kinect
@@ -0,0 +1,240 @@
+#include "Registration.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		//! Pixels mapped per call of the kernel, so the coordinates of registerColor() stay in cache.
+		const std::size_t BAND_PIXELS = 4096;
+
+		void mapScalar( const uint16_t* depth, const float* au, const float* av, const float* aw,
+			float bu, float bv, float bw, std::size_t count, float* colorX, float* colorY )
+		{
+			const float invalid = -std::numeric_limits< float >::infinity();
+			for( std::size_t i = 0; i < count; ++i )
+			{
+				const float z = static_cast< float >( depth[ i ] );
+				if( depth[ i ] == 0 )
+				{
+					colorX[ i ] = invalid;
+					colorY[ i ] = invalid;
+					continue;
+				}
+				const float w = 1.0f / ( z * aw[ i ] + bw );
+				colorX[ i ] = ( z * au[ i ] + bu ) * w;
+				colorY[ i ] = ( z * av[ i ] + bv ) * w;
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void mapSse2( const uint16_t* depth, const float* au, const float* av, const float* aw,
+			float bu, float bv, float bw, std::size_t count, float* colorX, float* colorY )
+		{
+			const __m128 invalid = _mm_set1_ps( -std::numeric_limits< float >::infinity() );
+			const __m128 vbu = _mm_set1_ps( bu );
+			const __m128 vbv = _mm_set1_ps( bv );
+			const __m128 vbw = _mm_set1_ps( bw );
+			const __m128 one = _mm_set1_ps( 1.0f );
+			const __m128i zero = _mm_setzero_si128();
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 3 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 4 )
+			{
+				const __m128i d = _mm_unpacklo_epi16( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( depth + i ) ), zero );
+				const __m128 z = _mm_cvtepi32_ps( d );
+				const __m128 empty = _mm_castsi128_ps( _mm_cmpeq_epi32( d, zero ) );
+
+				const __m128 w = _mm_div_ps( one, _mm_add_ps( _mm_mul_ps( z, _mm_loadu_ps( aw + i ) ), vbw ) );
+				const __m128 x = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( z, _mm_loadu_ps( au + i ) ), vbu ), w );
+				const __m128 y = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( z, _mm_loadu_ps( av + i ) ), vbv ), w );
+				_mm_storeu_ps( colorX + i, _mm_or_ps( _mm_and_ps( empty, invalid ), _mm_andnot_ps( empty, x ) ) );
+				_mm_storeu_ps( colorY + i, _mm_or_ps( _mm_and_ps( empty, invalid ), _mm_andnot_ps( empty, y ) ) );
+			}
+			mapScalar( depth + vectorCount, au + vectorCount, av + vectorCount, aw + vectorCount,
+				bu, bv, bw, count - vectorCount, colorX + vectorCount, colorY + vectorCount );
+		}
+
+		KINECT_TARGET_AVX2
+		void mapAvx2( const uint16_t* depth, const float* au, const float* av, const float* aw,
+			float bu, float bv, float bw, std::size_t count, float* colorX, float* colorY )
+		{
+			const __m256 invalid = _mm256_set1_ps( -std::numeric_limits< float >::infinity() );
+			const __m256 vbu = _mm256_set1_ps( bu );
+			const __m256 vbv = _mm256_set1_ps( bv );
+			const __m256 vbw = _mm256_set1_ps( bw );
+			const __m256 one = _mm256_set1_ps( 1.0f );
+			const __m256i zero = _mm256_setzero_si256();
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 7 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 8 )
+			{
+				const __m256i d = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + i ) ) );
+				const __m256 z = _mm256_cvtepi32_ps( d );
+				const __m256 empty = _mm256_castsi256_ps( _mm256_cmpeq_epi32( d, zero ) );
+
+				// Separate multiply and add, no FMA, to round as the scalar code does.
+				const __m256 w = _mm256_div_ps( one, _mm256_add_ps( _mm256_mul_ps( z, _mm256_loadu_ps( aw + i ) ), vbw ) );
+				const __m256 x = _mm256_mul_ps( _mm256_add_ps( _mm256_mul_ps( z, _mm256_loadu_ps( au + i ) ), vbu ), w );
+				const __m256 y = _mm256_mul_ps( _mm256_add_ps( _mm256_mul_ps( z, _mm256_loadu_ps( av + i ) ), vbv ), w );
+				_mm256_storeu_ps( colorX + i, _mm256_blendv_ps( x, invalid, empty ) );
+				_mm256_storeu_ps( colorY + i, _mm256_blendv_ps( y, invalid, empty ) );
+			}
+			mapScalar( depth + vectorCount, au + vectorCount, av + vectorCount, aw + vectorCount,
+				bu, bv, bw, count - vectorCount, colorX + vectorCount, colorY + vectorCount );
+		}
+#endif
+	}
+
+	DepthRegistration::DepthRegistration( const CameraIntrinsics& depth, unsigned int depthWidth, unsigned int depthHeight,
+		const CameraIntrinsics& color, unsigned int colorWidth, unsigned int colorHeight,
+		const CameraExtrinsics& depthToColor )
+		: depthWidth_( depthWidth ), depthHeight_( depthHeight ), colorWidth_( colorWidth ), colorHeight_( colorHeight ),
+		color_( color ), depthToColor_( depthToColor )
+	{
+		rays_ = computeRays( depth, depthWidth, depthHeight );
+		build( color, depthToColor );
+	}
+
+	DepthRegistration::DepthRegistration( const float* rays, unsigned int depthWidth, unsigned int depthHeight,
+		const CameraIntrinsics& color, unsigned int colorWidth, unsigned int colorHeight,
+		const CameraExtrinsics& depthToColor )
+		: depthWidth_( depthWidth ), depthHeight_( depthHeight ), colorWidth_( colorWidth ), colorHeight_( colorHeight ),
+		color_( color ), depthToColor_( depthToColor )
+	{
+		rays_.assign( rays, rays + static_cast< std::size_t >( depthWidth ) * depthHeight * 2 );
+		build( color, depthToColor );
+	}
+
+	void DepthRegistration::build( const CameraIntrinsics& color, const CameraExtrinsics& depthToColor )
+	{
+		if( depthWidth_ == 0 || depthHeight_ == 0 || colorWidth_ == 0 || colorHeight_ == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+
+		const std::size_t count = static_cast< std::size_t >( depthWidth_ ) * depthHeight_;
+		au_.resize( count );
+		av_.resize( count );
+		aw_.resize( count );
+
+		// Depth is in [mm], the table in [m].
+		const double scale = 0.001;
+		const float* r = depthToColor.rotation;
+		const float* t = depthToColor.translation;
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			const double rx = rays_[ i * 2 ];
+			const double ry = rays_[ i * 2 + 1 ];
+			const double qx = r[ 0 ] * rx + r[ 1 ] * ry + r[ 2 ];
+			const double qy = r[ 3 ] * rx + r[ 4 ] * ry + r[ 5 ];
+			const double qz = r[ 6 ] * rx + r[ 7 ] * ry + r[ 8 ];
+			au_[ i ] = static_cast< float >( scale * ( color.focalLengthX * qx + color.principalPointX * qz ) );
+			av_[ i ] = static_cast< float >( scale * ( color.focalLengthY * qy + color.principalPointY * qz ) );
+			aw_[ i ] = static_cast< float >( scale * qz );
+		}
+		bu_ = static_cast< float >( static_cast< double >( color.focalLengthX ) * t[ 0 ] + static_cast< double >( color.principalPointX ) * t[ 2 ] );
+		bv_ = static_cast< float >( static_cast< double >( color.focalLengthY ) * t[ 1 ] + static_cast< double >( color.principalPointY ) * t[ 2 ] );
+		bw_ = t[ 2 ];
+	}
+
+	void DepthRegistration::mapRange( const uint16_t* depth, std::size_t begin, std::size_t end,
+		float* colorX, float* colorY, SimdLevel simd ) const
+	{
+		const std::size_t count = end - begin;
+		switch( simd )
+		{
+#if KINECT_X86
+		case SIMD_AVX2:
+			mapAvx2( depth + begin, &au_[ begin ], &av_[ begin ], &aw_[ begin ], bu_, bv_, bw_, count, colorX, colorY );
+			break;
+		case SIMD_SSE2:
+			mapSse2( depth + begin, &au_[ begin ], &av_[ begin ], &aw_[ begin ], bu_, bv_, bw_, count, colorX, colorY );
+			break;
+#endif
+		default:
+			mapScalar( depth + begin, &au_[ begin ], &av_[ begin ], &aw_[ begin ], bu_, bv_, bw_, count, colorX, colorY );
+			break;
+		}
+	}
+
+	void DepthRegistration::mapToColor( const uint16_t* depth, float* colorX, float* colorY, SimdLevel simd ) const
+	{
+		const std::size_t count = static_cast< std::size_t >( depthWidth_ ) * depthHeight_;
+		mapRange( depth, 0, count, colorX, colorY, resolveSimdLevel( simd ) );
+	}
+
+	void DepthRegistration::registerColor( const uint16_t* depth, const unsigned char* colorRgba, std::size_t colorPitch,
+		unsigned char* dst, std::size_t dstPitch, SimdLevel simd ) const
+	{
+		simd = resolveSimdLevel( simd );
+		const std::size_t count = static_cast< std::size_t >( depthWidth_ ) * depthHeight_;
+		const float maxX = colorWidth_ - 0.5f;
+		const float maxY = colorHeight_ - 0.5f;
+		float colorX[ BAND_PIXELS ];
+		float colorY[ BAND_PIXELS ];
+
+		for( std::size_t begin = 0; begin < count; begin += BAND_PIXELS )
+		{
+			const std::size_t end = begin + BAND_PIXELS < count ? begin + BAND_PIXELS : count;
+			mapRange( depth, begin, end, colorX, colorY, simd );
+
+			for( std::size_t i = begin; i < end; ++i )
+			{
+				const float x = colorX[ i - begin ];
+				const float y = colorY[ i - begin ];
+				unsigned char* out = dst + ( i / depthWidth_ ) * dstPitch + ( i % depthWidth_ ) * 4;
+
+				// Also false for -infinity of empty depth.
+				if( x >= -0.5f && x < maxX && y >= -0.5f && y < maxY )
+				{
+					const std::size_t cx = static_cast< std::size_t >( x + 0.5f );
+					const std::size_t cy = static_cast< std::size_t >( y + 0.5f );
+					const unsigned char* in = colorRgba + cy * colorPitch + cx * 4;
+					out[ 0 ] = in[ 0 ];
+					out[ 1 ] = in[ 1 ];
+					out[ 2 ] = in[ 2 ];
+					out[ 3 ] = 255;
+				}
+				else
+				{
+					out[ 0 ] = 0;
+					out[ 1 ] = 0;
+					out[ 2 ] = 0;
+					out[ 3 ] = 0;
+				}
+			}
+		}
+	}
+
+	bool DepthRegistration::projectReference( unsigned int x, unsigned int y, uint16_t depth, double& colorX, double& colorY ) const
+	{
+		if( depth == 0 )
+		{
+			return false;
+		}
+
+		const std::size_t i = static_cast< std::size_t >( y ) * depthWidth_ + x;
+		const double z = depth * 0.001;
+		const double px = rays_[ i * 2 ] * z;
+		const double py = rays_[ i * 2 + 1 ] * z;
+		const double pz = z;
+
+		const float* r = depthToColor_.rotation;
+		const float* t = depthToColor_.translation;
+		const double cx = r[ 0 ] * px + r[ 1 ] * py + r[ 2 ] * pz + t[ 0 ];
+		const double cy = r[ 3 ] * px + r[ 4 ] * py + r[ 5 ] * pz + t[ 1 ];
+		const double cz = r[ 6 ] * px + r[ 7 ] * py + r[ 8 ] * pz + t[ 2 ];
+		colorX = color_.focalLengthX * cx / cz + color_.principalPointX;
+		colorY = color_.focalLengthY * cy / cz + color_.principalPointY;
+		return true;
+	}
+
+} // namespace kinect
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CameraModel.h"
+#include "Cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	//! Maps depth pixels into the color image through a table built once per sensor.
+	//!
+	//! For a depth pixel with ray r (undistorted, at z = 1 [m]) and depth z [mm], the color
+	//! image position is
+	//!   x = ( z * au + bu ) / ( z * aw + bw ),  y = ( z * av + bv ) / ( z * aw + bw )
+	//! where au, av, aw per pixel fold the ray, rotation and color focal length and principal
+	//! point together, and bu, bv, bw the translation. A frame then costs 3 multiply-adds
+	//! and a reciprocal per pixel. Distortion of the color camera is not modeled.
+	class DepthRegistration
+	{
+	public:
+		//! Build the table from the depth camera intrinsics.
+		DepthRegistration( const CameraIntrinsics& depth, unsigned int depthWidth, unsigned int depthHeight,
+			const CameraIntrinsics& color, unsigned int colorWidth, unsigned int colorHeight,
+			const CameraExtrinsics& depthToColor );
+
+		//! Build the table from the ray of each depth pixel, x and y at z = 1 in turn, in the
+		//! image axes (x grows with the column, y with the row).
+		DepthRegistration( const float* rays, unsigned int depthWidth, unsigned int depthHeight,
+			const CameraIntrinsics& color, unsigned int colorWidth, unsigned int colorHeight,
+			const CameraExtrinsics& depthToColor );
+
+		//! Color image position of each depth pixel. -infinity where depth is 0.
+		//! All SIMD levels give the same floats as SIMD_SCALAR.
+		void mapToColor( const uint16_t* depth, float* colorX, float* colorY, SimdLevel simd = SIMD_BEST ) const;
+
+		//! Color of each depth pixel, sampled at the nearest color pixel, into an RGBA image
+		//! of the depth size. Alpha is 0 where depth is 0 or the position is outside the color image.
+		void registerColor( const uint16_t* depth, const unsigned char* colorRgba, std::size_t colorPitch,
+			unsigned char* dst, std::size_t dstPitch, SimdLevel simd = SIMD_BEST ) const;
+
+		//! Reference projection of one depth pixel in double precision, without the table.
+		//! Return false if depth is 0.
+		bool projectReference( unsigned int x, unsigned int y, uint16_t depth, double& colorX, double& colorY ) const;
+
+		unsigned int depthWidth() const { return depthWidth_; }
+		unsigned int depthHeight() const { return depthHeight_; }
+
+	private:
+		void build( const CameraIntrinsics& color, const CameraExtrinsics& depthToColor );
+		void mapRange( const uint16_t* depth, std::size_t begin, std::size_t end, float* colorX, float* colorY, SimdLevel simd ) const;
+
+		unsigned int depthWidth_;
+		unsigned int depthHeight_;
+		unsigned int colorWidth_;
+		unsigned int colorHeight_;
+		CameraIntrinsics color_;
+		CameraExtrinsics depthToColor_;
+
+		std::vector< double > rays_;		// x, y at z = 1 per pixel, for the reference
+		std::vector< float > au_;
+		std::vector< float > av_;
+		std::vector< float > aw_;
+		float bu_;
+		float bv_;
+		float bw_;
+	};
+
+} // namespace kinect
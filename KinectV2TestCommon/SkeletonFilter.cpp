@@ -0,0 +1,272 @@
+#include "SkeletonFilter.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		enum
+		{
+			STRIDE = SkeletonHistory::JOINT_STRIDE
+		};
+		static_assert( STRIDE % 8 == 0, "rows are a multiple of 8 floats" );
+
+		const float TWO_PI = 6.28318530718f;
+
+		//! Default parameters of each JointGroup.
+		const OneEuroParams DEFAULT_PARAMS[ JOINT_GROUP_COUNT ] = {
+			{ 1.0f, 4.0f },		// torso
+			{ 1.5f, 8.0f },		// limb
+			{ 2.0f, 12.0f }		// extremity
+		};
+
+		//! Constants of a frame : 1 / dt, the smoothing factor of the velocity and 2 pi dt.
+		struct FrameStep
+		{
+			float rate;
+			float derivativeAlpha;
+			float twoPiDt;
+		};
+
+		//! The filter of slots [begin, end). Each SIMD kernel does the same operations in the same order.
+		void updateScalar( const FrameStep& step, const float* const* src, const float* minCutoff, const float* beta,
+			float* const* value, float* const* derivative, float* const* dst, std::size_t begin, std::size_t end )
+		{
+			for( std::size_t i = begin; i < end; ++i )
+			{
+				float velocity[ 3 ];
+				for( int a = 0; a < 3; ++a )
+				{
+					const float raw = ( src[ a ][ i ] - value[ a ][ i ] ) * step.rate;
+					velocity[ a ] = derivative[ a ][ i ] + step.derivativeAlpha * ( raw - derivative[ a ][ i ] );
+				}
+				const float speed = std::sqrt( velocity[ 0 ] * velocity[ 0 ] + velocity[ 1 ] * velocity[ 1 ] + velocity[ 2 ] * velocity[ 2 ] );
+				const float r = step.twoPiDt * ( minCutoff[ i ] + beta[ i ] * speed );
+				const float alpha = r / ( 1.0f + r );
+				for( int a = 0; a < 3; ++a )
+				{
+					const float v = value[ a ][ i ] + alpha * ( src[ a ][ i ] - value[ a ][ i ] );
+					value[ a ][ i ] = v;
+					derivative[ a ][ i ] = velocity[ a ];
+					dst[ a ][ i ] = v;
+				}
+			}
+		}
+
+#if KINECT_X86
+		KINECT_TARGET_SSE2
+		void updateSse2( const FrameStep& step, const float* const* src, const float* minCutoff, const float* beta,
+			float* const* value, float* const* derivative, float* const* dst )
+		{
+			const __m128 rate = _mm_set1_ps( step.rate );
+			const __m128 derivativeAlpha = _mm_set1_ps( step.derivativeAlpha );
+			const __m128 twoPiDt = _mm_set1_ps( step.twoPiDt );
+			const __m128 one = _mm_set1_ps( 1.0f );
+			for( std::size_t i = 0; i < STRIDE; i += 4 )
+			{
+				__m128 velocity[ 3 ];
+				for( int a = 0; a < 3; ++a )
+				{
+					const __m128 d = _mm_loadu_ps( derivative[ a ] + i );
+					const __m128 raw = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( src[ a ] + i ), _mm_loadu_ps( value[ a ] + i ) ), rate );
+					velocity[ a ] = _mm_add_ps( d, _mm_mul_ps( derivativeAlpha, _mm_sub_ps( raw, d ) ) );
+				}
+				const __m128 speed = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps(
+					_mm_mul_ps( velocity[ 0 ], velocity[ 0 ] ), _mm_mul_ps( velocity[ 1 ], velocity[ 1 ] ) ), _mm_mul_ps( velocity[ 2 ], velocity[ 2 ] ) ) );
+				const __m128 r = _mm_mul_ps( twoPiDt, _mm_add_ps( _mm_loadu_ps( minCutoff + i ), _mm_mul_ps( _mm_loadu_ps( beta + i ), speed ) ) );
+				const __m128 alpha = _mm_div_ps( r, _mm_add_ps( one, r ) );
+				for( int a = 0; a < 3; ++a )
+				{
+					const __m128 previous = _mm_loadu_ps( value[ a ] + i );
+					const __m128 v = _mm_add_ps( previous, _mm_mul_ps( alpha, _mm_sub_ps( _mm_loadu_ps( src[ a ] + i ), previous ) ) );
+					_mm_storeu_ps( value[ a ] + i, v );
+					_mm_storeu_ps( derivative[ a ] + i, velocity[ a ] );
+					_mm_storeu_ps( dst[ a ] + i, v );
+				}
+			}
+		}
+
+		KINECT_TARGET_AVX2
+		void updateAvx2( const FrameStep& step, const float* const* src, const float* minCutoff, const float* beta,
+			float* const* value, float* const* derivative, float* const* dst )
+		{
+			const __m256 rate = _mm256_set1_ps( step.rate );
+			const __m256 derivativeAlpha = _mm256_set1_ps( step.derivativeAlpha );
+			const __m256 twoPiDt = _mm256_set1_ps( step.twoPiDt );
+			const __m256 one = _mm256_set1_ps( 1.0f );
+			for( std::size_t i = 0; i < STRIDE; i += 8 )
+			{
+				__m256 velocity[ 3 ];
+				for( int a = 0; a < 3; ++a )
+				{
+					const __m256 d = _mm256_loadu_ps( derivative[ a ] + i );
+					const __m256 raw = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( src[ a ] + i ), _mm256_loadu_ps( value[ a ] + i ) ), rate );
+					velocity[ a ] = _mm256_add_ps( d, _mm256_mul_ps( derivativeAlpha, _mm256_sub_ps( raw, d ) ) );
+				}
+				const __m256 speed = _mm256_sqrt_ps( _mm256_add_ps( _mm256_add_ps(
+					_mm256_mul_ps( velocity[ 0 ], velocity[ 0 ] ), _mm256_mul_ps( velocity[ 1 ], velocity[ 1 ] ) ), _mm256_mul_ps( velocity[ 2 ], velocity[ 2 ] ) ) );
+				const __m256 r = _mm256_mul_ps( twoPiDt, _mm256_add_ps( _mm256_loadu_ps( minCutoff + i ), _mm256_mul_ps( _mm256_loadu_ps( beta + i ), speed ) ) );
+				const __m256 alpha = _mm256_div_ps( r, _mm256_add_ps( one, r ) );
+				for( int a = 0; a < 3; ++a )
+				{
+					const __m256 previous = _mm256_loadu_ps( value[ a ] + i );
+					const __m256 v = _mm256_add_ps( previous, _mm256_mul_ps( alpha, _mm256_sub_ps( _mm256_loadu_ps( src[ a ] + i ), previous ) ) );
+					_mm256_storeu_ps( value[ a ] + i, v );
+					_mm256_storeu_ps( derivative[ a ] + i, velocity[ a ] );
+					_mm256_storeu_ps( dst[ a ] + i, v );
+				}
+			}
+			_mm256_zeroupper();
+		}
+#endif
+	}
+
+	OneEuroSkeletonFilter::OneEuroSkeletonFilter( float derivativeCutoff )
+		: derivativeCutoff_( derivativeCutoff ),
+		minCutoff_( STRIDE ), beta_( STRIDE ), value_( 3 * STRIDE ), derivative_( 3 * STRIDE ), frame_( 3 * STRIDE )
+	{
+		if( !( derivativeCutoff > 0 ) )
+		{
+			throw std::invalid_argument( "Cutoff must be positive" );
+		}
+		for( int g = 0; g < JOINT_GROUP_COUNT; ++g )
+		{
+			setParams( static_cast< JointGroup >( g ), DEFAULT_PARAMS[ g ] );
+		}
+		reset();
+	}
+
+	void OneEuroSkeletonFilter::setParams( JointGroup group, const OneEuroParams& params )
+	{
+		if( !( params.minCutoff > 0 ) || !( params.beta >= 0 ) )
+		{
+			throw std::invalid_argument( "One Euro parameters out of range" );
+		}
+		params_[ group ] = params;
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				if( human::jointGroup( j ) != group ) continue;
+				minCutoff_[ b * MAX_JOINT_COUNT + j ] = params.minCutoff;
+				beta_[ b * MAX_JOINT_COUNT + j ] = params.beta;
+			}
+		}
+	}
+
+	void OneEuroSkeletonFilter::update( const SkeletonHistory& raw, float* x, float* y, float* z, SimdLevel simd )
+	{
+		const float* src[ 3 ] = {
+			raw.component( JOINT_POSITION_X, 0 ), raw.component( JOINT_POSITION_Y, 0 ), raw.component( JOINT_POSITION_Z, 0 )
+		};
+		uint64_t trackingIds[ MAX_BODY_COUNT ];
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			trackingIds[ b ] = raw.trackingId( 0, b );
+		}
+		float* dst[ 3 ] = { x, y, z };
+		update( src, raw.relativeTime( 0 ), raw.trackedMask( 0 ), trackingIds, dst, simd );
+	}
+
+	void OneEuroSkeletonFilter::update( BodyFrame& frame, SimdLevel simd )
+	{
+		float* rows[ 3 ] = { &frame_[ 0 ], &frame_[ STRIDE ], &frame_[ 2 * STRIDE ] };
+		uint32_t trackedMask = 0;
+		uint64_t trackingIds[ MAX_BODY_COUNT ];
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			const BodyData& body = frame.bodies[ b ];
+			trackingIds[ b ] = body.isTracked ? body.trackingId : 0;
+			trackedMask |= body.isTracked ? 1u << b : 0;
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				for( int a = 0; a < 3; ++a )
+				{
+					rows[ a ][ b * MAX_JOINT_COUNT + j ] = body.isTracked ? body.joints[ j ].position[ a ] : 0.0f;
+				}
+			}
+		}
+
+		const float* src[ 3 ] = { rows[ 0 ], rows[ 1 ], rows[ 2 ] };
+		update( src, frame.relativeTime, trackedMask, trackingIds, rows, simd );
+
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			if( !frame.bodies[ b ].isTracked ) continue;
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				for( int a = 0; a < 3; ++a )
+				{
+					frame.bodies[ b ].joints[ j ].position[ a ] = rows[ a ][ b * MAX_JOINT_COUNT + j ];
+				}
+			}
+		}
+	}
+
+	void OneEuroSkeletonFilter::update( const float* const* src, int64_t relativeTime, uint32_t trackedMask,
+		const uint64_t* trackingIds, float* const* dst, SimdLevel simd )
+	{
+		// A repeated or out of order frame counts as one frame interval.
+		int64_t ticks = hasLastTime_ ? relativeTime - lastTime_ : 0;
+		if( ticks <= 0 ) ticks = FRAME_INTERVAL_TICKS;
+		lastTime_ = relativeTime;
+		hasLastTime_ = true;
+
+		const float dt = static_cast< float >( ticks ) * 1e-7f;
+		const float derivativeR = TWO_PI * derivativeCutoff_ * dt;
+		FrameStep step;
+		step.rate = 1.0f / dt;
+		step.derivativeAlpha = derivativeR / ( 1.0f + derivativeR );
+		step.twoPiDt = TWO_PI * dt;
+
+		float* value[ 3 ] = { &value_[ 0 ], &value_[ STRIDE ], &value_[ 2 * STRIDE ] };
+		float* derivative[ 3 ] = { &derivative_[ 0 ], &derivative_[ STRIDE ], &derivative_[ 2 * STRIDE ] };
+
+		// New and lost bodies start from their raw positions at rest, which the filter then
+		// passes through unchanged. Done before the kernel, as dst may be src.
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			const uint64_t id = trackedMask & ( 1u << b ) ? trackingIds[ b ] : 0;
+			if( id != 0 && id == trackingIds_[ b ] ) continue;
+
+			trackingIds_[ b ] = id;
+			const int slot = b * MAX_JOINT_COUNT;
+			for( int a = 0; a < 3; ++a )
+			{
+				std::copy( src[ a ] + slot, src[ a ] + slot + MAX_JOINT_COUNT, value[ a ] + slot );
+				std::fill( derivative[ a ] + slot, derivative[ a ] + slot + MAX_JOINT_COUNT, 0.0f );
+			}
+		}
+
+		switch( resolveSimdLevel( simd ) )
+		{
+#if KINECT_X86
+		case SIMD_AVX2:
+			updateAvx2( step, src, &minCutoff_[ 0 ], &beta_[ 0 ], value, derivative, dst );
+			break;
+		case SIMD_SSE2:
+			updateSse2( step, src, &minCutoff_[ 0 ], &beta_[ 0 ], value, derivative, dst );
+			break;
+#endif
+		default:
+			updateScalar( step, src, &minCutoff_[ 0 ], &beta_[ 0 ], value, derivative, dst, 0, STRIDE );
+			break;
+		}
+	}
+
+	void OneEuroSkeletonFilter::reset()
+	{
+		std::fill( value_.begin(), value_.end(), 0.0f );
+		std::fill( derivative_.begin(), derivative_.end(), 0.0f );
+		std::fill( trackingIds_, trackingIds_ + MAX_BODY_COUNT, 0 );
+		lastTime_ = 0;
+		hasLastTime_ = false;
+	}
+
+} // namespace kinect
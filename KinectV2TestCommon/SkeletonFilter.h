@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Cpu.h"
+#include "FrameSource.h"
+#include "Human.h"
+#include "SkeletonHistory.h"
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	//! Parameters of the One Euro filter. Slow joints get minCutoff, the cutoff rises by
+	//! beta per [m/s] of speed so fast moves are followed with little lag.
+	struct OneEuroParams
+	{
+		float minCutoff;	// [Hz]
+		float beta;			// [Hz / (m/s)]
+	};
+
+	//! One Euro filter of the joint positions of all bodies, updated for all joints at once.
+	//!
+	//! State and parameters are rows of SkeletonHistory::JOINT_STRIDE floats, so a frame
+	//! is a few SIMD passes over 152 slots instead of 450 scalar filters. Parameters are set
+	//! per JointGroup : the torso barely jitters and moves slowly, hands and feet move fast.
+	//! A body starts over when it is lost or its tracking id changes. All arithmetic is
+	//! single precision in the same order for every SIMD level, so the results are the same.
+	class OneEuroSkeletonFilter
+	{
+	public:
+		explicit OneEuroSkeletonFilter( float derivativeCutoff = 1.0f );
+
+		void setParams( JointGroup group, const OneEuroParams& params );
+		const OneEuroParams& params( JointGroup group ) const { return params_[ group ]; }
+
+		//! Filter the newest frame of raw into rows of SkeletonHistory::JOINT_STRIDE positions.
+		void update( const SkeletonHistory& raw, float* x, float* y, float* z, SimdLevel simd = SIMD_BEST );
+
+		//! Filter the joint positions of a frame in place.
+		void update( BodyFrame& frame, SimdLevel simd = SIMD_BEST );
+
+		//! Forget all bodies.
+		void reset();
+
+	private:
+		void update( const float* const* src, int64_t relativeTime, uint32_t trackedMask, const uint64_t* trackingIds,
+			float* const* dst, SimdLevel simd );
+
+		float derivativeCutoff_;
+		OneEuroParams params_[ JOINT_GROUP_COUNT ];
+		std::vector< float > minCutoff_;		// per slot
+		std::vector< float > beta_;
+		std::vector< float > value_;			// 3 rows, filtered positions
+		std::vector< float > derivative_;		// 3 rows, filtered velocities [m/s]
+		std::vector< float > frame_;			// 3 rows, scratch of update( BodyFrame& )
+		uint64_t trackingIds_[ MAX_BODY_COUNT ];	// 0 for bodies with no state
+		int64_t lastTime_;
+		bool hasLastTime_;
+	};
+
+} // namespace kinect
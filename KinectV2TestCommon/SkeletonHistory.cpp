@@ -0,0 +1,121 @@
+#include "SkeletonHistory.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace kinect
+{
+	SkeletonHistory::SkeletonHistory( unsigned int capacity )
+		: capacity_( capacity ), size_( 0 ), newest_( capacity - 1 ), frameCount_( 0 )
+	{
+		if( capacity == 0 )
+		{
+			throw std::invalid_argument( "Skeleton history capacity is 0" );
+		}
+		components_.resize( static_cast< std::size_t >( JOINT_COMPONENT_COUNT ) * capacity * JOINT_STRIDE );
+		trackingStates_.resize( static_cast< std::size_t >( capacity ) * JOINT_STRIDE );
+		bodies_.resize( capacity );
+	}
+
+	void SkeletonHistory::push( const BodyFrame& frame )
+	{
+		newest_ = ( newest_ + 1 ) % capacity_;
+		size_ = std::min( size_ + 1, capacity_ );
+		++frameCount_;
+
+		float* rows[ JOINT_COMPONENT_COUNT ];
+		for( int c = 0; c < JOINT_COMPONENT_COUNT; ++c )
+		{
+			rows[ c ] = &components_[ ( static_cast< std::size_t >( c ) * capacity_ + newest_ ) * JOINT_STRIDE ];
+		}
+		uint8_t* states = &trackingStates_[ static_cast< std::size_t >( newest_ ) * JOINT_STRIDE ];
+		BodyRow& row = bodies_[ newest_ ];
+		row.relativeTime = frame.relativeTime;
+		row.trackedMask = 0;
+
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			const BodyData& body = frame.bodies[ b ];
+			const int slot = b * MAX_JOINT_COUNT;
+			row.trackingIds[ b ] = body.isTracked ? body.trackingId : 0;
+			if( !body.isTracked )
+			{
+				for( int c = 0; c < JOINT_COMPONENT_COUNT; ++c )
+				{
+					std::fill( rows[ c ] + slot, rows[ c ] + slot + MAX_JOINT_COUNT, 0.0f );
+				}
+				memset( states + slot, 0, MAX_JOINT_COUNT );
+				continue;
+			}
+
+			row.trackedMask |= 1u << b;
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				const JointData& joint = body.joints[ j ];
+				rows[ JOINT_POSITION_X ][ slot + j ] = joint.position[ 0 ];
+				rows[ JOINT_POSITION_Y ][ slot + j ] = joint.position[ 1 ];
+				rows[ JOINT_POSITION_Z ][ slot + j ] = joint.position[ 2 ];
+				rows[ JOINT_ORIENTATION_X ][ slot + j ] = joint.orientation[ 0 ];
+				rows[ JOINT_ORIENTATION_Y ][ slot + j ] = joint.orientation[ 1 ];
+				rows[ JOINT_ORIENTATION_Z ][ slot + j ] = joint.orientation[ 2 ];
+				rows[ JOINT_ORIENTATION_W ][ slot + j ] = joint.orientation[ 3 ];
+				states[ slot + j ] = static_cast< uint8_t >( joint.trackingState );
+			}
+		}
+	}
+
+	void SkeletonHistory::clear()
+	{
+		size_ = 0;
+		newest_ = capacity_ - 1;
+		frameCount_ = 0;
+	}
+
+	void SkeletonHistory::history( JointComponent c, unsigned int slot, unsigned int count, float* dst ) const
+	{
+		const float* ring = componentRing( c ) + slot;
+		unsigned int index = ringIndex( count - 1 );
+		for( unsigned int i = 0; i < count; ++i )
+		{
+			dst[ i ] = ring[ static_cast< std::size_t >( index ) * JOINT_STRIDE ];
+			index = index + 1 == capacity_ ? 0 : index + 1;
+		}
+	}
+
+	void SkeletonHistory::frame( unsigned int age, BodyFrame& dst ) const
+	{
+		memset( &dst, 0, sizeof dst );
+		const BodyRow& row = bodies_[ ringIndex( age ) ];
+		dst.relativeTime = row.relativeTime;
+
+		const uint8_t* states = trackingStates( age );
+		const float* rows[ JOINT_COMPONENT_COUNT ];
+		for( int c = 0; c < JOINT_COMPONENT_COUNT; ++c )
+		{
+			rows[ c ] = component( static_cast< JointComponent >( c ), age );
+		}
+
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			if( !( row.trackedMask & ( 1u << b ) ) ) continue;
+
+			BodyData& body = dst.bodies[ b ];
+			const int slot = b * MAX_JOINT_COUNT;
+			body.isTracked = true;
+			body.trackingId = row.trackingIds[ b ];
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				JointData& joint = body.joints[ j ];
+				joint.position[ 0 ] = rows[ JOINT_POSITION_X ][ slot + j ];
+				joint.position[ 1 ] = rows[ JOINT_POSITION_Y ][ slot + j ];
+				joint.position[ 2 ] = rows[ JOINT_POSITION_Z ][ slot + j ];
+				joint.orientation[ 0 ] = rows[ JOINT_ORIENTATION_X ][ slot + j ];
+				joint.orientation[ 1 ] = rows[ JOINT_ORIENTATION_Y ][ slot + j ];
+				joint.orientation[ 2 ] = rows[ JOINT_ORIENTATION_Z ][ slot + j ];
+				joint.orientation[ 3 ] = rows[ JOINT_ORIENTATION_W ][ slot + j ];
+				joint.trackingState = states[ slot + j ];
+			}
+		}
+	}
+
+} // namespace kinect
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "FrameSource.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	//! Float components of a joint, one array each.
+	enum JointComponent
+	{
+		JOINT_POSITION_X,
+		JOINT_POSITION_Y,
+		JOINT_POSITION_Z,
+		JOINT_ORIENTATION_X,
+		JOINT_ORIENTATION_Y,
+		JOINT_ORIENTATION_Z,
+		JOINT_ORIENTATION_W,
+		JOINT_COMPONENT_COUNT
+	};
+
+	//! Joints of all bodies over the last frames, as structure of arrays.
+	//!
+	//! A frame holds, for each component, one row of JOINT_STRIDE floats : joint j of body b
+	//! at slot b * MAX_JOINT_COUNT + j, then padding to a multiple of 8. Rows of the same
+	//! component follow each other frame by frame in a ring allocated once, so a kernel
+	//! runs over all 150 joints with 8-wide loads and steps to the previous frame by
+	//! JOINT_STRIDE. Bodies that are not tracked are stored as 0 with tracking state 0.
+	class SkeletonHistory
+	{
+	public:
+		enum
+		{
+			JOINT_SLOTS = MAX_BODY_COUNT * MAX_JOINT_COUNT,
+			JOINT_STRIDE = ( JOINT_SLOTS + 7 ) / 8 * 8,
+			DEFAULT_CAPACITY = 300		// 10 [s]
+		};
+
+		explicit SkeletonHistory( unsigned int capacity = DEFAULT_CAPACITY );
+
+		//! Add a frame, dropping the oldest one if full.
+		void push( const BodyFrame& frame );
+
+		//! Drop all frames.
+		void clear();
+
+		unsigned int capacity() const { return capacity_; }
+
+		//! Frames stored, at most capacity().
+		unsigned int size() const { return size_; }
+
+		//! Frames pushed since construction or clear().
+		uint64_t frameCount() const { return frameCount_; }
+
+		//! Ring index of the frame age frames older than the newest. age must be less than size().
+		unsigned int ringIndex( unsigned int age ) const { return ( newest_ + capacity_ - age ) % capacity_; }
+
+		//! Row of JOINT_STRIDE values of a frame.
+		const float* component( JointComponent c, unsigned int age ) const
+		{
+			return &components_[ ( static_cast< std::size_t >( c ) * capacity_ + ringIndex( age ) ) * JOINT_STRIDE ];
+		}
+		const uint8_t* trackingStates( unsigned int age ) const
+		{
+			return &trackingStates_[ static_cast< std::size_t >( ringIndex( age ) ) * JOINT_STRIDE ];
+		}
+
+		//! Whole ring of a component, capacity() rows, for kernels that handle the wrap themselves.
+		const float* componentRing( JointComponent c ) const
+		{
+			return &components_[ static_cast< std::size_t >( c ) * capacity_ * JOINT_STRIDE ];
+		}
+
+		int64_t relativeTime( unsigned int age ) const { return bodies_[ ringIndex( age ) ].relativeTime; }
+
+		//! Bit b is set if body b is tracked.
+		uint32_t trackedMask( unsigned int age ) const { return bodies_[ ringIndex( age ) ].trackedMask; }
+		uint64_t trackingId( unsigned int age, unsigned int body ) const { return bodies_[ ringIndex( age ) ].trackingIds[ body ]; }
+
+		//! Values of one joint slot over the last count frames, oldest first. count must be at most size().
+		void history( JointComponent c, unsigned int slot, unsigned int count, float* dst ) const;
+
+		//! Frame as it was pushed, for the tracked bodies.
+		void frame( unsigned int age, BodyFrame& dst ) const;
+
+	private:
+		struct BodyRow
+		{
+			int64_t relativeTime;
+			uint32_t trackedMask;
+			uint64_t trackingIds[ MAX_BODY_COUNT ];
+		};
+
+		unsigned int capacity_;
+		unsigned int size_;
+		unsigned int newest_;
+		uint64_t frameCount_;
+		std::vector< float > components_;		// JOINT_COMPONENT_COUNT rings of capacity_ rows
+		std::vector< uint8_t > trackingStates_;	// capacity_ rows
+		std::vector< BodyRow > bodies_;			// capacity_ rows
+	};
+
+} // namespace kinect
@@ -0,0 +1,54 @@
+#include "SkeletonProcessor.h"
+#include <chrono>
+#include <sstream>
+
+namespace kinect
+{
+	SkeletonProcessor::SkeletonProcessor( bool smooth, unsigned int threadCount )
+		: bones_( BoneMatrixBuilder::MAX_BONES ), boneCount_( 0 ), pool_( threadCount ), frames_( 0 ), seconds_( 0 )
+	{
+		if( smooth )
+		{
+			filter_.reset( new OneEuroSkeletonFilter() );
+		}
+		for( GestureMatch& match : matches_ )
+		{
+			match.templateIndex = -1;
+			match.distance = 0;
+		}
+	}
+
+	bool SkeletonProcessor::update( const BodyFrame& frame )
+	{
+		if( history_.size() > 0 && history_.relativeTime( 0 ) == frame.relativeTime )
+		{
+			return false;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		if( filter_ )
+		{
+			BodyFrame smoothed = frame;
+			filter_->update( smoothed );
+			history_.push( smoothed );
+		}
+		else
+		{
+			history_.push( frame );
+		}
+		boneCount_ = boneBuilder_.build( history_, bones_.data() );
+		gestures_.match( history_, matches_, &pool_ );
+		seconds_ += std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+		++frames_;
+		return true;
+	}
+
+	std::string SkeletonProcessor::summary() const
+	{
+		std::stringstream ss;
+		ss << "Skeleton : " << frames_ << " frames, " << ( frames_ > 0 ? seconds_ / frames_ * 1e6 : 0 ) << " [us] per frame, "
+			<< gestures_.templateCount() << " gesture templates on " << pool_.threadCount() << " threads";
+		return ss.str();
+	}
+
+} // namespace kinect
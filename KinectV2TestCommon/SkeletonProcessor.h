@@ -0,0 +1,63 @@
+#pragma once
+
+#include "BoneMatrices.h"
+#include "FrameSource.h"
+#include "GestureMatcher.h"
+#include "SkeletonFilter.h"
+#include "SkeletonHistory.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	//! Processing of a body stream, the same in KinectV2TestBody and in KinectV2TestCli :
+	//! each new frame is smoothed if asked, pushed to the history, turned into bone
+	//! matrices and matched against the gesture templates.
+	class SkeletonProcessor
+	{
+	public:
+		//! smooth runs the frames through OneEuroSkeletonFilter. Gestures are matched on a
+		//! pool of threadCount threads, 0 for one per hardware thread.
+		explicit SkeletonProcessor( bool smooth, unsigned int threadCount = 0 );
+
+		//! Process frame unless it is the newest one of the history already, as the latest
+		//! frame of a stream stays the same until the next one arrives. Return true if it was new.
+		bool update( const BodyFrame& frame );
+
+		//! Joints of all bodies over the last frames, smoothed if asked.
+		const SkeletonHistory& history() const { return history_; }
+
+		//! Bones of the tracked bodies of the newest frame.
+		const BoneInstance* bones() const { return bones_.data(); }
+		std::size_t boneCount() const { return boneCount_; }
+
+		//! Templates are added to it between updates.
+		GestureMatcher& gestures() { return gestures_; }
+
+		//! Best template of each body for the newest frame.
+		const GestureMatch& match( unsigned int body ) const { return matches_[ body ]; }
+
+		//! Frames and time per frame so far.
+		std::string summary() const;
+
+	private:
+		SkeletonProcessor( const SkeletonProcessor& ) = delete;
+		SkeletonProcessor& operator=( const SkeletonProcessor& ) = delete;
+
+		std::unique_ptr< OneEuroSkeletonFilter > filter_;
+		SkeletonHistory history_;
+		BoneMatrixBuilder boneBuilder_;
+		std::vector< BoneInstance > bones_;
+		std::size_t boneCount_;
+		GestureMatcher gestures_;
+		GestureMatch matches_[ MAX_BODY_COUNT ];
+		ThreadPool pool_;
+		uint64_t frames_;
+		double seconds_;
+	};
+
+} // namespace kinect
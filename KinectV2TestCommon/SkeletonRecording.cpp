@@ -0,0 +1,531 @@
+#include "SkeletonRecording.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace kinect
+{
+	namespace
+	{
+		const char SKELETON_RECORDING_MAGIC[ 8 ] = { 'K', 'V', '2', 'S', 'K', 'L', 0, 0 };
+
+		enum
+		{
+			FRAME_KEYFRAME = 1,
+			BODY_DIFFERENCE = 1,
+			BODY_STATES = 2,
+			STATE_BYTES = ( MAX_JOINT_COUNT * 2 + 7 ) / 8,
+			VALUES_PER_BODY = MAX_JOINT_COUNT * 7
+		};
+
+		static_assert( sizeof( SkeletonRecordingHeader ) == 64, "SkeletonRecordingHeader must be packed" );
+		static_assert( sizeof( SkeletonRecordingIndexEntry ) == 24, "SkeletonRecordingIndexEntry must be packed" );
+
+		void throwError( const char* what, const char* path )
+		{
+			std::stringstream ss;
+			ss << what << " : " << path;
+			throw std::runtime_error( ss.str() );
+		}
+
+		unsigned char* putVarint( unsigned char* p, uint64_t v )
+		{
+			while( v >= 0x80 )
+			{
+				*p++ = static_cast< unsigned char >( v | 0x80 );
+				v >>= 7;
+			}
+			*p++ = static_cast< unsigned char >( v );
+			return p;
+		}
+
+		unsigned char* putSigned( unsigned char* p, int64_t v )
+		{
+			return putVarint( p, ( static_cast< uint64_t >( v ) << 1 ) ^ static_cast< uint64_t >( v >> 63 ) );
+		}
+
+		//! Bounds checked reads of a frame.
+		struct Reader
+		{
+			const unsigned char* p;
+			const unsigned char* end;
+
+			uint8_t byte()
+			{
+				if( p == end ) throw std::runtime_error( "Broken skeleton frame" );
+				return *p++;
+			}
+
+			uint64_t varint()
+			{
+				uint64_t v = 0;
+				for( int shift = 0; shift < 64; shift += 7 )
+				{
+					const uint8_t b = byte();
+					v |= static_cast< uint64_t >( b & 0x7F ) << shift;
+					if( !( b & 0x80 ) ) return v;
+				}
+				throw std::runtime_error( "Broken skeleton frame" );
+			}
+
+			int64_t signedVarint()
+			{
+				const uint64_t v = varint();
+				return static_cast< int64_t >( v >> 1 ) ^ -static_cast< int64_t >( v & 1 );
+			}
+		};
+
+		int32_t quantize( double v, double limit )
+		{
+			return static_cast< int32_t >( std::max( -limit, std::min( std::floor( v + 0.5 ), limit ) ) );
+		}
+	}
+
+	SkeletonEncoder::SkeletonEncoder( float positionStep )
+		: positionStep_( positionStep ), positionScale_( 1.0 / positionStep )
+	{
+		if( !( positionStep > 0 ) )
+		{
+			throw std::invalid_argument( "Position step must be positive" );
+		}
+		reset();
+	}
+
+	void SkeletonEncoder::reset()
+	{
+		started_ = false;
+		lastTime_ = 0;
+		lastTracked_ = 0;
+		memset( trackingIds_, 0, sizeof trackingIds_ );
+		memset( states_, 0, sizeof states_ );
+		memset( values_, 0, sizeof values_ );
+	}
+
+	std::size_t SkeletonEncoder::encode( const BodyFrame& frame, bool keyframe, unsigned char* dst )
+	{
+		keyframe = keyframe || !started_;
+		started_ = true;
+
+		unsigned char* p = dst;
+		*p++ = keyframe ? FRAME_KEYFRAME : 0;
+		p = putSigned( p, keyframe ? frame.relativeTime : frame.relativeTime - lastTime_ );
+		lastTime_ = frame.relativeTime;
+
+		uint32_t tracked = 0;
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			tracked |= frame.bodies[ b ].isTracked ? 1u << b : 0;
+		}
+		*p++ = static_cast< unsigned char >( tracked );
+
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			if( !( tracked & ( 1u << b ) ) ) continue;
+
+			const BodyData& body = frame.bodies[ b ];
+			const bool difference = !keyframe && ( lastTracked_ & ( 1u << b ) ) && trackingIds_[ b ] == body.trackingId;
+			uint8_t states[ MAX_JOINT_COUNT ];
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				states[ j ] = static_cast< uint8_t >( body.joints[ j ].trackingState & 3 );
+			}
+			const bool statesFollow = !difference || memcmp( states, states_[ b ], sizeof states ) != 0;
+
+			*p++ = static_cast< unsigned char >( ( difference ? BODY_DIFFERENCE : 0 ) | ( statesFollow ? BODY_STATES : 0 ) );
+			if( !difference )
+			{
+				p = putVarint( p, body.trackingId );
+				trackingIds_[ b ] = body.trackingId;
+			}
+			if( statesFollow )
+			{
+				memset( p, 0, STATE_BYTES );
+				for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+				{
+					p[ j / 4 ] |= states[ j ] << ( j % 4 * 2 );
+				}
+				p += STATE_BYTES;
+				memcpy( states_[ b ], states, sizeof states );
+			}
+
+			int32_t* last = values_[ b ];
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				const JointData& joint = body.joints[ j ];
+				int32_t q[ 7 ];
+				for( int a = 0; a < 3; ++a )
+				{
+					q[ a ] = quantize( joint.position[ a ] * positionScale_, 2147483647.0 );
+				}
+				for( int a = 0; a < 4; ++a )
+				{
+					q[ 3 + a ] = quantize( joint.orientation[ a ] * static_cast< double >( SKELETON_ORIENTATION_SCALE ), SKELETON_ORIENTATION_SCALE );
+				}
+				for( int c = 0; c < 7; ++c )
+				{
+					p = putSigned( p, difference ? static_cast< int64_t >( q[ c ] ) - last[ c ] : q[ c ] );
+					last[ c ] = q[ c ];
+				}
+				last += 7;
+			}
+		}
+		lastTracked_ = tracked;
+		return static_cast< std::size_t >( p - dst );
+	}
+
+	SkeletonDecoder::SkeletonDecoder( float positionStep )
+		: positionStep_( positionStep )
+	{
+		reset();
+	}
+
+	void SkeletonDecoder::reset()
+	{
+		started_ = false;
+		lastTime_ = 0;
+		lastTracked_ = 0;
+		memset( trackingIds_, 0, sizeof trackingIds_ );
+		memset( states_, 0, sizeof states_ );
+		memset( values_, 0, sizeof values_ );
+	}
+
+	std::size_t SkeletonDecoder::decode( const unsigned char* src, std::size_t srcSize, BodyFrame& frame )
+	{
+		Reader in = { src, src + srcSize };
+		const uint8_t flags = in.byte();
+		const bool keyframe = ( flags & FRAME_KEYFRAME ) != 0;
+		if( !keyframe && !started_ )
+		{
+			throw std::runtime_error( "Skeleton frame before the first keyframe" );
+		}
+		started_ = true;
+		const int64_t time = in.signedVarint();
+		frame.relativeTime = keyframe ? time : lastTime_ + time;
+		lastTime_ = frame.relativeTime;
+
+		const uint32_t tracked = in.byte();
+		if( tracked >> MAX_BODY_COUNT )
+		{
+			throw std::runtime_error( "Broken skeleton frame" );
+		}
+
+		const float orientationStep = 1.0f / SKELETON_ORIENTATION_SCALE;
+		for( int b = 0; b < MAX_BODY_COUNT; ++b )
+		{
+			BodyData& body = frame.bodies[ b ];
+			if( !( tracked & ( 1u << b ) ) )
+			{
+				memset( &body, 0, sizeof body );
+				continue;
+			}
+
+			const uint8_t bodyFlags = in.byte();
+			const bool difference = ( bodyFlags & BODY_DIFFERENCE ) != 0;
+			if( difference && ( keyframe || !( lastTracked_ & ( 1u << b ) ) ) )
+			{
+				throw std::runtime_error( "Broken skeleton frame" );
+			}
+			if( !difference )
+			{
+				trackingIds_[ b ] = in.varint();
+			}
+			if( bodyFlags & BODY_STATES )
+			{
+				for( int k = 0; k < STATE_BYTES; ++k )
+				{
+					const uint8_t bits = in.byte();
+					for( int j = k * 4; j < std::min( k * 4 + 4, static_cast< int >( MAX_JOINT_COUNT ) ); ++j )
+					{
+						states_[ b ][ j ] = ( bits >> ( j % 4 * 2 ) ) & 3;
+					}
+				}
+			}
+			else if( !difference )
+			{
+				throw std::runtime_error( "Broken skeleton frame" );
+			}
+
+			body.isTracked = true;
+			body.trackingId = trackingIds_[ b ];
+			int32_t* last = values_[ b ];
+			for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+			{
+				for( int c = 0; c < 7; ++c )
+				{
+					const int64_t v = in.signedVarint();
+					last[ c ] = static_cast< int32_t >( difference ? last[ c ] + v : v );
+				}
+				JointData& joint = body.joints[ j ];
+				for( int a = 0; a < 3; ++a )
+				{
+					joint.position[ a ] = last[ a ] * positionStep_;
+				}
+				for( int a = 0; a < 4; ++a )
+				{
+					joint.orientation[ a ] = last[ 3 + a ] * orientationStep;
+				}
+				joint.trackingState = states_[ b ][ j ];
+				last += 7;
+			}
+		}
+		lastTracked_ = tracked;
+		return static_cast< std::size_t >( in.p - src );
+	}
+
+	SkeletonRecordingWriter::SkeletonRecordingWriter( const char* path, unsigned int queueFrames, float positionStep )
+		: fp_( nullptr ), encoder_( positionStep ), encoded_( SKELETON_CODEC_MAX_FRAME_SIZE ), position_( 0 ),
+		queue_( std::max( queueFrames, 1u ) ), head_( 0 ), count_( 0 ), written_( 0 ), dropped_( 0 ), bytes_( 0 ),
+		closing_( false )
+	{
+		memset( &header_, 0, sizeof header_ );
+		memcpy( header_.magic, SKELETON_RECORDING_MAGIC, sizeof header_.magic );
+		header_.version = SKELETON_RECORDING_VERSION;
+		header_.keyframeInterval = SKELETON_RECORDING_KEYFRAME_INTERVAL;
+		header_.positionStep = positionStep;
+
+		fp_ = fopen( path, "wb" );
+		if( !fp_ ) throwError( "Cannot create file", path );
+
+		// Header is written again with the frame count on close.
+		writeBytes( &header_, sizeof header_ );
+		thread_ = std::thread( [this]() { run(); } );
+	}
+
+	SkeletonRecordingWriter::~SkeletonRecordingWriter()
+	{
+		try {
+			close();
+		}
+		catch( ... ) {
+		}
+	}
+
+	bool SkeletonRecordingWriter::write( const BodyFrame& frame )
+	{
+		{
+			std::lock_guard< std::mutex > lock( mutex_ );
+			if( error_ )
+			{
+				std::rethrow_exception( error_ );
+			}
+			if( closing_ )
+			{
+				throw std::runtime_error( "Skeleton recording is closed" );
+			}
+			if( count_ == queue_.size() )
+			{
+				++dropped_;
+				return false;
+			}
+			queue_[ ( head_ + count_ ) % queue_.size() ] = frame;
+			++count_;
+		}
+		queued_.notify_one();
+		return true;
+	}
+
+	void SkeletonRecordingWriter::run()
+	{
+		try {
+			std::unique_lock< std::mutex > lock( mutex_ );
+			for( ;; )
+			{
+				queued_.wait( lock, [this]() { return count_ > 0 || closing_; } );
+				if( count_ == 0 )
+				{
+					break;
+				}
+
+				// The slot stays queued, so write() does not reuse it while it is coded.
+				const BodyFrame& frame = queue_[ head_ ];
+				lock.unlock();
+
+				const bool keyframe = header_.frameCount % header_.keyframeInterval == 0;
+				if( keyframe )
+				{
+					SkeletonRecordingIndexEntry entry;
+					entry.relativeTime = frame.relativeTime;
+					entry.frame = header_.frameCount;
+					entry.offset = position_;
+					index_.push_back( entry );
+				}
+				const std::size_t size = encoder_.encode( frame, keyframe, encoded_.data() );
+				writeBytes( encoded_.data(), size );
+				++header_.frameCount;
+
+				lock.lock();
+				head_ = ( head_ + 1 ) % queue_.size();
+				--count_;
+				++written_;
+				bytes_ += size;
+			}
+		}
+		catch( ... ) {
+			std::lock_guard< std::mutex > lock( mutex_ );
+			error_ = std::current_exception();
+		}
+	}
+
+	void SkeletonRecordingWriter::close()
+	{
+		if( !fp_ ) return;
+
+		{
+			std::lock_guard< std::mutex > lock( mutex_ );
+			closing_ = true;
+		}
+		queued_.notify_one();
+		if( thread_.joinable() )
+		{
+			thread_.join();
+		}
+
+		bool ok = !error_;
+		if( ok )
+		{
+			header_.indexOffset = position_;
+			header_.indexCount = index_.size();
+			header_.payloadSize = position_ - sizeof header_;
+			ok = index_.empty() ||
+				fwrite( index_.data(), sizeof( SkeletonRecordingIndexEntry ), index_.size(), fp_ ) == index_.size();
+			ok = ok && fseek( fp_, 0, SEEK_SET ) == 0 && fwrite( &header_, sizeof header_, 1, fp_ ) == 1;
+		}
+		const bool closed = fclose( fp_ ) == 0;
+		fp_ = nullptr;
+		if( error_ ) std::rethrow_exception( error_ );
+		if( !ok || !closed ) throw std::runtime_error( "Cannot finish skeleton recording" );
+	}
+
+	uint64_t SkeletonRecordingWriter::frameCount() const
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+		return written_;
+	}
+
+	uint64_t SkeletonRecordingWriter::droppedCount() const
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+		return dropped_;
+	}
+
+	uint64_t SkeletonRecordingWriter::payloadSize() const
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+		return bytes_;
+	}
+
+	void SkeletonRecordingWriter::writeBytes( const void* data, std::size_t size )
+	{
+		if( fwrite( data, 1, size, fp_ ) != size ) throw std::runtime_error( "Cannot write skeleton recording" );
+		position_ += size;
+	}
+
+	SkeletonRecordingReader::SkeletonRecordingReader( const char* path )
+		: data_( nullptr ), size_( 0 ), offset_( 0 ), group_( 0 ), cursor_( 0 ), decoded_( 0 )
+	{
+		file_.open( path );
+		if( file_.fileSize() < sizeof header_ ) throwError( "Not a skeleton recording", path );
+
+		memcpy( &header_, file_.map( 0, sizeof header_ ), sizeof header_ );
+		file_.unmap();
+
+		if( memcmp( header_.magic, SKELETON_RECORDING_MAGIC, sizeof header_.magic ) != 0 ||
+			header_.version != SKELETON_RECORDING_VERSION || header_.keyframeInterval == 0 || !( header_.positionStep > 0 ) )
+		{
+			throwError( "Not a skeleton recording", path );
+		}
+		if( header_.indexOffset == 0 || header_.indexOffset != sizeof header_ + header_.payloadSize ||
+			header_.indexOffset + header_.indexCount * sizeof( SkeletonRecordingIndexEntry ) > file_.fileSize() ||
+			( header_.frameCount != 0 ) != ( header_.indexCount != 0 ) )
+		{
+			throwError( "Skeleton recording was not closed", path );
+		}
+
+		index_.resize( static_cast< std::size_t >( header_.indexCount ) );
+		if( !index_.empty() )
+		{
+			const std::size_t indexSize = index_.size() * sizeof( SkeletonRecordingIndexEntry );
+			memcpy( index_.data(), file_.map( header_.indexOffset, indexSize ), indexSize );
+			file_.unmap();
+			if( index_.front().frame != 0 || index_.front().offset != sizeof header_ )
+			{
+				throwError( "Broken skeleton recording index", path );
+			}
+			for( std::size_t k = 1; k < index_.size(); ++k )
+			{
+				if( index_[ k ].frame <= index_[ k - 1 ].frame || index_[ k ].frame >= header_.frameCount ||
+					index_[ k ].offset <= index_[ k - 1 ].offset || index_[ k ].offset >= header_.indexOffset )
+				{
+					throwError( "Broken skeleton recording index", path );
+				}
+			}
+		}
+		decoder_ = SkeletonDecoder( header_.positionStep );
+		group_ = index_.size();
+	}
+
+	void SkeletonRecordingReader::load( std::size_t group, std::size_t frame )
+	{
+		if( group != group_ )
+		{
+			const uint64_t end = group + 1 < index_.size() ? index_[ group + 1 ].offset : header_.indexOffset;
+			size_ = static_cast< std::size_t >( end - index_[ group ].offset );
+			data_ = file_.map( index_[ group ].offset, size_ );
+			group_ = group;
+		}
+		decoder_.reset();
+		offset_ = 0;
+		decoded_ = static_cast< std::size_t >( index_[ group ].frame );
+
+		BodyFrame skipped;
+		while( decoded_ < frame )
+		{
+			offset_ += decoder_.decode( data_ + offset_, size_ - offset_, skipped );
+			++decoded_;
+		}
+	}
+
+	bool SkeletonRecordingReader::read( BodyFrame& frame )
+	{
+		if( cursor_ >= frameCount() ) return false;
+
+		if( cursor_ != decoded_ || group_ == index_.size() || offset_ == size_ )
+		{
+			auto it = std::upper_bound( index_.begin(), index_.end(), static_cast< uint64_t >( cursor_ ),
+				[]( uint64_t f, const SkeletonRecordingIndexEntry& entry ) { return f < entry.frame; } );
+			load( static_cast< std::size_t >( it - index_.begin() ) - 1, cursor_ );
+		}
+		offset_ += decoder_.decode( data_ + offset_, size_ - offset_, frame );
+		++decoded_;
+		++cursor_;
+		return true;
+	}
+
+	std::size_t SkeletonRecordingReader::findFrame( int64_t relativeTime )
+	{
+		// Last keyframe before the time, then frame by frame.
+		auto it = std::lower_bound( index_.begin(), index_.end(), relativeTime,
+			[]( const SkeletonRecordingIndexEntry& entry, int64_t time ) { return entry.relativeTime < time; } );
+		if( it == index_.begin() )
+		{
+			return 0;
+		}
+		const std::size_t cursor = cursor_;
+		cursor_ = static_cast< std::size_t >( ( it - 1 )->frame );
+		BodyFrame frame;
+		while( read( frame ) && frame.relativeTime < relativeTime )
+		{
+		}
+		const std::size_t found = frame.relativeTime < relativeTime ? frameCount() : cursor_ - 1;
+		cursor_ = cursor;
+		return found;
+	}
+
+	void SkeletonRecordingReader::seek( std::size_t frame )
+	{
+		cursor_ = frame;
+	}
+
+} // namespace kinect
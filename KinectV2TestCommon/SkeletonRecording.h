@@ -0,0 +1,208 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kinect
+{
+	//! Skeleton recording file layout.
+	//!
+	//!   [header] [frame 0] [frame 1] ... [frame N-1] [keyframe index]
+	//!
+	//! Positions are quantized to positionStep [m] and orientations to 1/32767, both as
+	//! integers. A body that keeps its tracking id from the previous frame is coded as the
+	//! differences of these integers, as zigzag varints, so a still joint takes 1 byte per
+	//! value. Every keyframeInterval frames all bodies are coded whole, and the index at the
+	//! end lists these keyframes, so a reader seeks by decoding at most keyframeInterval frames.
+	//!
+	//!   frame : flags (bit 0 keyframe), time (varint, difference from the previous frame
+	//!           unless keyframe), tracked body mask (uint8), then each tracked body :
+	//!   body  : flags (bit 0 difference from the previous frame, bit 1 tracking states follow),
+	//!           tracking id (varint) unless a difference, tracking states (2 bits per joint,
+	//!           7 bytes) if they changed, then for each joint x, y, z, qx, qy, qz, qw (varint)
+	enum
+	{
+		SKELETON_RECORDING_VERSION = 1,
+		SKELETON_RECORDING_KEYFRAME_INTERVAL = 30,
+		SKELETON_CODEC_MAX_FRAME_SIZE = 12 + MAX_BODY_COUNT * ( 18 + MAX_JOINT_COUNT * 7 * 10 ),
+		SKELETON_ORIENTATION_SCALE = 32767
+	};
+
+	struct SkeletonRecordingHeader
+	{
+		char magic[ 8 ];			// "KV2SKL\0\0"
+		uint32_t version;
+		uint32_t keyframeInterval;
+		float positionStep;			// [m]
+		uint32_t reserved[ 3 ];
+		uint64_t frameCount;
+		uint64_t indexOffset;		// 0 until the recording is closed
+		uint64_t indexCount;
+		uint64_t payloadSize;		// bytes of all frames
+	};
+
+	struct SkeletonRecordingIndexEntry
+	{
+		int64_t relativeTime;		// TIMESPAN ticks of the keyframe
+		uint64_t frame;
+		uint64_t offset;			// file offset of the keyframe
+	};
+
+	//! Frames to the recording format, one after another.
+	class SkeletonEncoder
+	{
+	public:
+		enum
+		{
+			DEFAULT_POSITION_STEP_UM = 250
+		};
+
+		explicit SkeletonEncoder( float positionStep = DEFAULT_POSITION_STEP_UM * 1e-6f );
+
+		//! Code frame into dst, at least SKELETON_CODEC_MAX_FRAME_SIZE bytes, whole if keyframe.
+		//! Return the size.
+		std::size_t encode( const BodyFrame& frame, bool keyframe, unsigned char* dst );
+
+		//! The next frame is coded as if it was the first.
+		void reset();
+
+		float positionStep() const { return positionStep_; }
+
+	private:
+		float positionStep_;
+		double positionScale_;
+		bool started_;
+		int64_t lastTime_;
+		uint32_t lastTracked_;
+		uint64_t trackingIds_[ MAX_BODY_COUNT ];
+		uint8_t states_[ MAX_BODY_COUNT ][ MAX_JOINT_COUNT ];
+		int32_t values_[ MAX_BODY_COUNT ][ MAX_JOINT_COUNT * 7 ];
+	};
+
+	//! Frames of the recording format back, in the order they were coded.
+	class SkeletonDecoder
+	{
+	public:
+		explicit SkeletonDecoder( float positionStep = SkeletonEncoder::DEFAULT_POSITION_STEP_UM * 1e-6f );
+
+		//! Decode the frame at src into frame. Return its size.
+		//! Throw std::runtime_error if the data is broken or a difference has nothing to apply to.
+		std::size_t decode( const unsigned char* src, std::size_t srcSize, BodyFrame& frame );
+
+		//! Decoding must start at a keyframe after this.
+		void reset();
+
+	private:
+		float positionStep_;
+		bool started_;
+		int64_t lastTime_;
+		uint32_t lastTracked_;
+		uint64_t trackingIds_[ MAX_BODY_COUNT ];
+		uint8_t states_[ MAX_BODY_COUNT ][ MAX_JOINT_COUNT ];
+		int32_t values_[ MAX_BODY_COUNT ][ MAX_JOINT_COUNT * 7 ];
+	};
+
+	//! Appends body frames to a skeleton recording on its own thread.
+	//! write() only copies the frame into a queue, coding and file writes happen on the thread.
+	class SkeletonRecordingWriter
+	{
+	public:
+		enum
+		{
+			DEFAULT_QUEUE_FRAMES = 256		// 8.5 [s]
+		};
+
+		//! Create file. Throw std::runtime_error if failed.
+		explicit SkeletonRecordingWriter( const char* path, unsigned int queueFrames = DEFAULT_QUEUE_FRAMES,
+			float positionStep = SkeletonEncoder::DEFAULT_POSITION_STEP_UM * 1e-6f );
+		~SkeletonRecordingWriter();
+
+		//! Queue a frame. Return false if the queue is full and the frame is dropped.
+		//! Rethrow the error the thread failed with, if any.
+		bool write( const BodyFrame& frame );
+
+		//! Write the queued frames, the index and the final header, and stop the thread.
+		//! Called by the destructor too.
+		void close();
+
+		//! Counters, final after close().
+		uint64_t frameCount() const;
+		uint64_t droppedCount() const;
+		uint64_t payloadSize() const;
+
+	private:
+		SkeletonRecordingWriter( const SkeletonRecordingWriter& ) = delete;
+		SkeletonRecordingWriter& operator=( const SkeletonRecordingWriter& ) = delete;
+
+		void run();
+		void writeBytes( const void* data, std::size_t size );
+
+		FILE* fp_;
+		SkeletonRecordingHeader header_;
+		SkeletonEncoder encoder_;
+		std::vector< unsigned char > encoded_;
+		std::vector< SkeletonRecordingIndexEntry > index_;
+		uint64_t position_;
+
+		// Queue, guarded by mutex_.
+		mutable std::mutex mutex_;
+		std::condition_variable queued_;
+		std::vector< BodyFrame > queue_;
+		std::size_t head_;			// oldest queued frame
+		std::size_t count_;
+		uint64_t written_;
+		uint64_t dropped_;
+		uint64_t bytes_;
+		bool closing_;
+		std::exception_ptr error_;
+		std::thread thread_;
+	};
+
+	//! Reader of a skeleton recording. Keyframe groups are mapped one at a time.
+	//! As a BodyFrameSource, it hands out frames in order as fast as they are acquired.
+	class SkeletonRecordingReader : public BodyFrameSource
+	{
+	public:
+		//! Open file. Throw std::runtime_error if failed or not a closed recording.
+		explicit SkeletonRecordingReader( const char* path );
+
+		const SkeletonRecordingHeader& header() const { return header_; }
+		std::size_t frameCount() const { return static_cast< std::size_t >( header_.frameCount ); }
+
+		//! Decode the frame at tell() and step to the next one. Return false at the end.
+		bool read( BodyFrame& frame );
+
+		//! Index of the first frame at or after the time. frameCount() if none.
+		std::size_t findFrame( int64_t relativeTime );
+
+		//! Set the frame read next.
+		void seek( std::size_t frame );
+		std::size_t tell() const { return cursor_; }
+
+		virtual bool acquireLatestFrame( BodyFrame& frame ) override { return read( frame ); }
+
+	private:
+		//! Map keyframe group k and decode up to frame.
+		void load( std::size_t group, std::size_t frame );
+
+		MappedFile file_;
+		SkeletonRecordingHeader header_;
+		std::vector< SkeletonRecordingIndexEntry > index_;
+		SkeletonDecoder decoder_;
+		const unsigned char* data_;		// mapped group
+		std::size_t size_;
+		std::size_t offset_;			// of the next frame in the group
+		std::size_t group_;				// index_.size() if none
+		std::size_t cursor_;			// next frame read
+		std::size_t decoded_;			// next frame the decoder is at
+	};
+
+} // namespace kinect
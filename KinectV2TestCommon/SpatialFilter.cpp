@@ -0,0 +1,127 @@
+#include "SpatialFilter.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace kinect
+{
+	BilateralDepthFilter::BilateralDepthFilter( unsigned int width, unsigned int height,
+		unsigned int radius, float sigmaSpatial, float sigmaRange )
+		: width_( width ), height_( height ), radius_( radius ),
+		tileColumns_( ( width + TILE_WIDTH - 1 ) / TILE_WIDTH ), tileRows_( ( height + TILE_HEIGHT - 1 ) / TILE_HEIGHT )
+	{
+		if( width == 0 || height == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+		if( radius > MAX_RADIUS )
+		{
+			throw std::invalid_argument( "Radius out of range" );
+		}
+		if( !( sigmaSpatial > 0 ) || !( sigmaRange > 0 ) )
+		{
+			throw std::invalid_argument( "Sigma must be positive" );
+		}
+
+		// Range weights up to the difference whose weight rounds to 0, then a 0.
+		std::vector< uint32_t > range;
+		for( unsigned int diff = 0; diff < MAX_RANGE_TABLE; ++diff )
+		{
+			const double w = std::exp( -( static_cast< double >( diff ) * diff ) / ( 2.0 * sigmaRange * sigmaRange ) );
+			const uint32_t weight = static_cast< uint32_t >( w * WEIGHT_ONE + 0.5 );
+			if( weight == 0 ) break;
+			range.push_back( weight );
+		}
+		range.push_back( 0 );
+		rangeSize_ = static_cast< unsigned int >( range.size() );
+
+		// Product of the two 1/WEIGHT_ONE weights, back to 1/WEIGHT_ONE so that the sum of
+		// ( 2 MAX_RADIUS + 1 )^2 weighted depths fits in 32 bits.
+		const int r = static_cast< int >( radius );
+		for( int dy = -r; dy <= r; ++dy )
+		{
+			for( int dx = -r; dx <= r; ++dx )
+			{
+				const double spatial = std::exp( -( dx * dx + dy * dy ) / ( 2.0 * sigmaSpatial * sigmaSpatial ) );
+				const uint32_t spatialWeight = static_cast< uint32_t >( spatial * WEIGHT_ONE + 0.5 );
+				for( const uint32_t rangeWeight : range )
+				{
+					weights_.push_back( static_cast< uint16_t >( ( spatialWeight * rangeWeight + WEIGHT_ONE / 2 ) / WEIGHT_ONE ) );
+				}
+			}
+		}
+	}
+
+	void BilateralDepthFilter::apply( const uint16_t* depth, uint16_t* dst ) const
+	{
+		const std::size_t tileCount = static_cast< std::size_t >( tileColumns_ ) * tileRows_;
+		for( std::size_t tile = 0; tile < tileCount; ++tile )
+		{
+			applyTile( depth, dst, tile );
+		}
+	}
+
+	void BilateralDepthFilter::apply( const uint16_t* depth, uint16_t* dst, ThreadPool& pool ) const
+	{
+		const std::size_t tileCount = static_cast< std::size_t >( tileColumns_ ) * tileRows_;
+		pool.parallelFor( tileCount, 1, [&]( std::size_t begin, std::size_t end ) {
+			for( std::size_t tile = begin; tile < end; ++tile )
+			{
+				applyTile( depth, dst, tile );
+			}
+		} );
+	}
+
+	void BilateralDepthFilter::applyTile( const uint16_t* depth, uint16_t* dst, std::size_t tile ) const
+	{
+		const int x0 = static_cast< int >( tile % tileColumns_ ) * TILE_WIDTH;
+		const int y0 = static_cast< int >( tile / tileColumns_ ) * TILE_HEIGHT;
+		const int x1 = std::min( x0 + TILE_WIDTH, static_cast< int >( width_ ) );
+		const int y1 = std::min( y0 + TILE_HEIGHT, static_cast< int >( height_ ) );
+		const int r = static_cast< int >( radius_ );
+		const int kernelWidth = 2 * r + 1;
+		const int rangeLast = static_cast< int >( rangeSize_ ) - 1;
+
+		for( int y = y0; y < y1; ++y )
+		{
+			// Halo rows come from the tiles above and below, clipped at the frame.
+			const int ky0 = std::max( y - r, 0 );
+			const int ky1 = std::min( y + r, static_cast< int >( height_ ) - 1 );
+			for( int x = x0; x < x1; ++x )
+			{
+				const int center = depth[ y * width_ + x ];
+				if( center == 0 )
+				{
+					dst[ y * width_ + x ] = 0;
+					continue;
+				}
+
+				const int kx0 = std::max( x - r, 0 );
+				const int kx1 = std::min( x + r, static_cast< int >( width_ ) - 1 );
+				uint32_t weightSum = 0;
+				uint32_t depthSum = 0;
+				for( int ky = ky0; ky <= ky1; ++ky )
+				{
+					const uint16_t* row = depth + ky * width_;
+					const uint16_t* tap = &weights_[ ( ( ky - y + r ) * kernelWidth + kx0 - x + r ) * rangeSize_ ];
+					for( int kx = kx0; kx <= kx1; ++kx, tap += rangeSize_ )
+					{
+						// Signed difference, a compare of noisy depths would defeat the branch prediction.
+						// Differences past the table take its last weight, 0, and so does an invalid neighbour.
+						const int d = row[ kx ];
+						const int diff = std::min( std::abs( d - center ), rangeLast );
+						const uint32_t w = d != 0 ? tap[ diff ] : 0;
+						weightSum += w;
+						depthSum += w * d;
+					}
+				}
+
+				// The center weighs WEIGHT_ONE, so weightSum is never 0.
+				dst[ y * width_ + x ] = static_cast< uint16_t >( ( depthSum + weightSum / 2 ) / weightSum );
+			}
+		}
+	}
+
+} // namespace kinect
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	class ThreadPool;
+
+	//! Edge-preserving smoothing of a depth frame : a bilateral filter in integer arithmetic.
+	//!
+	//! Each neighbour within radius gets the weight spatial( dx, dy ) * range( |d - center| ),
+	//! both from tables in 1/WEIGHT_ONE steps, so neighbours across a depth edge count for
+	//! nothing. Invalid 0 pixels are skipped and stay 0. The frame is cut into tiles that
+	//! read a halo of radius pixels from their neighbours; as all arithmetic is integer,
+	//! the result is the same for any number of threads.
+	class BilateralDepthFilter
+	{
+	public:
+		enum
+		{
+			MAX_RADIUS = 7,
+			TILE_WIDTH = 128,
+			TILE_HEIGHT = 32,
+			WEIGHT_ONE = 256,
+			MAX_RANGE_TABLE = 1024		// depth differences [mm] the range table covers at most
+		};
+
+		//! sigmaSpatial in pixels, sigmaRange in [mm].
+		BilateralDepthFilter( unsigned int width, unsigned int height,
+			unsigned int radius = 2, float sigmaSpatial = 1.5f, float sigmaRange = 30.0f );
+
+		//! Filter depth [mm] into dst on the calling thread. dst must not be depth.
+		void apply( const uint16_t* depth, uint16_t* dst ) const;
+
+		//! Same as above, with the tiles spread over the threads of pool.
+		void apply( const uint16_t* depth, uint16_t* dst, ThreadPool& pool ) const;
+
+		unsigned int radius() const { return radius_; }
+
+	private:
+		void applyTile( const uint16_t* depth, uint16_t* dst, std::size_t tile ) const;
+
+		unsigned int width_;
+		unsigned int height_;
+		unsigned int radius_;
+		unsigned int tileColumns_;
+		unsigned int tileRows_;
+		unsigned int rangeSize_;			// depth differences with a weight, plus the last 0
+		std::vector< uint16_t > weights_;	// spatial times range weight, rangeSize_ per kernel tap
+	};
+
+} // namespace kinect
@@ -0,0 +1,242 @@
+#include "SyntheticSource.h"
+#include <cmath>
+#include <cstring>
+
+namespace kinect
+{
+	namespace
+	{
+		//! Small deterministic random number generator for sensor noise.
+		struct Lcg
+		{
+			explicit Lcg( uint32_t seed ) : state_( seed ) {}
+			uint32_t next() {
+				state_ = state_ * 1664525u + 1013904223u;
+				return state_ >> 8;
+			}
+			uint32_t state_;
+		};
+
+		//! Is (x, y) inside the body silhouette of the pattern index?
+		bool insideBody( unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned int pattern )
+		{
+			const float phase = static_cast< float >( pattern ) / SyntheticFrameSource::PATTERN_COUNT;
+			const float cx = width * ( 0.3f + 0.4f * phase );
+			const float cy = height * 0.55f;
+			const float rx = width * 0.12f;
+			const float ry = height * 0.4f;
+			const float dx = ( x - cx ) / rx;
+			const float dy = ( y - cy ) / ry;
+			return dx * dx + dy * dy <= 1.0f;
+		}
+
+		void fillDepth( unsigned char* dst, unsigned int width, unsigned int height, unsigned int pattern )
+		{
+			Lcg rng( 1234 + pattern );
+			auto* depth = reinterpret_cast< uint16_t* >( dst );
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; ++x )
+				{
+					uint16_t d;
+					if( x < 8 || x >= width - 8 ) {
+						// Sensor returns no depth at the left and right edges.
+						d = 0;
+					}
+					else if( insideBody( x, y, width, height, pattern ) ) {
+						d = static_cast< uint16_t >( 1500 + ( rng.next() % 9 ) );
+					}
+					else {
+						// Wall behind, a bit farther at the top.
+						d = static_cast< uint16_t >( 3000 + ( height - y ) * 2 + ( rng.next() % 33 ) );
+					}
+					depth[ y * width + x ] = d;
+				}
+			}
+		}
+
+		void fillBodyIndex( unsigned char* dst, unsigned int width, unsigned int height, unsigned int pattern )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; ++x )
+				{
+					dst[ y * width + x ] = insideBody( x, y, width, height, pattern ) ? 0 : 255;
+				}
+			}
+		}
+
+		void fillRgba( unsigned char* dst, unsigned int width, unsigned int height, unsigned int pattern )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; ++x )
+				{
+					unsigned char* p = dst + ( y * width + x ) * 4;
+					const bool body = insideBody( x, y, width, height, pattern );
+					p[ 0 ] = body ? 0xEE : static_cast< unsigned char >( x * 255 / width );
+					p[ 1 ] = body ? 0x33 : static_cast< unsigned char >( y * 255 / height );
+					p[ 2 ] = body ? 0xBB : static_cast< unsigned char >( pattern * 32 );
+					p[ 3 ] = 0xFF;
+				}
+			}
+		}
+
+		void fillYuy2( unsigned char* dst, unsigned int width, unsigned int height, unsigned int pattern )
+		{
+			for( unsigned int y = 0; y < height; ++y )
+			{
+				for( unsigned int x = 0; x < width; x += 2 )
+				{
+					unsigned char* p = dst + ( y * width + x ) * 2;
+					const bool body = insideBody( x, y, width, height, pattern );
+					p[ 0 ] = body ? 0x60 : static_cast< unsigned char >( 16 + x * 219 / width );
+					p[ 1 ] = body ? 0xC0 : static_cast< unsigned char >( 16 + y * 224 / height );
+					p[ 2 ] = body ? 0x62 : static_cast< unsigned char >( 16 + ( x + 1 ) * 219 / width );
+					p[ 3 ] = body ? 0x90 : static_cast< unsigned char >( 16 + pattern * 28 );
+				}
+			}
+		}
+
+		//! Rest pose relative to SpineBase [m], in JointType order of Kinect SDK.
+		const float REST_POSE[ MAX_JOINT_COUNT ][ 3 ] = {
+			{  0.000f,  0.000f,  0.000f },	// SpineBase
+			{  0.000f,  0.051f,  0.000f },	// SpineMid
+			{  0.000f,  0.334f,  0.000f },	// Neck
+			{  0.000f,  0.549f,  0.000f },	// Head
+			{ -0.198f,  0.334f,  0.000f },	// ShoulderLeft
+			{ -0.441f,  0.334f,  0.000f },	// ElbowLeft
+			{ -0.706f,  0.334f,  0.000f },	// WristLeft
+			{ -0.788f,  0.334f,  0.000f },	// HandLeft
+			{  0.198f,  0.334f,  0.000f },	// ShoulderRight
+			{  0.441f,  0.334f,  0.000f },	// ElbowRight
+			{  0.706f,  0.334f,  0.000f },	// WristRight
+			{  0.788f,  0.334f,  0.000f },	// HandRight
+			{ -0.100f,  0.000f,  0.000f },	// HipLeft
+			{ -0.100f, -0.358f,  0.000f },	// KneeLeft
+			{ -0.100f, -0.710f,  0.000f },	// AnkleLeft
+			{ -0.100f, -0.710f, -0.115f },	// FootLeft
+			{  0.100f,  0.000f,  0.000f },	// HipRight
+			{  0.100f, -0.358f,  0.000f },	// KneeRight
+			{  0.100f, -0.710f,  0.000f },	// AnkleRight
+			{  0.100f, -0.710f, -0.115f },	// FootRight
+			{  0.000f,  0.300f,  0.000f },	// SpineShoulder
+			{ -0.860f,  0.334f,  0.000f },	// HandTipLeft
+			{ -0.800f,  0.300f,  0.000f },	// ThumbLeft
+			{  0.860f,  0.334f,  0.000f },	// HandTipRight
+			{  0.800f,  0.300f,  0.000f },	// ThumbRight
+		};
+	}
+
+	int64_t SyntheticClock::acquire( uint64_t next )
+	{
+		if( !realTime_ )
+		{
+			return static_cast< int64_t >( next );
+		}
+
+		const auto now = Clock::now();
+		if( !started_ )
+		{
+			start_ = now;
+			started_ = true;
+		}
+		const int64_t ticks = std::chrono::duration_cast< std::chrono::microseconds >( now - start_ ).count() * 10;
+		const int64_t newest = ticks / intervalTicks_;
+		return newest < static_cast< int64_t >( next ) ? -1 : newest;
+	}
+
+	SyntheticClock::Clock::time_point SyntheticClock::arrivalTime( int64_t relativeTime ) const
+	{
+		return start_ + std::chrono::microseconds( relativeTime / 10 );
+	}
+
+	SyntheticFrameSource::SyntheticFrameSource( PixelFormat format, unsigned int width, unsigned int height, bool realTime )
+		: format_( format ), width_( width ), height_( height ), bytesPerPixel_( bytesPerPixel( format ) ), frameCount_( 0 )
+	{
+		clock_.realTime_ = realTime;
+		patterns_.resize( PATTERN_COUNT );
+		for( unsigned int i = 0; i < PATTERN_COUNT; ++i )
+		{
+			auto& pattern = patterns_[ i ];
+			pattern.resize( static_cast< std::size_t >( width_ ) * height_ * bytesPerPixel_ );
+			switch( format_ )
+			{
+			case PIXEL_FORMAT_DEPTH16: fillDepth( pattern.data(), width_, height_, i ); break;
+			case PIXEL_FORMAT_BODY_INDEX8: fillBodyIndex( pattern.data(), width_, height_, i ); break;
+			case PIXEL_FORMAT_RGBA8: fillRgba( pattern.data(), width_, height_, i ); break;
+			case PIXEL_FORMAT_YUY2: fillYuy2( pattern.data(), width_, height_, i ); break;
+			}
+		}
+	}
+
+	bool SyntheticFrameSource::acquireLatestFrame( FrameView& frame )
+	{
+		const int64_t index = clock_.acquire( frameCount_ );
+		if( index < 0 )
+		{
+			return false;
+		}
+		frameCount_ = static_cast< uint64_t >( index );
+
+		frame.data = patterns_[ frameCount_ % PATTERN_COUNT ].data();
+		frame.width = width_;
+		frame.height = height_;
+		frame.bytesPerPixel = bytesPerPixel_;
+		frame.format = format_;
+		frame.relativeTime = static_cast< int64_t >( frameCount_ ) * clock_.intervalTicks_;
+		++frameCount_;
+		return true;
+	}
+
+	void SyntheticFrameSource::releaseFrame()
+	{
+	}
+
+	SyntheticBodyFrameSource::SyntheticBodyFrameSource( bool realTime )
+		: frameCount_( 0 )
+	{
+		clock_.realTime_ = realTime;
+	}
+
+	bool SyntheticBodyFrameSource::acquireLatestFrame( BodyFrame& frame )
+	{
+		const int64_t index = clock_.acquire( frameCount_ );
+		if( index < 0 )
+		{
+			return false;
+		}
+		frameCount_ = static_cast< uint64_t >( index );
+
+		memset( &frame, 0, sizeof frame );
+		frame.relativeTime = static_cast< int64_t >( frameCount_ ) * clock_.intervalTicks_;
+
+		// Walk from side to side, turning a little toward the walking direction.
+		const float t = static_cast< float >( frameCount_ ) / 30.0f;
+		const float baseX = 0.8f * std::sin( t * 0.5f );
+		const float yaw = 0.3f * std::cos( t * 0.5f );
+		const float s = std::sin( yaw * 0.5f );
+		const float c = std::cos( yaw * 0.5f );
+
+		BodyData& body = frame.bodies[ 0 ];
+		body.isTracked = true;
+		body.trackingId = 72057594037928000ull;
+		for( int j = 0; j < MAX_JOINT_COUNT; ++j )
+		{
+			JointData& joint = body.joints[ j ];
+			const float rx = REST_POSE[ j ][ 0 ];
+			const float rz = REST_POSE[ j ][ 2 ];
+			joint.position[ 0 ] = baseX + rx * std::cos( yaw ) + rz * std::sin( yaw );
+			joint.position[ 1 ] = REST_POSE[ j ][ 1 ];
+			joint.position[ 2 ] = 2.5f - rx * std::sin( yaw ) + rz * std::cos( yaw );
+			joint.orientation[ 0 ] = 0.0f;
+			joint.orientation[ 1 ] = s;
+			joint.orientation[ 2 ] = 0.0f;
+			joint.orientation[ 3 ] = c;
+			joint.trackingState = 2;
+		}
+		++frameCount_;
+		return true;
+	}
+
+} // namespace kinect
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "FrameSource.h"
+#include <chrono>
+#include <vector>
+
+namespace kinect
+{
+	//! Frame timing of the stand-ins. Free running by default,
+	//! or in real time a new frame every intervalTicks_ like the sensor.
+	struct SyntheticClock
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		SyntheticClock() : realTime_( false ), started_( false ), intervalTicks_( FRAME_INTERVAL_TICKS ) {}
+
+		//! Index of the frame to hand out, given the index of the next one in order.
+		//! In real time, skip to the newest arrived frame, or return -1 if next has not arrived.
+		int64_t acquire( uint64_t next );
+
+		//! Wall clock time the frame of relativeTime arrived at, in real time.
+		Clock::time_point arrivalTime( int64_t relativeTime ) const;
+
+		bool realTime_;
+		bool started_;
+		int64_t intervalTicks_;		// in real time, e.g. twice as long for color in low light
+		Clock::time_point start_;	// arrival of frame 0
+	};
+
+	//! Stand-in sensor for headless runs.
+	//! Unless realTime, every acquire returns a new frame at once, so the consumer runs as fast as it can.
+	//! Frames are generated up front and handed out in turn, generation cost is not measured.
+	struct SyntheticFrameSource : public FrameSource
+	{
+		enum
+		{
+			PATTERN_COUNT = 8
+		};
+
+		SyntheticFrameSource( PixelFormat format, unsigned int width, unsigned int height, bool realTime = false );
+
+		virtual bool acquireLatestFrame( FrameView& frame ) override;
+		virtual void releaseFrame() override;
+
+		//! Number of frames handed out so far, including the ones skipped in real time.
+		uint64_t frameCount() const { return frameCount_; }
+
+		PixelFormat format_;
+		unsigned int width_;
+		unsigned int height_;
+		unsigned int bytesPerPixel_;
+		uint64_t frameCount_;
+		SyntheticClock clock_;
+		std::vector< std::vector< unsigned char > > patterns_;
+	};
+
+	//! Stand-in body stream. One body walks from side to side.
+	struct SyntheticBodyFrameSource : public BodyFrameSource
+	{
+		explicit SyntheticBodyFrameSource( bool realTime = false );
+
+		virtual bool acquireLatestFrame( BodyFrame& frame ) override;
+
+		uint64_t frameCount() const { return frameCount_; }
+
+		uint64_t frameCount_;
+		SyntheticClock clock_;
+	};
+
+} // namespace kinect
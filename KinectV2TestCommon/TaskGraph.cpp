@@ -0,0 +1,200 @@
+#include "TaskGraph.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace kinect
+{
+	TaskGraph::TaskGraph()
+		: ran_( false ), elapsed_( 0 ), unfinished_( 0 )
+	{
+	}
+
+	TaskGraph::TaskId TaskGraph::add( const std::string& name, Task task,
+		const std::vector< TaskId >& dependencies, TaskThread thread )
+	{
+		if( ran_ )
+		{
+			throw std::runtime_error( "Task graph already ran" );
+		}
+		const TaskId id = nodes_.size();
+		for( const TaskId dependency : dependencies )
+		{
+			if( dependency >= id )
+			{
+				throw std::invalid_argument( "Dependency of " + name + " is not a task added before" );
+			}
+		}
+
+		Node node;
+		node.name = name;
+		node.task = task;
+		node.thread = thread;
+		node.waiting = dependencies.size();
+		node.timing.name = name;
+		node.timing.state = TASK_PENDING;
+		node.timing.start = 0;
+		node.timing.end = 0;
+		node.timing.thread = 0;
+		nodes_.push_back( node );
+		for( const TaskId dependency : dependencies )
+		{
+			nodes_[ dependency ].dependents.push_back( id );
+		}
+		return id;
+	}
+
+	void TaskGraph::run( unsigned int threadCount )
+	{
+		if( ran_ )
+		{
+			throw std::runtime_error( "Task graph already ran" );
+		}
+		ran_ = true;
+		if( nodes_.empty() )
+		{
+			return;
+		}
+		if( threadCount == 0 )
+		{
+			threadCount = static_cast< unsigned int >( std::min< std::size_t >( nodes_.size(), MAX_THREAD_COUNT ) );
+		}
+
+		begin_ = Clock::now();
+		unfinished_ = nodes_.size();
+		for( TaskId id = 0; id < nodes_.size(); ++id )
+		{
+			if( nodes_[ id ].waiting == 0 )
+			{
+				( nodes_[ id ].thread == TASK_MAIN_THREAD ? readyMain_ : readyAny_ ).push_back( id );
+			}
+		}
+
+		std::vector< std::thread > workers;
+		for( unsigned int i = 1; i < threadCount; ++i )
+		{
+			workers.push_back( std::thread( [this, i]() { runTasks( i, false ); } ) );
+		}
+		runTasks( 0, true );
+		for( auto& worker : workers )
+		{
+			worker.join();
+		}
+
+		for( const Node& node : nodes_ )
+		{
+			elapsed_ = std::max( elapsed_, node.timing.end );
+		}
+		if( error_ )
+		{
+			std::exception_ptr error = error_;
+			error_ = nullptr;
+			std::rethrow_exception( error );
+		}
+	}
+
+	void TaskGraph::runTasks( unsigned int threadIndex, bool mainThread )
+	{
+		std::unique_lock< std::mutex > lock( mutex_ );
+		for( ;; )
+		{
+			changed_.wait( lock, [&]() {
+				return unfinished_ == 0 || !readyAny_.empty() || ( mainThread && !readyMain_.empty() );
+			} );
+			if( unfinished_ == 0 )
+			{
+				return;
+			}
+
+			std::deque< TaskId >& queue = mainThread && !readyMain_.empty() ? readyMain_ : readyAny_;
+			const TaskId id = queue.front();
+			queue.pop_front();
+			Node& node = nodes_[ id ];
+			node.timing.thread = threadIndex;
+			node.timing.start = since( Clock::now() );
+			if( error_ )
+			{
+				finish( id, TASK_SKIPPED );
+				continue;
+			}
+
+			lock.unlock();
+			std::exception_ptr error;
+			try {
+				node.task();
+			}
+			catch( ... ) {
+				error = std::current_exception();
+			}
+			lock.lock();
+
+			if( error && !error_ )
+			{
+				error_ = error;
+			}
+			finish( id, error ? TASK_FAILED : TASK_DONE );
+		}
+	}
+
+	void TaskGraph::finish( TaskId id, TaskState state )
+	{
+		Node& node = nodes_[ id ];
+		node.timing.end = since( Clock::now() );
+		node.timing.state = state;
+		--unfinished_;
+		for( const TaskId dependent : node.dependents )
+		{
+			if( --nodes_[ dependent ].waiting == 0 )
+			{
+				( nodes_[ dependent ].thread == TASK_MAIN_THREAD ? readyMain_ : readyAny_ ).push_back( dependent );
+			}
+		}
+		changed_.notify_all();
+	}
+
+	double TaskGraph::since( Clock::time_point t ) const
+	{
+		return std::chrono::duration< double, std::milli >( t - begin_ ).count();
+	}
+
+	std::vector< TaskGraph::TaskTiming > TaskGraph::timeline() const
+	{
+		std::vector< TaskTiming > timings;
+		for( const Node& node : nodes_ )
+		{
+			timings.push_back( node.timing );
+		}
+		return timings;
+	}
+
+	double TaskGraph::serialTime() const
+	{
+		double sum = 0;
+		for( const Node& node : nodes_ )
+		{
+			if( node.timing.state == TASK_DONE || node.timing.state == TASK_FAILED )
+			{
+				sum += node.timing.end - node.timing.start;
+			}
+		}
+		return sum;
+	}
+
+	std::string TaskGraph::summary() const
+	{
+		static const char* const stateNames[] = { "pending", "done", "failed", "skipped" };
+
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision( 1 );
+		for( const Node& node : nodes_ )
+		{
+			ss << node.name << " : " << node.timing.start << " - " << node.timing.end << " [ms] thread "
+				<< node.timing.thread << ", " << stateNames[ node.timing.state ] << "\n";
+		}
+		ss << "elapsed " << elapsed_ << " [ms], serial " << serialTime() << " [ms]";
+		return ss.str();
+	}
+
+} // namespace kinect
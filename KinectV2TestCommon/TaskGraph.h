@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kinect
+{
+	//! Steps of a startup that depend on each other, run as soon as their dependencies are done.
+	//!
+	//! Steps that do not depend on each other, like opening the sensor and reading the shaders,
+	//! run at the same time on the threads of run(). Steps added with TASK_MAIN_THREAD only run
+	//! on the thread that calls run(), for the window and the swap chain that belong to it.
+	//! Once a task threw, the tasks not started yet are skipped, and run() rethrows the exception.
+	class TaskGraph
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+		typedef std::function< void() > Task;
+		typedef std::size_t TaskId;
+
+		enum
+		{
+			MAX_THREAD_COUNT = 8
+		};
+
+		enum TaskThread
+		{
+			TASK_ANY_THREAD,
+			TASK_MAIN_THREAD
+		};
+
+		enum TaskState
+		{
+			TASK_PENDING,
+			TASK_DONE,
+			TASK_FAILED,
+			TASK_SKIPPED
+		};
+
+		//! When a task ran, from the start of run() [ms]. Thread 0 is the one that called run().
+		struct TaskTiming
+		{
+			std::string name;
+			TaskState state;
+			double start;
+			double end;
+			unsigned int thread;
+		};
+
+		TaskGraph();
+
+		//! Add a task that runs after the tasks of dependencies, which must have been added before.
+		//! Throw std::invalid_argument if one was not, or std::runtime_error if the graph already ran.
+		TaskId add( const std::string& name, Task task,
+			const std::vector< TaskId >& dependencies = std::vector< TaskId >(), TaskThread thread = TASK_ANY_THREAD );
+
+		//! Run all tasks and return when they are done, on threadCount threads, the caller included.
+		//! threadCount 0 means one thread per task up to MAX_THREAD_COUNT, whatever the hardware
+		//! threads, as startup steps mostly wait on the sensor, the driver and the files.
+		//! Rethrow the first exception a task threw. A graph runs once.
+		void run( unsigned int threadCount = 0 );
+
+		//! Timing of each task in the order they were added.
+		std::vector< TaskTiming > timeline() const;
+
+		//! Time from the start of run() until the last task ended [ms].
+		double elapsed() const { return elapsed_; }
+
+		//! Sum of the time of the tasks that ran [ms], what the startup would take one after another.
+		double serialTime() const;
+
+		//! Report of the timeline, one line per task, plus elapsed and serial time.
+		std::string summary() const;
+
+	private:
+		TaskGraph( const TaskGraph& ) = delete;
+		TaskGraph& operator=( const TaskGraph& ) = delete;
+
+		struct Node
+		{
+			std::string name;
+			Task task;
+			TaskThread thread;
+			std::vector< TaskId > dependents;
+			std::size_t waiting;		// dependencies not finished yet
+			TaskTiming timing;
+		};
+
+		//! Run ready tasks until all are finished. mainThread also takes the TASK_MAIN_THREAD ones.
+		void runTasks( unsigned int threadIndex, bool mainThread );
+
+		//! Record the end of a task and queue the dependents it was the last dependency of.
+		void finish( TaskId id, TaskState state );
+
+		double since( Clock::time_point t ) const;
+
+		std::vector< Node > nodes_;
+		bool ran_;
+		double elapsed_;
+
+		// Current run, guarded by mutex_.
+		std::mutex mutex_;
+		std::condition_variable changed_;		// a task is ready or all are finished
+		std::deque< TaskId > readyAny_;
+		std::deque< TaskId > readyMain_;
+		std::size_t unfinished_;
+		std::exception_ptr error_;
+		Clock::time_point begin_;
+	};
+
+} // namespace kinect
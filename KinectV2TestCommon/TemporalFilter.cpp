@@ -0,0 +1,223 @@
+#include "TemporalFilter.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if KINECT_X86
+#include <immintrin.h>
+#endif
+
+namespace kinect
+{
+	namespace
+	{
+		//! Median of the valid samples of pixel i over the N slots. The newest slot gets depth[ i ] first.
+		template< unsigned int N >
+		void filterScalar( const uint16_t* depth, uint16_t* const* slots, unsigned int newest, unsigned int minValid,
+			std::size_t begin, std::size_t end, uint16_t* dst )
+		{
+			for( std::size_t i = begin; i < end; ++i )
+			{
+				slots[ newest ][ i ] = depth[ i ];
+
+				// Same sorting network as the SIMD kernels.
+				unsigned int v[ N ];
+				unsigned int zeros = 0;
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					v[ j ] = slots[ j ][ i ];
+					zeros += v[ j ] == 0;
+				}
+				for( unsigned int round = 0; round < N; ++round )
+				{
+					for( unsigned int j = round & 1; j + 1 < N; j += 2 )
+					{
+						const unsigned int lo = std::min( v[ j ], v[ j + 1 ] );
+						v[ j + 1 ] = std::max( v[ j ], v[ j + 1 ] );
+						v[ j ] = lo;
+					}
+				}
+
+				const unsigned int valid = N - zeros;
+				dst[ i ] = static_cast< uint16_t >( valid >= minValid ? v[ zeros + ( valid - 1 ) / 2 ] : 0 );
+			}
+		}
+
+#if KINECT_X86
+		//! Samples are biased by 0x8000 so that signed 16 bit compares order them as unsigned,
+		//! which puts the invalid 0 first as -32768.
+		template< unsigned int N >
+		KINECT_TARGET_SSE2
+		void filterSse2( const uint16_t* depth, uint16_t* const* slots, unsigned int newest, unsigned int minValid,
+			std::size_t count, uint16_t* dst )
+		{
+			const __m128i bias = _mm_set1_epi16( -32768 );
+			const __m128i one = _mm_set1_epi16( 1 );
+			const __m128i total = _mm_set1_epi16( N );
+			const __m128i minValidLess1 = _mm_set1_epi16( static_cast< short >( minValid - 1 ) );
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 7 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 8 )
+			{
+				const __m128i d = _mm_loadu_si128( reinterpret_cast< const __m128i* >( depth + i ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( slots[ newest ] + i ), d );
+
+				__m128i v[ N ];
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					v[ j ] = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast< const __m128i* >( slots[ j ] + i ) ), bias );
+				}
+
+				// Odd-even transposition sort, N rounds.
+				for( unsigned int round = 0; round < N; ++round )
+				{
+					for( unsigned int j = round & 1; j + 1 < N; j += 2 )
+					{
+						const __m128i lo = _mm_min_epi16( v[ j ], v[ j + 1 ] );
+						v[ j + 1 ] = _mm_max_epi16( v[ j ], v[ j + 1 ] );
+						v[ j ] = lo;
+					}
+				}
+
+				__m128i zeros = _mm_setzero_si128();
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					zeros = _mm_sub_epi16( zeros, _mm_cmpeq_epi16( v[ j ], bias ) );
+				}
+				const __m128i valid = _mm_sub_epi16( total, zeros );
+				const __m128i index = _mm_add_epi16( zeros, _mm_srai_epi16( _mm_sub_epi16( valid, one ), 1 ) );
+
+				__m128i median = _mm_setzero_si128();
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					median = _mm_or_si128( median, _mm_and_si128( _mm_cmpeq_epi16( index, _mm_set1_epi16( static_cast< short >( j ) ) ), v[ j ] ) );
+				}
+				const __m128i enough = _mm_cmpgt_epi16( valid, minValidLess1 );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( dst + i ), _mm_and_si128( enough, _mm_xor_si128( median, bias ) ) );
+			}
+			filterScalar< N >( depth, slots, newest, minValid, vectorCount, count, dst );
+		}
+
+		template< unsigned int N >
+		KINECT_TARGET_AVX2
+		void filterAvx2( const uint16_t* depth, uint16_t* const* slots, unsigned int newest, unsigned int minValid,
+			std::size_t count, uint16_t* dst )
+		{
+			const __m256i bias = _mm256_set1_epi16( -32768 );
+			const __m256i one = _mm256_set1_epi16( 1 );
+			const __m256i total = _mm256_set1_epi16( N );
+			const __m256i minValidLess1 = _mm256_set1_epi16( static_cast< short >( minValid - 1 ) );
+			const std::size_t vectorCount = count & ~static_cast< std::size_t >( 15 );
+
+			for( std::size_t i = 0; i < vectorCount; i += 16 )
+			{
+				const __m256i d = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( depth + i ) );
+				_mm256_storeu_si256( reinterpret_cast< __m256i* >( slots[ newest ] + i ), d );
+
+				__m256i v[ N ];
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					v[ j ] = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( slots[ j ] + i ) ), bias );
+				}
+
+				for( unsigned int round = 0; round < N; ++round )
+				{
+					for( unsigned int j = round & 1; j + 1 < N; j += 2 )
+					{
+						const __m256i lo = _mm256_min_epi16( v[ j ], v[ j + 1 ] );
+						v[ j + 1 ] = _mm256_max_epi16( v[ j ], v[ j + 1 ] );
+						v[ j ] = lo;
+					}
+				}
+
+				__m256i zeros = _mm256_setzero_si256();
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					zeros = _mm256_sub_epi16( zeros, _mm256_cmpeq_epi16( v[ j ], bias ) );
+				}
+				const __m256i valid = _mm256_sub_epi16( total, zeros );
+				const __m256i index = _mm256_add_epi16( zeros, _mm256_srai_epi16( _mm256_sub_epi16( valid, one ), 1 ) );
+
+				__m256i median = _mm256_setzero_si256();
+				for( unsigned int j = 0; j < N; ++j )
+				{
+					median = _mm256_or_si256( median, _mm256_and_si256( _mm256_cmpeq_epi16( index, _mm256_set1_epi16( static_cast< short >( j ) ) ), v[ j ] ) );
+				}
+				const __m256i enough = _mm256_cmpgt_epi16( valid, minValidLess1 );
+				_mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + i ), _mm256_and_si256( enough, _mm256_xor_si256( median, bias ) ) );
+			}
+			filterScalar< N >( depth, slots, newest, minValid, vectorCount, count, dst );
+		}
+#endif
+
+		template< unsigned int N >
+		void filter( SimdLevel simd, const uint16_t* depth, uint16_t* const* slots, unsigned int newest, unsigned int minValid,
+			std::size_t count, uint16_t* dst )
+		{
+			switch( simd )
+			{
+#if KINECT_X86
+			case SIMD_AVX2:
+				filterAvx2< N >( depth, slots, newest, minValid, count, dst );
+				break;
+			case SIMD_SSE2:
+				filterSse2< N >( depth, slots, newest, minValid, count, dst );
+				break;
+#endif
+			default:
+				filterScalar< N >( depth, slots, newest, minValid, 0, count, dst );
+				break;
+			}
+		}
+	}
+
+	TemporalDepthFilter::TemporalDepthFilter( unsigned int width, unsigned int height, unsigned int historySize, unsigned int minValid )
+		: width_( width ), height_( height ), historySize_( historySize ), minValid_( minValid ), newest_( 0 )
+	{
+		if( width == 0 || height == 0 )
+		{
+			throw std::invalid_argument( "Image size is 0" );
+		}
+		if( historySize == 0 || historySize > MAX_HISTORY )
+		{
+			throw std::invalid_argument( "History size out of range" );
+		}
+		if( minValid_ == 0 )
+		{
+			minValid_ = ( historySize + 1 ) / 2;
+		}
+		minValid_ = std::min( minValid_, historySize_ );
+		history_.resize( static_cast< std::size_t >( width ) * height * historySize );
+	}
+
+	void TemporalDepthFilter::apply( const uint16_t* depth, uint16_t* dst, SimdLevel simd )
+	{
+		simd = resolveSimdLevel( simd );
+		const std::size_t count = static_cast< std::size_t >( width_ ) * height_;
+		newest_ = ( newest_ + 1 ) % historySize_;
+
+		uint16_t* slots[ MAX_HISTORY ];
+		for( unsigned int j = 0; j < historySize_; ++j )
+		{
+			slots[ j ] = &history_[ j * count ];
+		}
+
+		switch( historySize_ )
+		{
+		case 1: filter< 1 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 2: filter< 2 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 3: filter< 3 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 4: filter< 4 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 5: filter< 5 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 6: filter< 6 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 7: filter< 7 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		case 8: filter< 8 >( simd, depth, slots, newest_, minValid_, count, dst ); break;
+		}
+	}
+
+	void TemporalDepthFilter::reset()
+	{
+		std::fill( history_.begin(), history_.end(), static_cast< uint16_t >( 0 ) );
+		newest_ = 0;
+	}
+
+} // namespace kinect
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kinect
+{
+	//! Per-pixel median of the last frames of a depth stream, ignoring invalid 0 samples.
+	//!
+	//! The last historySize frames are kept in a ring allocated once. A pixel is the median
+	//! of its valid samples (the lower one of an even count) if at least minValid of them
+	//! are valid, else 0. So an edge pixel that is lost every other frame stays stable
+	//! instead of flickering, and noise shrinks without blurring across pixels. Moving
+	//! surfaces lag by about historySize / 2 frames.
+	class TemporalDepthFilter
+	{
+	public:
+		enum
+		{
+			MAX_HISTORY = 8,
+			DEFAULT_HISTORY = 5
+		};
+
+		//! minValid 0 means half of historySize, rounded up.
+		TemporalDepthFilter( unsigned int width, unsigned int height,
+			unsigned int historySize = DEFAULT_HISTORY, unsigned int minValid = 0 );
+
+		//! Add a frame [mm] to the history and write the filtered frame to dst, which may be depth.
+		//! All SIMD levels give the same result.
+		void apply( const uint16_t* depth, uint16_t* dst, SimdLevel simd = SIMD_BEST );
+
+		//! Forget the history, e.g. after the sensor moved.
+		void reset();
+
+		unsigned int historySize() const { return historySize_; }
+		unsigned int minValid() const { return minValid_; }
+
+	private:
+		unsigned int width_;
+		unsigned int height_;
+		unsigned int historySize_;
+		unsigned int minValid_;
+		unsigned int newest_;				// slot of the newest frame in history_
+		std::vector< uint16_t > history_;	// historySize_ frames
+	};
+
+} // namespace kinect
@@ -0,0 +1,122 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace kinect
+{
+	ThreadPool::ThreadPool( unsigned int threadCount )
+		: body_( nullptr ), count_( 0 ), chunkSize_( 1 ), next_( 0 ), running_( 0 ), generation_( 0 ), stopping_( false )
+	{
+		if( threadCount == 0 )
+		{
+			threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+		}
+		for( unsigned int i = 1; i < threadCount; ++i )
+		{
+			workers_.push_back( std::thread( [this]() { workerLoop(); } ) );
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard< std::mutex > lock( mutex_ );
+			stopping_ = true;
+		}
+		start_.notify_all();
+		for( auto& worker : workers_ )
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::parallelFor( std::size_t count, std::size_t chunkSize, const Body& body )
+	{
+		if( count == 0 )
+		{
+			return;
+		}
+		chunkSize = std::max< std::size_t >( chunkSize, 1 );
+
+		// Not worth waking the workers for one chunk.
+		if( workers_.empty() || count <= chunkSize )
+		{
+			for( std::size_t begin = 0; begin < count; begin += chunkSize )
+			{
+				body( begin, std::min( begin + chunkSize, count ) );
+			}
+			return;
+		}
+
+		std::unique_lock< std::mutex > lock( mutex_ );
+		body_ = &body;
+		count_ = count;
+		chunkSize_ = chunkSize;
+		next_ = 0;
+		running_ = 0;
+		error_ = nullptr;
+		++generation_;
+		start_.notify_all();
+
+		runChunks( lock );
+		done_.wait( lock, [this]() { return next_ >= count_ && running_ == 0; } );
+
+		body_ = nullptr;
+		if( error_ )
+		{
+			std::exception_ptr error = error_;
+			error_ = nullptr;
+			std::rethrow_exception( error );
+		}
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		std::unique_lock< std::mutex > lock( mutex_ );
+		uint64_t generation = 0;
+		for( ;; )
+		{
+			start_.wait( lock, [&]() { return stopping_ || generation_ != generation; } );
+			if( stopping_ )
+			{
+				return;
+			}
+			generation = generation_;
+			runChunks( lock );
+		}
+	}
+
+	void ThreadPool::runChunks( std::unique_lock< std::mutex >& lock )
+	{
+		while( body_ && next_ < count_ )
+		{
+			const std::size_t begin = next_;
+			const std::size_t end = std::min( begin + chunkSize_, count_ );
+			const Body& body = *body_;
+			next_ = end;
+			++running_;
+
+			lock.unlock();
+			std::exception_ptr error;
+			try {
+				body( begin, end );
+			}
+			catch( ... ) {
+				error = std::current_exception();
+			}
+			lock.lock();
+
+			--running_;
+			if( error )
+			{
+				// Skip the chunks not started yet.
+				if( !error_ ) error_ = error;
+				next_ = count_;
+			}
+			if( next_ >= count_ && running_ == 0 )
+			{
+				done_.notify_one();
+			}
+		}
+	}
+
+} // namespace kinect
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kinect
+{
+	//! Fixed set of worker threads that run the chunks of one loop at a time.
+	//! The calling thread works on the loop too, so a pool of 1 thread has no workers.
+	class ThreadPool
+	{
+	public:
+		//! Body of a loop, called for the chunk [begin, end).
+		typedef std::function< void( std::size_t begin, std::size_t end ) > Body;
+
+		//! threadCount 0 means one thread per hardware thread.
+		explicit ThreadPool( unsigned int threadCount = 0 );
+		~ThreadPool();
+
+		//! Threads working on a loop, the caller included.
+		unsigned int threadCount() const { return static_cast< unsigned int >( workers_.size() ) + 1; }
+
+		//! Call body for the chunks of [0, count), chunkSize items each but the last,
+		//! and return when all are done. Which thread runs a chunk is not fixed, so the
+		//! result must not depend on it. Rethrow the first exception a chunk threw.
+		//! Loops are not reentrant : body must not call parallelFor of the same pool.
+		void parallelFor( std::size_t count, std::size_t chunkSize, const Body& body );
+
+	private:
+		ThreadPool( const ThreadPool& ) = delete;
+		ThreadPool& operator=( const ThreadPool& ) = delete;
+
+		void workerLoop();
+
+		//! Run chunks of the current loop until none is left.
+		void runChunks( std::unique_lock< std::mutex >& lock );
+
+		std::vector< std::thread > workers_;
+		std::mutex mutex_;
+		std::condition_variable start_;		// a loop is started or the pool stops
+		std::condition_variable done_;		// the last chunk of the loop finished
+
+		// Current loop, guarded by mutex_.
+		const Body* body_;
+		std::size_t count_;
+		std::size_t chunkSize_;
+		std::size_t next_;			// first item of the next chunk to hand out
+		std::size_t running_;		// chunks handed out and not finished yet
+		uint64_t generation_;		// incremented for each loop
+		std::exception_ptr error_;
+		bool stopping_;
+	};
+
+} // namespace kinect
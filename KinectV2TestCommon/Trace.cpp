@@ -0,0 +1,231 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace kinect
+{
+	namespace
+	{
+		static_assert( ( TRACE_EVENT_CAPACITY & ( TRACE_EVENT_CAPACITY - 1 ) ) == 0, "TRACE_EVENT_CAPACITY must be a power of 2" );
+
+		struct TraceEvent
+		{
+			const char* name;
+			uint64_t start;
+			uint64_t end;
+		};
+
+		//! Rings of all threads that traced. They are never freed, so that the events of threads
+		//! that ended stay in the trace and a thread tracing at exit does not touch a freed ring.
+		struct TraceRegistry
+		{
+			TraceRegistry() : originTicks_( traceClock() ), originTime_( std::chrono::steady_clock::now() ), clearedAt_( 0 ) {}
+
+			std::mutex mutex_;
+			std::vector< TraceBuffer* > buffers_;
+			const uint64_t originTicks_;
+			const std::chrono::steady_clock::time_point originTime_;
+			std::atomic< uint64_t > clearedAt_;
+		};
+
+		TraceRegistry& registry()
+		{
+			static TraceRegistry* instance = new TraceRegistry();
+			return *instance;
+		}
+
+		// Constructed before main, so that the clock origin precedes any event.
+		TraceRegistry& g_registry = registry();
+
+		//! Trace clock ticks per microsecond, measured against the steady clock since the origin.
+		double ticksPerMicrosecond()
+		{
+#if KINECT_X86
+			const auto calibration = std::chrono::milliseconds( TRACE_CALIBRATION_MS );
+			const auto elapsed = std::chrono::steady_clock::now() - g_registry.originTime_;
+			if( elapsed < calibration )
+			{
+				std::this_thread::sleep_for( calibration - elapsed );
+			}
+			const uint64_t ticks = traceClock() - g_registry.originTicks_;
+			const double us = std::chrono::duration< double, std::micro >( std::chrono::steady_clock::now() - g_registry.originTime_ ).count();
+			return ticks / us;
+#else
+			return 1000.0;
+#endif
+		}
+
+		//! Events a ring holds now, oldest first, without those overwritten while copying.
+		std::vector< TraceEvent > readBuffer( const TraceBuffer& buffer, uint64_t clearedAt )
+		{
+			const uint64_t written = buffer.written_.load( std::memory_order_acquire );
+			const uint64_t first = written > TRACE_EVENT_CAPACITY ? written - TRACE_EVENT_CAPACITY : 0;
+			std::vector< TraceEvent > events;
+			events.reserve( static_cast< std::size_t >( written - first ) );
+			for( uint64_t i = first; i < written; ++i )
+			{
+				const TraceEventSlot& slot = buffer.events_[ i & ( TRACE_EVENT_CAPACITY - 1 ) ];
+				TraceEvent event;
+				event.name = slot.name.load( std::memory_order_relaxed );
+				event.start = slot.start.load( std::memory_order_relaxed );
+				event.end = slot.end.load( std::memory_order_relaxed );
+				events.push_back( event );
+			}
+
+			// The writer may have lapped the copy. It is writing the slot of event
+			// rewritten - CAPACITY before it counts the event, so drop that one too.
+			std::atomic_thread_fence( std::memory_order_acquire );
+			const uint64_t rewritten = buffer.written_.load( std::memory_order_relaxed );
+			const uint64_t valid = rewritten + 1 > TRACE_EVENT_CAPACITY ? rewritten + 1 - TRACE_EVENT_CAPACITY : 0;
+			if( valid > first )
+			{
+				events.erase( events.begin(), events.begin() + static_cast< std::ptrdiff_t >( std::min( valid - first, written - first ) ) );
+			}
+			events.erase( std::remove_if( events.begin(), events.end(), [clearedAt]( const TraceEvent& e ) { return e.start < clearedAt; } ),
+				events.end() );
+			return events;
+		}
+
+		std::vector< TraceBuffer* > buffers()
+		{
+			std::lock_guard< std::mutex > lock( g_registry.mutex_ );
+			return g_registry.buffers_;
+		}
+
+		//! Nearest rank percentile of sorted values.
+		double percentile( const std::vector< double >& sorted, double p )
+		{
+			const std::size_t rank = static_cast< std::size_t >( std::ceil( p * sorted.size() ) );
+			return sorted[ std::max< std::size_t >( rank, 1 ) - 1 ];
+		}
+
+		void writeJsonString( std::ostream& os, const char* s )
+		{
+			os << '"';
+			for( ; *s; ++s )
+			{
+				if( *s == '"' || *s == '\\' ) os << '\\';
+				os << *s;
+			}
+			os << '"';
+		}
+	}
+
+	KINECT_THREAD_LOCAL TraceBuffer* t_traceBuffer = nullptr;
+
+	TraceBuffer* newTraceBuffer()
+	{
+		std::lock_guard< std::mutex > lock( g_registry.mutex_ );
+		t_traceBuffer = new TraceBuffer( static_cast< unsigned int >( g_registry.buffers_.size() ) + 1 );
+		g_registry.buffers_.push_back( t_traceBuffer );
+		return t_traceBuffer;
+	}
+
+	void setTraceThreadName( const char* name )
+	{
+		TraceBuffer* buffer = t_traceBuffer;
+		if( !buffer ) buffer = newTraceBuffer();
+		buffer->name_.store( name, std::memory_order_relaxed );
+	}
+
+	std::vector< TraceStageStats > traceStageStats( double windowMs )
+	{
+		const double ticksPerUs = ticksPerMicrosecond();
+		const uint64_t now = traceClock();
+		const uint64_t window = static_cast< uint64_t >( windowMs * 1000 * ticksPerUs );
+		const uint64_t from = now > window ? now - window : 0;
+
+		std::map< std::string, std::vector< double > > durations;
+		for( const TraceBuffer* buffer : buffers() )
+		{
+			for( const TraceEvent& event : readBuffer( *buffer, g_registry.clearedAt_.load() ) )
+			{
+				if( event.end >= from )
+				{
+					durations[ event.name ].push_back( ( event.end - event.start ) / ticksPerUs );
+				}
+			}
+		}
+
+		std::vector< TraceStageStats > stats;
+		for( auto& stage : durations )
+		{
+			std::vector< double >& d = stage.second;
+			std::sort( d.begin(), d.end() );
+			TraceStageStats s;
+			s.name = stage.first;
+			s.count = d.size();
+			s.p50 = percentile( d, 0.5 );
+			s.p99 = percentile( d, 0.99 );
+			s.max = d.back();
+			stats.push_back( s );
+		}
+		return stats;
+	}
+
+	std::string traceSummary( double windowMs )
+	{
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision( 1 );
+		for( const TraceStageStats& s : traceStageStats( windowMs ) )
+		{
+			ss << s.name << " : " << s.count << " times, [us] p50 " << s.p50 << " p99 " << s.p99 << " max " << s.max << "\n";
+		}
+		return ss.str();
+	}
+
+	void writeChromeTrace( const char* path )
+	{
+		const double ticksPerUs = ticksPerMicrosecond();
+		const uint64_t origin = g_registry.originTicks_;
+		const uint64_t clearedAt = g_registry.clearedAt_.load();
+
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision( 3 );
+		ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		for( const TraceBuffer* buffer : buffers() )
+		{
+			const char* threadName = buffer->name_.load( std::memory_order_relaxed );
+			if( threadName )
+			{
+				ss << ( first ? "\n" : ",\n" ) << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id_ << ",\"args\":{\"name\":";
+				writeJsonString( ss, threadName );
+				ss << "}}";
+				first = false;
+			}
+			for( const TraceEvent& event : readBuffer( *buffer, clearedAt ) )
+			{
+				ss << ( first ? "\n" : ",\n" ) << "{\"name\":";
+				writeJsonString( ss, event.name );
+				ss << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id_
+					<< ",\"ts\":" << ( event.start - origin ) / ticksPerUs << ",\"dur\":" << ( event.end - event.start ) / ticksPerUs << "}";
+				first = false;
+			}
+		}
+		ss << "\n]}\n";
+
+		const std::string json = ss.str();
+		FILE* fp = fopen( path, "wb" );
+		if( !fp ) throw std::runtime_error( std::string( "Cannot create file : " ) + path );
+		const bool ok = fwrite( json.data(), 1, json.size(), fp ) == json.size();
+		const bool closed = fclose( fp ) == 0;
+		if( !ok || !closed ) throw std::runtime_error( std::string( "Cannot write file : " ) + path );
+	}
+
+	void clearTrace()
+	{
+		g_registry.clearedAt_.store( traceClock() );
+	}
+
+} // namespace kinect
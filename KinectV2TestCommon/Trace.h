@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Cpu.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Scoped timing of the frame path stages. Build with KINECT_TRACE=0 to compile it out :
+// the macros then expand to nothing.
+#ifndef KINECT_TRACE
+#define KINECT_TRACE 1
+#endif
+
+#if KINECT_X86
+#if defined( _MSC_VER )
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+#if defined( _MSC_VER )
+#define KINECT_THREAD_LOCAL __declspec( thread )
+#else
+#define KINECT_THREAD_LOCAL __thread
+#endif
+
+#define KINECT_TRACE_CONCAT_( a, b ) a##b
+#define KINECT_TRACE_CONCAT( a, b ) KINECT_TRACE_CONCAT_( a, b )
+
+#if KINECT_TRACE
+//! Time the rest of the enclosing block as the stage name, a string literal.
+#define KINECT_TRACE_SCOPE( name ) ::kinect::TraceScope KINECT_TRACE_CONCAT( traceScope, __LINE__ )( name )
+//! Name the calling thread in the exported trace, a string literal.
+#define KINECT_TRACE_THREAD( name ) ::kinect::setTraceThreadName( name )
+#else
+#define KINECT_TRACE_SCOPE( name ) ( ( void )0 )
+#define KINECT_TRACE_THREAD( name ) ( ( void )0 )
+#endif
+
+namespace kinect
+{
+	//! Each thread records its events into a ring of its own, without locking; the oldest
+	//! are overwritten. The rings are read for the stage statistics and the Chrome trace,
+	//! which see the last TRACE_EVENT_CAPACITY - 1 events of each thread.
+	enum
+	{
+		TRACE_EVENT_CAPACITY = 1 << 14,		// events per thread, a power of 2
+		TRACE_CALIBRATION_MS = 10			// clock calibration time at least
+	};
+
+	//! Time stamp of the trace clock : the time stamp counter on x86, else the steady clock [ns].
+	inline uint64_t traceClock()
+	{
+#if KINECT_X86
+		return __rdtsc();
+#else
+		return static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
+	}
+
+	//! Fields are relaxed atomics, plain stores on x86, so that a reader may copy an event
+	//! while its thread overwrites it. Such copies are dropped by the reader.
+	struct TraceEventSlot
+	{
+		std::atomic< const char* > name;
+		std::atomic< uint64_t > start;
+		std::atomic< uint64_t > end;
+	};
+
+	//! Ring of one thread.
+	struct TraceBuffer
+	{
+		explicit TraceBuffer( unsigned int id ) : id_( id ), name_( nullptr ), written_( 0 ), events_( new TraceEventSlot[ TRACE_EVENT_CAPACITY ] ) {}
+
+		unsigned int id_;
+		std::atomic< const char* > name_;
+		std::atomic< uint64_t > written_;		// events recorded so far, the next slot modulo the capacity
+		std::unique_ptr< TraceEventSlot[] > events_;
+	};
+
+	//! Ring of the calling thread, nullptr until it records its first event.
+	extern KINECT_THREAD_LOCAL TraceBuffer* t_traceBuffer;
+
+	//! Make and register the ring of the calling thread.
+	TraceBuffer* newTraceBuffer();
+
+	//! Record a stage that ran from start to end on the calling thread.
+	//! name is kept as a pointer, so it must outlive the trace, like a string literal.
+	//! Inline, so that a scope costs little more than its two clock reads.
+	inline void traceEvent( const char* name, uint64_t start, uint64_t end )
+	{
+		TraceBuffer* buffer = t_traceBuffer;
+		if( !buffer ) buffer = newTraceBuffer();
+		const uint64_t index = buffer->written_.load( std::memory_order_relaxed );
+		TraceEventSlot& slot = buffer->events_[ index & ( TRACE_EVENT_CAPACITY - 1 ) ];
+
+		// A reader that sees a field of this event also sees the count before it, see readBuffer().
+		std::atomic_thread_fence( std::memory_order_release );
+		slot.name.store( name, std::memory_order_relaxed );
+		slot.start.store( start, std::memory_order_relaxed );
+		slot.end.store( end, std::memory_order_relaxed );
+		buffer->written_.store( index + 1, std::memory_order_release );
+	}
+
+	//! Name of the calling thread in the exported trace, kept as a pointer like the stage names.
+	void setTraceThreadName( const char* name );
+
+	//! Records the time from construction to destruction as a stage.
+	class TraceScope
+	{
+	public:
+		explicit TraceScope( const char* name ) : name_( name ), start_( traceClock() ) {}
+		~TraceScope() { traceEvent( name_, start_, traceClock() ); }
+
+	private:
+		TraceScope( const TraceScope& ) = delete;
+		TraceScope& operator=( const TraceScope& ) = delete;
+
+		const char* name_;
+		uint64_t start_;
+	};
+
+	//! Durations of a stage over a window [us].
+	struct TraceStageStats
+	{
+		std::string name;
+		uint64_t count;
+		double p50;
+		double p99;
+		double max;
+	};
+
+	//! Statistics of the stages that ended in the last windowMs on any thread, sorted by name.
+	//! Stages with more events than the rings hold for the window count the newest ones only.
+	std::vector< TraceStageStats > traceStageStats( double windowMs );
+
+	//! Report of traceStageStats(), one line per stage.
+	std::string traceSummary( double windowMs );
+
+	//! Write the events kept by the rings as Chrome trace event JSON, for chrome://tracing and
+	//! Perfetto. Throw std::runtime_error if the file cannot be written.
+	void writeChromeTrace( const char* path );
+
+	//! Forget the events recorded so far.
+	void clearTrace();
+
+} // namespace kinect
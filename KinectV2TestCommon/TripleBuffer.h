@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+namespace kinect
+{
+	//! Lock-free handoff of the newest value from one producer thread to one consumer thread.
+	//!
+	//! Three slots : the producer writes the back slot, the consumer reads the front slot,
+	//! and the middle slot holds the newest published value. publish() and update() swap
+	//! their own slot with the middle one, so neither side ever waits or copies.
+	//! Values the consumer did not pick up in time are overwritten.
+	template< class T >
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer() : back_( 0 ), middle_( 1 ), front_( 2 ) {}
+
+		//! Producer : slot to fill. Keeps its contents from the value published two turns ago.
+		T& writeBuffer() { return buffers_[ back_ ]; }
+
+		//! Producer : make the written slot the newest value.
+		void publish()
+		{
+			back_ = middle_.exchange( back_ | FRESH, std::memory_order_acq_rel ) & INDEX_MASK;
+		}
+
+		//! Consumer : take the newest value if one was published since the last call.
+		//! Return false and keep the current read slot otherwise.
+		bool update()
+		{
+			if( !( middle_.load( std::memory_order_relaxed ) & FRESH ) )
+			{
+				return false;
+			}
+			front_ = middle_.exchange( front_, std::memory_order_acq_rel ) & INDEX_MASK;
+			return true;
+		}
+
+		//! Consumer : value taken by the last successful update().
+		const T& readBuffer() const { return buffers_[ front_ ]; }
+		T& readBuffer() { return buffers_[ front_ ]; }
+
+	private:
+		TripleBuffer( const TripleBuffer& ) = delete;
+		TripleBuffer& operator=( const TripleBuffer& ) = delete;
+
+		enum
+		{
+			INDEX_MASK = 3,
+			FRESH = 4		// middle slot was published and not taken yet
+		};
+
+		T buffers_[ 3 ];
+
+		// Each index on its own cache line, written by one side only.
+		unsigned int back_;
+		char pad0_[ 64 ];
+		std::atomic< unsigned int > middle_;
+		char pad1_[ 64 ];
+		unsigned int front_;
+	};
+
+} // namespace kinect
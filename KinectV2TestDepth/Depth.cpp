@@ -1,25 +1,34 @@
 #include <Windows.h>
 #include <tchar.h>
-#include <Kinect.h>
 #include <d3d11.h>
-#include <fstream>
-#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <array>
 #include <memory>
-#include <filesystem>
 #include <exception>
+#include "../KinectV2TestCommon/AcquisitionThread.h"
+#include "../KinectV2TestCommon/AppShell.h"
+#include "../KinectV2TestCommon/AssetLoader.h"
+#include "../KinectV2TestCommon/DepthProcessor.h"
+#include "../KinectV2TestCommon/FrameCopy.h"
+#include "../KinectV2TestCommon/KinectSensor.h"
+#include "../KinectV2TestCommon/Recording.h"
+#include "../KinectV2TestCommon/SyntheticSource.h"
+#include "../KinectV2TestCommon/TaskGraph.h"
+#include "../KinectV2TestCommon/Trace.h"
 
-#pragma comment( lib, "kinect20.lib" )
 #pragma comment( lib, "d3d11.lib" )
 
 namespace
 {
 	const TCHAR* g_appName = _T( "Kinect Depth" );
+	const char* g_recordingPath = "depth.kv2rec";
+	const char* g_tracePath = "depth.trace.json";
 	const int g_windowWidth = 640;
 	const int g_windowHeight = 530;
+	const unsigned int g_frameWidth = 512;
+	const unsigned int g_frameHeight = 424;
 }
 
 //! Custom deleter of std::unique_ptr for COM instance.
@@ -40,83 +49,10 @@ void Assert( HRESULT hr )
 	}
 }
 
-//! Read all binary data from file.
-std::string fileGetContents( const char* path )
-{
-	// Get directory name of exe file.
-	namespace sys = std::tr2::sys;
-	auto exeDir = sys::path( __argv[ 0 ] ).parent_path();
-
-	std::stringstream newPathSS;
-	newPathSS << exeDir << sys::slash< sys::path >::value << path;
-	auto newPath = newPathSS.str();
-
-	// Read and copy all.
-	std::ifstream ifs( newPath, std::ios::binary );
-	std::string str(
-		(std::istreambuf_iterator< char >( ifs )),
-		std::istreambuf_iterator< char >()
-		);
-
-	// Error occurs if file not found or empty file.
-	if( str.size() == 0 )
-	{
-		std::stringstream ss;
-		ss << "File not found : " << path;
-		throw std::runtime_error( ss.str() );
-	}
-	return str;
-}
-
-struct Kinect
-{
-	enum
-	{
-		MAX_DEPTH_FRAME_WIDTH = 512,
-		MAX_DEPTH_FRAME_HEIGHT = 424,
-		MAX_DEPTH_FRAME_BYTE_PER_PIXEL = 2
-	};
-
-	void init()
-	{
-		HRESULT hr;
-
-		IKinectSensor* sensor;
-		hr = GetDefaultKinectSensor( &sensor );
-		Assert( hr );
-		sensor_.reset( sensor );
-
-		hr = sensor_->Open();
-		Assert( hr );
-
-		// Sensor -> Depth Source
-		IDepthFrameSource* depthSource;
-		hr = sensor_->get_DepthFrameSource( &depthSource );
-		Assert( hr );
-		depthSource_.reset( depthSource );
-
-		// Depth Source -> Depth Reader
-		IDepthFrameReader* depthReader;
-		hr = depthSource_->OpenReader( &depthReader );
-		Assert( hr );
-		depthReader_.reset( depthReader );
-	}
-
-	void release()
-	{
-		sensor_->Close();
-	}
-
-	std::unique_ptr< IKinectSensor, Deleter > sensor_;
-	std::unique_ptr< IDepthFrameSource, Deleter > depthSource_;
-	std::unique_ptr< IDepthFrameReader, Deleter > depthReader_;
-
-	//std::array< unsigned char, (MAX_DEPTH_FRAME_WIDTH * MAX_DEPTH_FRAME_HEIGHT * MAX_DEPTH_FRAME_BYTE_PER_PIXEL) > depthFrame_;
-};
-
 struct D3D
 {
-	void init( HWND hWnd )
+	//! Device and swap chain of the window.
+	void initDevice( HWND hWnd )
 	{
 		HRESULT hr;
 
@@ -160,6 +96,12 @@ struct D3D
 		Assert( hr );
 		backBufferRTV_.reset( backBufferRTV );
 		backBuffer->Release();
+	}
+
+	//! States, shaders and buffers, once the device is made and the shaders are loaded.
+	void initResources( kinect::AssetLoader& assets )
+	{
+		HRESULT hr;
 
 		// Common state
 
@@ -191,7 +133,7 @@ struct D3D
 		ID3D11Texture2D* tex;
 		D3D11_TEXTURE2D_DESC texDesc;
 		texDesc = CD3D11_TEXTURE2D_DESC(
-			DXGI_FORMAT_R16_UNORM, Kinect::MAX_DEPTH_FRAME_WIDTH, Kinect::MAX_DEPTH_FRAME_HEIGHT, 1, 1,
+			DXGI_FORMAT_R16_UNORM, g_frameWidth, g_frameHeight, 1, 1,
 			D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
 		hr = device_->CreateTexture2D( &texDesc, nullptr, &tex );
 		Assert( hr );
@@ -207,18 +149,15 @@ struct D3D
 		Assert( hr );
 		depthFrameSRV_.reset( srv );
 
-		std::string binData;
 		ID3D11VertexShader* vs;
-		binData = fileGetContents( "def.vs.cso" );
-		hr = device_->CreateVertexShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &vs );
+		const kinect::AssetSpan vsBin = assets.load( "def.vs.cso" );
+		hr = device_->CreateVertexShader( vsBin.data, vsBin.size, nullptr, &vs );
 		Assert( hr );
 		fullscreenVS_.reset( vs );
 
 		ID3D11PixelShader* ps;
-		binData = fileGetContents( "def.ps.cso" );
-		hr = device_->CreatePixelShader(
-			reinterpret_cast< const void* >( binData.c_str() ), binData.size(), nullptr, &ps );
+		const kinect::AssetSpan psBin = assets.load( "def.ps.cso" );
+		hr = device_->CreatePixelShader( psBin.data, psBin.size, nullptr, &ps );
 		Assert( hr );
 		texPS_.reset( ps );
 	}
@@ -243,50 +182,83 @@ struct D3D
 
 namespace
 {
-	HWND g_hWnd = NULL;
-	Kinect g_kinect;
+	kinect::KinectSensor g_sensor;
 	D3D g_d3d;
+
+	//! Frame source of the acquisition thread, the sensor or the stand-in.
+	kinect::FrameSource* g_source = nullptr;
+	std::unique_ptr< kinect::SyntheticFrameSource > g_synthetic;
+	std::unique_ptr< kinect::RecordingReader > g_replay;
+	std::unique_ptr< kinect::RecordingWriter > g_recorder;
+	kinect::AcquisitionThread< kinect::FrameBuffer > g_acquisition;
+
+	//! Filters and points of the frames, with "-denoise", "-smooth" and "-pointcloud".
+	std::unique_ptr< kinect::DepthProcessor > g_processor;
+	bool g_cameraSpaceTableSet = false;	// rays of the sensor, once it sent its calibration
 }
 
-void Step()
+//! Runs on the acquisition thread.
+bool Acquire( kinect::FrameBuffer& buffer )
 {
+	if( !kinect::copyLatestFrame( *g_source, buffer ) )
+	{
+		return false;
+	}
+
+	if( g_recorder )
+	{
+		g_recorder->write( buffer.view_ );
+	}
+
+	// Every frame goes through the filter, also those the render loop skips.
+	g_processor->denoise( reinterpret_cast< uint16_t* >( buffer.pixels_.data() ) );
+	return true;
+}
+
+//! Return whether a new frame was taken.
+bool Step()
+{
+	KINECT_TRACE_SCOPE( "Step" );
+
 	HRESULT hr;
 
-	IDepthFrame* frame;
-	hr = g_kinect.depthReader_->AcquireLatestFrame( &frame );
-	if( hr == E_PENDING )
+	const kinect::FrameBuffer* frame = g_acquisition.latest();
+	if( !frame )
 	{
-		return;
+		return false;
 	}
-	Assert( hr );
 
-	UINT frameSize;
-	UINT16* framePtr;
-	hr = frame->AccessUnderlyingBuffer( &frameSize, &framePtr );
-	Assert( hr );
+	// Points through the rays of this sensor once it sent them, else of a typical one.
+	if( ( g_processor->flags() & kinect::DEPTH_POINT_CLOUD ) && !g_cameraSpaceTableSet && g_source == g_sensor.sources().depth_ )
+	{
+		const std::vector< float > table = g_sensor.depthToCameraSpaceTable();
+		if( !table.empty() )
+		{
+			g_processor->setCameraSpaceTable( table.data() );
+			g_cameraSpaceTableSet = true;
+		}
+	}
+	const kinect::FrameView view = g_processor->process( frame->view_ );
 
 	// Copy pixels to Direct3D texture.
 	D3D11_MAPPED_SUBRESOURCE map;
-	D3D11_TEXTURE2D_DESC texDesc;
-	hr = g_d3d.context_->Map( g_d3d.depthFrame_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	{
+		KINECT_TRACE_SCOPE( "Map" );
+		hr = g_d3d.context_->Map( g_d3d.depthFrame_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map );
+	}
 	Assert( hr );
-	g_d3d.depthFrame_->GetDesc( &texDesc );
-	for( unsigned int y = 0; y < texDesc.Height; ++y )
+	kinect::copyFrame( view, reinterpret_cast< unsigned char* >( map.pData ), map.RowPitch );
 	{
-		const int copySize = Kinect::MAX_DEPTH_FRAME_WIDTH * Kinect::MAX_DEPTH_FRAME_BYTE_PER_PIXEL;
-		auto* destStart = reinterpret_cast< unsigned char* >( map.pData ) + map.RowPitch * y;
-		const auto* srcStart = reinterpret_cast< unsigned char* >( framePtr ) + y * copySize;
-		const auto* srcEnd = srcStart + copySize;
-		const auto dest = stdext::make_checked_array_iterator( destStart, copySize );
-		std::copy( srcStart, srcEnd, dest );
+		KINECT_TRACE_SCOPE( "Unmap" );
+		g_d3d.context_->Unmap( g_d3d.depthFrame_.get(), 0 );
 	}
-	g_d3d.context_->Unmap( g_d3d.depthFrame_.get(), 0 );
-
-	frame->Release();
+	return true;
 }
 
 void Draw()
 {
+	KINECT_TRACE_SCOPE( "Draw" );
+
 	ID3D11DeviceContext* context = g_d3d.context_.get();
 	
 	// Clear
@@ -309,65 +281,78 @@ void Draw()
 	context->RSSetViewports( 1, &viewport );
 	context->Draw( 4, 0 );
 
-	g_d3d.swapChain_->Present( 1, 0 );
+	{
+		KINECT_TRACE_SCOPE( "Present" );
+		g_d3d.swapChain_->Present( 1, 0 );
+	}
 }
 
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
-	nCmdShow; lpCmdLine; hPrevInstance;
-
-	WNDCLASS wcls;
-	memset( &wcls, 0, sizeof wcls );
-	wcls.style = CS_HREDRAW | CS_VREDRAW;
-	wcls.lpfnWndProc = []( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam ) -> LRESULT {
-		switch( message ) {
-		case WM_KEYDOWN:
-			if( wParam == VK_ESCAPE ) {
-				PostMessage( hWnd, WM_DESTROY, 0, 0 );
-				return 0;
-			}
-			break;
-		case WM_DESTROY:
-			PostQuitMessage( 0 );
-			break;
-		}
-		return DefWindowProc( hWnd, message, wParam, lParam );
-	};
-	wcls.hInstance = hInstance;
-	wcls.lpszClassName = g_appName;
-	RegisterClass( &wcls );
-
-	RECT rect = { 0, 0, g_windowWidth, g_windowHeight };
-	AdjustWindowRect( &rect, WS_OVERLAPPEDWINDOW, FALSE );
-
-	const int windowWidth  = ( rect.right  - rect.left );
-	const int windowHeight = ( rect.bottom - rect.top );
-	g_hWnd = CreateWindow( g_appName, g_appName, WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, windowWidth, windowHeight, NULL, NULL, hInstance, NULL );
-
-	ShowWindow( g_hWnd, SW_SHOW );
+	nCmdShow; hPrevInstance;
+	kinect::AppShell shell( hInstance, g_appName, g_windowWidth, g_windowHeight, lpCmdLine );
 
 	try {
-		g_kinect.init();
-		g_d3d.init( g_hWnd );
-
-		MSG msg;
-		memset( &msg, 0, sizeof msg );
-		while( msg.message != WM_QUIT ) {
-			BOOL r = PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE );
-			if( r == 0 ) {
-				Step();
-				Draw();
+		// Both read and write g_recordingPath : recording while replaying would truncate the file being read.
+		if( shell.hasOption( "-replay" ) && shell.hasOption( "-record" ) ) {
+			throw std::runtime_error( "-replay and -record can not be used together" );
+		}
+
+		kinect::TaskGraph& startup = shell.startup();
+		const kinect::TaskGraph::TaskId sensor = startup.add( "sensor", [&shell]() {
+			// "-synthetic" runs without the sensor, "-replay" plays the recording back.
+			if( shell.hasOption( "-synthetic" ) ) {
+				g_synthetic.reset( new kinect::SyntheticFrameSource(
+					kinect::PIXEL_FORMAT_DEPTH16, g_frameWidth, g_frameHeight, true ) );
+				g_source = g_synthetic.get();
+			}
+			else if( shell.hasOption( "-replay" ) ) {
+				g_replay.reset( new kinect::RecordingReader( g_recordingPath ) );
+				g_source = g_replay.get();
 			}
 			else {
-				DispatchMessage( &msg );
+				g_sensor.open( kinect::STREAM_FLAG_DEPTH );
+				g_source = g_sensor.sources().depth_;
 			}
-		}
+		} );
 
+		// "-record" saves every frame to the recording.
+		const kinect::TaskGraph::TaskId recorder = startup.add( "recorder", [&shell]() {
+			if( shell.hasOption( "-record" ) ) {
+				g_recorder.reset( new kinect::RecordingWriter(
+					g_recordingPath, kinect::PIXEL_FORMAT_DEPTH16, g_frameWidth, g_frameHeight ) );
+			}
+		} );
+
+		const kinect::TaskGraph::TaskId filters = startup.add( "filters", [&shell]() {
+			// "-denoise" smooths the depth over the last frames, "-smooth" filters each frame
+			// shown keeping the edges, "-pointcloud" makes the camera space points of each.
+			unsigned int flags = 0;
+			if( shell.hasOption( "-denoise" ) ) flags |= kinect::DEPTH_DENOISE;
+			if( shell.hasOption( "-smooth" ) ) flags |= kinect::DEPTH_SMOOTH;
+			if( shell.hasOption( "-pointcloud" ) ) flags |= kinect::DEPTH_POINT_CLOUD;
+			g_processor.reset( new kinect::DepthProcessor( g_frameWidth, g_frameHeight, flags ) );
+		} );
+
+		shell.addDeviceSteps( { "def.vs.cso", "def.ps.cso" },
+			[]( HWND hWnd ) { g_d3d.initDevice( hWnd ); },
+			[]( kinect::AssetLoader& assets ) { g_d3d.initResources( assets ); } );
+
+		startup.add( "acquisition", [&shell]() {
+			shell.startAcquisition( g_acquisition, *g_source, Acquire );
+		}, { sensor, recorder, filters } );
+		shell.runStartup();
+
+		shell.run( Step, Draw, g_tracePath );
+		if( g_processor->flags() != 0 ) {
+			OutputDebugStringA( ( g_processor->summary() + "\n" ).c_str() );
+		}
+		g_recorder.reset();
 		g_d3d.release();
-		g_kinect.release();
+		g_sensor.close();
 	}
 	catch( std::exception &e ) {
-		MessageBoxA( g_hWnd, e.what(), nullptr, MB_ICONSTOP );
+		MessageBoxA( shell.window(), e.what(), nullptr, MB_ICONSTOP );
 	}
 
 	return 0;